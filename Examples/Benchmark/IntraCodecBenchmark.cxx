@@ -0,0 +1,227 @@
+/*=========================================================================
+
+  Program:   Open IGT Link -- Benchmark for the intra-only video codec
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "igtlIntraEncoder.h"
+#include "igtlIntraDecoder.h"
+#include "igtlMultiThreader.h"
+#include "igtlTimeStamp.h"
+#include "igtlVideoMessage.h"
+
+// Encodes and decodes I420 frames with IntraEncoder/IntraDecoder with an increasing number of
+// threads, and reports the compression ratio against the uncompressed I420 stream sent by
+// I420Encoder, the frame rate and the throughput of each configuration.
+// The frames are either synthetic (a moving gradient over a flat background with a noisy band),
+// or read from a raw 8-bit gray image file, e.g. Testing/img/igtlTestImage1.raw (256 x 256).
+
+double GetTimeInSecond();
+void CreateSyntheticFrame(std::vector<igtl_uint8>& frame, int width, int height, int index);
+int RunBenchmark(std::vector<std::vector<igtl_uint8> >& frames, int width, int height, int maximumError, int numberOfThreads);
+
+int main(int argc, char* argv[])
+{
+  //------------------------------------------------------------
+  // Parse Arguments
+
+  if (argc != 1 && argc != 5 && argc != 6) // check number of arguments
+    {
+    // If not correct, print usage
+    std::cerr << "Usage: " << argv[0] << " [<width> <height> <frames> <maxerror> [<file>]]" << std::endl;
+    std::cerr << "    <width>    : Width of the frames (default 640)" << std::endl;
+    std::cerr << "    <height>   : Height of the frames (default 480)" << std::endl;
+    std::cerr << "    <frames>   : Number of frames encoded with each configuration (default 50)" << std::endl;
+    std::cerr << "    <maxerror> : Maximum error per pixel, 0 for lossless (default 0)" << std::endl;
+    std::cerr << "    <file>     : Raw 8-bit gray image file used as the luma plane (default synthetic frames)" << std::endl;
+    exit(0);
+    }
+
+  int width = 640;
+  int height = 480;
+  int numberOfFrames = 50;
+  int maximumError = 0;
+  if (argc >= 5)
+    {
+    width          = atoi(argv[1]);
+    height         = atoi(argv[2]);
+    numberOfFrames = atoi(argv[3]);
+    maximumError   = atoi(argv[4]);
+    }
+  if (width < 2 || height < 2 || (width & 1) || (height & 1) || numberOfFrames < 1)
+    {
+    std::cerr << "The width and height must be even, and at least one frame must be encoded." << std::endl;
+    exit(0);
+    }
+
+  int lumaSize = width * height;
+  std::vector<std::vector<igtl_uint8> > frames;
+  if (argc == 6)
+    {
+    FILE* fp = fopen(argv[5], "rb");
+    if (fp == NULL)
+      {
+      std::cerr << "Cannot open " << argv[5] << std::endl;
+      exit(0);
+      }
+    std::vector<igtl_uint8> frame(lumaSize * 3 / 2, 128);
+    while ((int)frames.size() < numberOfFrames && fread(&frame[0], 1, lumaSize, fp) == (size_t)lumaSize)
+      {
+      frames.push_back(frame);
+      }
+    fclose(fp);
+    if (frames.size() == 0)
+      {
+      std::cerr << "The file is smaller than one frame." << std::endl;
+      exit(0);
+      }
+    }
+  else
+    {
+    for (int i = 0; i < numberOfFrames; i++)
+      {
+      frames.push_back(std::vector<igtl_uint8>());
+      CreateSyntheticFrame(frames.back(), width, height, i);
+      }
+    }
+
+  std::cout << "Frames: " << frames.size() << " x " << width << "x" << height << " I420, "
+            << (lumaSize * 3 / 2) << " bytes uncompressed, maximum error " << maximumError << std::endl;
+  std::cout << std::setw(8) << "Threads" << std::setw(10) << "Ratio"
+            << std::setw(14) << "Enc (ms/fr)" << std::setw(14) << "Enc (MB/s)"
+            << std::setw(14) << "Dec (ms/fr)" << std::setw(14) << "Dec (MB/s)" << std::endl;
+
+  int maxThreads = igtl::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  for (int numberOfThreads = 1; numberOfThreads <= maxThreads; numberOfThreads *= 2)
+    {
+    if (RunBenchmark(frames, width, height, maximumError, numberOfThreads) < 0)
+      {
+      return 1;
+      }
+    }
+  return 0;
+}
+
+
+double GetTimeInSecond()
+{
+  igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+  ts->GetTime();
+  return ts->GetTimeStamp();
+}
+
+
+void CreateSyntheticFrame(std::vector<igtl_uint8>& frame, int width, int height, int index)
+{
+  int lumaSize = width * height;
+  frame.resize(lumaSize * 3 / 2);
+  for (int y = 0; y < height; y++)
+    {
+    for (int x = 0; x < width; x++)
+      {
+      int value = 30;
+      if (x > width / 8 && x < width * 7 / 8 && y > height / 8 && y < height * 7 / 8)
+        {
+        // Moving gradient
+        value = ((x + index * 4) / 2 + y / 3) & 0xFF;
+        }
+      if (y > height * 7 / 8)
+        {
+        // Noisy band
+        value = 100 + (rand() & 0x1F);
+        }
+      frame[y * width + x] = (igtl_uint8)value;
+      }
+    }
+  memset(&frame[lumaSize], 128, lumaSize / 2);
+}
+
+
+int RunBenchmark(std::vector<std::vector<igtl_uint8> >& frames, int width, int height, int maximumError, int numberOfThreads)
+{
+  int lumaSize = width * height;
+  int frameSize = lumaSize * 3 / 2;
+  igtl::IntraEncoder::Pointer encoder = igtl::IntraEncoder::New();
+  igtl::IntraDecoder::Pointer decoder = igtl::IntraDecoder::New();
+  if (encoder->SetMaximumError(maximumError) < 0)
+    {
+    std::cerr << "The maximum error must be between 0 and " << IGTL_INTRA_CODEC_MAXIMUM_ERROR << std::endl;
+    return -1;
+    }
+  encoder->SetNumberOfThreads(numberOfThreads);
+  decoder->SetNumberOfThreads(numberOfThreads);
+
+  igtl::SourcePicture source;
+  source.colorFormat = igtl::FormatI420;
+  source.picWidth = width;
+  source.picHeight = height;
+  source.stride[0] = width;
+  source.stride[1] = source.stride[2] = width >> 1;
+  std::vector<igtl_uint8> decodedFrame(frameSize);
+  igtl::SourcePicture decoded;
+  decoded.data[0] = &decodedFrame[0];
+
+  double encodeTime = 0.0;
+  double decodeTime = 0.0;
+  double compressedSize = 0.0;
+  int mismatches = 0;
+  for (unsigned int i = 0; i < frames.size(); i++)
+    {
+    // A new message for each frame, as VideoStreamIGTLinkServer does.
+    igtl::VideoMessage::Pointer videoMessage = igtl::VideoMessage::New();
+    source.data[0] = &frames[i][0];
+    source.data[1] = source.data[0] + lumaSize;
+    source.data[2] = source.data[1] + lumaSize / 4;
+
+    double start = GetTimeInSecond();
+    if (encoder->EncodeSingleFrameIntoVideoMSG(&source, videoMessage) != igtl::ResultSuccess)
+      {
+      std::cerr << "Encoding failed." << std::endl;
+      return -1;
+      }
+    encodeTime += GetTimeInSecond() - start;
+    compressedSize += videoMessage->GetBitStreamSize();
+
+    start = GetTimeInSecond();
+    if (decoder->DecodeVideoMSGIntoSingleFrame(videoMessage, &decoded) < 0)
+      {
+      std::cerr << "Decoding failed." << std::endl;
+      return -1;
+      }
+    decodeTime += GetTimeInSecond() - start;
+    if (maximumError == 0 && memcmp(&frames[i][0], &decodedFrame[0], frameSize) != 0)
+      {
+      mismatches++;
+      }
+    }
+
+  double numberOfFrames = frames.size();
+  double megabytes = numberOfFrames * frameSize / (1024.0 * 1024.0);
+  std::cout << std::fixed << std::setprecision(2)
+            << std::setw(8) << numberOfThreads
+            << std::setw(10) << numberOfFrames * frameSize / compressedSize
+            << std::setw(14) << encodeTime * 1000.0 / numberOfFrames
+            << std::setw(14) << megabytes / encodeTime
+            << std::setw(14) << decodeTime * 1000.0 / numberOfFrames
+            << std::setw(14) << megabytes / decodeTime << std::endl;
+  if (mismatches > 0)
+    {
+    std::cerr << mismatches << " frames were not decoded losslessly." << std::endl;
+    return -1;
+    }
+  return 0;
+}
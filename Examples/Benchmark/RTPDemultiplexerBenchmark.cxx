@@ -0,0 +1,232 @@
+/*=========================================================================
+
+  Program:   Open IGT Link -- Benchmark for unwrapping RTP streams from multiple senders
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "igtlOSUtil.h"
+#include "igtlImageMessage.h"
+#include "igtlMessageRTPWrapper.h"
+#include "igtlMessageRTPDemultiplexer.h"
+#include "igtlMultiThreader.h"
+#include "igtlTimeStamp.h"
+#include "igtlUDPClientSocket.h"
+#include "igtlUDPServerSocket.h"
+
+// Simulated senders multicast images to one receiver port on loopback. The received
+// packets are recorded, then replayed into a single MessageRTPWrapper and into
+// MessageRTPDemultiplexers running with an increasing number of threads.
+// The replay pushes the packets in batches and unwraps each batch, as a receiver loop would.
+
+#define REPLAY_BATCH_SIZE 256
+
+typedef struct {
+  int    port;
+  int    numberOfSenders;
+  int    numberOfMessages;
+  int    imageSize;
+  std::vector<std::vector<igtlUint8> > receivedPackets;
+} BenchmarkData;
+
+void* ReceiverThread(void* ptr);
+void* SenderThread(void* ptr);
+double GetTimeInSecond();
+int ReplayIntoSingleWrapper(BenchmarkData& data, double& elapsedTime);
+int ReplayIntoDemultiplexer(BenchmarkData& data, int numberOfThreads, double& elapsedTime);
+
+int main(int argc, char* argv[])
+{
+  //------------------------------------------------------------
+  // Parse Arguments
+
+  if (argc != 1 && argc != 5) // check number of arguments
+    {
+    // If not correct, print usage
+    std::cerr << "Usage: " << argv[0] << " [<port> <senders> <messages> <size>]" << std::endl;
+    std::cerr << "    <port>     : Receiver port # (default 18960)" << std::endl;
+    std::cerr << "    <senders>  : Number of simulated senders (default 16)" << std::endl;
+    std::cerr << "    <messages> : Number of images sent by each sender (default 20)" << std::endl;
+    std::cerr << "    <size>     : Width and height of the 8-bit images (default 256)" << std::endl;
+    exit(0);
+    }
+
+  BenchmarkData data;
+  data.port             = 18960;
+  data.numberOfSenders  = 16;
+  data.numberOfMessages = 20;
+  data.imageSize        = 256;
+  if (argc == 5)
+    {
+    data.port             = atoi(argv[1]);
+    data.numberOfSenders  = atoi(argv[2]);
+    data.numberOfMessages = atoi(argv[3]);
+    data.imageSize        = atoi(argv[4]);
+    }
+  if (data.numberOfSenders < 1 || data.numberOfSenders >= IGTL_MAX_THREADS)
+    {
+    std::cerr << "The number of senders must be between 1 and " << IGTL_MAX_THREADS - 1 << std::endl;
+    exit(0);
+    }
+
+  //------------------------------------------------------------
+  // Run the senders and the receiver on loopback. Thread 0 receives.
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SetNumberOfThreads(data.numberOfSenders + 1);
+  threader->SetMultipleMethod(0, (igtl::ThreadFunctionType) &ReceiverThread, &data);
+  for (int i = 1; i <= data.numberOfSenders; i++)
+    {
+    threader->SetMultipleMethod(i, (igtl::ThreadFunctionType) &SenderThread, &data);
+    }
+  threader->MultipleMethodExecute();
+  std::cerr << "Received " << data.receivedPackets.size() << " packets from "
+            << data.numberOfSenders << " senders." << std::endl;
+
+  //------------------------------------------------------------
+  // Replay the recorded packets
+  double elapsedTime = 0.0;
+  int numberOfMessages = ReplayIntoSingleWrapper(data, elapsedTime);
+  std::cerr << "Single wrapper          : " << numberOfMessages << " / "
+            << data.numberOfSenders * data.numberOfMessages << " messages, "
+            << elapsedTime * 1000.0 << " ms, "
+            << data.receivedPackets.size() / elapsedTime << " packets/s" << std::endl;
+
+  for (int numberOfThreads = 1; numberOfThreads <= data.numberOfSenders; numberOfThreads *= 2)
+    {
+    numberOfMessages = ReplayIntoDemultiplexer(data, numberOfThreads, elapsedTime);
+    std::cerr << "Demultiplexer " << numberOfThreads << " thread(s): " << numberOfMessages << " / "
+              << data.numberOfSenders * data.numberOfMessages << " messages, "
+              << elapsedTime * 1000.0 << " ms, "
+              << data.receivedPackets.size() / elapsedTime << " packets/s" << std::endl;
+    }
+  return 0;
+}
+
+
+void* ReceiverThread(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info =
+    static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  BenchmarkData* data = static_cast<BenchmarkData*>(info->UserData);
+
+  igtl::UDPClientSocket::Pointer socket = igtl::UDPClientSocket::New();
+  if (socket->JoinNetwork("127.0.0.1", data->port) < 0)
+    {
+    std::cerr << "Unable to join network." << std::endl;
+    return NULL;
+    }
+  // Stop once the senders have been silent for one second.
+  socket->SetReceiveTimeout(1000);
+  igtlUint8 buffer[RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH];
+  while (1)
+    {
+    int length = socket->ReadSocket(buffer, RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH);
+    if (length <= 0)
+      {
+      break;
+      }
+    data->receivedPackets.push_back(std::vector<igtlUint8>(buffer, buffer+length));
+    }
+  socket->CloseSocket();
+  return NULL;
+}
+
+
+void* SenderThread(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info =
+    static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  BenchmarkData* data = static_cast<BenchmarkData*>(info->UserData);
+
+  // Give the receiver time to bind its port.
+  igtl::Sleep(100);
+  igtl::UDPServerSocket::Pointer socket = igtl::UDPServerSocket::New();
+  socket->CreateUDPServer();
+  socket->AddClient("127.0.0.1", data->port, info->ThreadID);
+
+  igtl::MessageRTPWrapper::Pointer rtpWrapper = igtl::MessageRTPWrapper::New();
+  rtpWrapper->SetSSRC(info->ThreadID);
+  rtpWrapper->packetIntervalTime = 100000; // 0.1 ms between the fragments
+  int size[3] = {data->imageSize, data->imageSize, 1};
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetDeviceName("Imager");
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  for (int i = 0; i < data->numberOfMessages; i++)
+    {
+    memset(imageMsg->GetScalarPointer(), (i + info->ThreadID) & 0xFF, imageMsg->GetImageSize());
+    imageMsg->SetMessageID(i + 1);
+    imageMsg->Pack();
+    rtpWrapper->WrapMessageAndSend(socket, (igtl_uint8*)imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+    // Pace the senders to stay within the receive buffer of the loopback socket.
+    igtl::Sleep(10);
+    }
+  socket->CloseSocket();
+  return NULL;
+}
+
+
+double GetTimeInSecond()
+{
+  igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+  ts->GetTime();
+  return ts->GetTimeStamp();
+}
+
+
+int ReplayIntoSingleWrapper(BenchmarkData& data, double& elapsedTime)
+{
+  // All the senders share one packet buffer and one reorder buffer map, so fragments of
+  // messages with the same ID from different senders collide.
+  igtl::MessageRTPWrapper::Pointer rtpWrapper = igtl::MessageRTPWrapper::New();
+  double start = GetTimeInSecond();
+  for (unsigned int i = 0; i < data.receivedPackets.size(); i++)
+    {
+    rtpWrapper->PushDataIntoPacketBuffer(&data.receivedPackets[i][0], data.receivedPackets[i].size());
+    if ((i + 1) % REPLAY_BATCH_SIZE == 0 || i + 1 == data.receivedPackets.size())
+      {
+      while (rtpWrapper->UnWrapPacketWithTypeAndName("IMAGE", "Imager"));
+      }
+    }
+  elapsedTime = GetTimeInSecond() - start;
+  return rtpWrapper->unWrappedMessages.size();
+}
+
+
+int ReplayIntoDemultiplexer(BenchmarkData& data, int numberOfThreads, double& elapsedTime)
+{
+  igtl::MessageRTPDemultiplexer::Pointer demultiplexer = igtl::MessageRTPDemultiplexer::New();
+  demultiplexer->SetNumberOfThreads(numberOfThreads);
+  double start = GetTimeInSecond();
+  for (unsigned int i = 0; i < data.receivedPackets.size(); i++)
+    {
+    demultiplexer->PushDataIntoPacketBuffer(&data.receivedPackets[i][0], data.receivedPackets[i].size());
+    if ((i + 1) % REPLAY_BATCH_SIZE == 0 || i + 1 == data.receivedPackets.size())
+      {
+      demultiplexer->UnWrapPacketsWithTypeAndName("IMAGE", "Imager");
+      }
+    }
+  elapsedTime = GetTimeInSecond() - start;
+
+  int numberOfMessages = 0;
+  std::vector<igtl_uint32> ssrcs;
+  demultiplexer->GetSSRCs(ssrcs);
+  for (unsigned int i = 0; i < ssrcs.size(); i++)
+    {
+    numberOfMessages += demultiplexer->GetContext(ssrcs[i])->unWrappedMessages.size();
+    }
+  return numberOfMessages;
+}
@@ -0,0 +1,397 @@
+/*=========================================================================
+
+  Program:   Open IGT Link -- Benchmark for the lossless scalar codec
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "igtlImageMessage.h"
+#include "igtlMultiThreader.h"
+#include "igtlOSUtil.h"
+#include "igtlScalarCodec.h"
+#include "igtlServerSocket.h"
+#include "igtlClientSocket.h"
+#include "igtlThreadPool.h"
+#include "igtlTimeStamp.h"
+#include "igtl_util.h"
+
+// Sends a 16-bit volume over a loopback connection, and reports the compression ratio and
+// the end-to-end transfer time (from the first byte packed to the last scalar decoded by the
+// receiver) of:
+//   - the raw IMAGE message,
+//   - the IMAGE message encoded by ScalarCodec,
+//   - slabs of slices encoded by ScalarCodec, the next slab being encoded while a slab is sent,
+// with an increasing number of threads. As a loopback connection is much faster than a network,
+// the sender can be limited to a bandwidth to simulate one.
+// The volume is either synthetic (a CT-like phantom with noise), or read from a raw file of
+// 8-bit slices, e.g. Testing/img/igtlTestImage1.raw (256 x 256).
+
+#define SCALAR_CODEC_BENCHMARK_DEVICE "CT"
+
+struct BenchmarkReceiver
+{
+  igtl::ClientSocket::Pointer Socket;
+  igtl::ScalarCodec::Pointer  Codec;
+  int                         VolumeSize;  // Bytes of scalars making a volume
+  int                         Errors;
+};
+
+double GetTimeInSecond();
+void CreatePhantom(std::vector<igtl_int16>& volume, int size, int slices);
+igtl::ImageMessage::Pointer CreateSlab(std::vector<igtl_int16>& volume, int size, int slices, int first, int count);
+int SendLimited(igtl::Socket* socket, igtl::MessageBase* msg, double bandwidth);
+void* ReceiveVolumes(void* ptr);
+void* EncodeSlab(void* ptr);
+
+int main(int argc, char* argv[])
+{
+  //------------------------------------------------------------
+  // Parse Arguments
+
+  if (argc != 1 && argc != 5 && argc != 6) // check number of arguments
+    {
+    // If not correct, print usage
+    std::cerr << "Usage: " << argv[0] << " [<size> <slices> <slab> <bandwidth> [<file>]]" << std::endl;
+    std::cerr << "    <size>      : Width and height of the slices (default 512)" << std::endl;
+    std::cerr << "    <slices>    : Number of slices (default 64)" << std::endl;
+    std::cerr << "    <slab>      : Number of slices of a slab (default 8)" << std::endl;
+    std::cerr << "    <bandwidth> : Bandwidth of the sender in MB/s, 0 for unlimited (default 0)" << std::endl;
+    std::cerr << "    <file>      : Raw file of 8-bit slices (default synthetic phantom)" << std::endl;
+    exit(0);
+    }
+
+  int size = 512;
+  int slices = 64;
+  int slab = 8;
+  double bandwidth = 0.0;
+  if (argc >= 5)
+    {
+    size      = atoi(argv[1]);
+    slices    = atoi(argv[2]);
+    slab      = atoi(argv[3]);
+    bandwidth = atof(argv[4]);
+    }
+  if (size < 1 || slices < 1 || slab < 1 || bandwidth < 0.0 ||
+      (double)size * size * slices * sizeof(igtl_int16) > 1.0e9)
+    {
+    std::cerr << "The size, the number of slices and the slab must be positive, and the volume below 1 GB." << std::endl;
+    exit(0);
+    }
+  if (slab > slices)
+    {
+    slab = slices;
+    }
+
+  std::vector<igtl_int16> volume;
+  if (argc == 6)
+    {
+    FILE* fp = fopen(argv[5], "rb");
+    if (fp == NULL)
+      {
+      std::cerr << "Cannot open " << argv[5] << std::endl;
+      exit(0);
+      }
+    std::vector<igtl_uint8> slice(size * size);
+    volume.resize((size_t)size * size * slices);
+    for (int k = 0; k < slices; k++)
+      {
+      // Repeats the file if it has less slices than the volume
+      if (fread(&slice[0], 1, slice.size(), fp) != slice.size())
+        {
+        rewind(fp);
+        if (fread(&slice[0], 1, slice.size(), fp) != slice.size())
+          {
+          std::cerr << "The file is smaller than one slice." << std::endl;
+          fclose(fp);
+          exit(0);
+          }
+        }
+      for (int i = 0; i < size * size; i++)
+        {
+        volume[(size_t)k * size * size + i] = (igtl_int16)(slice[i] * 8 - 1000);
+        }
+      }
+    fclose(fp);
+    }
+  else
+    {
+    CreatePhantom(volume, size, slices);
+    }
+  int volumeSize = (int)(volume.size() * sizeof(igtl_int16));
+
+  //------------------------------------------------------------
+  // Loopback connection
+
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+  if (serverSocket->CreateServer(0) != 0 ||
+      socket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()) != 0)
+    {
+    std::cerr << "Cannot open a loopback connection." << std::endl;
+    exit(1);
+    }
+  BenchmarkReceiver receiver;
+  receiver.Socket = serverSocket->WaitForConnection(1000);
+  receiver.Codec = igtl::ScalarCodec::New();
+  receiver.VolumeSize = volumeSize;
+  receiver.Errors = 0;
+  if (receiver.Socket.IsNull())
+    {
+    std::cerr << "Cannot open a loopback connection." << std::endl;
+    exit(1);
+    }
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SpawnThread((igtl::ThreadFunctionType)&ReceiveVolumes, &receiver);
+
+  std::cout << "Volume: " << size << "x" << size << "x" << slices << " INT16, " << volumeSize << " bytes, slabs of "
+            << slab << " slices, bandwidth ";
+  if (bandwidth > 0.0)
+    {
+    std::cout << bandwidth << " MB/s" << std::endl;
+    }
+  else
+    {
+    std::cout << "unlimited" << std::endl;
+    }
+  std::cout << std::setw(8) << "Threads" << std::setw(12) << "Mode" << std::setw(10) << "Ratio"
+            << std::setw(14) << "Time (ms)" << std::setw(14) << "Rate (MB/s)" << std::endl;
+
+  int maxThreads = igtl::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  pool->ReserveWorkers(1);
+  for (int numberOfThreads = 0; numberOfThreads <= maxThreads; numberOfThreads = (numberOfThreads == 0 ? 1 : numberOfThreads * 2))
+    {
+    // The raw message does not depend on the number of threads
+    int mode = numberOfThreads == 0 ? 0 : 1;
+    for (; mode < (numberOfThreads == 0 ? 1 : 3); mode++)
+      {
+      igtl::ScalarCodec::Pointer codec = igtl::ScalarCodec::New();
+      codec->SetNumberOfThreads(numberOfThreads);
+      receiver.Codec->SetNumberOfThreads(numberOfThreads);
+
+      double start = GetTimeInSecond();
+      double sentSize = 0.0;
+      int r = 1;
+      if (mode == 0 || mode == 1)
+        {
+        igtl::ImageMessage::Pointer imageMsg = CreateSlab(volume, size, slices, 0, slices);
+        imageMsg->Pack();
+        igtl::MessageBase::Pointer msg = imageMsg.GetPointer();
+        if (mode == 1)
+          {
+          msg = codec->Encode(imageMsg);
+          }
+        r = msg.IsNotNull() && SendLimited(socket, msg, bandwidth);
+        sentSize = msg.IsNotNull() ? msg->GetPackSize() : 0;
+        }
+      else
+        {
+        // The next slab is encoded on the pool while a slab is sent.
+        std::vector<igtl::MessageBase::Pointer> encoded((slices + slab - 1) / slab);
+        std::vector<void*> jobs(encoded.size() * 3);
+        igtl::ThreadPoolFuture::Pointer future;
+        for (unsigned int n = 0; n <= encoded.size() && r; n++)
+          {
+          if (n < encoded.size())
+            {
+            igtl::ImageMessage::Pointer slabMsg = CreateSlab(volume, size, slices, n * slab, std::min(slab, slices - (int)n * slab));
+            jobs[n * 3]     = codec.GetPointer();
+            jobs[n * 3 + 1] = slabMsg.GetPointer();
+            jobs[n * 3 + 2] = &encoded[n];
+            slabMsg->Register();
+            future = pool->Submit(&EncodeSlab, &jobs[n * 3]);
+            }
+          if (n > 0)
+            {
+            r = encoded[n - 1].IsNotNull() && SendLimited(socket, encoded[n - 1], bandwidth);
+            sentSize += encoded[n - 1].IsNotNull() ? encoded[n - 1]->GetPackSize() : 0;
+            encoded[n - 1] = NULL;
+            }
+          if (n < encoded.size())
+            {
+            future->Wait();
+            }
+          }
+        }
+
+      // Acknowledgement of the receiver once the volume is decoded
+      char ack = 0;
+      if (!r || socket->Receive(&ack, 1) != 1 || ack != 1)
+        {
+        std::cerr << "The transfer failed." << std::endl;
+        return 1;
+        }
+      double time = GetTimeInSecond() - start;
+
+      const char* modes[] = {"raw", "encoded", "pipelined"};
+      std::cout << std::setw(8) << numberOfThreads << std::setw(12) << modes[mode]
+                << std::setw(10) << std::fixed << std::setprecision(2) << volumeSize / sentSize
+                << std::setw(14) << std::setprecision(1) << time * 1000.0
+                << std::setw(14) << volumeSize / time / 1.0e6 << std::endl;
+      }
+    }
+
+  socket->CloseSocket();
+  for (int i = 0; i < 100 && receiver.Socket->GetConnected(); i++)
+    {
+    igtl::Sleep(10);
+    }
+  return receiver.Errors > 0 ? 1 : 0;
+}
+
+
+double GetTimeInSecond()
+{
+  igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+  ts->GetTime();
+  return ts->GetTimeStamp();
+}
+
+
+void CreatePhantom(std::vector<igtl_int16>& volume, int size, int slices)
+{
+  // Air around an elliptic body of soft tissue, with a bone ring and noise
+  volume.resize((size_t)size * size * slices);
+  igtl_int16* p = &volume[0];
+  double c = (size - 1) / 2.0;
+  for (int k = 0; k < slices; k++)
+    {
+    for (int j = 0; j < size; j++)
+      {
+      for (int i = 0; i < size; i++)
+        {
+        double x = (i - c) / (size * 0.45);
+        double y = (j - c) / (size * 0.35);
+        double r = x * x + y * y;
+        int value = -1000 + (rand() & 0x7);
+        if (r < 1.0)
+          {
+          value = 40 + (int)(20.0 * r) + (rand() & 0x1F) - 16;
+          }
+        if (r > 0.7 && r < 0.8)
+          {
+          value = 1200 + (rand() & 0x3F);
+          }
+        *(p++) = (igtl_int16)value;
+        }
+      }
+    }
+}
+
+
+igtl::ImageMessage::Pointer CreateSlab(std::vector<igtl_int16>& volume, int size, int slices, int first, int count)
+{
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetDeviceName(SCALAR_CODEC_BENCHMARK_DEVICE);
+  imageMsg->SetDimensions(size, size, slices);
+  imageMsg->SetSubVolume(size, size, count, 0, 0, first);
+  imageMsg->SetSpacing(0.5f, 0.5f, 1.0f);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_INT16);
+  imageMsg->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG);
+  imageMsg->AllocateScalars();
+  memcpy(imageMsg->GetScalarPointer(), &volume[(size_t)first * size * size], imageMsg->GetSubVolumeImageSize());
+  return imageMsg;
+}
+
+
+int SendLimited(igtl::Socket* socket, igtl::MessageBase* msg, double bandwidth)
+{
+  const char* data = static_cast<const char*>(msg->GetPackPointer());
+  int size = msg->GetPackSize();
+  if (bandwidth <= 0.0)
+    {
+    return socket->Send(data, size);
+    }
+  // Pieces of 64 KB, at most bandwidth MB per second
+  double start = GetTimeInSecond();
+  for (int offset = 0; offset < size; offset += 65536)
+    {
+    int length = std::min(65536, size - offset);
+    if (!socket->Send(data + offset, length))
+      {
+      return 0;
+      }
+    double wait = (offset + length) / (bandwidth * 1.0e6) - (GetTimeInSecond() - start);
+    if (wait > 0.001)
+      {
+      igtl::Sleep((int)(wait * 1000.0));
+      }
+    }
+  return 1;
+}
+
+
+void* ReceiveVolumes(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  BenchmarkReceiver* receiver = static_cast<BenchmarkReceiver*>(info->UserData);
+  igtl::Socket* socket = receiver->Socket;
+
+  int receivedSize = 0;
+  while (1)
+    {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitPack();
+    if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+      {
+      return NULL;
+      }
+    headerMsg->Unpack();
+    igtl::ImageMessage::Pointer received = igtl::ImageMessage::New();
+    received->SetMessageHeader(headerMsg);
+    received->AllocatePack();
+    if (socket->Receive(received->GetPackBodyPointer(), received->GetPackBodySize()) != received->GetPackBodySize())
+      {
+      return NULL;
+      }
+
+    // The meta data tell whether the scalars are encoded.
+    igtl::ImageMessage::Pointer imageMsg = received;
+    received->UnpackHeaderAndMetaData(1);
+    if (igtl::ScalarCodec::IsEncoded(received))
+      {
+      imageMsg = igtl::ImageMessage::New();
+      if (!receiver->Codec->Decode(received, imageMsg, 0))
+        {
+        receiver->Errors++;
+        }
+      }
+    else if (!(received->Unpack(1) & igtl::MessageHeader::UNPACK_BODY))
+      {
+      receiver->Errors++;
+      }
+    receivedSize += imageMsg->GetSubVolumeImageSize();
+    if (receivedSize >= receiver->VolumeSize)
+      {
+      char ack = receiver->Errors == 0 ? 1 : 0;
+      socket->Send(&ack, 1);
+      receivedSize = 0;
+      }
+    }
+}
+
+
+void* EncodeSlab(void* ptr)
+{
+  void** job = static_cast<void**>(ptr);
+  igtl::ScalarCodec* codec = static_cast<igtl::ScalarCodec*>(job[0]);
+  igtl::ImageMessage* slabMsg = static_cast<igtl::ImageMessage*>(job[1]);
+  *static_cast<igtl::MessageBase::Pointer*>(job[2]) = codec->Encode(slabMsg);
+  slabMsg->UnRegister();
+  return NULL;
+}
@@ -17,10 +17,13 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <map>
+#include <string>
 
 #include "igtlOSUtil.h"
 #include "igtlMessageHeader.h"
 #include "igtlImageMessage.h"
+#include "igtlImageFileSource.h"
 #include "igtlImageMetaMessage.h"
 #include "igtlLabelMetaMessage.h"
 #include "igtlServerSocket.h"
@@ -29,7 +32,7 @@ int SendImageMeta(igtl::Socket::Pointer& socket, const char* name);
 int SendLabelMeta(igtl::Socket::Pointer& socket, const char* name);
 int SendImage(igtl::Socket::Pointer& socket, const char* name, const char* filedir);
 int SendLabel(igtl::Socket::Pointer& socket, const char* name, const char* filedir);
-int GetTestImage(igtl::ImageMessage::Pointer& msg, const char* dir, int i);
+igtl::ImageFileSource* GetTestImage(const char* dir, int i);
 
 int main(int argc, char* argv[])
 {
@@ -298,37 +301,25 @@ int SendImage(igtl::Socket::Pointer& socket, const char* name, const char* filed
     index = 6;
     }
 
+  igtl::ImageFileSource* source = NULL;
   if (index > 0)
     {
-    int   size[]     = {256, 256, 1};       // image dimension
-    float spacing[]  = {1.0, 1.0, 5.0};     // spacing (mm/pixel)
-    int   svsize[]   = {256, 256, 1};       // sub-volume size
-    int   svoffset[] = {0, 0, 0};           // sub-volume offset
-    int   scalarType = igtl::ImageMessage::TYPE_UINT8;// scalar type
-    
-    igtl::ImageMessage::Pointer imgMsg = igtl::ImageMessage::New();
-    imgMsg->SetDimensions(size);
+    //------------------------------------------------------------
+    // Get the memory-mapped image (See GetTestImage() bellow for the details)
+    source = GetTestImage(filedir, index);
+    }
+
+  if (source != NULL)
+    {
+    // The message is sent with the scalars of the mapped file, without copying them.
+    igtl::ImageMessage* imgMsg = source->GetImageMessage();
+    float spacing[] = {1.0, 1.0, 5.0};     // spacing (mm/pixel)
     imgMsg->SetSpacing(spacing);
-    imgMsg->SetScalarType(scalarType);
     imgMsg->SetDeviceName(name);
-    imgMsg->SetSubVolume(svsize, svoffset);
-    imgMsg->AllocateScalars();
-    
-    // Following line may be called in case of 16-, 32-, and 64-bit scalar types.
-    // imgMsg->SetEndian(igtl::ImageMessage::ENDIAN_BIG);
 
-    //------------------------------------------------------------
-    // Set image data (See GetTestImage() bellow for the details)
-    GetTestImage(imgMsg, filedir, index);
-    
-    igtl::Matrix4x4 matrix;
-    igtl::IdentityMatrix(matrix);
-    imgMsg->SetMatrix(matrix);
-    
     //------------------------------------------------------------
     // Pack (serialize) and send
-    imgMsg->Pack();
-    socket->Send(imgMsg->GetPackPointer(), imgMsg->GetPackSize());
+    source->Send(socket);
     }
   else
     {
@@ -344,43 +335,43 @@ int SendImage(igtl::Socket::Pointer& socket, const char* name, const char* filed
 
 
 //------------------------------------------------------------
-// Function to read test image data
-int GetTestImage(igtl::ImageMessage::Pointer& msg, const char* dir, int i)
+// Function to map test image data. The files are mapped once, and shared by
+// all the requests and the clients.
+igtl::ImageFileSource* GetTestImage(const char* dir, int i)
 {
+  static std::map<int, igtl::ImageFileSource::Pointer> sources;
 
   //------------------------------------------------------------
   // Check if image index is in the range
   if (i < 0 || i >= 7) 
     {
     std::cerr << "Image index is invalid." << std::endl;
-    return 0;
+    return NULL;
+    }
+
+  if (sources.find(i) != sources.end())
+    {
+    return sources[i];
     }
 
   //------------------------------------------------------------
   // Generate path to the raw image file
   char filename[128];
-  sprintf(filename, "%s/igtlTestImage%d.raw", dir, i+1);
-  std::cerr << "Reading " << filename << "...";
+  sprintf(filename, "%s/igtlTestImage%d.raw", dir, i);
+  std::cerr << "Mapping " << filename << "...";
 
   //------------------------------------------------------------
-  // Load raw data from the file
-  FILE *fp = fopen(filename, "rb");
-  if (fp == NULL)
+  // Map the raw data of the file
+  int size[] = {256, 256, 1};       // image dimension
+  igtl::ImageFileSource::Pointer source = igtl::ImageFileSource::New();
+  if (!source->OpenRawFile(filename, size, igtl::ImageMessage::TYPE_UINT8, 1, igtl::ImageMessage::ENDIAN_BIG))
     {
     std::cerr << "File opeining error: " << filename << std::endl;
-    return 0;
+    return NULL;
     }
-  int fsize = msg->GetImageSize();
-  //size_t b = fread(msg->GetScalarPointer(), 1, fsize, fp);
-  fread(msg->GetScalarPointer(), 1, fsize, fp);
-
-  fclose(fp);
+  sources[i] = source;
 
   std::cerr << "done." << std::endl;
 
-  return 1;
+  return source;
 }
-
-
-
-
@@ -0,0 +1,492 @@
+/*=========================================================================
+
+  Program:   OpenIGTLink
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtlIntraCodecCommon.h"
+
+#include <string.h>
+
+// Number of gradient activity contexts
+#define IntraCodecNumberOfContexts   8
+// Length of the unary prefix above which a value is escaped
+#define IntraCodecUnaryLimit         16
+// Number of bits of an escaped residual and run length
+#define IntraCodecResidualEscapeBits 9
+#define IntraCodecRunEscapeBits      16
+// The statistics of a context are halved after this number of samples
+#define IntraCodecContextReset       64
+
+namespace igtl {
+
+namespace {
+
+// Statistics of the Golomb-Rice code of a context.
+class IntraContext
+{
+public:
+  IntraContext(){sum = 4; count = 1;};
+
+  int GetRiceParameter() const
+  {
+    int k = 0;
+    while ((count << k) < sum && k < 15)
+      {
+      k++;
+      }
+    return k;
+  };
+
+  void Update(int value)
+  {
+    sum += value;
+    count++;
+    if (count == IntraCodecContextReset)
+      {
+      sum >>= 1;
+      count >>= 1;
+      }
+  };
+
+  int sum;
+  int count;
+};
+
+
+class IntraBitWriter
+{
+public:
+  IntraBitWriter(std::vector<igtl_uint8>& out):buffer(out){accumulator = 0; numberOfBits = 0;};
+
+  // n <= 25
+  void PutBits(igtl_uint32 value, int n)
+  {
+    accumulator = (accumulator << n) | (value & ((1u << n) - 1));
+    numberOfBits += n;
+    while (numberOfBits >= 8)
+      {
+      numberOfBits -= 8;
+      buffer.push_back((igtl_uint8)(accumulator >> numberOfBits));
+      }
+  };
+
+  void PutValue(int value, IntraContext& context, int escapeBits)
+  {
+    int k = context.GetRiceParameter();
+    int q = value >> k;
+    if (q < IntraCodecUnaryLimit)
+      {
+      // q ones followed by a zero, then the k lower bits
+      this->PutBits(((1u << q) - 1) << 1, q + 1);
+      if (k > 0)
+        {
+        this->PutBits(value, k);
+        }
+      }
+    else
+      {
+      this->PutBits((1u << IntraCodecUnaryLimit) - 1, IntraCodecUnaryLimit);
+      this->PutBits(value, escapeBits);
+      }
+    context.Update(value);
+  };
+
+  void Flush()
+  {
+    if (numberOfBits > 0)
+      {
+      buffer.push_back((igtl_uint8)(accumulator << (8 - numberOfBits)));
+      numberOfBits = 0;
+      }
+  };
+
+private:
+  std::vector<igtl_uint8>& buffer;
+  igtl_uint64 accumulator;
+  int numberOfBits;
+};
+
+
+class IntraBitReader
+{
+public:
+  IntraBitReader(const igtl_uint8* in, igtl_uint32 size){data = in; dataSize = size; position = 0; accumulator = 0; numberOfBits = 0;};
+
+  void Refill()
+  {
+    while (numberOfBits <= 56)
+      {
+      // Reading beyond the end returns zeros, Overrun() reports it.
+      accumulator = (accumulator << 8) | (position < dataSize ? data[position] : 0);
+      position++;
+      numberOfBits += 8;
+      }
+  };
+
+  igtl_uint32 GetBits(int n)
+  {
+    if (numberOfBits < n)
+      {
+      this->Refill();
+      }
+    numberOfBits -= n;
+    return (igtl_uint32)(accumulator >> numberOfBits) & ((1u << n) - 1);
+  };
+
+  int GetValue(IntraContext& context, int escapeBits)
+  {
+    if (numberOfBits < IntraCodecUnaryLimit + 1)
+      {
+      this->Refill();
+      }
+    int q = 0;
+    while (q < IntraCodecUnaryLimit && ((accumulator >> (numberOfBits - 1 - q)) & 1))
+      {
+      q++;
+      }
+    int value;
+    if (q < IntraCodecUnaryLimit)
+      {
+      numberOfBits -= q + 1;
+      int k = context.GetRiceParameter();
+      value = (q << k) | (k > 0 ? this->GetBits(k) : 0);
+      }
+    else
+      {
+      numberOfBits -= IntraCodecUnaryLimit;
+      value = this->GetBits(escapeBits);
+      }
+    context.Update(value);
+    return value;
+  };
+
+  bool Overrun()
+  {
+    // The bytes still in the accumulator have not been consumed.
+    return position - numberOfBits / 8 > dataSize;
+  };
+
+private:
+  const igtl_uint8* data;
+  igtl_uint32 dataSize;
+  igtl_uint32 position;
+  igtl_uint64 accumulator;
+  int numberOfBits;
+};
+
+
+inline void GetNeighbours(const igtl_uint8* row, const igtl_uint8* above, int x, int width, int& a, int& b, int& c, int& d)
+{
+  if (above)
+    {
+    b = above[x];
+    a = x > 0 ? row[x-1] : b;
+    c = x > 0 ? above[x-1] : b;
+    d = x + 1 < width ? above[x+1] : b;
+    }
+  else
+    {
+    a = x > 0 ? row[x-1] : 128;
+    b = c = d = a;
+    }
+}
+
+// Median edge detector
+inline int Predict(int a, int b, int c)
+{
+  int mx = a > b ? a : b;
+  int mn = a > b ? b : a;
+  if (c >= mx)
+    {
+    return mn;
+    }
+  if (c <= mn)
+    {
+    return mx;
+    }
+  return a + b - c;
+}
+
+inline int GetContext(int a, int b, int c, int d)
+{
+  int activity = (d > b ? d - b : b - d) + (b > c ? b - c : c - b) + (c > a ? c - a : a - c) + 1;
+  int context = 0;
+  while (activity > 1 && context < IntraCodecNumberOfContexts - 1)
+    {
+    activity >>= 1;
+    context++;
+    }
+  return context;
+}
+
+inline int Clamp(int value)
+{
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+inline int ZigZag(int e)
+{
+  return e >= 0 ? 2 * e : -2 * e - 1;
+}
+
+inline int UnZigZag(int v)
+{
+  return (v & 1) ? -((v + 1) >> 1) : (v >> 1);
+}
+
+// Codes a plane region. recon receives the pixels as the decoder will reconstruct them, the prediction is
+// computed from them so that the encoder and the decoder stay in sync in the near-lossless mode.
+void EncodePlane(const igtl_uint8* src, int srcStride, int width, int height, int maximumError,
+                 igtl_uint8* recon, IntraBitWriter& writer)
+{
+  IntraContext contexts[IntraCodecNumberOfContexts];
+  IntraContext runContext;
+  const int step = 2 * maximumError + 1;
+  for (int y = 0; y < height; y++)
+    {
+    const igtl_uint8* s = src + y * srcStride;
+    igtl_uint8* row = recon + y * width;
+    const igtl_uint8* above = y > 0 ? row - width : NULL;
+    bool afterRun = false;
+    int x = 0;
+    while (x < width)
+      {
+      int a, b, c, d;
+      GetNeighbours(row, above, x, width, a, b, c, d);
+      if (!afterRun && above && x > 0 && a == b && b == c && c == d)
+        {
+        int run = 0;
+        while (x < width && s[x] - a <= maximumError && a - s[x] <= maximumError)
+          {
+          row[x] = (igtl_uint8)a;
+          x++;
+          run++;
+          }
+        writer.PutValue(run, runContext, IntraCodecRunEscapeBits);
+        // The pixel interrupting the run is coded in the regular mode.
+        afterRun = true;
+        continue;
+        }
+      afterRun = false;
+      int prediction = Predict(a, b, c);
+      IntraContext& context = contexts[GetContext(a, b, c, d)];
+      if (maximumError == 0)
+        {
+        int e = (igtl_int8)(igtl_uint8)(s[x] - prediction);
+        writer.PutValue(ZigZag(e), context, IntraCodecResidualEscapeBits);
+        row[x] = s[x];
+        }
+      else
+        {
+        int e = s[x] - prediction;
+        int q = e > 0 ? (e + maximumError) / step : -((maximumError - e) / step);
+        writer.PutValue(ZigZag(q), context, IntraCodecResidualEscapeBits);
+        row[x] = (igtl_uint8)Clamp(prediction + q * step);
+        }
+      x++;
+      }
+    }
+}
+
+// Decodes a plane region in place. Returns 0 if the stream is inconsistent.
+int DecodePlane(IntraBitReader& reader, igtl_uint8* dst, int dstStride, int width, int height, int maximumError)
+{
+  IntraContext contexts[IntraCodecNumberOfContexts];
+  IntraContext runContext;
+  const int step = 2 * maximumError + 1;
+  for (int y = 0; y < height; y++)
+    {
+    igtl_uint8* row = dst + y * dstStride;
+    const igtl_uint8* above = y > 0 ? row - dstStride : NULL;
+    bool afterRun = false;
+    int x = 0;
+    while (x < width)
+      {
+      int a, b, c, d;
+      GetNeighbours(row, above, x, width, a, b, c, d);
+      if (!afterRun && above && x > 0 && a == b && b == c && c == d)
+        {
+        int run = reader.GetValue(runContext, IntraCodecRunEscapeBits);
+        if (run > width - x)
+          {
+          return 0;
+          }
+        memset(row + x, a, run);
+        x += run;
+        afterRun = true;
+        continue;
+        }
+      afterRun = false;
+      int prediction = Predict(a, b, c);
+      IntraContext& context = contexts[GetContext(a, b, c, d)];
+      int v = reader.GetValue(context, IntraCodecResidualEscapeBits);
+      if (maximumError == 0)
+        {
+        row[x] = (igtl_uint8)(prediction + UnZigZag(v));
+        }
+      else
+        {
+        row[x] = (igtl_uint8)Clamp(prediction + UnZigZag(v) * step);
+        }
+      x++;
+      }
+    }
+  return 1;
+}
+
+} // anonymous namespace
+
+
+int IntraCodec::GetNumberOfTiles(int picWidth, int picHeight, int tileWidth, int tileHeight)
+{
+  if (picWidth <= 0 || picHeight <= 0 || tileWidth <= 0 || tileHeight <= 0)
+    {
+    return 0;
+    }
+  return ((picWidth + tileWidth - 1) / tileWidth) * ((picHeight + tileHeight - 1) / tileHeight);
+}
+
+int IntraCodec::GetNumberOfTileColumns(int picWidth, int tileWidth)
+{
+  if (picWidth <= 0 || tileWidth <= 0)
+    {
+    return 0;
+    }
+  return (picWidth + tileWidth - 1) / tileWidth;
+}
+
+void IntraCodec::GetPlaneSize(int plane, int colorFormat, int picWidth, int picHeight, int& width, int& height)
+{
+  width = picWidth;
+  height = picHeight;
+  if (plane > 0 && colorFormat == FormatI420)
+    {
+    width = picWidth >> 1;
+    height = picHeight >> 1;
+    }
+}
+
+void IntraCodec::GetTileRegion(int plane, int colorFormat, int picWidth, int picHeight, int tileWidth, int tileHeight,
+                               int tileIndex, int& x, int& y, int& width, int& height)
+{
+  int tilesPerRow = (picWidth + tileWidth - 1) / tileWidth;
+  int x0 = (tileIndex % tilesPerRow) * tileWidth;
+  int y0 = (tileIndex / tilesPerRow) * tileHeight;
+  int x1 = x0 + tileWidth < picWidth ? x0 + tileWidth : picWidth;
+  int y1 = y0 + tileHeight < picHeight ? y0 + tileHeight : picHeight;
+  if (plane > 0 && colorFormat == FormatI420)
+    {
+    // The tile sizes are even, the last tile ends with the chroma plane.
+    x0 >>= 1; y0 >>= 1; x1 >>= 1; y1 >>= 1;
+    }
+  x = x0;
+  y = y0;
+  width = x1 - x0;
+  height = y1 - y0;
+}
+
+int IntraCodec::IsTileChanged(SourcePicture* pic, SourcePicture* reference, int colorFormat, int tileWidth, int tileHeight, int tileIndex)
+{
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int x, y, width, height;
+    GetTileRegion(plane, colorFormat, pic->picWidth, pic->picHeight, tileWidth, tileHeight, tileIndex, x, y, width, height);
+    if (width <= 0 || height <= 0)
+      {
+      continue;
+      }
+    int planeWidth, planeHeight;
+    GetPlaneSize(plane, colorFormat, pic->picWidth, pic->picHeight, planeWidth, planeHeight);
+    int stride = pic->stride[plane] > 0 ? pic->stride[plane] : planeWidth;
+    int referenceStride = reference->stride[plane] > 0 ? reference->stride[plane] : planeWidth;
+    const igtl_uint8* row = pic->data[plane] + y * stride + x;
+    const igtl_uint8* referenceRow = reference->data[plane] + y * referenceStride + x;
+    // memcmp compares the rows with the widest vector instructions available.
+    for (int j = 0; j < height; j++, row += stride, referenceRow += referenceStride)
+      {
+      if (memcmp(row, referenceRow, width) != 0)
+        {
+        return 1;
+        }
+      }
+    }
+  return 0;
+}
+
+void IntraCodec::CopyTile(SourcePicture* src, SourcePicture* dst, int colorFormat, int tileWidth, int tileHeight, int tileIndex)
+{
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int x, y, width, height;
+    GetTileRegion(plane, colorFormat, src->picWidth, src->picHeight, tileWidth, tileHeight, tileIndex, x, y, width, height);
+    if (width <= 0 || height <= 0)
+      {
+      continue;
+      }
+    int planeWidth, planeHeight;
+    GetPlaneSize(plane, colorFormat, src->picWidth, src->picHeight, planeWidth, planeHeight);
+    int srcStride = src->stride[plane] > 0 ? src->stride[plane] : planeWidth;
+    int dstStride = dst->stride[plane] > 0 ? dst->stride[plane] : planeWidth;
+    const igtl_uint8* srcRow = src->data[plane] + y * srcStride + x;
+    igtl_uint8* dstRow = dst->data[plane] + y * dstStride + x;
+    for (int j = 0; j < height; j++, srcRow += srcStride, dstRow += dstStride)
+      {
+      memcpy(dstRow, srcRow, width);
+      }
+    }
+}
+
+void IntraCodec::EncodeTile(SourcePicture* pSrcPic, int colorFormat, int tileWidth, int tileHeight, int tileIndex,
+                            int maximumError, std::vector<igtl_uint8>& output, std::vector<igtl_uint8>& scratch)
+{
+  IntraBitWriter writer(output);
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int x, y, width, height;
+    GetTileRegion(plane, colorFormat, pSrcPic->picWidth, pSrcPic->picHeight, tileWidth, tileHeight, tileIndex, x, y, width, height);
+    if (width <= 0 || height <= 0)
+      {
+      continue;
+      }
+    int planeWidth, planeHeight;
+    GetPlaneSize(plane, colorFormat, pSrcPic->picWidth, pSrcPic->picHeight, planeWidth, planeHeight);
+    int stride = pSrcPic->stride[plane] > 0 ? pSrcPic->stride[plane] : planeWidth;
+    if (scratch.size() < (size_t)(width * height))
+      {
+      scratch.resize(width * height);
+      }
+    EncodePlane(pSrcPic->data[plane] + y * stride + x, stride, width, height, maximumError, &scratch[0], writer);
+    }
+  writer.Flush();
+}
+
+int IntraCodec::DecodeTile(const igtl_uint8* input, igtl_uint32 inputSize, SourcePicture* pDecodedPic, int colorFormat,
+                           int tileWidth, int tileHeight, int tileIndex, int maximumError)
+{
+  IntraBitReader reader(input, inputSize);
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int x, y, width, height;
+    GetTileRegion(plane, colorFormat, pDecodedPic->picWidth, pDecodedPic->picHeight, tileWidth, tileHeight, tileIndex, x, y, width, height);
+    if (width <= 0 || height <= 0)
+      {
+      continue;
+      }
+    int stride = pDecodedPic->stride[plane];
+    if (!DecodePlane(reader, pDecodedPic->data[plane] + y * stride + x, stride, width, height, maximumError))
+      {
+      return 0;
+      }
+    }
+  return reader.Overrun() ? 0 : 1;
+}
+
+} // namespace igtl
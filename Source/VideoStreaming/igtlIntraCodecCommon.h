@@ -0,0 +1,91 @@
+/*=========================================================================
+
+  Program:   OpenIGTLink
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __igtlIntraCodecCommon_h
+#define __igtlIntraCodecCommon_h
+
+#include <vector>
+
+#include "igtl_types.h"
+#include "igtlCodecCommonClasses.h"
+
+/// Bit stream layout of the intra codec, all the values are big endian:
+///
+///   version (1 byte), color format (1 byte, FormatI420 or FormatI444), maximum error (1 byte), flags (1 byte),
+///   tile width (2 bytes), tile height (2 bytes), number of tiles (4 bytes),
+///   tile table,
+///   compressed tiles.
+///
+/// The tiles cover the luma plane in raster order, the chroma planes are split at the corresponding positions.
+/// Each tile holds its Y, U and V regions and is coded independently from the other tiles, so that the tiles
+/// can be encoded and decoded in parallel.
+///
+/// In a full frame, the tile table holds the compressed size of each tile (4 bytes per tile).
+/// In a partial update (IGTL_INTRA_CODEC_FLAG_PARTIAL_UPDATE), only the tiles changed since the previous frame
+/// are sent: the number of tiles is the number of tiles sent, and the tile table holds the column (2 bytes),
+/// the row (2 bytes) and the compressed size (4 bytes) of each tile sent. The other tiles are kept from the
+/// previous frame by the decoder.
+#define IGTL_INTRA_CODEC_VERSION            1
+#define IGTL_INTRA_CODEC_HEADER_SIZE        12
+#define IGTL_INTRA_CODEC_TILE_SIZE_BYTES    4
+#define IGTL_INTRA_CODEC_DEFAULT_TILE_SIZE  128
+#define IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE  16
+#define IGTL_INTRA_CODEC_MAXIMUM_TILE_SIZE  4096
+#define IGTL_INTRA_CODEC_MAXIMUM_ERROR      16
+#define IGTL_INTRA_CODEC_FLAG_PARTIAL_UPDATE 0x01
+#define IGTL_INTRA_CODEC_PARTIAL_TILE_ENTRY_BYTES 8
+#define IGTL_INTRA_CODEC_DEFAULT_KEY_FRAME_DISTANCE 60
+
+namespace igtl {
+
+/// IntraCodec implements the coding of a tile shared by IntraEncoder and IntraDecoder.
+///
+/// Each pixel is predicted from its left, upper and upper-left neighbours with the median edge detector
+/// of LOCO-I / JPEG-LS. The prediction residuals are coded with adaptive Golomb-Rice codes, the parameter
+/// of the code being estimated in 8 contexts of local gradient activity. Flat areas are coded as runs
+/// of pixels equal to their left neighbour. With a maximum error greater than 0, the residuals are quantized
+/// (near-lossless mode) and each decoded pixel differs from the source by at most the maximum error.
+class IGTLCommon_EXPORT IntraCodec
+{
+public:
+  /// Gets the number of tiles covering a picture.
+  static int GetNumberOfTiles(int picWidth, int picHeight, int tileWidth, int tileHeight);
+
+  /// Gets the region of a tile in a plane (0: Y, 1: U, 2: V) in the plane coordinates.
+  static void GetTileRegion(int plane, int colorFormat, int picWidth, int picHeight, int tileWidth, int tileHeight,
+                            int tileIndex, int& x, int& y, int& width, int& height);
+
+  /// Gets the width and height of a plane (0: Y, 1: U, 2: V).
+  static void GetPlaneSize(int plane, int colorFormat, int picWidth, int picHeight, int& width, int& height);
+
+  /// Gets the number of tile columns covering a picture.
+  static int GetNumberOfTileColumns(int picWidth, int tileWidth);
+
+  /// Returns 1 if any pixel of the tile differs between the two pictures.
+  static int IsTileChanged(SourcePicture* pic, SourcePicture* reference, int colorFormat, int tileWidth, int tileHeight, int tileIndex);
+
+  /// Copies the pixels of the tile from a picture to another picture of the same size.
+  static void CopyTile(SourcePicture* src, SourcePicture* dst, int colorFormat, int tileWidth, int tileHeight, int tileIndex);
+
+  /// Appends the coded tile to the output. scratch is used to keep the reconstructed pixels.
+  static void EncodeTile(SourcePicture* pSrcPic, int colorFormat, int tileWidth, int tileHeight, int tileIndex,
+                         int maximumError, std::vector<igtl_uint8>& output, std::vector<igtl_uint8>& scratch);
+
+  /// Decodes a coded tile into the picture. Returns 0 if the coded tile is corrupted.
+  static int DecodeTile(const igtl_uint8* input, igtl_uint32 inputSize, SourcePicture* pDecodedPic, int colorFormat,
+                        int tileWidth, int tileHeight, int tileIndex, int maximumError);
+};
+
+} // namespace igtl
+
+#endif // __igtlIntraCodecCommon_h
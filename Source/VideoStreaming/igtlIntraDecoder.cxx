@@ -0,0 +1,233 @@
+/*=========================================================================
+
+Program:   OpenIGTLink
+Language:  C++
+
+Copyright (c) Insight Software Consortium. All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtlIntraDecoder.h"
+
+#include <string.h>
+
+namespace igtl {
+
+  IntraDecoder::IntraDecoder()
+  {
+    this->deviceName = "";
+    this->numberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+    this->currentStream = NULL;
+    this->currentPicture = NULL;
+    this->colorFormat = FormatI420;
+    this->tileWidth = IGTL_INTRA_CODEC_DEFAULT_TILE_SIZE;
+    this->tileHeight = IGTL_INTRA_CODEC_DEFAULT_TILE_SIZE;
+    this->maximumError = 0;
+    memset(&this->framePicture, 0, sizeof(SourcePicture));
+    memset(this->updatedRegion, 0, sizeof(this->updatedRegion));
+    this->threader = MultiThreader::New();
+  }
+
+  IntraDecoder::~IntraDecoder()
+  {
+  }
+
+  void IntraDecoder::SetNumberOfThreads(int numThreads)
+  {
+    if (numThreads < 1)
+      {
+      numThreads = 1;
+      }
+    if (numThreads > IGTL_MAX_THREADS)
+      {
+      numThreads = IGTL_MAX_THREADS;
+      }
+    this->numberOfThreads = numThreads;
+  }
+
+  int IntraDecoder::GetUpdatedRegion(int& x, int& y, int& width, int& height)
+  {
+    x = this->updatedRegion[0];
+    y = this->updatedRegion[1];
+    width = this->updatedRegion[2];
+    height = this->updatedRegion[3];
+    return this->tileIndices.size();
+  }
+
+  void* IntraDecoder::DecodeTileThreadFunction(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    IntraDecoder* decoder = static_cast<IntraDecoder*>(info->UserData);
+
+    int numberOfTiles = decoder->tileIndices.size();
+    for (int i = info->ThreadID; i < numberOfTiles; i += info->NumberOfThreads)
+      {
+      decoder->tileStatus[i] = IntraCodec::DecodeTile(decoder->currentStream + decoder->tileOffsets[i], decoder->tileSizes[i],
+                                                      decoder->currentPicture, decoder->colorFormat, decoder->tileWidth,
+                                                      decoder->tileHeight, decoder->tileIndices[i], decoder->maximumError);
+      }
+    return NULL;
+  }
+
+  int IntraDecoder::DecodeVideoMSGIntoSingleFrame(igtl::VideoMessage* videoMessage, SourcePicture* pDecodedPic)
+  {
+    if (videoMessage == NULL || pDecodedPic == NULL || pDecodedPic->data[0] == NULL)
+      {
+      return -1;
+      }
+    igtl_int32 iWidth = videoMessage->GetWidth();
+    igtl_int32 iHeight = videoMessage->GetHeight();
+    igtl_uint64 streamSize = videoMessage->GetBitStreamSize();
+    const igtl_uint8* stream = videoMessage->GetPackFragmentPointer(2);
+    if (iWidth <= 0 || iHeight <= 0 || streamSize < IGTL_INTRA_CODEC_HEADER_SIZE || stream[0] != IGTL_INTRA_CODEC_VERSION)
+      {
+      return -1;
+      }
+
+    // Header
+    int format = stream[1];
+    int maxError = stream[2];
+    bool partialUpdate = (stream[3] & IGTL_INTRA_CODEC_FLAG_PARTIAL_UPDATE) != 0;
+    int tileW = (stream[4] << 8) | stream[5];
+    int tileH = (stream[6] << 8) | stream[7];
+    igtl_uint32 numberOfTiles = ((igtl_uint32)stream[8] << 24) | ((igtl_uint32)stream[9] << 16) |
+                                ((igtl_uint32)stream[10] << 8) | (igtl_uint32)stream[11];
+    igtl_uint32 totalNumberOfTiles = IntraCodec::GetNumberOfTiles(iWidth, iHeight, tileW, tileH);
+    int entrySize = partialUpdate ? IGTL_INTRA_CODEC_PARTIAL_TILE_ENTRY_BYTES : IGTL_INTRA_CODEC_TILE_SIZE_BYTES;
+    if ((format != FormatI420 && format != FormatI444) || maxError > IGTL_INTRA_CODEC_MAXIMUM_ERROR ||
+        tileW < IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE || tileH < IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE ||
+        (format == FormatI420 && ((iWidth & 1) || (iHeight & 1))) ||
+        (partialUpdate ? numberOfTiles > totalNumberOfTiles : numberOfTiles != totalNumberOfTiles) ||
+        streamSize < IGTL_INTRA_CODEC_HEADER_SIZE + (igtl_uint64)numberOfTiles * entrySize)
+      {
+      return -1;
+      }
+    // The partial updates are composited into the previous frame.
+    if (partialUpdate && (this->framePicture.picWidth != iWidth || this->framePicture.picHeight != iHeight ||
+                          this->framePicture.colorFormat != format))
+      {
+      return -1;
+      }
+
+    // Tile table
+    this->tileIndices.resize(numberOfTiles);
+    this->tileOffsets.resize(numberOfTiles);
+    this->tileSizes.resize(numberOfTiles);
+    this->tileStatus.assign(numberOfTiles, 0);
+    int tilesPerRow = IntraCodec::GetNumberOfTileColumns(iWidth, tileW);
+    int tilesPerColumn = totalNumberOfTiles / tilesPerRow;
+    const igtl_uint8* tileTable = stream + IGTL_INTRA_CODEC_HEADER_SIZE;
+    igtl_uint64 offset = IGTL_INTRA_CODEC_HEADER_SIZE + (igtl_uint64)numberOfTiles * entrySize;
+    for (igtl_uint32 i = 0; i < numberOfTiles; i++)
+      {
+      igtl_uint32 tileIndex = i;
+      if (partialUpdate)
+        {
+        int column = (tileTable[0] << 8) | tileTable[1];
+        int row = (tileTable[2] << 8) | tileTable[3];
+        if (column >= tilesPerRow || row >= tilesPerColumn)
+          {
+          return -1;
+          }
+        tileIndex = row * tilesPerRow + column;
+        tileTable += 4;
+        }
+      igtl_uint32 tileSize = ((igtl_uint32)tileTable[0] << 24) | ((igtl_uint32)tileTable[1] << 16) |
+                             ((igtl_uint32)tileTable[2] << 8) | (igtl_uint32)tileTable[3];
+      tileTable += 4;
+      if (offset + tileSize > streamSize)
+        {
+        return -1;
+        }
+      this->tileIndices[i] = tileIndex;
+      this->tileOffsets[i] = (igtl_uint32)offset;
+      this->tileSizes[i] = tileSize;
+      offset += tileSize;
+      }
+
+    igtl_uint16 frameType = videoMessage->GetFrameType();
+    isGrayImage = false;
+    if (frameType>0X00FF)
+      {
+      frameType= frameType>>8;
+      isGrayImage = true;
+      }
+    int chromaWidth, chromaHeight;
+    IntraCodec::GetPlaneSize(1, format, iWidth, iHeight, chromaWidth, chromaHeight);
+    int frameSize = iWidth*iHeight + 2*chromaWidth*chromaHeight;
+    if (!partialUpdate)
+      {
+      this->frameBuffer.resize(frameSize);
+      this->framePicture.colorFormat = format;
+      this->framePicture.picWidth = iWidth;
+      this->framePicture.picHeight = iHeight;
+      this->framePicture.data[0] = &this->frameBuffer[0];
+      this->framePicture.data[1] = this->framePicture.data[0] + iWidth*iHeight;
+      this->framePicture.data[2] = this->framePicture.data[1] + chromaWidth*chromaHeight;
+      this->framePicture.stride[0] = iWidth;
+      this->framePicture.stride[1] = this->framePicture.stride[2] = chromaWidth;
+      this->framePicture.stride[3] = 0;
+      }
+
+    this->currentStream = stream;
+    this->currentPicture = &this->framePicture;
+    this->colorFormat = format;
+    this->tileWidth = tileW;
+    this->tileHeight = tileH;
+    this->maximumError = maxError;
+    int numThreads = this->numberOfThreads < (int)numberOfTiles ? this->numberOfThreads : (int)numberOfTiles;
+    if (numThreads > 1)
+      {
+      this->threader->SetNumberOfThreads(numThreads);
+      this->threader->SetSingleMethod((igtl::ThreadFunctionType) &IntraDecoder::DecodeTileThreadFunction, this);
+      this->threader->SingleMethodExecute();
+      }
+    else if (numThreads == 1)
+      {
+      igtl::MultiThreader::ThreadInfo info;
+      info.ThreadID = 0;
+      info.NumberOfThreads = 1;
+      info.UserData = this;
+      DecodeTileThreadFunction(&info);
+      }
+    this->currentStream = NULL;
+    this->currentPicture = NULL;
+
+    int x0 = iWidth, y0 = iHeight, x1 = 0, y1 = 0;
+    for (igtl_uint32 i = 0; i < numberOfTiles; i++)
+      {
+      if (!this->tileStatus[i])
+        {
+        // The frame is partly overwritten, the next partial updates cannot be applied.
+        this->framePicture.picWidth = 0;
+        return -1;
+        }
+      int x, y, w, h;
+      IntraCodec::GetTileRegion(0, format, iWidth, iHeight, tileW, tileH, this->tileIndices[i], x, y, w, h);
+      x0 = x < x0 ? x : x0;
+      y0 = y < y0 ? y : y0;
+      x1 = x + w > x1 ? x + w : x1;
+      y1 = y + h > y1 ? y + h : y1;
+      }
+    this->updatedRegion[0] = numberOfTiles > 0 ? x0 : 0;
+    this->updatedRegion[1] = numberOfTiles > 0 ? y0 : 0;
+    this->updatedRegion[2] = numberOfTiles > 0 ? x1 - x0 : 0;
+    this->updatedRegion[3] = numberOfTiles > 0 ? y1 - y0 : 0;
+
+    pDecodedPic->colorFormat = format;
+    pDecodedPic->picWidth = iWidth;
+    pDecodedPic->picHeight = iHeight;
+    pDecodedPic->data[1] = pDecodedPic->data[0] + iWidth*iHeight;
+    pDecodedPic->data[2] = pDecodedPic->data[1] + chromaWidth*chromaHeight;
+    pDecodedPic->stride[0] = iWidth;
+    pDecodedPic->stride[1] = pDecodedPic->stride[2] = chromaWidth;
+    pDecodedPic->stride[3] = 0;
+    memcpy(pDecodedPic->data[0], &this->frameBuffer[0], frameSize);
+    return 1;
+  }
+
+}// namespace igtl
@@ -0,0 +1,94 @@
+/*=========================================================================
+
+Program:   OpenIGTLink
+Language:  C++
+
+Copyright (c) Insight Software Consortium. All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __igtlIntraDecoder_h
+#define __igtlIntraDecoder_h
+
+#include <vector>
+
+#include "igtl_types.h"
+#include "igtlVideoMessage.h"
+#include "igtlCodecCommonClasses.h"
+#include "igtlIntraCodecCommon.h"
+#include "igtlMultiThreader.h"
+
+namespace igtl {
+
+  /// IntraDecoder decodes the frames encoded by IntraEncoder, the tiles are decoded in parallel.
+  /// The decoded picture is written contiguously at pDecodedPic->data[0], which must hold
+  /// width*height*3/2 bytes for I420 frames and width*height*3 bytes for I444 frames.
+  ///
+  /// The decoder keeps the last frame, into which the tiles of the partial updates are composited.
+  /// A partial update received before a full frame of the same size and format is rejected.
+  class IGTLCommon_EXPORT IntraDecoder :public GenericDecoder
+  {
+  public:
+    igtlTypeMacro(IntraDecoder, GenericDecoder);
+    igtlNewMacro(IntraDecoder);
+
+    IntraDecoder();
+    ~IntraDecoder();
+
+    virtual int DecodeBitStreamIntoFrame(unsigned char* bitStream, igtl_uint8* outputFrame, igtl_uint32 iDimensions[2], igtl_uint64 &iStreamSize) { return -1; };
+
+    /// Returns 1 on success, -1 if the bit stream is not a valid intra codec stream.
+    virtual int DecodeVideoMSGIntoSingleFrame(igtl::VideoMessage* videoMessage, SourcePicture* pDecodedPic);
+
+    /// Gets the number of tiles updated by the last decoded frame, and the bounding box of these tiles
+    /// in the luma plane, e.g. to redraw only the changed region. The box is empty if no tile was updated.
+    int GetUpdatedRegion(int& x, int& y, int& width, int& height);
+
+    void SetNumberOfThreads(int numberOfThreads);
+
+    int GetNumberOfThreads(){return this->numberOfThreads;};
+
+  protected:
+    static void* DecodeTileThreadFunction(void* ptr);
+
+  private:
+    int numberOfThreads;
+
+    /// State of the frame being decoded, shared by the threads
+    const igtl_uint8* currentStream;
+
+    SourcePicture* currentPicture;
+
+    int colorFormat;
+
+    int tileWidth;
+
+    int tileHeight;
+
+    int maximumError;
+
+    std::vector<igtl_uint32> tileIndices;
+
+    std::vector<igtl_uint32> tileOffsets;
+
+    std::vector<igtl_uint32> tileSizes;
+
+    std::vector<int> tileStatus;
+
+    /// Last decoded frame
+    std::vector<igtl_uint8> frameBuffer;
+
+    SourcePicture framePicture;
+
+    int updatedRegion[4];
+
+    MultiThreader::Pointer threader;
+  };
+
+} // namespace igtl
+
+#endif
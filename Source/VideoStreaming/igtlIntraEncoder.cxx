@@ -0,0 +1,289 @@
+/*=========================================================================
+ 
+ Program:   OpenIGTLink
+ Language:  C++
+ 
+ Copyright (c) Insight Software Consortium. All rights reserved.
+ 
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+ 
+ =========================================================================*/
+
+
+#include "igtlIntraEncoder.h"
+#include "igtlVideoMessage.h"
+
+#include <string.h>
+
+namespace igtl {
+
+IntraEncoder::IntraEncoder(char *configFile):GenericEncoder()
+{
+  this->tileWidth = IGTL_INTRA_CODEC_DEFAULT_TILE_SIZE;
+  this->tileHeight = IGTL_INTRA_CODEC_DEFAULT_TILE_SIZE;
+  this->maximumError = 0;
+  this->numberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->colorFormat = FormatI420;
+  this->currentPicture = NULL;
+  this->partialUpdate = false;
+  this->keyFrameDistance = IGTL_INTRA_CODEC_DEFAULT_KEY_FRAME_DISTANCE;
+  this->framesSinceKeyFrame = 0;
+  this->isKeyFrame = true;
+  this->numberOfEncodedTiles = 0;
+  memset(&this->referencePicture, 0, sizeof(SourcePicture));
+  this->threader = MultiThreader::New();
+}
+
+IntraEncoder::~IntraEncoder()
+{
+}
+
+int IntraEncoder::InitializeEncoder()
+{
+  this->initializationDone = true;
+  return 0;
+}
+
+int IntraEncoder::SetPicWidthAndHeight(unsigned int width, unsigned int height)
+{
+  this->picWidth = width;
+  this->picHeight = height;
+  return 0;
+}
+
+int IntraEncoder::SetTileSize(unsigned int width, unsigned int height)
+{
+  if (width < IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE || width > IGTL_INTRA_CODEC_MAXIMUM_TILE_SIZE || (width & 1) ||
+      height < IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE || height > IGTL_INTRA_CODEC_MAXIMUM_TILE_SIZE || (height & 1))
+    {
+    return -1;
+    }
+  this->tileWidth = width;
+  this->tileHeight = height;
+  return 0;
+}
+
+int IntraEncoder::SetMaximumError(int maxError)
+{
+  if (maxError < 0 || maxError > IGTL_INTRA_CODEC_MAXIMUM_ERROR)
+    {
+    return -1;
+    }
+  this->maximumError = maxError;
+  this->isLossLessLink = (maxError == 0);
+  return 0;
+}
+
+void IntraEncoder::SetPartialUpdate(bool enable)
+{
+  this->partialUpdate = enable;
+  // The reference is only kept up to date in the partial update mode.
+  this->referencePicture.picWidth = 0;
+}
+
+int IntraEncoder::SetKeyFrameDistance(int frameNum)
+{
+  if (frameNum < 1)
+    {
+    return -1;
+    }
+  this->keyFrameDistance = frameNum;
+  return 0;
+}
+
+void IntraEncoder::SetNumberOfThreads(int numThreads)
+{
+  if (numThreads < 1)
+    {
+    numThreads = 1;
+    }
+  if (numThreads > IGTL_MAX_THREADS)
+    {
+    numThreads = IGTL_MAX_THREADS;
+    }
+  this->numberOfThreads = numThreads;
+}
+
+void* IntraEncoder::EncodeTileThreadFunction(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  IntraEncoder* encoder = static_cast<IntraEncoder*>(info->UserData);
+
+  // The tiles are distributed round robin, so that the tiles of each thread are spread over the picture.
+  int numberOfTiles = encoder->tileStreams.size();
+  std::vector<igtl_uint8>& scratch = encoder->scratchBuffers[info->ThreadID];
+  for (int i = info->ThreadID; i < numberOfTiles; i += info->NumberOfThreads)
+    {
+    encoder->tileStreams[i].clear();
+    if (!encoder->isKeyFrame &&
+        !IntraCodec::IsTileChanged(encoder->currentPicture, &encoder->referencePicture, encoder->colorFormat,
+                                   encoder->tileWidth, encoder->tileHeight, i))
+      {
+      encoder->tileEncoded[i] = 0;
+      continue;
+      }
+    encoder->tileEncoded[i] = 1;
+    IntraCodec::EncodeTile(encoder->currentPicture, encoder->colorFormat, encoder->tileWidth, encoder->tileHeight, i,
+                           encoder->maximumError, encoder->tileStreams[i], scratch);
+    if (encoder->partialUpdate)
+      {
+      IntraCodec::CopyTile(encoder->currentPicture, &encoder->referencePicture, encoder->colorFormat,
+                           encoder->tileWidth, encoder->tileHeight, i);
+      }
+    }
+  return NULL;
+}
+
+int IntraEncoder::EncodeSingleFrameIntoVideoMSG(SourcePicture* pSrcPic, igtl::VideoMessage* videoMessage, bool isGrayImage)
+{
+  if (pSrcPic == NULL || videoMessage == NULL || pSrcPic->picWidth <= 0 || pSrcPic->picHeight <= 0 ||
+      pSrcPic->data[0] == NULL || pSrcPic->data[1] == NULL || pSrcPic->data[2] == NULL)
+    {
+    return InitParaError;
+    }
+  if (pSrcPic->colorFormat != FormatI420 && pSrcPic->colorFormat != FormatI444)
+    {
+    return UnsupportedData;
+    }
+  if (pSrcPic->colorFormat == FormatI420 && ((pSrcPic->picWidth & 1) || (pSrcPic->picHeight & 1)))
+    {
+    return UnsupportedData;
+    }
+
+  this->colorFormat = pSrcPic->colorFormat;
+  this->currentPicture = pSrcPic;
+  int numberOfTiles = IntraCodec::GetNumberOfTiles(pSrcPic->picWidth, pSrcPic->picHeight, this->tileWidth, this->tileHeight);
+  this->tileStreams.resize(numberOfTiles);
+  this->tileEncoded.resize(numberOfTiles);
+
+  // A full frame is sent when partial updates are disabled, when the reference does not match the picture,
+  // and every key frame distance.
+  this->isKeyFrame = true;
+  if (this->partialUpdate)
+    {
+    if (this->referencePicture.picWidth == pSrcPic->picWidth && this->referencePicture.picHeight == pSrcPic->picHeight &&
+        this->referencePicture.colorFormat == this->colorFormat &&
+        this->framesSinceKeyFrame + 1 < this->keyFrameDistance)
+      {
+      this->isKeyFrame = false;
+      }
+    else
+      {
+      int chromaWidth, chromaHeight;
+      IntraCodec::GetPlaneSize(1, this->colorFormat, pSrcPic->picWidth, pSrcPic->picHeight, chromaWidth, chromaHeight);
+      int lumaSize = pSrcPic->picWidth * pSrcPic->picHeight;
+      this->referenceBuffer.resize(lumaSize + 2 * chromaWidth * chromaHeight);
+      this->referencePicture.colorFormat = this->colorFormat;
+      this->referencePicture.picWidth = pSrcPic->picWidth;
+      this->referencePicture.picHeight = pSrcPic->picHeight;
+      this->referencePicture.data[0] = &this->referenceBuffer[0];
+      this->referencePicture.data[1] = this->referencePicture.data[0] + lumaSize;
+      this->referencePicture.data[2] = this->referencePicture.data[1] + chromaWidth * chromaHeight;
+      this->referencePicture.data[3] = NULL;
+      this->referencePicture.stride[0] = pSrcPic->picWidth;
+      this->referencePicture.stride[1] = this->referencePicture.stride[2] = chromaWidth;
+      this->referencePicture.stride[3] = 0;
+      }
+    }
+  this->framesSinceKeyFrame = this->isKeyFrame ? 0 : this->framesSinceKeyFrame + 1;
+
+  int numThreads = this->numberOfThreads < numberOfTiles ? this->numberOfThreads : numberOfTiles;
+  this->scratchBuffers.resize(numThreads);
+  if (numThreads > 1)
+    {
+    this->threader->SetNumberOfThreads(numThreads);
+    this->threader->SetSingleMethod((igtl::ThreadFunctionType) &IntraEncoder::EncodeTileThreadFunction, this);
+    this->threader->SingleMethodExecute();
+    }
+  else
+    {
+    igtl::MultiThreader::ThreadInfo info;
+    info.ThreadID = 0;
+    info.NumberOfThreads = 1;
+    info.UserData = this;
+    EncodeTileThreadFunction(&info);
+    }
+  this->currentPicture = NULL;
+
+  this->numberOfEncodedTiles = 0;
+  igtl_uint32 streamSize = IGTL_INTRA_CODEC_HEADER_SIZE;
+  for (int i = 0; i < numberOfTiles; i++)
+    {
+    if (this->tileEncoded[i])
+      {
+      this->numberOfEncodedTiles++;
+      streamSize += this->tileStreams[i].size();
+      }
+    }
+  streamSize += this->numberOfEncodedTiles *
+    (this->isKeyFrame ? IGTL_INTRA_CODEC_TILE_SIZE_BYTES : IGTL_INTRA_CODEC_PARTIAL_TILE_ENTRY_BYTES);
+
+  videoMessage->SetCodecType(IGTL_VIDEO_CODEC_NAME_INTRA);
+  videoMessage->SetBitStreamSize(streamSize);
+  videoMessage->AllocateScalars();
+  int endian = (igtl_is_little_endian() == 1 ? IGTL_VIDEO_ENDIAN_LITTLE : IGTL_VIDEO_ENDIAN_BIG);
+  videoMessage->SetEndian(endian); //little endian is 2 big endian is 1
+  videoMessage->SetWidth(pSrcPic->picWidth);
+  videoMessage->SetHeight(pSrcPic->picHeight);
+  encodedFrameType = FrameTypeKey;
+  if (!this->isKeyFrame)
+    {
+    encodedFrameType = this->numberOfEncodedTiles > 0 ? FrameTypeInterPrediction : FrameTypeSkip;
+    }
+  // The gray flag is only set in the message, so that GetVideoFrameType() tells VideoStreamIGTLinkServer
+  // to skip the frames without changed tile.
+  videoMessage->SetFrameType(isGrayImage ? (encodedFrameType << 8) : encodedFrameType);
+
+  // Header and tile table, big endian
+  igtl_uint8* stream = videoMessage->GetPackFragmentPointer(2);
+  stream[0] = IGTL_INTRA_CODEC_VERSION;
+  stream[1] = (igtl_uint8)this->colorFormat;
+  stream[2] = (igtl_uint8)this->maximumError;
+  stream[3] = this->isKeyFrame ? 0 : IGTL_INTRA_CODEC_FLAG_PARTIAL_UPDATE;
+  stream[4] = (igtl_uint8)(this->tileWidth >> 8);
+  stream[5] = (igtl_uint8)(this->tileWidth);
+  stream[6] = (igtl_uint8)(this->tileHeight >> 8);
+  stream[7] = (igtl_uint8)(this->tileHeight);
+  stream[8] = (igtl_uint8)(this->numberOfEncodedTiles >> 24);
+  stream[9] = (igtl_uint8)(this->numberOfEncodedTiles >> 16);
+  stream[10] = (igtl_uint8)(this->numberOfEncodedTiles >> 8);
+  stream[11] = (igtl_uint8)(this->numberOfEncodedTiles);
+  igtl_uint8* tileTable = stream + IGTL_INTRA_CODEC_HEADER_SIZE;
+  igtl_uint8* tileData = tileTable + this->numberOfEncodedTiles *
+    (this->isKeyFrame ? IGTL_INTRA_CODEC_TILE_SIZE_BYTES : IGTL_INTRA_CODEC_PARTIAL_TILE_ENTRY_BYTES);
+  int tilesPerRow = IntraCodec::GetNumberOfTileColumns(pSrcPic->picWidth, this->tileWidth);
+  for (int i = 0; i < numberOfTiles; i++)
+    {
+    if (!this->tileEncoded[i])
+      {
+      continue;
+      }
+    if (!this->isKeyFrame)
+      {
+      int column = i % tilesPerRow;
+      int row = i / tilesPerRow;
+      tileTable[0] = (igtl_uint8)(column >> 8);
+      tileTable[1] = (igtl_uint8)(column);
+      tileTable[2] = (igtl_uint8)(row >> 8);
+      tileTable[3] = (igtl_uint8)(row);
+      tileTable += 4;
+      }
+    igtl_uint32 tileSize = this->tileStreams[i].size();
+    tileTable[0] = (igtl_uint8)(tileSize >> 24);
+    tileTable[1] = (igtl_uint8)(tileSize >> 16);
+    tileTable[2] = (igtl_uint8)(tileSize >> 8);
+    tileTable[3] = (igtl_uint8)(tileSize);
+    tileTable += 4;
+    if (tileSize > 0)
+      {
+      memcpy(tileData, &this->tileStreams[i][0], tileSize);
+      tileData += tileSize;
+      }
+    }
+  videoMessage->Pack();
+  return ResultSuccess;
+}
+
+}// namespace igtl
@@ -0,0 +1,136 @@
+/*=========================================================================
+
+  Program:   OpenIGTLink
+  Language:  C++
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __igtlIntraEncoder_h
+#define __igtlIntraEncoder_h
+
+#include <vector>
+
+#include "igtlCodecCommonClasses.h"
+#include "igtlIntraCodecCommon.h"
+#include "igtlMultiThreader.h"
+
+namespace igtl {
+
+/// IntraEncoder is a lossless / near-lossless intra-frame encoder without external dependency.
+/// The frame is split into tiles which are encoded in parallel, see IntraCodec for the coding.
+/// I420 and I444 pictures are supported, the format is given by SourcePicture::colorFormat.
+///
+/// With the partial update mode, only the tiles changed since the previous frame are sent, which suits
+/// user interface overlays and imaging with a static background. A full frame is still sent every
+/// key frame distance, and when the picture size or format changes.
+class IGTLCommon_EXPORT IntraEncoder: public GenericEncoder
+{
+public:
+  igtlTypeMacro(IntraEncoder, GenericEncoder);
+  igtlNewMacro(IntraEncoder);
+
+  IntraEncoder(char * configFile = NULL);
+  ~IntraEncoder();
+
+  virtual int InitializeEncoder();
+
+  /**
+   Encode a frame, for performance issue, before encode the frame, make sure the frame pointer is updated with a new frame.
+   Otherwize, the old frame will be encoded.
+   */
+  virtual int EncodeSingleFrameIntoVideoMSG(SourcePicture* pSrcPic, igtl::VideoMessage* videoMessage, bool isGrayImage = false );
+
+  virtual int SetPicWidthAndHeight(unsigned int width, unsigned int height);
+
+  /**
+   Set the tile size. The width and height must be even and between IGTL_INTRA_CODEC_MINIMUM_TILE_SIZE and
+   IGTL_INTRA_CODEC_MAXIMUM_TILE_SIZE. Smaller tiles give more parallelism, larger tiles a slightly better compression.
+   */
+  int SetTileSize(unsigned int width, unsigned int height);
+
+  /**
+   Set the maximum error per pixel. 0 (default) is lossless, larger values up to IGTL_INTRA_CODEC_MAXIMUM_ERROR
+   reduce the bit rate.
+   */
+  int SetMaximumError(int maximumError);
+
+  int GetMaximumError(){return this->maximumError;};
+
+  /**
+   Enable or disable the partial update mode. When a frame has no changed tile, the frame type is
+   FrameTypeSkip and VideoStreamIGTLinkServer does not send the message.
+   */
+  void SetPartialUpdate(bool enable);
+
+  bool GetPartialUpdate(){return this->partialUpdate;};
+
+  /**
+   Set the number of frames between two full frames in the partial update mode, 1 sends only full frames.
+   */
+  virtual int SetKeyFrameDistance(int frameNum);
+
+  int GetKeyFrameDistance(){return this->keyFrameDistance;};
+
+  /**
+   Get the number of tiles in the last encoded frame.
+   */
+  int GetNumberOfEncodedTiles(){return this->numberOfEncodedTiles;};
+
+  /**
+   Set the number of threads encoding the tiles.
+   */
+  void SetNumberOfThreads(int numberOfThreads);
+
+  int GetNumberOfThreads(){return this->numberOfThreads;};
+
+protected:
+  static void* EncodeTileThreadFunction(void* ptr);
+
+private:
+  unsigned int tileWidth;
+
+  unsigned int tileHeight;
+
+  int maximumError;
+
+  int numberOfThreads;
+
+  int colorFormat;
+
+  SourcePicture* currentPicture;
+
+  bool partialUpdate;
+
+  int keyFrameDistance;
+
+  int framesSinceKeyFrame;
+
+  bool isKeyFrame;
+
+  int numberOfEncodedTiles;
+
+  /// Previous frame, the changed tiles are detected against it in the partial update mode
+  std::vector<igtl_uint8> referenceBuffer;
+
+  SourcePicture referencePicture;
+
+  /// 1 if the tile is encoded in the current frame
+  std::vector<char> tileEncoded;
+
+  /// Coded tiles, reused from frame to frame
+  std::vector<std::vector<igtl_uint8> > tileStreams;
+
+  /// Reconstructed pixels of each thread
+  std::vector<std::vector<igtl_uint8> > scratchBuffers;
+
+  MultiThreader::Pointer threader;
+};
+
+
+}// Namespace igtl
+#endif
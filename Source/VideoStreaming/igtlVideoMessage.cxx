@@ -94,7 +94,7 @@ namespace igtl {
   
   int VideoMessage::SetCodecType(const char codecType[])
   {
-    if (strcmp(codecType, IGTL_VIDEO_CODEC_NAME_I420) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_X265) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_VP9) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_H264) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_OPENHEVC) == 0)
+    if (strcmp(codecType, IGTL_VIDEO_CODEC_NAME_I420) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_X265) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_VP9) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_H264) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_OPENHEVC) == 0 || strcmp(codecType, IGTL_VIDEO_CODEC_NAME_INTRA) == 0)
       {
       this->m_CodecType = std::string(codecType);
       return 0;
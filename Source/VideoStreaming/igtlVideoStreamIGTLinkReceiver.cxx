@@ -106,6 +106,12 @@ void VideoStreamIGTLinkReceiver::SetDecoder(GenericDecoder* decoder)
   this->decodeInstance = decoder;
 }
 
+void VideoStreamIGTLinkReceiver::SetLatencyRecorder(igtl::LatencyRecorder::Pointer recorder)
+{
+  this->latencyRecorder = recorder;
+  this->rtpWrapper->SetLatencyRecorder(recorder);
+}
+
 
 int VideoStreamIGTLinkReceiver::RunOnTCPSocket()
 {
@@ -181,8 +187,16 @@ int VideoStreamIGTLinkReceiver::RunOnTCPSocket()
         }
       this->videoMessageBuffer = new igtl_uint8[streamLength];
       memcpy(this->videoMessageBuffer, videoMsg->GetPackFragmentPointer(2), streamLength);
+      if (this->latencyRecorder.IsNotNull())
+        {
+        this->latencyRecorder->ReadStampsFromMetaData(videoMsg);
+        }
       static int frameNum = 0;
       int status = this->ProcessVideoStream(this->videoMessageBuffer,streamLength);
+      if (this->latencyRecorder.IsNotNull())
+        {
+        this->latencyRecorder->Stamp(videoMsg->GetMessageID(), LatencyRecorder::STAGE_DECODED);
+        }
       
       if (status == 0)
         {
@@ -273,7 +287,15 @@ int VideoStreamIGTLinkReceiver::RunOnUDPSocket()
         this->videoMessageBuffer = new igtl_uint8[streamLength];
         memcpy(this->videoMessageBuffer, videoMultiPKTMSG->GetPackFragmentPointer(2), streamLength);
         
+        if (this->latencyRecorder.IsNotNull())
+          {
+          this->latencyRecorder->ReadStampsFromMetaData(videoMultiPKTMSG);
+          }
         int status = this->ProcessVideoStream(this->videoMessageBuffer,streamLength);
+        if (this->latencyRecorder.IsNotNull())
+          {
+          this->latencyRecorder->Stamp(videoMultiPKTMSG->GetMessageID(), LatencyRecorder::STAGE_DECODED);
+          }
         
         if (status == 0)
           {
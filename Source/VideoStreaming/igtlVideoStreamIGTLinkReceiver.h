@@ -52,6 +52,10 @@ public:
   
   void SetDecoder(GenericDecoder* decoder);
   
+  /// Set the recorder of the frame latency. The packet and reassembly stages are recorded by the RTP wrapper,
+  /// the encoding stages are read from the meta data of the video messages.
+  void SetLatencyRecorder(igtl::LatencyRecorder::Pointer recorder);
+  
   bool InitializeClient();
   
   void SendStopMessage();
@@ -114,6 +118,8 @@ private:
   
   igtl::MessageRTPWrapper::Pointer rtpWrapper;
   
+  igtl::LatencyRecorder::Pointer latencyRecorder;
+  
   char codecType[IGTL_VIDEO_CODEC_NAME_SIZE];
   
   int Width;
@@ -657,6 +657,7 @@ int VideoStreamIGTLinkServer::EncodeFile(void)
   int picSize = pSrcPic->picWidth*pSrcPic->picHeight;
   
   igtl_int32 iFrameIdx = 0;
+  static int messageID = -1;
   this->totalCompressedDataSize = 0;
   int iActualFrameEncodedCount = 0;
   while(this->iTotalFrameToEncode)
@@ -681,6 +682,13 @@ int VideoStreamIGTLinkServer::EncodeFile(void)
       igtl::VideoMessage::Pointer videoMsg = igtl::VideoMessage::New();
       videoMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
       videoMsg->SetDeviceName(this->deviceName.c_str());
+      if (this->latencyRecorder.IsNotNull())
+        {
+        // The stamps are written before the encoding, so that the encoder allocates the message with room for them.
+        videoMsg->SetMessageID(messageID + 1);
+        this->latencyRecorder->SetStamp(messageID + 1, LatencyRecorder::STAGE_ENCODE_START, this->encodeStartTime);
+        this->latencyRecorder->WriteStampsToMetaData(videoMsg);
+        }
       int iEncFrames = this->videoEncoder->EncodeSingleFrameIntoVideoMSG(this->pSrcPic, videoMsg, false);
       this->ServerTimer->GetTime();
       this->encodeEndTime = this->ServerTimer->GetTimeStampInNanoseconds();
@@ -691,8 +699,13 @@ int VideoStreamIGTLinkServer::EncodeFile(void)
       }
       
       if (iEncFrames == ResultSuccess ) {
-        static int messageID = -1;
         messageID++;
+        if (this->latencyRecorder.IsNotNull())
+          {
+          // Updates the stamps of the message packed by the encoder.
+          this->latencyRecorder->SetStamp(messageID, LatencyRecorder::STAGE_ENCODE_END, this->encodeEndTime);
+          this->latencyRecorder->WriteStampsToMetaData(videoMsg);
+          }
         this->totalCompressedDataSize += videoMsg->GetPackedBitStreamSize();
         encodedFrame* frame = new encodedFrame();
         memcpy(frame->messagePackPointer, videoMsg->GetPackPointer(), videoMsg->GetBufferSize());
@@ -718,6 +731,12 @@ int VideoStreamIGTLinkServer::EncodeFile(void)
   return 0;
 }
 
+void VideoStreamIGTLinkServer::SetLatencyRecorder(igtl::LatencyRecorder::Pointer recorder)
+{
+  this->latencyRecorder = recorder;
+  this->rtpWrapper->SetLatencyRecorder(recorder);
+}
+
 void VideoStreamIGTLinkServer::Stop()
 {
   if(serverThreadID>=0)
@@ -102,6 +102,12 @@ public:
    */
   void SetWaitSTTCommand(bool needSTTCommand){ waitSTTCommand = needSTTCommand;};
   
+  /**
+   Set the recorder of the frame latency. The encoding stages are carried in the meta data of the video messages,
+   the wrap and packet stages are recorded by the RTP wrapper.
+   */
+  void SetLatencyRecorder(igtl::LatencyRecorder::Pointer recorder);
+  
   /**
    Get the encoder and server initialization status.
    */
@@ -146,6 +152,8 @@ public:
   
   igtl::MessageRTPWrapper::Pointer rtpWrapper;
   
+  igtl::LatencyRecorder::Pointer latencyRecorder;
+  
   GenericEncoder*  videoEncoder;
   
   // for server configuration file
@@ -9,6 +9,9 @@ LIST(APPEND OpenIGTLink_SOURCES
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlVideoMetaMessage.cxx
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlI420Decoder.cxx
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlI420Encoder.cxx
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraCodecCommon.cxx
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraDecoder.cxx
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraEncoder.cxx
   )
 LIST(APPEND OpenIGTLink_INCLUDE_DIRS
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming
@@ -23,6 +26,9 @@ LIST(APPEND OpenIGTLink_INCLUDE_FILES
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlVideoMetaMessage.h
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlI420Decoder.h
   ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlI420Encoder.h
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraCodecCommon.h
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraDecoder.h
+  ${PROJECT_SOURCE_DIR}/Source/VideoStreaming/igtlIntraEncoder.h
   )
 IF(OpenIGTLink_USE_H264)
   INCLUDE(${OpenIGTLink_SOURCE_DIR}/SuperBuild/External_openh264.cmake)
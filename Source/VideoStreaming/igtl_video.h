@@ -47,6 +47,7 @@
 #define IGTL_VIDEO_CODEC_NAME_X265      "X265"
 #define IGTL_VIDEO_CODEC_NAME_OPENHEVC  "O265"
 #define IGTL_VIDEO_CODEC_NAME_AV1       "AV10"
+#define IGTL_VIDEO_CODEC_NAME_INTRA     "INTR"
 
 #ifdef __cplusplus
 extern "C" {
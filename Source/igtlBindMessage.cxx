@@ -16,11 +16,15 @@
 
 #include "igtl_header.h"
 #include "igtl_bind.h"
+#include "igtl_util.h"
 
 #include <string.h>
 
 namespace igtl {
 
+// Padding byte appended to the child message bodies of odd size
+static unsigned char BindMessagePadding = 0;
+
 
 
 BindMessageBase::BindMessageBase():
@@ -118,6 +122,18 @@ const char* BindMessageBase::GetChildMessageType(unsigned int i)
 }
 
 
+const char* BindMessageBase::GetChildMessageName(unsigned int i)
+{
+  if (i < this->m_ChildMessages.size())
+    {
+    return this->m_ChildMessages[i].name.c_str();
+    }
+  else
+    {
+    return NULL;
+    }
+}
+
 
 BindMessage::BindMessage():
   BindMessageBase()
@@ -170,11 +186,142 @@ int BindMessage::GetChildMessage(unsigned int i, igtl::MessageBase * child)
 }
 
 
-int BindMessage::CalculateContentBufferSize()
+int BindMessage::AppendChildMessageBody(const char * type, const char * name, const void * body, igtlUint64 size)
+{
+  if (this->m_ChildMessages.size() < 0xFFFF &&
+      strlen(type) <= IGTL_HEADER_TYPE_SIZE &&
+      strlen(name) <= IGTL_HEADER_NAME_SIZE)
+    {
+    m_IsBodyPacked = false;
+    ChildMessageInfo info;
+    info.type = type;
+    info.name = name;
+    info.size = size;
+    info.ptr  = (void*)body;
+    this->m_ChildMessages.push_back(info);
+    }
+  return this->m_ChildMessages.size();
+}
+
+
+const void* BindMessage::GetChildMessageBodyPointer(unsigned int i)
+{
+  if (i < this->m_ChildMessages.size())
+    {
+    return this->m_ChildMessages[i].ptr;
+    }
+  else
+    {
+    return NULL;
+    }
+}
+
+
+igtlUint64 BindMessage::GetChildMessageBodySize(unsigned int i)
+{
+  if (i < this->m_ChildMessages.size())
+    {
+    return this->m_ChildMessages[i].size;
+    }
+  else
+    {
+    return 0;
+    }
+}
+
+
+int BindMessage::PackFragments()
+{
+  this->m_PackFragmentPointers.clear();
+  this->m_PackFragmentSizes.clear();
+
+  // Only the BIND header and the name table are serialized in the buffer of the message.
+#if OpenIGTLink_HEADER_VERSION >= 2
+  PackIntegrityMetaData();
+#endif
+  int bindHeaderSize = CalculateBindHeaderSize();
+  AllocateBuffer(bindHeaderSize);
+#if OpenIGTLink_HEADER_VERSION >= 2
+  PackExtendedHeader();
+#endif
+  if (PackBindHeader() == 0)
+    {
+    return 0;
+    }
+
+  this->m_PackFragmentPointers.push_back(this->m_Header);
+  this->m_PackFragmentSizes.push_back(((unsigned char*)this->m_Content - this->m_Header) + bindHeaderSize);
+  std::vector<ChildMessageInfo>::iterator iter;
+  for (iter = this->m_ChildMessages.begin(); iter != this->m_ChildMessages.end(); iter ++)
+    {
+    this->m_PackFragmentPointers.push_back((*iter).ptr);
+    this->m_PackFragmentSizes.push_back((int)(*iter).size);
+    if ((*iter).size % 2)
+      {
+      this->m_PackFragmentPointers.push_back(&BindMessagePadding);
+      this->m_PackFragmentSizes.push_back(1);
+      }
+    }
+#if OpenIGTLink_HEADER_VERSION >= 2
+  if (m_HeaderVersion == IGTL_HEADER_VERSION_2)
+    {
+    this->m_PackFragmentPointers.push_back(this->m_MetaDataHeader);
+    this->m_PackFragmentSizes.push_back(GetMetaDataHeaderSize() + GetMetaDataSize());
+    }
+#endif
+
+  // The meta data are packed and the CRC is calculated over the fragments of the body,
+  // according to the integrity mode.
+  std::vector<const unsigned char*> bodyFragments(1, this->m_Body);
+  std::vector<igtlUint64> bodySizes(1, this->m_PackFragmentSizes[0] - IGTL_HEADER_SIZE);
+  igtlUint64 bodySize = bodySizes[0];
+  for (unsigned int i = 1; i < this->m_PackFragmentPointers.size(); i ++)
+    {
+    bodyFragments.push_back((const unsigned char*)this->m_PackFragmentPointers[i]);
+    bodySizes.push_back(this->m_PackFragmentSizes[i]);
+    bodySize += this->m_PackFragmentSizes[i];
+    }
+  PackMetaDataAndBodyCRC(bodyFragments, bodySizes);
+  PackHeader(bodySize);
+
+  // The buffer does not hold the whole message, Pack() has to serialize it again.
+  m_IsBodyPacked = false;
+  m_IsHeaderUnpacked = false;
+
+  return 1;
+}
+
+
+int BindMessage::GetNumberOfPackFragments()
+{
+  return this->m_PackFragmentPointers.size();
+}
+
+
+void* BindMessage::GetPackFragmentPointer(int id)
+{
+  if (id >= 0 && id < (int)this->m_PackFragmentPointers.size())
+    {
+    return this->m_PackFragmentPointers[id];
+    }
+  return NULL;
+}
+
+
+int BindMessage::GetPackFragmentSize(int id)
+{
+  if (id >= 0 && id < (int)this->m_PackFragmentSizes.size())
+    {
+    return this->m_PackFragmentSizes[id];
+    }
+  return 0;
+}
+
+
+int BindMessage::CalculateBindHeaderSize()
 {
   int size;
   int nameTableSectionSize = 0; // Size of name table section
-  int dataSectionSize = 0; // Size of data section
 
   size = sizeof(igtlUint16)  // Number of child messages section
     + (IGTL_HEADER_TYPE_SIZE + sizeof(igtlUint64)) * this->m_ChildMessages.size() // BIND header
@@ -185,7 +332,6 @@ int BindMessage::CalculateContentBufferSize()
     {
     nameTableSectionSize += (*iter).name.length();
     nameTableSectionSize += 1; // NULL separator
-    dataSectionSize += (*iter).size + ((*iter).size%2); // child message body + padding (if applicable)
     }
 
   // Add padding for the whole name table section
@@ -194,17 +340,58 @@ int BindMessage::CalculateContentBufferSize()
     nameTableSectionSize++;
     }
   size += nameTableSectionSize;
-  size += dataSectionSize;
 
   return size;
 }
 
 
+int BindMessage::CalculateContentBufferSize()
+{
+  int dataSectionSize = 0; // Size of data section
+
+  std::vector<ChildMessageInfo>::iterator iter;
+  for (iter = this->m_ChildMessages.begin(); iter != this->m_ChildMessages.end(); iter ++)
+    {
+    dataSectionSize += (*iter).size + ((*iter).size%2); // child message body + padding (if applicable)
+    }
+
+  return CalculateBindHeaderSize() + dataSectionSize;
+}
+
+
 int BindMessage::PackContent()
 {
   // Allocate buffer
   AllocateBuffer();
 
+  int bind_size = PackBindHeader();
+  if (bind_size == 0)
+    {
+    return 0;
+    }
+
+  char * ptr = (char *)this->m_Content;
+  ptr = ptr + bind_size;
+  std::vector<ChildMessageInfo>::iterator iter;
+  for (iter = this->m_ChildMessages.begin(); iter != this->m_ChildMessages.end(); iter ++)
+    {
+    memcpy((void*)ptr, (*iter).ptr, (*iter).size);
+    ptr += (*iter).size;
+    /* Note: a padding byte is added, if the size of the child message body
+       is odd. */
+    if ((*iter).size % 2)
+      {
+      *ptr = '\0';
+      ptr ++;
+      }
+    }
+
+  return 1;
+}
+
+
+int BindMessage::PackBindHeader()
+{
   igtl_bind_info bind_info;
   igtl_bind_init_info(&bind_info);
   
@@ -226,26 +413,11 @@ int BindMessage::PackContent()
       }
     
     igtl_bind_pack(&bind_info, this->m_Content, IGTL_TYPE_PREFIX_NONE);
-    int nc = this->m_ChildMessages.size();
-    size_t bind_size = (size_t) igtl_bind_get_size(&bind_info, IGTL_TYPE_PREFIX_NONE);
-    char * ptr = (char *)this->m_Content;
-    ptr = ptr + bind_size;
-    for (int i = 0; i < nc; i ++)
-      {
-      memcpy((void*)ptr, bind_info.child_info_array[i].ptr, bind_info.child_info_array[i].size);
-      ptr += bind_info.child_info_array[i].size;
-      /* Note: a padding byte is added, if the size of the child message body
-         is odd. */
-      if (bind_info.child_info_array[i].size % 2)
-        {
-        *ptr = '\0';
-        ptr ++;
-        }
-      }
+    int bind_size = (int) igtl_bind_get_size(&bind_info, IGTL_TYPE_PREFIX_NONE);
     
     igtl_bind_free_info(&bind_info);   // TODO: calling igtl_bind_free_info() after igtl_bind_pack() causes 
                                        // this causes segmentation fault on Linux... why?
-    return 1;
+    return bind_size;
     }
   else
     {
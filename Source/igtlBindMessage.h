@@ -16,6 +16,7 @@
 #define __igtlBindMessage_h
 
 #include <string>
+#include <vector>
 
 #include "igtlObject.h"
 #include "igtlMath.h"
@@ -57,6 +58,9 @@ public:
   /// Gets the name of a child message specified by the index 'i'.
   const char* GetChildMessageType(unsigned int i);
 
+  /// Gets the device name of a child message specified by the index 'i'.
+  const char* GetChildMessageName(unsigned int i);
+
 protected:
 
   BindMessageBase();
@@ -93,6 +97,40 @@ public:
   /// Returns non-zero value if success. 
   int         GetChildMessage(unsigned int i, igtl::MessageBase * child);
 
+  /// Appends a child message given by its type, device name and serialized body, e.g. a body
+  /// kept from a previously packed message. The body is not copied until Pack() and must be kept
+  /// until then. Returns the number of child messages after appending.
+  int         AppendChildMessageBody(const char * type, const char * name, const void * body, igtlUint64 size);
+
+  /// Gets a pointer to the serialized body of a child message specified by the index 'i'.
+  /// After Unpack(), the pointer refers to the buffer of the BIND message, so that the body
+  /// can be read or forwarded without copying it. It is valid until the BIND message is
+  /// deleted or its buffer is reallocated. Returns NULL if the index is out of range.
+  const void* GetChildMessageBodyPointer(unsigned int i);
+
+  /// Gets the size of the serialized body of a child message specified by the index 'i'.
+  igtlUint64  GetChildMessageBodySize(unsigned int i);
+
+  /// PackFragments() serializes the message without copying the bodies of the child messages
+  /// into the buffer of the BIND message. The serialized message consists of the fragments
+  /// returned by GetPackFragmentPointer() and GetPackFragmentSize(): the header and the BIND
+  /// header, the body of each child message (with a padding byte if its size is odd) and the
+  /// meta data. The fragments can be sent without copying by Socket::Send(data, length, n).
+  /// The child messages must have been packed before they are appended, and must be kept
+  /// until the fragments are sent. After PackFragments(), GetPackPointer() does not hold the
+  /// whole message; call Pack() to serialize it into a single buffer.
+  /// Returns non-zero value if success.
+  int         PackFragments();
+
+  /// Gets the number of fragments serialized by PackFragments().
+  int         GetNumberOfPackFragments();
+
+  /// Gets a pointer to the specified fragment serialized by PackFragments().
+  void*       GetPackFragmentPointer(int id);
+
+  /// Gets the size of the specified fragment serialized by PackFragments().
+  int         GetPackFragmentSize(int id);
+
 protected:
   BindMessage();
   ~BindMessage();
@@ -103,6 +141,16 @@ protected:
   virtual int  PackContent();
   virtual int  UnpackContent();
 
+  /// Calculates the size of the BIND header and the name table, without the child message bodies.
+  int          CalculateBindHeaderSize();
+
+  /// Serializes the BIND header and the name table into the content. Returns their size, 0 on error.
+  int          PackBindHeader();
+
+  /// Fragments serialized by PackFragments()
+  std::vector<void*> m_PackFragmentPointers;
+  std::vector<int>   m_PackFragmentSizes;
+
 };
 
 
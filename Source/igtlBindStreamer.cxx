@@ -0,0 +1,370 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlBindStreamer.h"
+#include "igtlOSUtil.h"
+#include "igtl_util.h"
+
+#include <algorithm>
+
+namespace igtl {
+
+  BindStreamer::BindStreamer():Object()
+  {
+    this->m_SourceLock = MutexLock::New();
+    this->m_SendLock = MutexLock::New();
+    this->m_BindMessage = BindMessage::New();
+    this->m_TimeStamp = TimeStamp::New();
+    this->m_Threader = MultiThreader::New();
+    this->m_StateCondition = ConditionVariable::New();
+    this->m_ThreadID = -1;
+    this->m_Streaming = false;
+    this->m_HeaderVersion = IGTL_HEADER_VERSION_1;
+    this->m_Period = BindStreamerMinimumPeriod;
+    this->m_NumberOfBindsSent = 0;
+    this->m_NumberOfMissedDeadlines = 0;
+    this->m_MaximumLateness = 0;
+  }
+
+  BindStreamer::~BindStreamer()
+  {
+    this->StopThread();
+  }
+
+  void BindStreamer::SetSocket(Socket* socket)
+  {
+    this->m_SendLock->Lock();
+    this->m_Socket = socket;
+    this->m_SendLock->Unlock();
+  }
+
+  int BindStreamer::UpdateSource(MessageBase* message)
+  {
+    if (message == NULL || message->GetPackBodySize() == 0 || message->GetPackBodyPointer() == NULL)
+      {
+      return 0;
+      }
+    const unsigned char* body = (const unsigned char*)message->GetPackBodyPointer();
+    std::string type = message->GetMessageType();
+    std::string name = message->GetDeviceName();
+
+    this->m_SourceLock->Lock();
+    std::vector<Source>::iterator it;
+    for (it = this->m_Sources.begin(); it != this->m_Sources.end(); ++it)
+      {
+      if (it->type == type && it->name == name)
+        {
+        break;
+        }
+      }
+    if (it == this->m_Sources.end())
+      {
+      this->m_Sources.push_back(Source());
+      it = this->m_Sources.end() - 1;
+      it->type = type;
+      it->name = name;
+      }
+    // assign() keeps the capacity of the body, so that it is only reallocated when the body grows.
+    it->body.assign(body, body + message->GetPackBodySize());
+    this->m_SourceLock->Unlock();
+    return 1;
+  }
+
+  int BindStreamer::RemoveSource(const char* type, const char* name)
+  {
+    if (type == NULL || name == NULL)
+      {
+      return 0;
+      }
+    int r = 0;
+    this->m_SourceLock->Lock();
+    std::vector<Source>::iterator it;
+    for (it = this->m_Sources.begin(); it != this->m_Sources.end(); ++it)
+      {
+      if (it->type == type && it->name == name)
+        {
+        this->m_Sources.erase(it);
+        r = 1;
+        break;
+        }
+      }
+    this->m_SourceLock->Unlock();
+    return r;
+  }
+
+  int BindStreamer::GetNumberOfSources()
+  {
+    this->m_SourceLock->Lock();
+    int numberOfSources = this->m_Sources.size();
+    this->m_SourceLock->Unlock();
+    return numberOfSources;
+  }
+
+  int BindStreamer::Start(StartBindMessage* request)
+  {
+    if (request == NULL || this->m_Socket.IsNull())
+      {
+      return 0;
+      }
+    this->StopThread();
+
+    this->m_SourceLock->Lock();
+    this->m_RequestedSources.clear();
+    for (int i = 0; i < request->GetNumberOfChildMessages(); i++)
+      {
+      this->m_RequestedSources.push_back(std::pair<std::string, std::string>(request->GetChildMessageType(i),
+                                                                           request->GetChildMessageName(i)));
+      }
+    this->m_SourceLock->Unlock();
+
+    this->m_SendLock->Lock();
+    this->m_HeaderVersion = request->GetHeaderVersion();
+    this->m_DeviceName = request->GetDeviceName();
+    this->m_SendLock->Unlock();
+
+    this->m_Period = std::max(ResolutionToNanoseconds(request->GetResolution()), (igtl_uint64)BindStreamerMinimumPeriod);
+
+    if (!this->SendResponse(RTSBindMessage::STATUS_SUCCESS))
+      {
+      return 0;
+      }
+
+    this->m_StateLock.Lock();
+    this->m_Streaming = true;
+    this->m_StateLock.Unlock();
+    this->m_ThreadID = this->m_Threader->SpawnThread((ThreadFunctionType)&BindStreamer::StreamingThread, this);
+    return 1;
+  }
+
+  int BindStreamer::Stop()
+  {
+    bool streaming = this->StopThread();
+    this->SendResponse(streaming ? RTSBindMessage::STATUS_SUCCESS : RTSBindMessage::STATUS_ERROR);
+    return streaming ? 1 : 0;
+  }
+
+  bool BindStreamer::StopThread()
+  {
+    this->m_StateLock.Lock();
+    // The streaming thread stops by itself if the socket fails, the thread is joined anyway.
+    bool streaming = this->m_Streaming || this->m_ThreadID >= 0;
+    this->m_Streaming = false;
+    this->m_StateCondition->Broadcast();
+    this->m_StateLock.Unlock();
+
+    if (this->m_ThreadID >= 0)
+      {
+      this->m_Threader->TerminateThread(this->m_ThreadID);
+      this->m_ThreadID = -1;
+      }
+    return streaming;
+  }
+
+  bool BindStreamer::IsStreaming()
+  {
+    this->m_StateLock.Lock();
+    bool streaming = this->m_Streaming;
+    this->m_StateLock.Unlock();
+    return streaming;
+  }
+
+  igtl_uint64 BindStreamer::GetPeriod()
+  {
+    return this->m_Period;
+  }
+
+  int BindStreamer::SendBind()
+  {
+    int numberOfChildMessages = 0;
+
+    this->m_SendLock->Lock();
+    if (this->m_Socket.IsNull())
+      {
+      this->m_SendLock->Unlock();
+      return -1;
+      }
+
+    this->m_BindMessage->Init();
+    this->m_BindMessage->SetHeaderVersion(this->m_HeaderVersion);
+    this->m_BindMessage->SetDeviceName(this->m_DeviceName);
+
+    // The bodies are packed while the sources are locked, then the BIND message is sent
+    // without blocking the producers.
+    this->m_SourceLock->Lock();
+    for (unsigned int i = 0; i < this->m_Sources.size(); i++)
+      {
+      const Source& source = this->m_Sources[i];
+      if (!source.body.empty() && this->IsRequested(source) &&
+          this->m_BindMessage->AppendChildMessageBody(source.type.c_str(), source.name.c_str(),
+                                                      &source.body[0], source.body.size()) > numberOfChildMessages)
+        {
+        numberOfChildMessages++;
+        }
+      }
+    if (numberOfChildMessages > 0)
+      {
+      this->m_TimeStamp->GetTime();
+      this->m_BindMessage->SetTimeStamp(this->m_TimeStamp);
+      this->m_BindMessage->Pack();
+      }
+    this->m_SourceLock->Unlock();
+
+    if (numberOfChildMessages > 0)
+      {
+      if (!this->m_Socket->Send(this->m_BindMessage->GetPackPointer(), this->m_BindMessage->GetPackSize()))
+        {
+        numberOfChildMessages = -1;
+        }
+      }
+    this->m_SendLock->Unlock();
+
+    if (numberOfChildMessages > 0)
+      {
+      this->m_StateLock.Lock();
+      this->m_NumberOfBindsSent++;
+      this->m_StateLock.Unlock();
+      }
+    return numberOfChildMessages;
+  }
+
+  igtl_uint64 BindStreamer::GetNumberOfBindsSent()
+  {
+    this->m_StateLock.Lock();
+    igtl_uint64 n = this->m_NumberOfBindsSent;
+    this->m_StateLock.Unlock();
+    return n;
+  }
+
+  igtl_uint64 BindStreamer::GetNumberOfMissedDeadlines()
+  {
+    this->m_StateLock.Lock();
+    igtl_uint64 n = this->m_NumberOfMissedDeadlines;
+    this->m_StateLock.Unlock();
+    return n;
+  }
+
+  igtl_uint64 BindStreamer::GetMaximumLateness()
+  {
+    this->m_StateLock.Lock();
+    igtl_uint64 lateness = this->m_MaximumLateness;
+    this->m_StateLock.Unlock();
+    return lateness;
+  }
+
+  void BindStreamer::ResetStatistics()
+  {
+    this->m_StateLock.Lock();
+    this->m_NumberOfBindsSent = 0;
+    this->m_NumberOfMissedDeadlines = 0;
+    this->m_MaximumLateness = 0;
+    this->m_StateLock.Unlock();
+  }
+
+  igtl_uint64 BindStreamer::ResolutionToNanoseconds(igtlUint64 resolution)
+  {
+    igtl_uint64 sec = (resolution >> 32) & 0xFFFFFFFF;
+    igtl_uint32 frac = (igtl_uint32)(resolution & 0xFFFFFFFF);
+    return sec * 1000000000ULL + igtl_frac_to_nanosec(frac);
+  }
+
+  int BindStreamer::SendResponse(igtlUint8 status)
+  {
+    RTSBindMessage::Pointer response = RTSBindMessage::New();
+    this->m_SendLock->Lock();
+    if (this->m_Socket.IsNull())
+      {
+      this->m_SendLock->Unlock();
+      return 0;
+      }
+    response->SetHeaderVersion(this->m_HeaderVersion);
+    response->SetDeviceName(this->m_DeviceName);
+    response->SetStatus(status);
+    response->Pack();
+    int r = this->m_Socket->Send(response->GetPackPointer(), response->GetPackSize());
+    this->m_SendLock->Unlock();
+    return r;
+  }
+
+  bool BindStreamer::IsRequested(const Source& source)
+  {
+    if (this->m_RequestedSources.empty())
+      {
+      return true;
+      }
+    for (unsigned int i = 0; i < this->m_RequestedSources.size(); i++)
+      {
+      if (this->m_RequestedSources[i].first == source.type &&
+          this->m_RequestedSources[i].second == source.name)
+        {
+        return true;
+        }
+      }
+    return false;
+  }
+
+  void* BindStreamer::StreamingThread(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    BindStreamer* streamer = static_cast<BindStreamer*>(info->UserData);
+    streamer->StreamingLoop();
+    return NULL;
+  }
+
+  void BindStreamer::StreamingLoop()
+  {
+    igtl_uint64 next = TimeStamp::GetMonotonicTimeInNanoseconds();
+
+    this->m_StateLock.Lock();
+    while (this->m_Streaming)
+      {
+      igtl_uint64 now = TimeStamp::GetMonotonicTimeInNanoseconds();
+      if (now < next)
+        {
+        igtl_uint32 remaining = (igtl_uint32)((next - now) / 1000000);
+        if (remaining > 0)
+          {
+          // Woken up early by Stop()
+          this->m_StateCondition->Wait(&this->m_StateLock, remaining);
+          }
+        else
+          {
+          this->m_StateLock.Unlock();
+          igtl::Sleep(0);
+          this->m_StateLock.Lock();
+          }
+        continue;
+        }
+
+      // Ticks that could not be sent in time are skipped, the next tick stays on the schedule.
+      igtl_uint64 lateness = now - next;
+      igtl_uint64 missed = lateness / this->m_Period;
+      if (lateness > this->m_MaximumLateness)
+        {
+        this->m_MaximumLateness = lateness;
+        }
+      this->m_NumberOfMissedDeadlines += missed;
+      next += (missed + 1) * this->m_Period;
+
+      this->m_StateLock.Unlock();
+      int r = this->SendBind();
+      this->m_StateLock.Lock();
+      if (r < 0)
+        {
+        this->m_Streaming = false;
+        }
+      }
+    this->m_StateLock.Unlock();
+  }
+
+} // namespace igtl
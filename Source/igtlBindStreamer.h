@@ -0,0 +1,173 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlBindStreamer_h
+#define __igtlBindStreamer_h
+
+#include <string>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlBindMessage.h"
+#include "igtlConditionVariable.h"
+#include "igtlMultiThreader.h"
+#include "igtlMutexLock.h"
+#include "igtlSocket.h"
+#include "igtlTimeStamp.h"
+#include "igtl_types.h"
+
+// Shortest period between two BIND messages (ns), used when the requested resolution is shorter.
+#define BindStreamerMinimumPeriod 1000000
+
+namespace igtl
+{
+  /// The BindStreamer class implements the server side of the BIND streaming (STT_BIND / STP_BIND).
+  /// The application updates the latest value of each source (tracking tools, image meta data,
+  /// status...) as they are produced. Once started by a STT_BIND request, the streamer samples the
+  /// latest value of the requested sources at the requested resolution, and sends them bundled in
+  /// one BIND message per tick, instead of one message per source.
+  ///
+  /// The bodies of the sources and the BIND message are kept between the ticks, so that the buffers
+  /// are only reallocated when their size changes.
+  ///
+  /// A tick is missed if the previous one has been sent too late, e.g. because the socket was blocked.
+  /// The missed ticks are skipped rather than sent late, and reported by GetNumberOfMissedDeadlines().
+  ///
+  /// Typical use:
+  ///
+  ///   streamer->SetSocket(socket);
+  ///
+  ///   Producer threads:
+  ///     transformMsg->Pack();
+  ///     streamer->UpdateSource(transformMsg);
+  ///
+  ///   Receiving thread:
+  ///     // On STT_BIND
+  ///     startBindMsg->Unpack();
+  ///     streamer->Start(startBindMsg); // sends RTS_BIND and starts the streaming thread
+  ///     // On STP_BIND
+  ///     streamer->Stop(); // stops the streaming thread and sends RTS_BIND
+  ///
+  /// The streamer serializes its own sends on the socket. The application must not send other
+  /// messages on the same socket while streaming, unless it serializes them with the streamer.
+  class IGTLCommon_EXPORT BindStreamer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::BindStreamer, Object)
+    igtlNewMacro(igtl::BindStreamer);
+
+  public:
+    /// Sets the socket the BIND and RTS_BIND messages are sent to.
+    void SetSocket(Socket* socket);
+
+    /// Updates the latest value of a source, identified by the type and device name of the message.
+    /// The message must have been packed. Its body is copied, so that the message can be reused.
+    /// A source is registered by its first update. Returns 0 if the message is not packed.
+    int UpdateSource(MessageBase* message);
+
+    /// Removes a source. Returns 0 if the source is not registered.
+    int RemoveSource(const char* type, const char* name);
+
+    int GetNumberOfSources();
+
+    /// Starts streaming the sources requested by a STT_BIND message at its resolution, and sends
+    /// RTS_BIND. All the sources are streamed if the request has no child message. If the streamer
+    /// is already streaming, it is restarted with the new request. Returns 1 if streaming started.
+    int Start(StartBindMessage* request);
+
+    /// Stops streaming, e.g. on STP_BIND, and sends RTS_BIND. Returns 0 if not streaming.
+    int Stop();
+
+    bool IsStreaming();
+
+    /// Gets the period between two BIND messages in nanoseconds.
+    igtl_uint64 GetPeriod();
+
+    /// Packs the latest value of the requested sources into a BIND message and sends it.
+    /// Called by the streaming thread on each tick. Returns the number of child messages sent,
+    /// 0 if no requested source has a value, -1 if the message could not be sent.
+    int SendBind();
+
+    /// Gets the number of BIND messages sent.
+    igtl_uint64 GetNumberOfBindsSent();
+
+    /// Gets the number of ticks skipped because the previous tick was late.
+    igtl_uint64 GetNumberOfMissedDeadlines();
+
+    /// Gets the maximum delay (ns) between the scheduled time of a tick and the time it was processed.
+    igtl_uint64 GetMaximumLateness();
+
+    void ResetStatistics();
+
+    /// Converts a STT_BIND resolution (64-bit fixed-point seconds, as OpenIGTLink time stamps) to nanoseconds.
+    static igtl_uint64 ResolutionToNanoseconds(igtlUint64 resolution);
+
+  protected:
+    BindStreamer();
+    ~BindStreamer();
+
+    /// Latest value of a source
+    class Source
+    {
+    public:
+      std::string                 type;
+      std::string                 name;
+      std::vector<unsigned char>  body;
+    };
+
+    /// Sends a RTS_BIND message with the status.
+    int SendResponse(igtlUint8 status);
+
+    /// Stops the streaming thread. Returns true if it was streaming.
+    bool StopThread();
+
+    /// Returns true if the source is requested by the STT_BIND request. Must be called with the source lock held.
+    bool IsRequested(const Source& source);
+
+    static void* StreamingThread(void* ptr);
+
+    void StreamingLoop();
+
+  private:
+    Socket::Pointer                     m_Socket;
+
+    std::vector<Source>                 m_Sources;
+    MutexLock::Pointer                  m_SourceLock;
+
+    /// Type and device name of the requested sources, all the sources if empty
+    std::vector<std::pair<std::string, std::string> > m_RequestedSources;
+    unsigned short                      m_HeaderVersion;
+    std::string                         m_DeviceName;
+    igtl_uint64                         m_Period;
+
+    /// BIND message reused on each tick, used under the send lock
+    BindMessage::Pointer                m_BindMessage;
+    TimeStamp::Pointer                  m_TimeStamp;
+    MutexLock::Pointer                  m_SendLock;
+
+    MultiThreader::Pointer              m_Threader;
+    int                                 m_ThreadID;
+    bool                                m_Streaming;
+    SimpleMutexLock                     m_StateLock;
+    ConditionVariable::Pointer          m_StateCondition;
+
+    igtl_uint64                         m_NumberOfBindsSent;
+    igtl_uint64                         m_NumberOfMissedDeadlines;
+    igtl_uint64                         m_MaximumLateness;
+  };
+
+} // namespace igtl
+
+#endif // __igtlBindStreamer_h
@@ -0,0 +1,124 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtlClockSyncMessage.h"
+
+#include "igtl_util.h"
+
+#include <string.h>
+
+namespace igtl {
+
+namespace
+{
+  void PackTime(unsigned char* ptr, igtlUint64 nanoseconds)
+  {
+    if (igtl_is_little_endian())
+      {
+      nanoseconds = BYTE_SWAP_INT64(nanoseconds);
+      }
+    memcpy(ptr, &nanoseconds, sizeof(igtlUint64));
+  }
+
+  igtlUint64 UnpackTime(const unsigned char* ptr)
+  {
+    igtlUint64 nanoseconds;
+    memcpy(&nanoseconds, ptr, sizeof(igtlUint64));
+    if (igtl_is_little_endian())
+      {
+      nanoseconds = BYTE_SWAP_INT64(nanoseconds);
+      }
+    return nanoseconds;
+  }
+}
+
+//----------------------------------------------------------------------
+// igtl::GetClockSyncMessage class
+
+GetClockSyncMessage::GetClockSyncMessage():
+  MessageBase()
+{
+  this->m_SendMessageType = "GET_CLKSYNC";
+  this->m_OriginateTime = 0;
+}
+
+GetClockSyncMessage::~GetClockSyncMessage()
+{
+}
+
+int GetClockSyncMessage::CalculateContentBufferSize()
+{
+  return IGTL_CLOCKSYNC_REQUEST_SIZE;
+}
+
+int GetClockSyncMessage::PackContent()
+{
+  AllocateBuffer();
+  PackTime(this->m_Content, this->m_OriginateTime);
+  return 1;
+}
+
+int GetClockSyncMessage::UnpackContent()
+{
+  if (this->CalculateReceiveContentSize() < IGTL_CLOCKSYNC_REQUEST_SIZE)
+    {
+    return 0;
+    }
+  this->m_OriginateTime = UnpackTime(this->m_Content);
+  return 1;
+}
+
+//----------------------------------------------------------------------
+// igtl::RTSClockSyncMessage class
+
+RTSClockSyncMessage::RTSClockSyncMessage():
+  MessageBase()
+{
+  this->m_SendMessageType = "RTS_CLKSYNC";
+  this->m_OriginateTime = 0;
+  this->m_ReceiveTime = 0;
+  this->m_TransmitTime = 0;
+}
+
+RTSClockSyncMessage::~RTSClockSyncMessage()
+{
+}
+
+int RTSClockSyncMessage::CalculateContentBufferSize()
+{
+  return IGTL_CLOCKSYNC_RESPONSE_SIZE;
+}
+
+int RTSClockSyncMessage::PackContent()
+{
+  AllocateBuffer();
+  PackTime(this->m_Content, this->m_OriginateTime);
+  PackTime(this->m_Content + 8, this->m_ReceiveTime);
+  PackTime(this->m_Content + 16, this->m_TransmitTime);
+  return 1;
+}
+
+int RTSClockSyncMessage::UnpackContent()
+{
+  if (this->CalculateReceiveContentSize() < IGTL_CLOCKSYNC_RESPONSE_SIZE)
+    {
+    return 0;
+    }
+  this->m_OriginateTime = UnpackTime(this->m_Content);
+  this->m_ReceiveTime = UnpackTime(this->m_Content + 8);
+  this->m_TransmitTime = UnpackTime(this->m_Content + 16);
+  return 1;
+}
+
+} // namespace igtl
@@ -0,0 +1,98 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __igtlClockSyncMessage_h
+#define __igtlClockSyncMessage_h
+
+#include "igtlObject.h"
+#include "igtlMessageBase.h"
+#include "igtlTypes.h"
+
+/// Body sizes of the clock synchronization messages. The times are 64-bit unsigned integers
+/// in nanoseconds since 00:00:00 January 1, 1970 UTC, in network byte order.
+#define IGTL_CLOCKSYNC_REQUEST_SIZE   8
+#define IGTL_CLOCKSYNC_RESPONSE_SIZE  24
+
+namespace igtl
+{
+
+/// GET_CLKSYNC requests the clock of the peer. It carries the time at which the request is sent
+/// (originate time, T1), which is echoed back in the RTS_CLKSYNC response.
+class IGTLCommon_EXPORT GetClockSyncMessage: public MessageBase
+{
+public:
+  igtlTypeMacro(igtl::GetClockSyncMessage, igtl::MessageBase);
+  igtlNewMacro(igtl::GetClockSyncMessage);
+
+public:
+
+  /// Sets the time at which the request is sent (T1).
+  void        SetOriginateTime(igtlUint64 nanoseconds) { this->m_OriginateTime = nanoseconds; };
+  igtlUint64  GetOriginateTime() { return this->m_OriginateTime; };
+
+protected:
+  GetClockSyncMessage();
+  ~GetClockSyncMessage();
+
+protected:
+
+  virtual int  CalculateContentBufferSize();
+  virtual int  PackContent();
+  virtual int  UnpackContent();
+
+  igtlUint64   m_OriginateTime;
+};
+
+
+/// RTS_CLKSYNC answers a GET_CLKSYNC with the originate time of the request (T1), the time at which
+/// the request was received (T2) and the time at which the response is sent (T3), all but T1 read
+/// from the clock of the responder. See ClockSynchronizer.
+class IGTLCommon_EXPORT RTSClockSyncMessage: public MessageBase
+{
+public:
+  igtlTypeMacro(igtl::RTSClockSyncMessage, igtl::MessageBase);
+  igtlNewMacro(igtl::RTSClockSyncMessage);
+
+public:
+
+  /// Sets the originate time copied from the request (T1).
+  void        SetOriginateTime(igtlUint64 nanoseconds) { this->m_OriginateTime = nanoseconds; };
+  igtlUint64  GetOriginateTime() { return this->m_OriginateTime; };
+
+  /// Sets the time at which the request was received (T2).
+  void        SetReceiveTime(igtlUint64 nanoseconds) { this->m_ReceiveTime = nanoseconds; };
+  igtlUint64  GetReceiveTime() { return this->m_ReceiveTime; };
+
+  /// Sets the time at which the response is sent (T3). It should be set right before Pack().
+  void        SetTransmitTime(igtlUint64 nanoseconds) { this->m_TransmitTime = nanoseconds; };
+  igtlUint64  GetTransmitTime() { return this->m_TransmitTime; };
+
+protected:
+  RTSClockSyncMessage();
+  ~RTSClockSyncMessage();
+
+protected:
+
+  virtual int  CalculateContentBufferSize();
+  virtual int  PackContent();
+  virtual int  UnpackContent();
+
+  igtlUint64   m_OriginateTime;
+  igtlUint64   m_ReceiveTime;
+  igtlUint64   m_TransmitTime;
+};
+
+} // namespace igtl
+
+#endif // __igtlClockSyncMessage_h
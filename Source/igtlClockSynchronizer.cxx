@@ -0,0 +1,265 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlClockSynchronizer.h"
+#include "igtlTimeStamp.h"
+
+#include <algorithm>
+#include <vector>
+
+// Below this span of local time (ns), the drift is not estimated, as it would mostly fit the jitter.
+#define ClockSynchronizerMinimumDriftSpan 1000000000.0
+
+namespace igtl {
+
+  namespace
+  {
+    // Signed difference a - b of two times in nanoseconds
+    inline double TimeDifference(igtl_uint64 a, igtl_uint64 b)
+    {
+      return (double)((igtl_int64)(a - b));
+    }
+
+    inline igtl_uint64 AddTime(igtl_uint64 t, double nanoseconds)
+    {
+      return t + (igtl_uint64)((igtl_int64)(nanoseconds < 0.0 ? nanoseconds - 0.5 : nanoseconds + 0.5));
+    }
+
+    bool CompareRoundTripDelay(const std::pair<igtl_uint64, int>& a, const std::pair<igtl_uint64, int>& b)
+    {
+      return a.first < b.first;
+    }
+  }
+
+  ClockSynchronizer::ClockSynchronizer():Object()
+  {
+    this->maximumNumberOfSamples = ClockSynchronizerDefaultMaximumSamples;
+    this->referenceTime = 0;
+    this->offset = 0.0;
+    this->drift = 0.0;
+    this->minimumRoundTripDelay = 0;
+    this->lock = MutexLock::New();
+  }
+
+  ClockSynchronizer::~ClockSynchronizer()
+  {
+  }
+
+  igtl_uint64 ClockSynchronizer::GetCurrentTimeInNanoseconds()
+  {
+    igtl::TimeStamp::Pointer timer = igtl::TimeStamp::New();
+    timer->GetTime();
+    return timer->GetTimeStampInNanoseconds();
+  }
+
+  void ClockSynchronizer::FillResponse(GetClockSyncMessage* request, igtl_uint64 receiveTime, RTSClockSyncMessage* response)
+  {
+    if (request == NULL || response == NULL)
+      {
+      return;
+      }
+    response->SetDeviceName(request->GetDeviceName());
+    response->SetOriginateTime(request->GetOriginateTime());
+    response->SetReceiveTime(receiveTime);
+    response->SetTransmitTime(GetCurrentTimeInNanoseconds());
+  }
+
+  int ClockSynchronizer::AddSample(igtl_uint64 t1, igtl_uint64 t2, igtl_uint64 t3, igtl_uint64 t4)
+  {
+    double roundTrip = TimeDifference(t4, t1);
+    double processing = TimeDifference(t3, t2);
+    if (t1 == 0 || t2 == 0 || roundTrip < 0.0 || processing < 0.0 || processing > roundTrip)
+      {
+      return 0;
+      }
+
+    Sample sample;
+    sample.localTime = t1 + (t4 - t1) / 2;
+    sample.offset = (TimeDifference(t2, t1) + TimeDifference(t3, t4)) / 2.0;
+    sample.roundTripDelay = (igtl_uint64)(roundTrip - processing);
+
+    this->lock->Lock();
+    while (this->samples.size() >= this->maximumNumberOfSamples)
+      {
+      this->samples.pop_front();
+      }
+    this->samples.push_back(sample);
+    this->UpdateEstimate();
+    this->lock->Unlock();
+    return 1;
+  }
+
+  int ClockSynchronizer::AddResponse(RTSClockSyncMessage* response, igtl_uint64 arrivalTime)
+  {
+    if (response == NULL)
+      {
+      return 0;
+      }
+    return this->AddSample(response->GetOriginateTime(), response->GetReceiveTime(),
+                           response->GetTransmitTime(), arrivalTime);
+  }
+
+  void ClockSynchronizer::UpdateEstimate()
+  {
+    if (this->samples.size() == 0)
+      {
+      this->referenceTime = 0;
+      this->offset = 0.0;
+      this->drift = 0.0;
+      this->minimumRoundTripDelay = 0;
+      return;
+      }
+
+    // Keep the half of the samples with the shortest round trip delays.
+    std::vector<std::pair<igtl_uint64, int> > delays;
+    for (unsigned int i = 0; i < this->samples.size(); i++)
+      {
+      delays.push_back(std::pair<igtl_uint64, int>(this->samples[i].roundTripDelay, i));
+      }
+    std::sort(delays.begin(), delays.end(), CompareRoundTripDelay);
+    unsigned int n = (delays.size() + 1) / 2;
+    this->minimumRoundTripDelay = delays[0].first;
+
+    // Least squares fit of offset + drift * (t - referenceTime), referenceTime being the mean time of the
+    // samples used, so that the offset and the drift are uncorrelated.
+    igtl_uint64 first = this->samples[delays[0].second].localTime;
+    double meanTime = 0.0;
+    double meanOffset = 0.0;
+    for (unsigned int i = 0; i < n; i++)
+      {
+      const Sample& s = this->samples[delays[i].second];
+      meanTime += TimeDifference(s.localTime, first);
+      meanOffset += s.offset;
+      }
+    meanTime /= n;
+    meanOffset /= n;
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    double minTime = 0.0;
+    double maxTime = 0.0;
+    for (unsigned int i = 0; i < n; i++)
+      {
+      const Sample& s = this->samples[delays[i].second];
+      double x = TimeDifference(s.localTime, first) - meanTime;
+      sxx += x * x;
+      sxy += x * (s.offset - meanOffset);
+      minTime = std::min(minTime, x);
+      maxTime = std::max(maxTime, x);
+      }
+
+    this->referenceTime = AddTime(first, meanTime);
+    if (n >= 2 && maxTime - minTime >= ClockSynchronizerMinimumDriftSpan && sxx > 0.0)
+      {
+      this->offset = meanOffset;
+      this->drift = sxy / sxx;
+      }
+    else
+      {
+      // Too little data for the drift, use the most accurate sample.
+      const Sample& best = this->samples[delays[0].second];
+      this->referenceTime = best.localTime;
+      this->offset = best.offset;
+      this->drift = 0.0;
+      }
+  }
+
+  double ClockSynchronizer::GetOffset(igtl_uint64 localTime)
+  {
+    this->lock->Lock();
+    double o = this->offset + this->drift * TimeDifference(localTime, this->referenceTime);
+    this->lock->Unlock();
+    return o;
+  }
+
+  double ClockSynchronizer::GetOffset()
+  {
+    return this->GetOffset(GetCurrentTimeInNanoseconds());
+  }
+
+  double ClockSynchronizer::GetDrift()
+  {
+    this->lock->Lock();
+    double d = this->drift;
+    this->lock->Unlock();
+    return d;
+  }
+
+  igtl_uint64 ClockSynchronizer::GetMinimumRoundTripDelay()
+  {
+    this->lock->Lock();
+    igtl_uint64 d = this->minimumRoundTripDelay;
+    this->lock->Unlock();
+    return d;
+  }
+
+  igtl_uint64 ClockSynchronizer::RemoteToLocal(igtl_uint64 remoteTime)
+  {
+    this->lock->Lock();
+    igtl_uint64 localTime = remoteTime;
+    if (this->samples.size() > 0)
+      {
+      // Solves remoteTime = t + offset + drift * (t - referenceTime) for t.
+      double d = (TimeDifference(remoteTime, this->referenceTime) - this->offset) / (1.0 + this->drift);
+      localTime = AddTime(this->referenceTime, d);
+      }
+    this->lock->Unlock();
+    return localTime;
+  }
+
+  igtl_uint64 ClockSynchronizer::LocalToRemote(igtl_uint64 localTime)
+  {
+    this->lock->Lock();
+    igtl_uint64 remoteTime = localTime;
+    if (this->samples.size() > 0)
+      {
+      remoteTime = AddTime(localTime, this->offset + this->drift * TimeDifference(localTime, this->referenceTime));
+      }
+    this->lock->Unlock();
+    return remoteTime;
+  }
+
+  void ClockSynchronizer::SetMaximumNumberOfSamples(unsigned int numSamples)
+  {
+    if (numSamples < 1)
+      {
+      numSamples = 1;
+      }
+    this->lock->Lock();
+    this->maximumNumberOfSamples = numSamples;
+    while (this->samples.size() > this->maximumNumberOfSamples)
+      {
+      this->samples.pop_front();
+      }
+    this->UpdateEstimate();
+    this->lock->Unlock();
+  }
+
+  int ClockSynchronizer::GetNumberOfSamples()
+  {
+    this->lock->Lock();
+    int numberOfSamples = this->samples.size();
+    this->lock->Unlock();
+    return numberOfSamples;
+  }
+
+  void ClockSynchronizer::Clear()
+  {
+    this->lock->Lock();
+    this->samples.clear();
+    this->UpdateEstimate();
+    this->lock->Unlock();
+  }
+
+} // namespace igtl
@@ -0,0 +1,146 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlClockSynchronizer_h
+#define __igtlClockSynchronizer_h
+
+#include <deque>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMutexLock.h"
+#include "igtlClockSyncMessage.h"
+#include "igtl_types.h"
+
+#define ClockSynchronizerDefaultMaximumSamples 64
+
+namespace igtl
+{
+  /// The ClockSynchronizer class estimates the offset and the drift of the clock of a peer
+  /// from GET_CLKSYNC / RTS_CLKSYNC exchanges, in the way of NTP and PTP, so that the time stamps
+  /// of the messages received from the peer can be mapped to the local clock.
+  ///
+  /// Each exchange gives four times: T1 (request sent, local clock), T2 (request received, remote clock),
+  /// T3 (response sent, remote clock) and T4 (response received, local clock). Assuming symmetric
+  /// paths, the offset of the remote clock is ((T2 - T1) + (T3 - T4)) / 2 at the local time (T1 + T4) / 2,
+  /// with an uncertainty of half the round trip delay (T4 - T1) - (T3 - T2).
+  ///
+  /// The estimate uses the half of the recent exchanges with the shortest round trip delays, the others
+  /// being likely delayed by queuing. The offset and the drift are fitted to those by least squares.
+  ///
+  /// Typical use:
+  ///
+  ///   Requester:
+  ///     igtl::GetClockSyncMessage::Pointer request = igtl::GetClockSyncMessage::New();
+  ///     request->SetOriginateTime(igtl::ClockSynchronizer::GetCurrentTimeInNanoseconds());
+  ///     request->Pack();
+  ///     socket->Send(request->GetPackPointer(), request->GetPackSize());
+  ///     ...
+  ///     // On RTS_CLKSYNC, stamp the arrival time right after the header is received
+  ///     igtl_uint64 arrival = igtl::ClockSynchronizer::GetCurrentTimeInNanoseconds();
+  ///     response->Unpack();
+  ///     synchronizer->AddResponse(response, arrival);
+  ///     ...
+  ///     igtl_uint64 local = synchronizer->RemoteToLocal(remoteTimeStampInNanoseconds);
+  ///
+  ///   Responder:
+  ///     // On GET_CLKSYNC, stamp the arrival time right after the header is received
+  ///     igtl_uint64 arrival = igtl::ClockSynchronizer::GetCurrentTimeInNanoseconds();
+  ///     request->Unpack();
+  ///     igtl::RTSClockSyncMessage::Pointer response = igtl::RTSClockSyncMessage::New();
+  ///     igtl::ClockSynchronizer::FillResponse(request, arrival, response); // stamps T3
+  ///     response->Pack();
+  ///     socket->Send(response->GetPackPointer(), response->GetPackSize());
+  class IGTLCommon_EXPORT ClockSynchronizer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ClockSynchronizer, Object)
+    igtlNewMacro(igtl::ClockSynchronizer);
+
+  public:
+
+    /// Gets the current time in nanoseconds since the Unix epoch, the clock used in the exchanges.
+    static igtl_uint64 GetCurrentTimeInNanoseconds();
+
+    /// Fills the response to a request received at receiveTime, and stamps its transmit time
+    /// with the current time. Pack() the response right after.
+    static void FillResponse(GetClockSyncMessage* request, igtl_uint64 receiveTime, RTSClockSyncMessage* response);
+
+    /// Adds the times of an exchange. Returns 0 if the times are inconsistent (e.g. the response was
+    /// received before the request was sent).
+    int AddSample(igtl_uint64 t1, igtl_uint64 t2, igtl_uint64 t3, igtl_uint64 t4);
+
+    /// Adds the exchange of an unpacked RTS_CLKSYNC message received at arrivalTime.
+    int AddResponse(RTSClockSyncMessage* response, igtl_uint64 arrivalTime);
+
+    /// Gets the offset in nanoseconds of the remote clock (remote - local) at the local time.
+    double GetOffset(igtl_uint64 localTime);
+
+    /// Gets the offset in nanoseconds of the remote clock at the current time.
+    double GetOffset();
+
+    /// Gets the drift of the remote clock relative to the local clock, e.g. 1e-5 if the remote clock
+    /// gains 10 us per second. 0 until the exchanges span some time.
+    double GetDrift();
+
+    /// Gets the shortest round trip delay of the exchanges in nanoseconds, which bounds the error of the offset.
+    igtl_uint64 GetMinimumRoundTripDelay();
+
+    /// Maps a time of the remote clock to the local clock, both in nanoseconds. Returns the time
+    /// unchanged if no exchange has been added.
+    igtl_uint64 RemoteToLocal(igtl_uint64 remoteTime);
+
+    /// Maps a time of the local clock to the remote clock.
+    igtl_uint64 LocalToRemote(igtl_uint64 localTime);
+
+    /// Sets the number of exchanges kept, the oldest ones are discarded first.
+    void SetMaximumNumberOfSamples(unsigned int numSamples);
+
+    unsigned int GetMaximumNumberOfSamples(){return this->maximumNumberOfSamples;};
+
+    int GetNumberOfSamples();
+
+    void Clear();
+
+  protected:
+    ClockSynchronizer();
+    ~ClockSynchronizer();
+
+    class Sample
+    {
+    public:
+      igtl_uint64 localTime;
+      double      offset;
+      igtl_uint64 roundTripDelay;
+    };
+
+    /// Fits the offset and the drift to the samples. Must be called with the lock held.
+    void UpdateEstimate();
+
+  private:
+    std::deque<Sample> samples;
+    unsigned int maximumNumberOfSamples;
+
+    /// Estimate: offset(t) = offset + drift * (t - referenceTime)
+    igtl_uint64 referenceTime;
+    double offset;
+    double drift;
+    igtl_uint64 minimumRoundTripDelay;
+
+    MutexLock::Pointer lock;
+  };
+
+} // namespace igtl
+
+#endif // __igtlClockSynchronizer_h
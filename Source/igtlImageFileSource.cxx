@@ -0,0 +1,625 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageFileSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <algorithm>
+#include <map>
+
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtl_util.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  #include <windows.h>
+#else
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// Largest fragment of scalars passed to a send
+#define ImageFileSourceMaxFragmentSize  (1 << 30)
+// Offset of the scalars at the end of the file (NRRD "byte skip: -1")
+#define ImageFileSourceEndOfFile        ((igtlUint64)-1)
+
+namespace igtl
+{
+
+  // IMAGE message packed without its scalars: the content is the image header only.
+  class ImageFileSourceMessage : public ImageMessage
+  {
+  public:
+    igtlTypeMacro(igtl::ImageFileSourceMessage, igtl::ImageMessage)
+    igtlNewMacro(igtl::ImageFileSourceMessage);
+
+    /// Packs the message again, e.g. with a new time stamp, new meta data or a new header
+    /// version (the buffer is allocated again for its layout).
+    int Repack()
+    {
+      AllocateScalars();
+      m_IsBodyPacked = false;
+      return Pack();
+    }
+
+    /// Gets the offset of the scalars (i.e. the meta data) in the pack.
+    int GetScalarOffset()
+    {
+      return (int)(m_ImageHeader - m_Header) + IGTL_IMAGE_HEADER_SIZE;
+    }
+
+  protected:
+    ImageFileSourceMessage() : ImageMessage() {}
+    ~ImageFileSourceMessage() {}
+
+    virtual int CalculateContentBufferSize()
+    {
+      return IGTL_IMAGE_HEADER_SIZE;
+    }
+  };
+
+  // Size of the scalars of the whole volume of a message
+  static igtlUint64 ImageFileSourceGetVolumeSize(ImageMessage* msg)
+  {
+    int dim[3];
+    msg->GetDimensions(dim);
+    return (igtlUint64)dim[0] * dim[1] * dim[2] * msg->GetScalarSize() * msg->GetNumComponents();
+  }
+
+  static std::string ImageFileSourceTrim(const std::string& s)
+  {
+    std::string::size_type first = s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+      {
+      return std::string();
+      }
+    std::string::size_type last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+  }
+
+  // Splits a NRRD field into its values; the vectors "(x, y, z)" are single values.
+  static std::vector<std::string> ImageFileSourceSplit(const std::string& s)
+  {
+    std::vector<std::string> values;
+    std::string value;
+    int depth = 0;
+    for (std::string::size_type i = 0; i < s.size(); i ++)
+      {
+      char c = s[i];
+      if (c == '(')
+        {
+        depth ++;
+        }
+      else if (c == ')')
+        {
+        depth --;
+        }
+      if (c == ' ' || c == '\t')
+        {
+        if (depth == 0 && !value.empty())
+          {
+          values.push_back(value);
+          value.clear();
+          }
+        }
+      else
+        {
+        value += c;
+        }
+      }
+    if (!value.empty())
+      {
+      values.push_back(value);
+      }
+    return values;
+  }
+
+  // Scalar type of a NRRD type, or -1 if not supported
+  static int ImageFileSourceGetNrrdType(const std::string& type)
+  {
+    const char* names[][2] = {
+      {"signed char", "2"}, {"int8", "2"}, {"int8_t", "2"},
+      {"uchar", "3"}, {"unsigned char", "3"}, {"uint8", "3"}, {"uint8_t", "3"},
+      {"short", "4"}, {"short int", "4"}, {"signed short", "4"}, {"signed short int", "4"},
+      {"int16", "4"}, {"int16_t", "4"},
+      {"ushort", "5"}, {"unsigned short", "5"}, {"unsigned short int", "5"}, {"uint16", "5"}, {"uint16_t", "5"},
+      {"int", "6"}, {"signed int", "6"}, {"int32", "6"}, {"int32_t", "6"},
+      {"uint", "7"}, {"unsigned int", "7"}, {"uint32", "7"}, {"uint32_t", "7"},
+      {"float", "10"}, {"double", "11"}
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i ++)
+      {
+      if (type == names[i][0])
+        {
+        return atoi(names[i][1]);
+        }
+      }
+    return -1;
+  }
+
+  ImageFileSource::ImageFileSource()
+  {
+    this->m_ImageMessage = ImageFileSourceMessage::New().GetPointer();
+    this->m_Data = NULL;
+    this->m_DataSize = 0;
+    this->m_Offset = 0;
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    this->m_FileMapping = NULL;
+#endif
+    this->m_ScalarSize = 0;
+    this->m_CRC = 0;
+    this->m_CRCValid = false;
+  }
+
+  ImageFileSource::~ImageFileSource()
+  {
+    this->Close();
+  }
+
+  int ImageFileSource::OpenRawFile(const char* filename, int dimensions[3], int scalarType, int numComponents,
+                                   int endian, igtlUint64 offset)
+  {
+    this->Close();
+    if (filename == NULL || dimensions[0] < 1 || dimensions[1] < 1 || dimensions[2] < 1 ||
+        scalarType < ImageMessage::TYPE_INT8 ||
+        scalarType > ImageMessage::TYPE_FLOAT64 || this->m_ImageMessage->GetScalarSize(scalarType) == 0 ||
+        numComponents < 1 || numComponents > 255 ||
+        (endian != ImageMessage::ENDIAN_BIG && endian != ImageMessage::ENDIAN_LITTLE))
+      {
+      return 0;
+      }
+
+    int offsets[3] = {0, 0, 0};
+    Matrix4x4 matrix;
+    IdentityMatrix(matrix);
+    this->m_ImageMessage->SetDimensions(dimensions);
+    this->m_ImageMessage->SetSubVolume(dimensions, offsets);
+    this->m_ImageMessage->SetScalarType(scalarType);
+    this->m_ImageMessage->SetNumComponents(numComponents);
+    this->m_ImageMessage->SetEndian(endian);
+    this->m_ImageMessage->SetSpacing(1.0f, 1.0f, 1.0f);
+    this->m_ImageMessage->SetMatrix(matrix);
+    return this->MapFile(filename, offset);
+  }
+
+  int ImageFileSource::OpenNrrdFile(const char* filename)
+  {
+    this->Close();
+    FILE* fp = filename == NULL ? NULL : fopen(filename, "rb");
+    if (fp == NULL)
+      {
+      return 0;
+      }
+
+    // Fields of the header, up to the empty line before the attached data
+    char line[4096];
+    std::map<std::string, std::string> fields;
+    bool valid = fgets(line, sizeof(line), fp) != NULL && strncmp(line, "NRRD000", 7) == 0;
+    while (valid && fgets(line, sizeof(line), fp) != NULL)
+      {
+      std::string field = ImageFileSourceTrim(line);
+      if (field.empty())
+        {
+        break;
+        }
+      std::string::size_type colon = field.find(": ");
+      if (field[0] == '#' || colon == std::string::npos)
+        {
+        // Comment or key/value pair
+        continue;
+        }
+      std::string key = field.substr(0, colon);
+      std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+      if (key == "datafile")
+        {
+        key = "data file";
+        }
+      fields[key] = ImageFileSourceTrim(field.substr(colon + 2));
+      }
+    igtlUint64 headerSize = (igtlUint64)ftell(fp);
+    fclose(fp);
+    if (!valid || fields["encoding"] != "raw" ||
+        (fields.count("line skip") && atoi(fields["line skip"].c_str()) != 0))
+      {
+      return 0;
+      }
+
+    // Layout: the components are on the first axis of a 4-D volume, or of a volume whose first
+    // axis is not a domain.
+    int dimension = atoi(fields["dimension"].c_str());
+    std::vector<std::string> sizes = ImageFileSourceSplit(fields["sizes"]);
+    std::vector<std::string> kinds = ImageFileSourceSplit(fields["kinds"]);
+    int scalarType = ImageFileSourceGetNrrdType(fields["type"]);
+    if (dimension < 1 || dimension > 4 || (int)sizes.size() != dimension || scalarType < 0)
+      {
+      return 0;
+      }
+    int componentAxis = (dimension == 4 || (kinds.size() > 0 && kinds[0] != "domain" && kinds[0] != "space" &&
+                                            dimension > 1)) ? 1 : 0;
+    int numComponents = componentAxis ? atoi(sizes[0].c_str()) : 1;
+    int dim[3] = {1, 1, 1};
+    for (int i = componentAxis; i < dimension; i ++)
+      {
+      dim[i - componentAxis] = atoi(sizes[i].c_str());
+      }
+    int endian = igtl_is_little_endian() ? ImageMessage::ENDIAN_LITTLE : ImageMessage::ENDIAN_BIG;
+    if (fields["endian"] == "little")
+      {
+      endian = ImageMessage::ENDIAN_LITTLE;
+      }
+    else if (fields["endian"] == "big")
+      {
+      endian = ImageMessage::ENDIAN_BIG;
+      }
+    else if (this->m_ImageMessage->GetScalarSize(scalarType) > 1)
+      {
+      return 0;
+      }
+
+    // Geometry: the columns of the matrix are the directions of the spatial axes.
+    float spacing[3] = {1.0f, 1.0f, 1.0f};
+    float norm[3][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    std::vector<std::string> directions = ImageFileSourceSplit(fields["space directions"]);
+    std::vector<std::string> spacings = ImageFileSourceSplit(fields["spacings"]);
+    int numberOfAxes = dimension - componentAxis;
+    if ((int)directions.size() == dimension)
+      {
+      for (int i = 0; i < numberOfAxes; i ++)
+        {
+        double v[3];
+        if (sscanf(directions[i + componentAxis].c_str(), "(%lf,%lf,%lf)", &v[0], &v[1], &v[2]) != 3)
+          {
+          return 0;
+          }
+        double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length <= 0.0)
+          {
+          return 0;
+          }
+        spacing[i] = (float)length;
+        for (int j = 0; j < 3; j ++)
+          {
+          norm[i][j] = (float)(v[j] / length);
+          }
+        }
+      if (numberOfAxes < 3)
+        {
+        // Normal of the slice
+        norm[2][0] = norm[0][1] * norm[1][2] - norm[0][2] * norm[1][1];
+        norm[2][1] = norm[0][2] * norm[1][0] - norm[0][0] * norm[1][2];
+        norm[2][2] = norm[0][0] * norm[1][1] - norm[0][1] * norm[1][0];
+        }
+      }
+    else if ((int)spacings.size() == dimension)
+      {
+      for (int i = 0; i < numberOfAxes; i ++)
+        {
+        double s = atof(spacings[i + componentAxis].c_str());
+        if (s > 0.0)
+          {
+          spacing[i] = (float)s;
+          }
+        }
+      }
+    std::string origins = fields["space origin"];
+    if (!origins.empty())
+      {
+      double v[3];
+      std::vector<std::string> values = ImageFileSourceSplit(origins);
+      if (values.size() != 1 || sscanf(values[0].c_str(), "(%lf,%lf,%lf)", &v[0], &v[1], &v[2]) != 3)
+        {
+        return 0;
+        }
+      origin[0] = (float)v[0];
+      origin[1] = (float)v[1];
+      origin[2] = (float)v[2];
+      }
+    std::string space = fields["space"];
+    if (space == "left-posterior-superior" || space == "LPS")
+      {
+      // LPS to RAS
+      for (int i = 0; i < 3; i ++)
+        {
+        norm[i][0] = -norm[i][0];
+        norm[i][1] = -norm[i][1];
+        }
+      origin[0] = -origin[0];
+      origin[1] = -origin[1];
+      }
+
+    // Data: attached after the header, or detached in a file relative to the header
+    std::string dataFile = filename;
+    igtlUint64 offset = headerSize;
+    if (fields.count("data file"))
+      {
+      dataFile = fields["data file"];
+      if (dataFile.empty() || dataFile.find('%') != std::string::npos || dataFile.compare(0, 4, "LIST") == 0)
+        {
+        return 0;
+        }
+      std::string header = filename;
+      std::string::size_type slash = header.find_last_of("/\\");
+      bool absolute = dataFile[0] == '/' || dataFile[0] == '\\' || (dataFile.size() > 1 && dataFile[1] == ':');
+      if (!absolute && slash != std::string::npos)
+        {
+        dataFile = header.substr(0, slash + 1) + dataFile;
+        }
+      offset = 0;
+      }
+    if (fields.count("byte skip"))
+      {
+      // Bytes skipped from the start of the data, or -1 for the data at the end of the file
+      double skip = atof(fields["byte skip"].c_str());
+      if (skip < -1.0 || skip != floor(skip))
+        {
+        return 0;
+        }
+      offset = skip < 0.0 ? ImageFileSourceEndOfFile : offset + (igtlUint64)skip;
+      }
+
+    int offsets[3] = {0, 0, 0};
+    Matrix4x4 matrix;
+    for (int i = 0; i < 3; i ++)
+      {
+      matrix[i][0] = norm[0][i];
+      matrix[i][1] = norm[1][i];
+      matrix[i][2] = norm[2][i];
+      matrix[i][3] = origin[i];
+      matrix[3][i] = 0.0f;
+      }
+    matrix[3][3] = 1.0f;
+    if (dim[0] < 1 || dim[1] < 1 || dim[2] < 1 || numComponents < 1 || numComponents > 255)
+      {
+      return 0;
+      }
+    this->m_ImageMessage->SetDimensions(dim);
+    this->m_ImageMessage->SetSubVolume(dim, offsets);
+    this->m_ImageMessage->SetScalarType(scalarType);
+    this->m_ImageMessage->SetNumComponents(numComponents);
+    this->m_ImageMessage->SetEndian(endian);
+    this->m_ImageMessage->SetSpacing(spacing);
+    this->m_ImageMessage->SetMatrix(matrix);
+    return this->MapFile(dataFile, offset);
+  }
+
+  int ImageFileSource::MapFile(const std::string& filename, igtlUint64 offset)
+  {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      {
+      return 0;
+      }
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+      {
+      mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      }
+    // The mapping keeps the file open.
+    CloseHandle(file);
+    if (mapping == NULL)
+      {
+      return 0;
+      }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+      {
+      CloseHandle(mapping);
+      return 0;
+      }
+    this->m_FileMapping = mapping;
+    this->m_DataSize = (igtlUint64)size.QuadPart;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      {
+      return 0;
+      }
+    struct stat status;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0 && (igtlUint64)status.st_size <= (igtlUint64)(size_t)-1)
+      {
+      data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      }
+    // The mapping keeps the file open.
+    close(fd);
+    if (data == MAP_FAILED)
+      {
+      return 0;
+      }
+#if defined(POSIX_MADV_SEQUENTIAL)
+    posix_madvise(data, (size_t)status.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+    this->m_DataSize = (igtlUint64)status.st_size;
+#endif
+    this->m_Data = static_cast<const unsigned char*>(data);
+
+    igtlUint64 volumeSize = ImageFileSourceGetVolumeSize(this->m_ImageMessage);
+    if (volumeSize > this->m_DataSize)
+      {
+      this->Close();
+      return 0;
+      }
+    if (offset == ImageFileSourceEndOfFile)
+      {
+      offset = this->m_DataSize - volumeSize;
+      }
+    if (offset > this->m_DataSize - volumeSize)
+      {
+      this->Close();
+      return 0;
+      }
+    this->m_Offset = offset;
+    return 1;
+  }
+
+  void ImageFileSource::Close()
+  {
+    if (this->m_Data != NULL)
+      {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+      UnmapViewOfFile(this->m_Data);
+      CloseHandle(this->m_FileMapping);
+      this->m_FileMapping = NULL;
+#else
+      munmap(const_cast<unsigned char*>(this->m_Data), (size_t)this->m_DataSize);
+#endif
+      }
+    this->m_Data = NULL;
+    this->m_DataSize = 0;
+    this->m_Offset = 0;
+    this->m_Fragments.clear();
+    this->m_FragmentSizes.clear();
+    this->m_ScalarSize = 0;
+    this->m_CRCValid = false;
+  }
+
+  int ImageFileSource::PackFragments()
+  {
+    if (this->m_Data == NULL)
+      {
+      return 0;
+      }
+    ImageFileSourceMessage* msg = static_cast<ImageFileSourceMessage*>(this->m_ImageMessage.GetPointer());
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    msg->GetDimensions(dim);
+    msg->GetSubVolume(subDim, subOff);
+    for (int i = 0; i < 3; i ++)
+      {
+      if (subDim[i] < 1 || subOff[i] < 0 || subOff[i] + subDim[i] > dim[i])
+        {
+        return 0;
+        }
+      }
+    // The volume may have been changed on the message.
+    if (ImageFileSourceGetVolumeSize(msg) > this->m_DataSize - this->m_Offset || !msg->Repack())
+      {
+      return 0;
+      }
+
+    unsigned char* pack = static_cast<unsigned char*>(msg->GetPackPointer());
+    int prefixSize = msg->GetScalarOffset();
+    this->m_Prefix.assign(pack, pack + prefixSize);
+    this->m_Suffix.assign(pack + prefixSize, pack + msg->GetPackSize());
+
+    // Rows of the sub-volume, merged when they are contiguous in the file
+    igtlUint64 voxelSize = (igtlUint64)msg->GetScalarSize() * msg->GetNumComponents();
+    igtlUint64 rowSize = subDim[0] * voxelSize;
+    const unsigned char* scalars = this->m_Data + this->m_Offset;
+    const unsigned char* end = NULL;
+    this->m_Fragments.clear();
+    this->m_FragmentSizes.clear();
+    this->m_ScalarSize = 0;
+    for (int k = 0; k < subDim[2]; k ++)
+      {
+      for (int j = 0; j < subDim[1]; j ++)
+        {
+        const unsigned char* p = scalars +
+          (((igtlUint64)(subOff[2] + k) * dim[1] + subOff[1] + j) * dim[0] + subOff[0]) * voxelSize;
+        igtlUint64 n = rowSize;
+        while (n > 0)
+          {
+          if (p != end || this->m_FragmentSizes.back() == ImageFileSourceMaxFragmentSize)
+            {
+            this->m_Fragments.push_back(p);
+            this->m_FragmentSizes.push_back(0);
+            }
+          int length = (int)std::min<igtlUint64>(n, ImageFileSourceMaxFragmentSize - this->m_FragmentSizes.back());
+          this->m_FragmentSizes.back() += length;
+          p += length;
+          n -= length;
+          end = p;
+          }
+        this->m_ScalarSize += rowSize;
+        }
+      }
+
+    // The CRC of the body is computed again only when the body changes: the scalars are
+    // given by the image header in the prefix.
+    if (!this->m_CRCValid || this->m_CRCSuffix != this->m_Suffix ||
+        this->m_CRCPrefix.size() != (size_t)(prefixSize - IGTL_HEADER_SIZE) ||
+        memcmp(&this->m_CRCPrefix[0], &this->m_Prefix[IGTL_HEADER_SIZE], prefixSize - IGTL_HEADER_SIZE) != 0)
+      {
+      igtl_uint64 crc = crc64(0, 0, 0LL);
+      crc = crc64(&this->m_Prefix[IGTL_HEADER_SIZE], prefixSize - IGTL_HEADER_SIZE, crc);
+      for (size_t i = 0; i < this->m_Fragments.size(); i ++)
+        {
+        crc = crc64(const_cast<unsigned char*>(static_cast<const unsigned char*>(this->m_Fragments[i])),
+                    this->m_FragmentSizes[i], crc);
+        }
+      if (!this->m_Suffix.empty())
+        {
+        crc = crc64(&this->m_Suffix[0], this->m_Suffix.size(), crc);
+        }
+      this->m_CRCPrefix.assign(this->m_Prefix.begin() + IGTL_HEADER_SIZE, this->m_Prefix.end());
+      this->m_CRCSuffix = this->m_Suffix;
+      this->m_CRC = crc;
+      this->m_CRCValid = true;
+      }
+
+    // The header was packed without the scalars.
+    igtl_header header;
+    memcpy(&header, &this->m_Prefix[0], IGTL_HEADER_SIZE);
+    igtl_header_convert_byte_order(&header);
+    header.body_size += this->m_ScalarSize;
+    header.crc = this->m_CRC;
+    igtl_header_convert_byte_order(&header);
+    memcpy(&this->m_Prefix[0], &header, IGTL_HEADER_SIZE);
+    return 1;
+  }
+
+  igtlUint64 ImageFileSource::GetPackSize()
+  {
+    if (!this->PackFragments())
+      {
+      return 0;
+      }
+    return this->m_Prefix.size() + this->m_ScalarSize + this->m_Suffix.size();
+  }
+
+  int ImageFileSource::Send(Socket* socket)
+  {
+    if (socket == NULL || !this->PackFragments())
+      {
+      return 0;
+      }
+    std::vector<const void*> data;
+    std::vector<int> sizes;
+    data.reserve(this->m_Fragments.size() + 2);
+    sizes.reserve(this->m_Fragments.size() + 2);
+    data.push_back(&this->m_Prefix[0]);
+    sizes.push_back((int)this->m_Prefix.size());
+    data.insert(data.end(), this->m_Fragments.begin(), this->m_Fragments.end());
+    sizes.insert(sizes.end(), this->m_FragmentSizes.begin(), this->m_FragmentSizes.end());
+    if (!this->m_Suffix.empty())
+      {
+      data.push_back(&this->m_Suffix[0]);
+      sizes.push_back((int)this->m_Suffix.size());
+      }
+    return socket->Send(&data[0], &sizes[0], (int)data.size());
+  }
+
+} // namespace igtl
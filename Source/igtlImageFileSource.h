@@ -0,0 +1,132 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlImageFileSource_h
+#define __igtlImageFileSource_h
+
+#include <string>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlImageMessage.h"
+#include "igtlSocket.h"
+
+namespace igtl
+{
+  /// The ImageFileSource class sends IMAGE messages whose scalars are read from a memory-mapped
+  /// volume file, a raw file or a NRRD file (attached, or detached header), without copying
+  /// the scalars into the message.
+  ///
+  /// The header, the image header and the meta data of the message are packed from an
+  /// ImageMessage without scalars (GetImageMessage()), and sent with the mapped scalars of the
+  /// sub-volume in a single scatter-gather send. The pages of the file are shared by all the
+  /// sources and the processes mapping it, and read from the disk as they are sent: serving a
+  /// large volume to several clients neither copies it for each request nor keeps a copy per
+  /// client in memory.
+  ///
+  /// The CRC of the body is computed once, and computed again only when the body changes
+  /// (e.g. a new sub-volume or new meta data); the time stamp is in the header. The file must
+  /// not be modified while it is open.
+  ///
+  /// Typical use:
+  ///
+  ///   igtl::ImageFileSource::Pointer source = igtl::ImageFileSource::New();
+  ///   source->OpenNrrdFile("ct.nhdr");
+  ///   source->GetImageMessage()->SetDeviceName("CT");
+  ///   ...
+  ///   source->GetImageMessage()->SetTimeStamp(ts);
+  ///   source->Send(socket);
+  class IGTLCommon_EXPORT ImageFileSource: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ImageFileSource, Object)
+    igtlNewMacro(igtl::ImageFileSource);
+
+  public:
+    /// Maps a raw file, whose scalars start at 'offset' bytes (e.g. after a header). The message
+    /// is set to the dimensions, scalar type, number of components and endian (ENDIAN_BIG or
+    /// ENDIAN_LITTLE of ImageMessage) of the volume, with an identity orientation, a spacing of 1
+    /// and the whole volume as the sub-volume. Returns 1 on success, or 0 if the file cannot be
+    /// mapped or is smaller than the volume.
+    int OpenRawFile(const char* filename, int dimensions[3], int scalarType, int numComponents,
+                    int endian, igtlUint64 offset = 0);
+
+    /// Maps the data of a NRRD file (.nrrd, or .nhdr with its "data file"), whose encoding must
+    /// be raw. The message is set to the volume and geometry of the header: the sizes (a 4-D
+    /// volume has the components on the first axis), the type, the endian, the space directions
+    /// or the spacings, and the space origin, converted to RAS from a LPS space.
+    /// Returns 1 on success, or 0 if the header is not supported or the file cannot be mapped.
+    int OpenNrrdFile(const char* filename);
+
+    /// Unmaps the file.
+    void Close();
+
+    bool IsOpen() { return this->m_Data != NULL; }
+
+    /// Gets the message carrying the device name, the time stamp, the geometry, the sub-volume,
+    /// the header version and the meta data of the messages sent. Its scalars must not be
+    /// allocated: they are the mapped scalars.
+    ImageMessage* GetImageMessage() { return this->m_ImageMessage; }
+
+    /// Gets the mapped scalars of the whole volume (read-only), or NULL if no file is open.
+    const void* GetScalarPointer() { return this->m_Data == NULL ? NULL : this->m_Data + this->m_Offset; }
+
+    /// Gets the size of the message sent with the current sub-volume and meta data.
+    igtlUint64 GetPackSize();
+
+    /// Packs the message and sends it with the scalars of its sub-volume.
+    /// Returns 1 on success, or 0 if no file is open, the sub-volume lies outside of the
+    /// volume or the send fails.
+    int Send(Socket* socket);
+
+  protected:
+    ImageFileSource();
+    ~ImageFileSource();
+
+    /// Maps a file, and checks that it holds the scalars of the message from 'offset'.
+    int MapFile(const std::string& filename, igtlUint64 offset);
+
+    /// Packs the header, the image header and the meta data of the message, and computes the
+    /// fragments of the scalars of the sub-volume and the CRC of the body.
+    int PackFragments();
+
+  private:
+    ImageMessage::Pointer m_ImageMessage;
+
+    const unsigned char*  m_Data;
+    igtlUint64            m_DataSize;
+    igtlUint64            m_Offset;
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    void*                 m_FileMapping;
+#endif
+
+    // Packed message: the header, the extended header and the image header (prefix), the
+    // fragments of the mapped scalars, and the meta data (suffix).
+    std::vector<unsigned char> m_Prefix;
+    std::vector<unsigned char> m_Suffix;
+    std::vector<const void*>   m_Fragments;
+    std::vector<int>           m_FragmentSizes;
+    igtlUint64                 m_ScalarSize;
+
+    // Body of the last CRC computed, except the scalars
+    std::vector<unsigned char> m_CRCPrefix;
+    std::vector<unsigned char> m_CRCSuffix;
+    igtlUint64                 m_CRC;
+    bool                       m_CRCValid;
+  };
+
+} // namespace igtl
+
+#endif // __igtlImageFileSource_h
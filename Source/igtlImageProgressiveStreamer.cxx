@@ -0,0 +1,317 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageProgressiveStreamer.h"
+
+#include "igtl_header.h"
+#include "igtl_util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace igtl {
+
+  // Reverses the bytes of a scalar.
+  static void ImageProgressiveSwap(unsigned char* p, int size)
+  {
+    for (int b = 0; b < size / 2; b ++)
+      {
+      unsigned char c = p[b];
+      p[b] = p[size - 1 - b];
+      p[size - 1 - b] = c;
+      }
+  }
+
+  // Converts an average to the scalar type, rounded to the nearest integer for the integer types.
+  template <typename T>
+  static T ImageProgressiveRound(double v)
+  {
+    if ((T)0.5 == (T)0)
+      {
+      return (T)(v < 0 ? v - 0.5 : v + 0.5);
+      }
+    return (T)v;
+  }
+
+  // Averages the voxels of each factor^3 block. The rows of a block are first summed into a
+  // row at full resolution, a contiguous loop that the compiler vectorizes, then the sums of
+  // the voxels of each block are gathered along i.
+  template <typename T>
+  static void ImageProgressiveDownsample(const unsigned char* src, unsigned char* dst, int dim[3],
+                                         int outDim[3], int components, int factor, bool swap)
+  {
+    int rowLength = dim[0] * components;
+    std::vector<double> sum(rowLength);
+    std::vector<T> swapped(swap ? rowLength : 0);
+    T* out = reinterpret_cast<T*>(dst);
+    for (int ok = 0; ok < outDim[2]; ok ++)
+      {
+      int k1 = (ok + 1) * factor < dim[2] ? (ok + 1) * factor : dim[2];
+      for (int oj = 0; oj < outDim[1]; oj ++)
+        {
+        int j1 = (oj + 1) * factor < dim[1] ? (oj + 1) * factor : dim[1];
+        double* s = &sum[0];
+        for (int x = 0; x < rowLength; x ++)
+          {
+          s[x] = 0.0;
+          }
+        for (int k = ok * factor; k < k1; k ++)
+          {
+          for (int j = oj * factor; j < j1; j ++)
+            {
+            const T* in = reinterpret_cast<const T*>(src + ((size_t)k * dim[1] + j) * rowLength * sizeof(T));
+            if (swap)
+              {
+              memcpy(&swapped[0], in, rowLength * sizeof(T));
+              for (int x = 0; x < rowLength; x ++)
+                {
+                ImageProgressiveSwap(reinterpret_cast<unsigned char*>(&swapped[x]), sizeof(T));
+                }
+              in = &swapped[0];
+              }
+            for (int x = 0; x < rowLength; x ++)
+              {
+              s[x] += in[x];
+              }
+            }
+          }
+        int rows = (k1 - ok * factor) * (j1 - oj * factor);
+        for (int oi = 0; oi < outDim[0]; oi ++)
+          {
+          int i0 = oi * factor;
+          int i1 = i0 + factor < dim[0] ? i0 + factor : dim[0];
+          for (int c = 0; c < components; c ++)
+            {
+            double total = 0.0;
+            for (int i = i0; i < i1; i ++)
+              {
+              total += s[i * components + c];
+              }
+            *out = ImageProgressiveRound<T>(total / ((i1 - i0) * rows));
+            if (swap)
+              {
+              ImageProgressiveSwap(reinterpret_cast<unsigned char*>(out), sizeof(T));
+              }
+            out ++;
+            }
+          }
+        }
+      }
+  }
+
+  // Copies the header and the geometry of a volume to a new message.
+  static ImageMessage::Pointer ImageProgressiveCreateMessage(ImageMessage* volume)
+  {
+    ImageMessage::Pointer msg = ImageMessage::New();
+    msg->SetHeaderVersion(volume->GetHeaderVersion());
+    msg->SetDeviceName(volume->GetDeviceName());
+    igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+    volume->GetTimeStamp(timeStamp);
+    msg->SetTimeStamp(timeStamp);
+    msg->SetScalarType(volume->GetScalarType());
+    msg->SetNumComponents(volume->GetNumComponents());
+    msg->SetEndian(volume->GetEndian());
+    msg->SetCoordinateSystem(volume->GetCoordinateSystem());
+    float spacing[3];
+    volume->GetSpacing(spacing);
+    msg->SetSpacing(spacing);
+    Matrix4x4 matrix;
+    volume->GetMatrix(matrix);
+    msg->SetMatrix(matrix);
+    return msg;
+  }
+
+  ImageProgressiveStreamer::ImageProgressiveStreamer():Object()
+  {
+    this->m_PreviewFactor = ImageProgressiveStreamerDefaultPreviewFactor;
+    this->m_RefinementSize = ImageProgressiveStreamerDefaultRefinementSize;
+    this->m_Volume = NULL;
+    this->m_NumberOfParts = 0;
+    this->m_SlicesPerRefinement = 1;
+    this->m_Part = NULL;
+  }
+
+  ImageProgressiveStreamer::~ImageProgressiveStreamer()
+  {
+  }
+
+  int ImageProgressiveStreamer::Start(ImageMessage* volume)
+  {
+    this->m_Volume = NULL;
+    this->m_NumberOfParts = 0;
+    this->m_Part = NULL;
+    if (volume == NULL || volume->GetScalarPointer() == NULL)
+      {
+      return -1;
+      }
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    volume->GetDimensions(dim);
+    volume->GetSubVolume(subDim, subOff);
+    if (subDim[0] != dim[0] || subDim[1] != dim[1] || subDim[2] != dim[2])
+      {
+      return -1;
+      }
+
+    int sliceSize = dim[0] * dim[1] * volume->GetScalarSize() * volume->GetNumComponents();
+    this->m_SlicesPerRefinement = sliceSize > 0 ? this->m_RefinementSize / sliceSize : 1;
+    if (this->m_SlicesPerRefinement < 1)
+      {
+      this->m_SlicesPerRefinement = 1;
+      }
+    this->m_Volume = volume;
+    this->m_NumberOfParts = (dim[2] + this->m_SlicesPerRefinement - 1) / this->m_SlicesPerRefinement;
+    if (this->m_PreviewFactor > 1)
+      {
+      this->m_NumberOfParts ++;
+      }
+    return this->m_NumberOfParts;
+  }
+
+  ImageMessage* ImageProgressiveStreamer::GetPart(int i)
+  {
+    if (this->m_Volume.IsNull() || i < 0 || i >= this->m_NumberOfParts)
+      {
+      return NULL;
+      }
+    if (this->m_PreviewFactor > 1)
+      {
+      if (i == 0)
+        {
+        this->m_Part = Downsample(this->m_Volume, this->m_PreviewFactor);
+        if (this->m_Part.IsNull())
+          {
+          return NULL;
+          }
+        this->TagPart(this->m_Part, i, this->m_PreviewFactor);
+        return this->m_Part;
+        }
+      }
+
+    // Refinement: a slab of slices, contiguous in the scalars of the volume
+    int refinement = this->m_PreviewFactor > 1 ? i - 1 : i;
+    int dim[3];
+    this->m_Volume->GetDimensions(dim);
+    int k0 = refinement * this->m_SlicesPerRefinement;
+    int slices = k0 + this->m_SlicesPerRefinement < dim[2] ? this->m_SlicesPerRefinement : dim[2] - k0;
+
+    this->m_Part = ImageProgressiveCreateMessage(this->m_Volume);
+    this->m_Part->SetDimensions(dim);
+    this->m_Part->SetSubVolume(dim[0], dim[1], slices, 0, 0, k0);
+    this->m_Part->AllocateScalars();
+    size_t sliceSize = (size_t)dim[0] * dim[1] * this->m_Volume->GetScalarSize() * this->m_Volume->GetNumComponents();
+    memcpy(this->m_Part->GetScalarPointer(),
+           static_cast<const unsigned char*>(this->m_Volume->GetScalarPointer()) + k0 * sliceSize,
+           slices * sliceSize);
+    this->TagPart(this->m_Part, i, 1);
+    return this->m_Part;
+  }
+
+  ImageMessage::Pointer ImageProgressiveStreamer::Downsample(ImageMessage* volume, int factor)
+  {
+    if (volume == NULL || volume->GetScalarPointer() == NULL || factor < 1)
+      {
+      return NULL;
+      }
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    volume->GetDimensions(dim);
+    volume->GetSubVolume(subDim, subOff);
+    if (subDim[0] != dim[0] || subDim[1] != dim[1] || subDim[2] != dim[2])
+      {
+      return NULL;
+      }
+
+    ImageMessage::Pointer preview = ImageProgressiveCreateMessage(volume);
+    int outDim[3];
+    float spacing[3];
+    Matrix4x4 matrix;
+    volume->GetSpacing(spacing);
+    volume->GetMatrix(matrix);
+    for (int n = 0; n < 3; n ++)
+      {
+      outDim[n] = (dim[n] + factor - 1) / factor;
+      // The origin is the center of the volume, which moves when the dimension is not
+      // a multiple of the factor.
+      float shift = (float)(outDim[n] * factor - dim[n]) * spacing[n] * 0.5f;
+      for (int r = 0; r < 3; r ++)
+        {
+        matrix[r][3] += matrix[r][n] * shift;
+        }
+      spacing[n] *= factor;
+      }
+    preview->SetDimensions(outDim);
+    preview->SetSpacing(spacing);
+    preview->SetMatrix(matrix);
+    preview->AllocateScalars();
+
+    const unsigned char* src = static_cast<const unsigned char*>(volume->GetScalarPointer());
+    unsigned char* dst = static_cast<unsigned char*>(preview->GetScalarPointer());
+    int hostEndian = igtl_is_little_endian() ? ImageMessage::ENDIAN_LITTLE : ImageMessage::ENDIAN_BIG;
+    bool swap = volume->GetScalarSize() > 1 && volume->GetEndian() != hostEndian;
+    int components = volume->GetNumComponents();
+    switch (volume->GetScalarType())
+      {
+      case ImageMessage::TYPE_INT8:
+        ImageProgressiveDownsample<igtl_int8>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_UINT8:
+        ImageProgressiveDownsample<igtl_uint8>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_INT16:
+        ImageProgressiveDownsample<igtl_int16>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_UINT16:
+        ImageProgressiveDownsample<igtl_uint16>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_INT32:
+        ImageProgressiveDownsample<igtl_int32>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_UINT32:
+        ImageProgressiveDownsample<igtl_uint32>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_FLOAT32:
+        ImageProgressiveDownsample<igtl_float32>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      case ImageMessage::TYPE_FLOAT64:
+        ImageProgressiveDownsample<igtl_float64>(src, dst, dim, outDim, components, factor, swap);
+        break;
+      default:
+        return NULL;
+      }
+    return preview;
+  }
+
+  void ImageProgressiveStreamer::TagPart(ImageMessage* msg, int i, int factor)
+  {
+#if OpenIGTLink_HEADER_VERSION >= 2
+    if (msg->GetHeaderVersion() >= IGTL_HEADER_VERSION_2)
+      {
+      int dim[3];
+      this->m_Volume->GetDimensions(dim);
+      char dimensions[64];
+      sprintf(dimensions, "%d %d %d", dim[0], dim[1], dim[2]);
+      msg->SetMetaDataElement(IGTL_PROGRESSIVE_INDEX, (igtl_uint32)i);
+      msg->SetMetaDataElement(IGTL_PROGRESSIVE_COUNT, (igtl_uint32)this->m_NumberOfParts);
+      msg->SetMetaDataElement(IGTL_PROGRESSIVE_FACTOR, (igtl_uint32)factor);
+      msg->SetMetaDataElement(IGTL_PROGRESSIVE_DIMENSIONS, IANA_TYPE_US_ASCII, dimensions);
+      }
+#endif
+    msg->Pack();
+  }
+
+} // namespace igtl
@@ -0,0 +1,105 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlImageProgressiveStreamer_h
+#define __igtlImageProgressiveStreamer_h
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlImageMessage.h"
+
+#define ImageProgressiveStreamerDefaultPreviewFactor    4
+#define ImageProgressiveStreamerDefaultRefinementSize   4194304
+
+/// Meta data elements of the messages created by ImageProgressiveStreamer
+/// (header version 2 only). The index and the count are those of the message
+/// in the transfer; the factor is the downsampling factor of the preview, or 1
+/// for the refinements; the dimensions ("i j k") are those of the full volume.
+#define IGTL_PROGRESSIVE_INDEX       "ProgressiveIndex"
+#define IGTL_PROGRESSIVE_COUNT       "ProgressiveCount"
+#define IGTL_PROGRESSIVE_FACTOR      "ProgressiveFactor"
+#define IGTL_PROGRESSIVE_DIMENSIONS  "ProgressiveDimensions"
+
+namespace igtl
+{
+  /// The ImageProgressiveStreamer class splits a large volume (e.g. a CT) into IMAGE messages
+  /// that a viewer can render as they arrive: a preview downsampled by the preview factor,
+  /// followed by the refinements, i.e. slabs of slices at full resolution sent as sub-volumes.
+  ///
+  /// All the messages are valid IMAGE messages: the preview is a volume with the same extent
+  /// and a larger spacing, and a stock receiver simply displays the preview, then the slabs.
+  /// ImageRegionCache recognizes the preview from its meta data, and expands it to the full
+  /// volume, which the refinements then overwrite.
+  ///
+  /// Typical use:
+  ///
+  ///   int n = streamer->Start(volumeMsg);
+  ///   for (int i = 0; i < n; i ++)
+  ///     {
+  ///     igtl::ImageMessage* msg = streamer->GetPart(i);
+  ///     socket->Send(msg->GetPackPointer(), msg->GetPackSize());
+  ///     }
+  class IGTLCommon_EXPORT ImageProgressiveStreamer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ImageProgressiveStreamer, Object)
+    igtlNewMacro(igtl::ImageProgressiveStreamer);
+
+  public:
+    /// Sets the downsampling factor of the preview along each axis (4 by default).
+    /// No preview is sent if the factor is 1.
+    void SetPreviewFactor(int factor) { this->m_PreviewFactor = factor < 1 ? 1 : factor; }
+    int GetPreviewFactor() { return this->m_PreviewFactor; }
+
+    /// Sets the maximum size of the scalars of a refinement (bytes). A refinement has
+    /// at least one slice.
+    void SetRefinementSize(int size) { this->m_RefinementSize = size < 1 ? 1 : size; }
+    int GetRefinementSize() { return this->m_RefinementSize; }
+
+    /// Starts the transfer of a volume, whose scalars cover the whole volume (no sub-volume).
+    /// The volume is referenced, and must not change until the last message is created.
+    /// Returns the number of messages (parts), or -1 if the volume is a sub-volume or has no scalars.
+    int Start(ImageMessage* volume);
+
+    int GetNumberOfParts() { return this->m_NumberOfParts; }
+
+    /// Creates and packs the i-th message of the transfer: the preview first, if any, then
+    /// the refinements. The message is valid until the next call. Returns NULL if i is out of range.
+    ImageMessage* GetPart(int i);
+
+    /// Downsamples a volume by averaging the voxels of each factor^3 block. The spacing of the
+    /// preview is multiplied by the factor, and its origin moved so that it covers the volume.
+    /// Returns NULL if the volume is a sub-volume or its scalar type is unknown.
+    static ImageMessage::Pointer Downsample(ImageMessage* volume, int factor);
+
+  protected:
+    ImageProgressiveStreamer();
+    ~ImageProgressiveStreamer();
+
+    /// Adds the meta data of the i-th part, and packs it.
+    void TagPart(ImageMessage* msg, int i, int factor);
+
+  private:
+    int                    m_PreviewFactor;
+    int                    m_RefinementSize;
+
+    ImageMessage::Pointer  m_Volume;
+    int                    m_NumberOfParts;
+    int                    m_SlicesPerRefinement;
+    ImageMessage::Pointer  m_Part;
+  };
+
+} // namespace igtl
+
+#endif // __igtlImageProgressiveStreamer_h
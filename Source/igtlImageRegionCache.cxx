@@ -0,0 +1,209 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageRegionCache.h"
+
+#include "igtlImageProgressiveStreamer.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace igtl {
+
+  ImageRegionCache::ImageRegionCache():Object()
+  {
+  }
+
+  ImageRegionCache::~ImageRegionCache()
+  {
+  }
+
+  int ImageRegionCache::Patch(ImageMessage* region)
+  {
+    if (region == NULL || region->GetScalarPointer() == NULL)
+      {
+      return 0;
+      }
+#if OpenIGTLink_HEADER_VERSION >= 2
+    igtl_uint64 factor;
+    if (region->GetMetaDataElement(IGTL_PROGRESSIVE_FACTOR, factor) && factor > 1)
+      {
+      return factor <= (igtl_uint64)INT_MAX ? this->PatchPreview(region, (int)factor) : 0;
+      }
+#endif
+
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    region->GetDimensions(dim);
+    region->GetSubVolume(subDim, subOff);
+    for (int n = 0; n < 3; n ++)
+      {
+      if (subOff[n] < 0 || subDim[n] < 0 || subOff[n] + subDim[n] > dim[n])
+        {
+        return 0;
+        }
+      }
+
+    ImageMessage* volume = this->PrepareVolume(region, dim);
+
+    size_t voxelSize = (size_t)region->GetScalarSize() * region->GetNumComponents();
+    size_t rowSize = subDim[0] * voxelSize;
+    const unsigned char* src = static_cast<const unsigned char*>(region->GetScalarPointer());
+    unsigned char* dst = static_cast<unsigned char*>(volume->GetScalarPointer());
+    for (int k = 0; k < subDim[2]; k ++)
+      {
+      for (int j = 0; j < subDim[1]; j ++)
+        {
+        size_t offset = (((size_t)(subOff[2] + k) * dim[1] + subOff[1] + j) * dim[0] + subOff[0]) * voxelSize;
+        memcpy(dst + offset, src, rowSize);
+        src += rowSize;
+        }
+      }
+    return 1;
+  }
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+  int ImageRegionCache::PatchPreview(ImageMessage* preview, int factor)
+  {
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    int previewDim[3];
+    std::string dimensions;
+    preview->GetDimensions(previewDim);
+    preview->GetSubVolume(subDim, subOff);
+    if (!preview->GetMetaDataElement(IGTL_PROGRESSIVE_DIMENSIONS, dimensions) ||
+        sscanf(dimensions.c_str(), "%d %d %d", &dim[0], &dim[1], &dim[2]) != 3)
+      {
+      return 0;
+      }
+    for (int n = 0; n < 3; n ++)
+      {
+      if (dim[n] < 1 || (dim[n] - 1) / factor + 1 != previewDim[n] || subDim[n] != previewDim[n])
+        {
+        return 0;
+        }
+      }
+
+    // Geometry of the full volume (see ImageProgressiveStreamer::Downsample())
+    ImageMessage* volume = this->PrepareVolume(preview, dim);
+    float spacing[3];
+    Matrix4x4 matrix;
+    preview->GetSpacing(spacing);
+    preview->GetMatrix(matrix);
+    for (int n = 0; n < 3; n ++)
+      {
+      spacing[n] /= factor;
+      float shift = (float)(previewDim[n] * factor - dim[n]) * spacing[n] * 0.5f;
+      for (int r = 0; r < 3; r ++)
+        {
+        matrix[r][3] -= matrix[r][n] * shift;
+        }
+      }
+    volume->SetSpacing(spacing);
+    volume->SetMatrix(matrix);
+
+    // Each voxel of the preview fills a factor^3 block: the rows are expanded along i once,
+    // and copied to the rows of the block.
+    size_t voxelSize = (size_t)preview->GetScalarSize() * preview->GetNumComponents();
+    size_t rowSize = dim[0] * voxelSize;
+    const unsigned char* src = static_cast<const unsigned char*>(preview->GetScalarPointer());
+    unsigned char* dst = static_cast<unsigned char*>(volume->GetScalarPointer());
+    std::vector<unsigned char> row(rowSize);
+    for (int pk = 0; pk < previewDim[2]; pk ++)
+      {
+      for (int pj = 0; pj < previewDim[1]; pj ++)
+        {
+        const unsigned char* previewRow = src + ((size_t)pk * previewDim[1] + pj) * previewDim[0] * voxelSize;
+        for (int i = 0; i < dim[0]; i ++)
+          {
+          memcpy(&row[i * voxelSize], previewRow + (i / factor) * voxelSize, voxelSize);
+          }
+        for (int k = pk * factor; k < (pk + 1) * factor && k < dim[2]; k ++)
+          {
+          for (int j = pj * factor; j < (pj + 1) * factor && j < dim[1]; j ++)
+            {
+            memcpy(dst + ((size_t)k * dim[1] + j) * rowSize, &row[0], rowSize);
+            }
+          }
+        }
+      }
+    return 1;
+  }
+#endif
+
+  ImageMessage* ImageRegionCache::PrepareVolume(ImageMessage* region, int dim[3])
+  {
+    ImageMessage::Pointer& volume = this->m_Volumes[region->GetDeviceName()];
+    int volumeDim[3] = {0, 0, 0};
+    if (volume.IsNotNull())
+      {
+      volume->GetDimensions(volumeDim);
+      }
+    if (volume.IsNull() || volumeDim[0] != dim[0] || volumeDim[1] != dim[1] || volumeDim[2] != dim[2] ||
+        volume->GetScalarType() != region->GetScalarType() ||
+        volume->GetNumComponents() != region->GetNumComponents() ||
+        volume->GetEndian() != region->GetEndian())
+      {
+      volume = ImageMessage::New();
+      volume->SetDeviceName(region->GetDeviceName());
+      volume->SetDimensions(dim);
+      volume->SetScalarType(region->GetScalarType());
+      volume->SetNumComponents(region->GetNumComponents());
+      volume->SetEndian(region->GetEndian());
+      volume->AllocateScalars();
+      memset(volume->GetScalarPointer(), 0, volume->GetImageSize());
+      }
+
+    volume->SetHeaderVersion(region->GetHeaderVersion());
+    igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+    region->GetTimeStamp(timeStamp);
+    volume->SetTimeStamp(timeStamp);
+    volume->SetCoordinateSystem(region->GetCoordinateSystem());
+    float spacing[3];
+    region->GetSpacing(spacing);
+    volume->SetSpacing(spacing);
+    Matrix4x4 matrix;
+    region->GetMatrix(matrix);
+    volume->SetMatrix(matrix);
+    return volume;
+  }
+
+  ImageMessage* ImageRegionCache::GetVolume(const char* name)
+  {
+    if (name == NULL)
+      {
+      return NULL;
+      }
+    std::map<std::string, ImageMessage::Pointer>::iterator it = this->m_Volumes.find(name);
+    if (it == this->m_Volumes.end())
+      {
+      return NULL;
+      }
+    return it->second;
+  }
+
+  int ImageRegionCache::RemoveVolume(const char* name)
+  {
+    if (name == NULL)
+      {
+      return 0;
+      }
+    return this->m_Volumes.erase(name) > 0 ? 1 : 0;
+  }
+
+} // namespace igtl
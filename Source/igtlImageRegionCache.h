@@ -0,0 +1,82 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlImageRegionCache_h
+#define __igtlImageRegionCache_h
+
+#include <map>
+#include <string>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlImageMessage.h"
+
+namespace igtl
+{
+  /// The ImageRegionCache class keeps the whole volume of each device up to date from the IMAGE
+  /// messages carrying sub-volumes, e.g. the regions created by ImageRegionStreamer.
+  ///
+  /// The volume of a device is created by its first message, filled with zeros outside of the
+  /// sub-volume, and created again when the dimensions, the scalar type, the number of components
+  /// or the endian change. The geometry (spacing, orientation and origin) and the time stamp of
+  /// the volume are those of the last message.
+  ///
+  /// The preview created by ImageProgressiveStreamer, recognized from its meta data, is expanded
+  /// to the full volume (each voxel of the preview fills a block), so that a progressive transfer
+  /// can be displayed from its first message.
+  ///
+  /// Typical use:
+  ///
+  ///   imageMsg->Unpack(1);
+  ///   cache->Patch(imageMsg);
+  ///   igtl::ImageMessage* volume = cache->GetVolume(imageMsg->GetDeviceName());
+  class IGTLCommon_EXPORT ImageRegionCache: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ImageRegionCache, Object)
+    igtlNewMacro(igtl::ImageRegionCache);
+
+  public:
+    /// Copies the sub-volume of an unpacked IMAGE message into the volume of its device.
+    /// Returns 1 if the volume is updated, or 0 if the sub-volume lies outside of the volume.
+    int Patch(ImageMessage* region);
+
+    /// Gets the volume of a device (not packed), or NULL if no message was received from the device.
+    ImageMessage* GetVolume(const char* name);
+
+    /// Removes the volume of a device. Returns 0 if there is no volume for the device.
+    int RemoveVolume(const char* name);
+
+    int GetNumberOfVolumes() { return (int)this->m_Volumes.size(); }
+
+  protected:
+    ImageRegionCache();
+    ~ImageRegionCache();
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    /// Expands a preview of a progressive transfer to the volume of its device.
+    int PatchPreview(ImageMessage* preview, int factor);
+#endif
+
+    /// Gets the volume of the device of a message, created again if its layout differs, and
+    /// copies the time stamp and the geometry of the message.
+    ImageMessage* PrepareVolume(ImageMessage* region, int dim[3]);
+
+  private:
+    std::map<std::string, ImageMessage::Pointer> m_Volumes;
+  };
+
+} // namespace igtl
+
+#endif // __igtlImageRegionCache_h
@@ -0,0 +1,276 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageRegionStreamer.h"
+
+#include <string.h>
+
+namespace igtl {
+
+  // Range of changed blocks [begin, end) along i and j
+  struct ImageRegionStreamerBox
+  {
+    int bi0, bi1;
+    int bj0, bj1;
+  };
+
+  ImageRegionStreamer::ImageRegionStreamer():Object()
+  {
+    this->m_BlockSize[0] = ImageRegionStreamerDefaultBlockSize;
+    this->m_BlockSize[1] = ImageRegionStreamerDefaultBlockSize;
+    this->m_BlockSize[2] = ImageRegionStreamerDefaultBlockSize;
+    this->m_FullFrameRatio = 0.5;
+    this->m_Dimensions[0] = 0;
+    this->m_Dimensions[1] = 0;
+    this->m_Dimensions[2] = 0;
+    this->m_VoxelSize = 0;
+    this->m_ScalarType = 0;
+    this->m_NumComponents = 0;
+    this->m_NumberOfChangedBlocks = 0;
+  }
+
+  ImageRegionStreamer::~ImageRegionStreamer()
+  {
+  }
+
+  void ImageRegionStreamer::SetBlockSize(int i, int j, int k)
+  {
+    this->m_BlockSize[0] = i < 1 ? 1 : i;
+    this->m_BlockSize[1] = j < 1 ? 1 : j;
+    this->m_BlockSize[2] = k < 1 ? 1 : k;
+    this->Reset();
+  }
+
+  void ImageRegionStreamer::GetBlockSize(int size[3])
+  {
+    size[0] = this->m_BlockSize[0];
+    size[1] = this->m_BlockSize[1];
+    size[2] = this->m_BlockSize[2];
+  }
+
+  ImageMessage* ImageRegionStreamer::GetRegion(int i)
+  {
+    if (i < 0 || i >= (int)this->m_Regions.size())
+      {
+      return NULL;
+      }
+    return this->m_Regions[i];
+  }
+
+  void ImageRegionStreamer::Reset()
+  {
+    this->m_Previous.clear();
+  }
+
+  int ImageRegionStreamer::Update(ImageMessage* frame)
+  {
+    this->m_Regions.clear();
+    this->m_NumberOfChangedBlocks = 0;
+    if (frame == NULL || frame->GetScalarPointer() == NULL)
+      {
+      return -1;
+      }
+    int dim[3];
+    int subDim[3];
+    int subOff[3];
+    frame->GetDimensions(dim);
+    frame->GetSubVolume(subDim, subOff);
+    if (subDim[0] != dim[0] || subDim[1] != dim[1] || subDim[2] != dim[2])
+      {
+      return -1;
+      }
+
+    int numberOfBlocks[3];
+    for (int n = 0; n < 3; n ++)
+      {
+      numberOfBlocks[n] = (dim[n] + this->m_BlockSize[n] - 1) / this->m_BlockSize[n];
+      }
+    int totalBlocks = numberOfBlocks[0] * numberOfBlocks[1] * numberOfBlocks[2];
+    int zero[3] = {0, 0, 0};
+
+    int voxelSize = frame->GetScalarSize() * frame->GetNumComponents();
+    if (this->m_Previous.empty() || voxelSize != this->m_VoxelSize ||
+        frame->GetScalarType() != this->m_ScalarType || frame->GetNumComponents() != this->m_NumComponents ||
+        dim[0] != this->m_Dimensions[0] || dim[1] != this->m_Dimensions[1] || dim[2] != this->m_Dimensions[2])
+      {
+      // New layout: the whole volume is sent.
+      for (int n = 0; n < 3; n ++)
+        {
+        this->m_Dimensions[n] = dim[n];
+        }
+      this->m_VoxelSize = voxelSize;
+      this->m_ScalarType = frame->GetScalarType();
+      this->m_NumComponents = frame->GetNumComponents();
+      this->m_Previous.resize(frame->GetImageSize());
+      this->m_NumberOfChangedBlocks = totalBlocks;
+      this->AddRegion(frame, zero, dim);
+      return 1;
+      }
+
+    const unsigned char* scalars = static_cast<const unsigned char*>(frame->GetScalarPointer());
+    std::vector<char> changed(totalBlocks, 0);
+    for (int bk = 0; bk < numberOfBlocks[2]; bk ++)
+      {
+      for (int bj = 0; bj < numberOfBlocks[1]; bj ++)
+        {
+        for (int bi = 0; bi < numberOfBlocks[0]; bi ++)
+          {
+          if (this->IsBlockChanged(scalars, bi, bj, bk))
+            {
+            changed[(bk * numberOfBlocks[1] + bj) * numberOfBlocks[0] + bi] = 1;
+            this->m_NumberOfChangedBlocks ++;
+            }
+          }
+        }
+      }
+    if (this->m_NumberOfChangedBlocks == 0)
+      {
+      return 0;
+      }
+    if (this->m_NumberOfChangedBlocks >= this->m_FullFrameRatio * totalBlocks)
+      {
+      this->AddRegion(frame, zero, dim);
+      return 1;
+      }
+
+    for (int bk = 0; bk < numberOfBlocks[2]; bk ++)
+      {
+      // Runs of changed blocks along i, merged with the run of the previous row when they have
+      // the same extent.
+      std::vector<ImageRegionStreamerBox> boxes;
+      for (int bj = 0; bj < numberOfBlocks[1]; bj ++)
+        {
+        const char* row = &changed[(bk * numberOfBlocks[1] + bj) * numberOfBlocks[0]];
+        int bi = 0;
+        while (bi < numberOfBlocks[0])
+          {
+          if (!row[bi])
+            {
+            bi ++;
+            continue;
+            }
+          int bi0 = bi;
+          while (bi < numberOfBlocks[0] && row[bi])
+            {
+            bi ++;
+            }
+          bool merged = false;
+          for (size_t b = 0; b < boxes.size() && !merged; b ++)
+            {
+            if (boxes[b].bi0 == bi0 && boxes[b].bi1 == bi && boxes[b].bj1 == bj)
+              {
+              boxes[b].bj1 = bj + 1;
+              merged = true;
+              }
+            }
+          if (!merged)
+            {
+            ImageRegionStreamerBox box;
+            box.bi0 = bi0;
+            box.bi1 = bi;
+            box.bj0 = bj;
+            box.bj1 = bj + 1;
+            boxes.push_back(box);
+            }
+          }
+        }
+
+      for (size_t b = 0; b < boxes.size(); b ++)
+        {
+        int off[3];
+        int end[3];
+        off[0] = boxes[b].bi0 * this->m_BlockSize[0];
+        off[1] = boxes[b].bj0 * this->m_BlockSize[1];
+        off[2] = bk * this->m_BlockSize[2];
+        end[0] = boxes[b].bi1 * this->m_BlockSize[0];
+        end[1] = boxes[b].bj1 * this->m_BlockSize[1];
+        end[2] = off[2] + this->m_BlockSize[2];
+        int size[3];
+        for (int n = 0; n < 3; n ++)
+          {
+          size[n] = (end[n] < dim[n] ? end[n] : dim[n]) - off[n];
+          }
+        this->AddRegion(frame, off, size);
+        }
+      }
+    return (int)this->m_Regions.size();
+  }
+
+  bool ImageRegionStreamer::IsBlockChanged(const unsigned char* frame, int bi, int bj, int bk)
+  {
+    int i0 = bi * this->m_BlockSize[0];
+    int j0 = bj * this->m_BlockSize[1];
+    int k0 = bk * this->m_BlockSize[2];
+    int i1 = i0 + this->m_BlockSize[0] < this->m_Dimensions[0] ? i0 + this->m_BlockSize[0] : this->m_Dimensions[0];
+    int j1 = j0 + this->m_BlockSize[1] < this->m_Dimensions[1] ? j0 + this->m_BlockSize[1] : this->m_Dimensions[1];
+    int k1 = k0 + this->m_BlockSize[2] < this->m_Dimensions[2] ? k0 + this->m_BlockSize[2] : this->m_Dimensions[2];
+    size_t rowSize = (size_t)(i1 - i0) * this->m_VoxelSize;
+
+    // memcmp() is vectorized by the C library, and returns at the first difference.
+    for (int k = k0; k < k1; k ++)
+      {
+      for (int j = j0; j < j1; j ++)
+        {
+        size_t offset = (((size_t)k * this->m_Dimensions[1] + j) * this->m_Dimensions[0] + i0) * this->m_VoxelSize;
+        if (memcmp(frame + offset, &this->m_Previous[offset], rowSize) != 0)
+          {
+          return true;
+          }
+        }
+      }
+    return false;
+  }
+
+  void ImageRegionStreamer::AddRegion(ImageMessage* frame, int off[3], int dim[3])
+  {
+    ImageMessage::Pointer region = ImageMessage::New();
+    region->SetHeaderVersion(frame->GetHeaderVersion());
+    region->SetDeviceName(frame->GetDeviceName());
+    igtl::TimeStamp::Pointer timeStamp = igtl::TimeStamp::New();
+    frame->GetTimeStamp(timeStamp);
+    region->SetTimeStamp(timeStamp);
+
+    region->SetDimensions(this->m_Dimensions);
+    region->SetSubVolume(dim, off);
+    region->SetScalarType(frame->GetScalarType());
+    region->SetNumComponents(frame->GetNumComponents());
+    region->SetEndian(frame->GetEndian());
+    region->SetCoordinateSystem(frame->GetCoordinateSystem());
+    float spacing[3];
+    frame->GetSpacing(spacing);
+    region->SetSpacing(spacing);
+    Matrix4x4 matrix;
+    frame->GetMatrix(matrix);
+    region->SetMatrix(matrix);
+    region->AllocateScalars();
+
+    const unsigned char* src = static_cast<const unsigned char*>(frame->GetScalarPointer());
+    unsigned char* dst = static_cast<unsigned char*>(region->GetScalarPointer());
+    size_t rowSize = (size_t)dim[0] * this->m_VoxelSize;
+    for (int k = 0; k < dim[2]; k ++)
+      {
+      for (int j = 0; j < dim[1]; j ++)
+        {
+        size_t offset = (((size_t)(off[2] + k) * this->m_Dimensions[1] + off[1] + j) * this->m_Dimensions[0] + off[0])
+                        * this->m_VoxelSize;
+        memcpy(dst, src + offset, rowSize);
+        memcpy(&this->m_Previous[offset], src + offset, rowSize);
+        dst += rowSize;
+        }
+      }
+    region->Pack();
+    this->m_Regions.push_back(region);
+  }
+
+} // namespace igtl
@@ -0,0 +1,109 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlImageRegionStreamer_h
+#define __igtlImageRegionStreamer_h
+
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlImageMessage.h"
+
+#define ImageRegionStreamerDefaultBlockSize 16
+
+namespace igtl
+{
+  /// The ImageRegionStreamer class compares the successive frames of a volume (e.g. intra-operative
+  /// MRI or 3D ultrasound) by blocks, and creates IMAGE messages carrying only the sub-volumes that
+  /// changed since the previous frame. The receiver patches them into its copy of the volume with
+  /// ImageRegionCache.
+  ///
+  /// The changed blocks adjacent along i are sent as one sub-volume, and the rows of blocks with
+  /// the same extent along i, adjacent along j, are merged. The whole volume is sent for the first
+  /// frame, when the dimensions or the scalar type change, after Reset(), and when the changed
+  /// blocks exceed the full frame ratio.
+  ///
+  /// Typical use:
+  ///
+  ///   streamer->SetBlockSize(16, 16, 4);
+  ///   ...
+  ///   volumeMsg->AllocateScalars();
+  ///   // copy the new frame to volumeMsg->GetScalarPointer()
+  ///   int n = streamer->Update(volumeMsg);
+  ///   for (int i = 0; i < n; i ++)
+  ///     {
+  ///     socket->Send(streamer->GetRegion(i)->GetPackPointer(), streamer->GetRegion(i)->GetPackSize());
+  ///     }
+  class IGTLCommon_EXPORT ImageRegionStreamer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ImageRegionStreamer, Object)
+    igtlNewMacro(igtl::ImageRegionStreamer);
+
+  public:
+    /// Sets the size of the blocks compared (voxels). The whole volume is sent by the next Update().
+    void SetBlockSize(int i, int j, int k);
+    void GetBlockSize(int size[3]);
+
+    /// Sets the ratio of changed blocks from which the whole volume is sent as a single message
+    /// (0.5 by default).
+    void SetFullFrameRatio(double ratio) { this->m_FullFrameRatio = ratio; }
+    double GetFullFrameRatio() { return this->m_FullFrameRatio; }
+
+    /// Compares a new frame, whose scalars cover the whole volume (no sub-volume), with the
+    /// previous one, and creates the packed messages of the regions that changed, with the
+    /// device name, time stamp and geometry of the frame.
+    /// Returns the number of regions (0 if nothing changed), or -1 if the frame is a sub-volume.
+    int Update(ImageMessage* frame);
+
+    int GetNumberOfRegions() { return (int)this->m_Regions.size(); }
+
+    /// Gets a packed region created by the last Update().
+    ImageMessage* GetRegion(int i);
+
+    /// Gets the number of blocks that changed in the last Update().
+    int GetNumberOfChangedBlocks() { return this->m_NumberOfChangedBlocks; }
+
+    /// Forgets the previous frame, so that the whole volume is sent by the next Update().
+    void Reset();
+
+  protected:
+    ImageRegionStreamer();
+    ~ImageRegionStreamer();
+
+    /// Returns true if the block differs from the previous frame.
+    bool IsBlockChanged(const unsigned char* frame, int bi, int bj, int bk);
+
+    /// Creates the message of a region, and copies the region to the previous frame.
+    void AddRegion(ImageMessage* frame, int off[3], int dim[3]);
+
+  private:
+    int                                 m_BlockSize[3];
+    double                              m_FullFrameRatio;
+
+    /// Layout of the previous frame
+    int                                 m_Dimensions[3];
+    int                                 m_VoxelSize;
+    int                                 m_ScalarType;
+    int                                 m_NumComponents;
+    std::vector<unsigned char>          m_Previous;
+
+    std::vector<ImageMessage::Pointer>  m_Regions;
+    int                                 m_NumberOfChangedBlocks;
+  };
+
+} // namespace igtl
+
+#endif // __igtlImageRegionStreamer_h
@@ -0,0 +1,396 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlLatencyRecorder.h"
+#include "igtlTimeStamp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// Frames are identified by the part of the message ID carried by the RTP packets.
+#define LatencyRecorderFrameIDMask 0xFFFF
+
+// The stamps carried in the meta data, the later stages are stamped after the message is packed.
+#define LatencyRecorderNumberOfMetaDataStages 3
+
+// Width of the meta data values, enough for any igtl_uint64.
+#define LatencyRecorderMetaDataValueWidth 20
+
+namespace igtl {
+
+  static const char* LatencyRecorderStageNames[LatencyRecorder::NUMBER_OF_STAGES] =
+  {
+    "Capture",
+    "EncodeStart",
+    "EncodeEnd",
+    "Wrap",
+    "FirstPacketSent",
+    "LastPacketSent",
+    "FirstPacketReceived",
+    "LastPacketReceived",
+    "Reassembled",
+    "Decoded"
+  };
+
+  LatencyRecorder::LatencyRecorder():Object()
+  {
+    this->maximumNumberOfFrames = LatencyRecorderDefaultMaximumFrames;
+    this->lock = MutexLock::New();
+  }
+
+  LatencyRecorder::~LatencyRecorder()
+  {
+  }
+
+  const char* LatencyRecorder::GetStageName(int stage)
+  {
+    if (stage < 0 || stage >= NUMBER_OF_STAGES)
+      {
+      return "";
+      }
+    return LatencyRecorderStageNames[stage];
+  }
+
+  igtl_uint64 LatencyRecorder::GetCurrentTimeInNanoseconds()
+  {
+    return igtl::TimeStamp::GetSystemTimeInNanoseconds();
+  }
+
+  LatencyRecorder::FrameStamps& LatencyRecorder::GetFrameStamps(igtl_uint32 frameID)
+  {
+    std::map<igtl_uint32, FrameStamps>::iterator it = this->frames.find(frameID);
+    if (it != this->frames.end())
+      {
+      return it->second;
+      }
+    while (this->frameOrder.size() >= this->maximumNumberOfFrames)
+      {
+      this->frames.erase(this->frameOrder.front());
+      this->frameOrder.pop_front();
+      }
+    this->frameOrder.push_back(frameID);
+    return this->frames[frameID];
+  }
+
+  int LatencyRecorder::SetStamp(igtl_uint32 frameID, int stage, igtl_uint64 timeInNanoseconds)
+  {
+    if (stage < 0 || stage >= NUMBER_OF_STAGES || timeInNanoseconds == 0)
+      {
+      return 0;
+      }
+    this->lock->Lock();
+    this->GetFrameStamps(frameID & LatencyRecorderFrameIDMask).stamps[stage] = timeInNanoseconds;
+    this->lock->Unlock();
+    return 1;
+  }
+
+  int LatencyRecorder::Stamp(igtl_uint32 frameID, int stage)
+  {
+    return this->SetStamp(frameID, stage, GetCurrentTimeInNanoseconds());
+  }
+
+  int LatencyRecorder::StampIfUnset(igtl_uint32 frameID, int stage, igtl_uint64 timeInNanoseconds)
+  {
+    if (stage < 0 || stage >= NUMBER_OF_STAGES || timeInNanoseconds == 0)
+      {
+      return 0;
+      }
+    int r = 0;
+    this->lock->Lock();
+    FrameStamps& frame = this->GetFrameStamps(frameID & LatencyRecorderFrameIDMask);
+    if (frame.stamps[stage] == 0)
+      {
+      frame.stamps[stage] = timeInNanoseconds;
+      r = 1;
+      }
+    this->lock->Unlock();
+    return r;
+  }
+
+  igtl_uint64 LatencyRecorder::GetStamp(igtl_uint32 frameID, int stage)
+  {
+    if (stage < 0 || stage >= NUMBER_OF_STAGES)
+      {
+      return 0;
+      }
+    igtl_uint64 stamp = 0;
+    this->lock->Lock();
+    std::map<igtl_uint32, FrameStamps>::iterator it = this->frames.find(frameID & LatencyRecorderFrameIDMask);
+    if (it != this->frames.end())
+      {
+      stamp = it->second.stamps[stage];
+      }
+    this->lock->Unlock();
+    return stamp;
+  }
+
+  int LatencyRecorder::WriteStampsToMetaData(MessageBase* message)
+  {
+    if (message == NULL)
+      {
+      return 0;
+      }
+    // A message allocated without the stamps has no room for them in its buffer.
+    bool allocated = (message->GetBufferSize() > IGTL_HEADER_SIZE);
+    std::string value;
+    if (allocated && !message->GetMetaDataElement(std::string("Latency") + GetStageName(0), value))
+      {
+      return 0;
+      }
+
+    FrameStamps frame;
+    this->lock->Lock();
+    std::map<igtl_uint32, FrameStamps>::iterator it = this->frames.find(message->GetMessageID() & LatencyRecorderFrameIDMask);
+    if (it != this->frames.end())
+      {
+      frame = it->second;
+      }
+    this->lock->Unlock();
+
+    int numberOfStamps = 0;
+    for (int stage = 0; stage < LatencyRecorderNumberOfMetaDataStages; stage++)
+      {
+      // The unset stages are written as well, so that the size of the meta data does not change when they are stamped.
+      std::stringstream ss;
+      ss << std::setw(LatencyRecorderMetaDataValueWidth) << std::setfill('0') << frame.stamps[stage];
+      std::string key = std::string("Latency") + GetStageName(stage);
+      if (message->SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str()))
+        {
+        numberOfStamps++;
+        }
+      }
+    if (allocated)
+      {
+      message->Pack();
+      }
+    return numberOfStamps;
+  }
+
+  int LatencyRecorder::ReadStampsFromMetaData(MessageBase* message)
+  {
+    if (message == NULL)
+      {
+      return 0;
+      }
+    int numberOfStamps = 0;
+    igtl_uint32 frameID = message->GetMessageID();
+    for (int stage = 0; stage < LatencyRecorderNumberOfMetaDataStages; stage++)
+      {
+      std::string value;
+      if (!message->GetMetaDataElement(std::string("Latency") + GetStageName(stage), value))
+        {
+        continue;
+        }
+      std::stringstream ss(value);
+      igtl_uint64 stamp = 0;
+      ss >> stamp;
+      if (!ss.fail() && this->SetStamp(frameID, stage, stamp))
+        {
+        numberOfStamps++;
+        }
+      }
+    return numberOfStamps;
+  }
+
+  void LatencyRecorder::Merge(LatencyRecorder* recorder)
+  {
+    if (recorder == NULL || recorder == this)
+      {
+      return;
+      }
+    std::vector<std::pair<igtl_uint32, FrameStamps> > otherFrames;
+    recorder->lock->Lock();
+    for (unsigned int i = 0; i < recorder->frameOrder.size(); i++)
+      {
+      otherFrames.push_back(std::pair<igtl_uint32, FrameStamps>(recorder->frameOrder[i], recorder->frames[recorder->frameOrder[i]]));
+      }
+    recorder->lock->Unlock();
+
+    this->lock->Lock();
+    for (unsigned int i = 0; i < otherFrames.size(); i++)
+      {
+      FrameStamps& frame = this->GetFrameStamps(otherFrames[i].first);
+      for (int stage = 0; stage < NUMBER_OF_STAGES; stage++)
+        {
+        if (frame.stamps[stage] == 0)
+          {
+          frame.stamps[stage] = otherFrames[i].second.stamps[stage];
+          }
+        }
+      }
+    this->lock->Unlock();
+  }
+
+  int LatencyRecorder::GetLatencyPercentile(int fromStage, int toStage, double percentile, double& latency)
+  {
+    if (fromStage < 0 || fromStage >= NUMBER_OF_STAGES || toStage < 0 || toStage >= NUMBER_OF_STAGES)
+      {
+      return 0;
+      }
+    std::vector<double> latencies;
+    this->lock->Lock();
+    std::map<igtl_uint32, FrameStamps>::iterator it;
+    for (it = this->frames.begin(); it != this->frames.end(); ++it)
+      {
+      igtl_uint64 from = it->second.stamps[fromStage];
+      igtl_uint64 to = it->second.stamps[toStage];
+      if (from != 0 && to != 0)
+        {
+        // The difference may be negative if the clocks of the sender and the receiver are not synchronized.
+        latencies.push_back((double)((igtl_int64)(to - from)) / 1e6);
+        }
+      }
+    this->lock->Unlock();
+    if (latencies.size() == 0)
+      {
+      return 0;
+      }
+
+    // Nearest-rank percentile
+    std::sort(latencies.begin(), latencies.end());
+    if (percentile < 0.0)
+      {
+      percentile = 0.0;
+      }
+    if (percentile > 100.0)
+      {
+      percentile = 100.0;
+      }
+    unsigned int rank = (unsigned int)ceil(percentile / 100.0 * latencies.size());
+    if (rank < 1)
+      {
+      rank = 1;
+      }
+    if (rank > latencies.size())
+      {
+      rank = latencies.size();
+      }
+    latency = latencies[rank-1];
+    return latencies.size();
+  }
+
+  void LatencyRecorder::WriteFramesCSV(std::ostream& os)
+  {
+    os << "FrameID";
+    for (int stage = 0; stage < NUMBER_OF_STAGES; stage++)
+      {
+      os << "," << GetStageName(stage);
+      }
+    os << std::endl;
+
+    this->lock->Lock();
+    for (unsigned int i = 0; i < this->frameOrder.size(); i++)
+      {
+      const FrameStamps& frame = this->frames[this->frameOrder[i]];
+      os << this->frameOrder[i];
+      for (int stage = 0; stage < NUMBER_OF_STAGES; stage++)
+        {
+        os << ",";
+        if (frame.stamps[stage] != 0)
+          {
+          os << frame.stamps[stage];
+          }
+        }
+      os << std::endl;
+      }
+    this->lock->Unlock();
+  }
+
+  void LatencyRecorder::WriteSummaryCSV(std::ostream& os)
+  {
+    static const double percentiles[] = {50.0, 90.0, 95.0, 99.0};
+    const int numberOfPercentiles = sizeof(percentiles) / sizeof(percentiles[0]);
+
+    // Only the stages stamped for at least one frame are reported.
+    std::vector<int> stages;
+    for (int stage = 0; stage < NUMBER_OF_STAGES; stage++)
+      {
+      double latency;
+      if (this->GetLatencyPercentile(stage, stage, 0.0, latency) > 0)
+        {
+        stages.push_back(stage);
+        }
+      }
+    std::vector<std::pair<int, int> > intervals;
+    for (unsigned int i = 1; i < stages.size(); i++)
+      {
+      intervals.push_back(std::pair<int, int>(stages[i-1], stages[i]));
+      }
+    if (stages.size() > 2)
+      {
+      intervals.push_back(std::pair<int, int>(stages.front(), stages.back()));
+      }
+
+    os << "From,To,Frames,Min,P50,P90,P95,P99,Max" << std::endl;
+    for (unsigned int i = 0; i < intervals.size(); i++)
+      {
+      double latency = 0.0;
+      int numberOfFrames = this->GetLatencyPercentile(intervals[i].first, intervals[i].second, 0.0, latency);
+      os << GetStageName(intervals[i].first) << "," << GetStageName(intervals[i].second) << "," << numberOfFrames;
+      if (numberOfFrames == 0)
+        {
+        os << ",,,,,," << std::endl;
+        continue;
+        }
+      os << "," << latency;
+      for (int j = 0; j < numberOfPercentiles; j++)
+        {
+        this->GetLatencyPercentile(intervals[i].first, intervals[i].second, percentiles[j], latency);
+        os << "," << latency;
+        }
+      this->GetLatencyPercentile(intervals[i].first, intervals[i].second, 100.0, latency);
+      os << "," << latency << std::endl;
+      }
+  }
+
+  void LatencyRecorder::SetMaximumNumberOfFrames(unsigned int numFrames)
+  {
+    if (numFrames < 1)
+      {
+      numFrames = 1;
+      }
+    if (numFrames > LatencyRecorderMaximumFrames)
+      {
+      numFrames = LatencyRecorderMaximumFrames;
+      }
+    this->lock->Lock();
+    this->maximumNumberOfFrames = numFrames;
+    while (this->frameOrder.size() > this->maximumNumberOfFrames)
+      {
+      this->frames.erase(this->frameOrder.front());
+      this->frameOrder.pop_front();
+      }
+    this->lock->Unlock();
+  }
+
+  int LatencyRecorder::GetNumberOfFrames()
+  {
+    this->lock->Lock();
+    int numberOfFrames = this->frames.size();
+    this->lock->Unlock();
+    return numberOfFrames;
+  }
+
+  void LatencyRecorder::Clear()
+  {
+    this->lock->Lock();
+    this->frames.clear();
+    this->frameOrder.clear();
+    this->lock->Unlock();
+  }
+
+} // namespace igtl
@@ -0,0 +1,161 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlLatencyRecorder_h
+#define __igtlLatencyRecorder_h
+
+#include <deque>
+#include <map>
+#include <ostream>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlMutexLock.h"
+#include "igtl_types.h"
+
+#define LatencyRecorderDefaultMaximumFrames 4096
+#define LatencyRecorderMaximumFrames 32768
+
+namespace igtl
+{
+  /// The LatencyRecorder class collects the time stamps of each frame along the streaming path,
+  /// from the capture to the decoding at the receiver side, and computes the latency statistics
+  /// of each stage.
+  ///
+  /// The stamps are in nanoseconds since the Unix epoch (TimeStamp::GetTimeStampInNanoseconds()),
+  /// the latency between stamps taken on different hosts is only meaningful if their clocks are synchronized.
+  ///
+  /// Frames are identified by the lower 16 bits of the message ID, which is the part of the message ID
+  /// carried by the RTP packets of MessageRTPWrapper.
+  ///
+  /// Typical use:
+  ///
+  ///   Sender:
+  ///     recorder->Stamp(frameID, LatencyRecorder::STAGE_CAPTURE);
+  ///     recorder->Stamp(frameID, LatencyRecorder::STAGE_ENCODE_START);
+  ///     videoMsg->SetMessageID(frameID);
+  ///     recorder->WriteStampsToMetaData(videoMsg); // before the message is allocated
+  ///     encoder->EncodeSingleFrameIntoVideoMSG(pic, videoMsg);
+  ///     recorder->Stamp(frameID, LatencyRecorder::STAGE_ENCODE_END);
+  ///     recorder->WriteStampsToMetaData(videoMsg); // packs the message again
+  ///     rtpWrapper->SetLatencyRecorder(recorder); // stamps the wrap and packet stages
+  ///
+  ///   Receiver:
+  ///     rtpWrapper->SetLatencyRecorder(recorder); // stamps the packet and reassembly stages
+  ///     videoMsg->Unpack();
+  ///     recorder->ReadStampsFromMetaData(videoMsg);
+  ///     decoder->DecodeVideoMSGIntoSingleFrame(videoMsg, pic);
+  ///     recorder->Stamp(videoMsg->GetMessageID(), LatencyRecorder::STAGE_DECODED);
+  ///     recorder->WriteSummaryCSV(std::cout);
+  class IGTLCommon_EXPORT LatencyRecorder: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::LatencyRecorder, Object)
+    igtlNewMacro(igtl::LatencyRecorder);
+
+  public:
+    enum Stage
+    {
+      STAGE_CAPTURE,
+      STAGE_ENCODE_START,
+      STAGE_ENCODE_END,
+      STAGE_WRAP,
+      STAGE_FIRST_PACKET_SENT,
+      STAGE_LAST_PACKET_SENT,
+      STAGE_FIRST_PACKET_RECEIVED,
+      STAGE_LAST_PACKET_RECEIVED,
+      STAGE_REASSEMBLED,
+      STAGE_DECODED,
+      NUMBER_OF_STAGES
+    };
+
+    /// Gets the name of the stage, used in the CSV columns and the meta data keys.
+    static const char* GetStageName(int stage);
+
+    /// Gets the current time in nanoseconds since the Unix epoch.
+    static igtl_uint64 GetCurrentTimeInNanoseconds();
+
+    /// Records the time of the stage for the frame. Returns 0 if the stage is invalid or the time is 0.
+    int SetStamp(igtl_uint32 frameID, int stage, igtl_uint64 timeInNanoseconds);
+
+    /// Records the current time for the stage of the frame.
+    int Stamp(igtl_uint32 frameID, int stage);
+
+    /// Records the time of the stage only if the stage has not been stamped yet for the frame.
+    int StampIfUnset(igtl_uint32 frameID, int stage, igtl_uint64 timeInNanoseconds);
+
+    /// Gets the time of the stage for the frame. Returns 0 if the stage has not been stamped.
+    igtl_uint64 GetStamp(igtl_uint32 frameID, int stage);
+
+    /// Writes the capture and encoding stamps of the frame of the message ID into the meta data of the message.
+    /// The values have a fixed width, so that the stamps can be updated without changing the size of the message.
+    /// The first call has to be made before the message buffer is allocated, so that it has room for the stamps.
+    /// Once the buffer is allocated, the calls update the stamps and pack the message again.
+    /// Returns the number of stamps written, 0 if the buffer was allocated without room for them.
+    int WriteStampsToMetaData(MessageBase* message);
+
+    /// Reads the stamps written by WriteStampsToMetaData() from an unpacked message.
+    /// Returns the number of stamps read.
+    int ReadStampsFromMetaData(MessageBase* message);
+
+    /// Copies the stamps of another recorder, e.g. to combine the sender and receiver sides of a loopback.
+    /// The stamps already set in this recorder are kept.
+    void Merge(LatencyRecorder* recorder);
+
+    /// Gets the latency in milliseconds between two stages at the given percentile (0-100), computed over the
+    /// frames stamped at both stages. Returns the number of frames used, 0 if no frame has both stamps.
+    int GetLatencyPercentile(int fromStage, int toStage, double percentile, double& latency);
+
+    /// Writes one line per frame with the stamps in nanoseconds. The stamps not recorded are left empty.
+    void WriteFramesCSV(std::ostream& os);
+
+    /// Writes the percentiles in milliseconds of each stage, i.e. between each stage and the next recorded one,
+    /// and of the whole path from the capture to the decoding.
+    void WriteSummaryCSV(std::ostream& os);
+
+    /// Sets the number of frames kept, the oldest frames are discarded first. Clamped to 1 - LatencyRecorderMaximumFrames.
+    void SetMaximumNumberOfFrames(unsigned int numFrames);
+
+    unsigned int GetMaximumNumberOfFrames(){return this->maximumNumberOfFrames;};
+
+    int GetNumberOfFrames();
+
+    void Clear();
+
+  protected:
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    /// Stamps of one frame, 0 when a stage is not recorded.
+    class FrameStamps
+    {
+    public:
+      FrameStamps(){for (int i = 0; i < NUMBER_OF_STAGES; i++) stamps[i] = 0;};
+      igtl_uint64 stamps[NUMBER_OF_STAGES];
+    };
+
+    /// Gets the stamps of the frame, creates them if needed. Must be called with the lock held.
+    FrameStamps& GetFrameStamps(igtl_uint32 frameID);
+
+  private:
+    std::map<igtl_uint32, FrameStamps> frames;
+    std::deque<igtl_uint32> frameOrder;
+    unsigned int maximumNumberOfFrames;
+    MutexLock::Pointer lock;
+  };
+
+} // namespace igtl
+
+#endif // __igtlLatencyRecorder_h
@@ -0,0 +1,601 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlLocalSocket.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define IGTL_LOCAL_SOCKET_SUPPORTED
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#define IGTL_LOCAL_SOCKET_DESCRIPTOR_PASSING
+#endif
+#endif
+
+// Size of the blocks read to skip data received through the socket
+#define IGTL_LOCAL_SOCKET_SKIP_BLOCK_SIZE 65536
+
+// Largest number of descriptors accepted with a message
+#define IGTL_LOCAL_SOCKET_MAX_DESCRIPTORS 4
+
+namespace
+{
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+  bool IsSocketTimeout()
+  {
+    // EAGAIN is also returned when the timeout set by SO_SNDTIMEO or SO_RCVTIMEO expires.
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+
+  bool SetAddress(const char* path, struct sockaddr_un* address)
+  {
+    if (path == NULL || strlen(path) == 0 || strlen(path) >= sizeof(address->sun_path))
+      {
+      return false;
+      }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strncpy(address->sun_path, path, sizeof(address->sun_path) - 1);
+    return true;
+  }
+#endif
+
+  // Returns the size of the body and whether it may be passed as a file descriptor.
+  igtl_uint64 ParseHeader(const igtl_uint8* data, bool* largeData)
+  {
+    igtl_header header;
+    memcpy(&header, data, IGTL_HEADER_SIZE);
+    igtl_header_convert_byte_order(&header);
+    *largeData = strncmp(header.name, "IMAGE", IGTL_HEADER_TYPE_SIZE) == 0 ||
+                 strncmp(header.name, "VIDEO", IGTL_HEADER_TYPE_SIZE) == 0;
+    return header.body_size;
+  }
+}
+
+namespace igtl {
+
+  LocalSocket::LocalSocket():Socket()
+  {
+    this->m_DescriptorPassing = false;
+    this->m_DescriptorPassingSize = LocalSocketDefaultDescriptorPassingSize;
+    this->m_SendHeaderSize = 0;
+    this->m_SendBodyRemaining = 0;
+    this->m_SendBodyFile = -1;
+    this->m_SendBody = NULL;
+    this->m_SendBodySize = 0;
+    this->m_ReceiveHeaderSize = 0;
+    this->m_ReceiveBodyRemaining = 0;
+    this->m_ReceiveBodyFile = -1;
+    this->m_ReceiveBody = NULL;
+    this->m_ReceiveBodySize = 0;
+  }
+
+  LocalSocket::~LocalSocket()
+  {
+    this->CloseSocket();
+  }
+
+  int LocalSocket::CreateServer(const char* path)
+  {
+    this->CloseSocket();
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    struct sockaddr_un address;
+    if (!SetAddress(path, &address))
+      {
+      return -1;
+      }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0)
+      {
+      return -1;
+      }
+    int r = bind(sock, (struct sockaddr*)&address, sizeof(address));
+    if (r != 0 && errno == EADDRINUSE)
+      {
+      // A socket file left by a server that has exited refuses the connections. The test
+      // connection to a running server is closed at once.
+      int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+      bool stale = probe >= 0 && connect(probe, (struct sockaddr*)&address, sizeof(address)) != 0 &&
+                   errno == ECONNREFUSED;
+      if (probe >= 0)
+        {
+        close(probe);
+        }
+      if (!stale)
+        {
+        igtlErrorMacro("Local socket " << path << " is used by another server.");
+        close(sock);
+        return -1;
+        }
+      unlink(path);
+      r = bind(sock, (struct sockaddr*)&address, sizeof(address));
+      }
+    if (r != 0 || this->Listen(sock) != 0)
+      {
+      close(sock);
+      return -1;
+      }
+    this->m_SocketDescriptor = sock;
+    this->m_Path = path;
+    return 0;
+#else
+    (void)path;
+    return -1;
+#endif
+  }
+
+  LocalSocket::Pointer LocalSocket::WaitForConnection(unsigned long msec)
+  {
+    if (this->m_SocketDescriptor < 0 || this->m_Path.empty())
+      {
+      igtlErrorMacro("Server Socket not created yet!");
+      return NULL;
+      }
+    if (this->SelectSocket(this->m_SocketDescriptor, msec) != 1)
+      {
+      return NULL;
+      }
+    int sock = this->Accept(this->m_SocketDescriptor);
+    if (sock < 0)
+      {
+      return NULL;
+      }
+    LocalSocket::Pointer socket = LocalSocket::New();
+    socket->m_SocketDescriptor = sock;
+    socket->m_DescriptorPassing = this->m_DescriptorPassing;
+    socket->m_DescriptorPassingSize = this->m_DescriptorPassingSize;
+    return socket;
+  }
+
+  int LocalSocket::ConnectToServer(const char* path)
+  {
+    this->CloseSocket();
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    struct sockaddr_un address;
+    if (!SetAddress(path, &address))
+      {
+      return -1;
+      }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0)
+      {
+      return -1;
+      }
+    if (connect(sock, (struct sockaddr*)&address, sizeof(address)) != 0)
+      {
+      close(sock);
+      return -1;
+      }
+    this->m_SocketDescriptor = sock;
+    return 0;
+#else
+    (void)path;
+    return -1;
+#endif
+  }
+
+  void LocalSocket::CloseSocket()
+  {
+    this->ReleaseBodyFiles();
+    this->Superclass::CloseSocket();
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    if (!this->m_Path.empty())
+      {
+      unlink(this->m_Path.c_str());
+      }
+#endif
+    this->m_Path.clear();
+    this->m_SendHeaderSize = 0;
+    this->m_SendBodyRemaining = 0;
+    this->m_ReceiveHeaderSize = 0;
+    this->m_ReceiveBodyRemaining = 0;
+  }
+
+  void LocalSocket::ReleaseBodyFiles()
+  {
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    if (this->m_SendBody != NULL)
+      {
+      munmap(this->m_SendBody, (size_t)this->m_SendBodySize);
+      }
+    if (this->m_SendBodyFile >= 0)
+      {
+      close(this->m_SendBodyFile);
+      }
+    if (this->m_ReceiveBody != NULL)
+      {
+      munmap((void*)this->m_ReceiveBody, (size_t)this->m_ReceiveBodySize);
+      }
+    if (this->m_ReceiveBodyFile >= 0)
+      {
+      close(this->m_ReceiveBodyFile);
+      }
+#endif
+    this->m_SendBody = NULL;
+    this->m_SendBodyFile = -1;
+    this->m_ReceiveBody = NULL;
+    this->m_ReceiveBodyFile = -1;
+  }
+
+  bool LocalSocket::CreateBodyFile(igtl_uint64 size)
+  {
+#if defined(IGTL_LOCAL_SOCKET_DESCRIPTOR_PASSING)
+    int fd = memfd_create("igtl-body", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+      {
+      return false;
+      }
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+      {
+      p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      }
+    if (p == MAP_FAILED)
+      {
+      close(fd);
+      return false;
+      }
+    this->m_SendBodyFile = fd;
+    this->m_SendBody = static_cast<char*>(p);
+    this->m_SendBodySize = size;
+    return true;
+#else
+    (void)size;
+    return false;
+#endif
+  }
+
+  int LocalSocket::SendBodyFile()
+  {
+#if defined(IGTL_LOCAL_SOCKET_DESCRIPTOR_PASSING)
+    // The file is sealed, so that the receiver can map it without it being changed or truncated.
+    munmap(this->m_SendBody, (size_t)this->m_SendBodySize);
+    this->m_SendBody = NULL;
+    fcntl(this->m_SendBodyFile, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+    struct iovec iov;
+    iov.iov_base = this->m_SendHeader;
+    iov.iov_len = IGTL_HEADER_SIZE;
+    union
+    {
+      struct cmsghdr header;
+      char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &this->m_SendBodyFile, sizeof(int));
+
+    ssize_t n = sendmsg(this->m_SocketDescriptor, &message, this->GetSendFlags());
+    close(this->m_SendBodyFile);
+    this->m_SendBodyFile = -1;
+    if (n < 0)
+      {
+      return 0;
+      }
+    // The descriptor is sent with the first byte, the rest of the header is sent as data.
+    return this->Superclass::Send(this->m_SendHeader + n, IGTL_HEADER_SIZE - (int)n);
+#else
+    return 0;
+#endif
+  }
+
+  int LocalSocket::SendMessageData(const char* data, int length)
+  {
+    int offset = 0;
+    while (offset < length)
+      {
+      if (this->m_SendBodyRemaining > 0)
+        {
+        int n = (int)std::min<igtl_uint64>(this->m_SendBodyRemaining, length - offset);
+        if (this->m_SendBody != NULL)
+          {
+          memcpy(this->m_SendBody + (this->m_SendBodySize - this->m_SendBodyRemaining), data + offset, n);
+          }
+        else if (!this->Superclass::Send(data + offset, n))
+          {
+          return 0;
+          }
+        this->m_SendBodyRemaining -= n;
+        offset += n;
+        if (this->m_SendBodyRemaining == 0 && this->m_SendBody != NULL && !this->SendBodyFile())
+          {
+          return 0;
+          }
+        continue;
+        }
+
+      int n = std::min(IGTL_HEADER_SIZE - this->m_SendHeaderSize, length - offset);
+      memcpy(this->m_SendHeader + this->m_SendHeaderSize, data + offset, n);
+      this->m_SendHeaderSize += n;
+      offset += n;
+      if (this->m_SendHeaderSize < IGTL_HEADER_SIZE)
+        {
+        continue;
+        }
+      this->m_SendHeaderSize = 0;
+
+      bool largeData = false;
+      this->m_SendBodyRemaining = ParseHeader(this->m_SendHeader, &largeData);
+      if (largeData && this->m_SendBodyRemaining > 0 &&
+          this->m_SendBodyRemaining >= this->m_DescriptorPassingSize &&
+          this->CreateBodyFile(this->m_SendBodyRemaining))
+        {
+        // The header is sent with the file, once the body has been copied.
+        continue;
+        }
+
+      // The header is sent with the part of the body at hand.
+      const void* fragments[2] = {this->m_SendHeader, data + offset};
+      int sizes[2] = {IGTL_HEADER_SIZE, (int)std::min<igtl_uint64>(this->m_SendBodyRemaining, length - offset)};
+      if (!this->Superclass::Send(fragments, sizes, 2))
+        {
+        return 0;
+        }
+      this->m_SendBodyRemaining -= sizes[1];
+      offset += sizes[1];
+      }
+    return 1;
+  }
+
+  int LocalSocket::Send(const void* data, int length)
+  {
+    if (!this->m_DescriptorPassing)
+      {
+      return this->Superclass::Send(data, length);
+      }
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    return this->SendMessageData(static_cast<const char*>(data), length);
+  }
+
+  int LocalSocket::Send(const void* const* data, const int* length, int numberOfFragments)
+  {
+    if (!this->m_DescriptorPassing)
+      {
+      return this->Superclass::Send(data, length, numberOfFragments);
+      }
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    for (int i = 0; i < numberOfFragments; i ++)
+      {
+      if (!this->SendMessageData(static_cast<const char*>(data[i]), length[i]))
+        {
+        return 0;
+        }
+      }
+    return 1;
+  }
+
+  int LocalSocket::SendNonBlocking(const void* data, int length)
+  {
+    if (!this->m_DescriptorPassing)
+      {
+      return this->Superclass::SendNonBlocking(data, length);
+      }
+    if (length <= 0)
+      {
+      return this->GetConnected() ? 0 : -1;
+      }
+    return this->Send(data, length) ? length : -1;
+  }
+
+  bool LocalSocket::MapBodyFile(int fd, igtl_uint64 size)
+  {
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (igtl_uint64)st.st_size < size)
+      {
+      return false;
+      }
+    void* p = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      {
+      return false;
+      }
+    this->m_ReceiveBody = static_cast<const char*>(p);
+    this->m_ReceiveBodySize = size;
+    return true;
+#else
+    (void)fd;
+    (void)size;
+    return false;
+#endif
+  }
+
+  int LocalSocket::ReceiveMessageData(char* data, int length, int readFully)
+  {
+#if defined(IGTL_LOCAL_SOCKET_SUPPORTED)
+    if (length <= 0 || !this->GetConnected())
+      {
+      return 0;
+      }
+    std::vector<char> scratch;
+    if (data == NULL)
+      {
+      scratch.resize(IGTL_LOCAL_SOCKET_SKIP_BLOCK_SIZE);
+      }
+
+    int total = 0;
+    while (total < length)
+      {
+      // Body passed as a file descriptor
+      if (this->m_ReceiveBody != NULL)
+        {
+        int n = (int)std::min<igtl_uint64>(this->m_ReceiveBodyRemaining, length - total);
+        if (data != NULL)
+          {
+          memcpy(data + total, this->m_ReceiveBody + (this->m_ReceiveBodySize - this->m_ReceiveBodyRemaining), n);
+          }
+        this->m_ReceiveBodyRemaining -= n;
+        total += n;
+        if (this->m_ReceiveBodyRemaining == 0)
+          {
+          munmap((void*)this->m_ReceiveBody, (size_t)this->m_ReceiveBodySize);
+          this->m_ReceiveBody = NULL;
+          }
+        continue;
+        }
+      if (!readFully && total > 0)
+        {
+        break;
+        }
+
+      // A read does not go beyond the header, so that a descriptor is received with its header.
+      bool inBody = this->m_ReceiveBodyRemaining > 0;
+      int size = inBody ? (int)std::min<igtl_uint64>(this->m_ReceiveBodyRemaining, length - total)
+                        : std::min(IGTL_HEADER_SIZE - this->m_ReceiveHeaderSize, length - total);
+      char* buffer = data + total;
+      if (data == NULL)
+        {
+        size = std::min(size, (int)scratch.size());
+        buffer = &scratch[0];
+        }
+
+      struct iovec iov;
+      iov.iov_base = buffer;
+      iov.iov_len = size;
+      union
+      {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(IGTL_LOCAL_SOCKET_MAX_DESCRIPTORS * sizeof(int))];
+      } control;
+      struct msghdr message;
+      memset(&message, 0, sizeof(message));
+      message.msg_iov = &iov;
+      message.msg_iovlen = 1;
+      message.msg_control = control.buffer;
+      message.msg_controllen = sizeof(control.buffer);
+      int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+      flags |= MSG_CMSG_CLOEXEC;
+#endif
+      ssize_t n = recvmsg(this->m_SocketDescriptor, &message, flags);
+      if (n == 0)
+        {
+        break; // Disconnected
+        }
+      if (n < 0)
+        {
+        if (total == 0)
+          {
+          return IsSocketTimeout() ? -1 : 0;
+          }
+        break;
+        }
+
+      // Descriptors received with the first byte of a header
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+          {
+          continue;
+          }
+        int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < count; i ++)
+          {
+          int fd;
+          memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+          if (!inBody && this->m_ReceiveBodyFile < 0)
+            {
+            this->m_ReceiveBodyFile = fd;
+            }
+          else
+            {
+            close(fd);
+            }
+          }
+        }
+
+      if (inBody)
+        {
+        this->m_ReceiveBodyRemaining -= n;
+        }
+      else
+        {
+        memcpy(this->m_ReceiveHeader + this->m_ReceiveHeaderSize, buffer, n);
+        this->m_ReceiveHeaderSize += (int)n;
+        if (this->m_ReceiveHeaderSize == IGTL_HEADER_SIZE)
+          {
+          bool largeData = false;
+          this->m_ReceiveHeaderSize = 0;
+          this->m_ReceiveBodyRemaining = ParseHeader(this->m_ReceiveHeader, &largeData);
+          if (this->m_ReceiveBodyFile >= 0)
+            {
+            bool mapped = this->m_ReceiveBodyRemaining > 0 &&
+                          this->MapBodyFile(this->m_ReceiveBodyFile, this->m_ReceiveBodyRemaining);
+            close(this->m_ReceiveBodyFile);
+            this->m_ReceiveBodyFile = -1;
+            if (!mapped && this->m_ReceiveBodyRemaining > 0)
+              {
+              igtlErrorMacro("Failed to map the body received as a file descriptor.");
+              this->CloseSocket();
+              return total > 0 ? total : 0;
+              }
+            }
+          }
+        }
+      total += (int)n;
+      if (!readFully)
+        {
+        break;
+        }
+      }
+    return total;
+#else
+    (void)data;
+    (void)length;
+    (void)readFully;
+    return 0;
+#endif
+  }
+
+  int LocalSocket::Receive(void* data, int length, int readFully/*=1*/)
+  {
+    return this->ReceiveMessageData(static_cast<char*>(data), length, readFully);
+  }
+
+  int LocalSocket::Skip(int length, int /*skipFully=1*/)
+  {
+    // As Socket::Skip(), the data are skipped until 'length' bytes or the timeout, whatever skipFully.
+    return this->ReceiveMessageData(NULL, length, 1);
+  }
+
+  void LocalSocket::PrintSelf(std::ostream& os) const
+  {
+    this->Superclass::PrintSelf(os);
+  }
+
+} // namespace igtl
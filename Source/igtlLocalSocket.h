@@ -0,0 +1,152 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlLocalSocket_h
+#define __igtlLocalSocket_h
+
+#include <string>
+
+#include "igtlSocket.h"
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtl_header.h"
+#include "igtl_types.h"
+
+// Default size of the bodies passed as file descriptors (bytes)
+#define LocalSocketDefaultDescriptorPassingSize (1024 * 1024)
+
+namespace igtl
+{
+  /// The LocalSocket class connects two processes of the same host through a Unix domain
+  /// (AF_UNIX) stream socket bound to a path of the file system, rather than the TCP loopback.
+  /// It is used as any other socket, e.g. by SessionManager::Connect(Socket*).
+  ///
+  /// When descriptor passing is enabled on the sending side, the body of an IMAGE or VIDEO
+  /// message of at least GetDescriptorPassingSize() bytes is not written into the socket: it
+  /// is copied into a sealed memory file (memfd, Linux), whose descriptor is sent with the
+  /// header (SCM_RIGHTS). The receiving LocalSocket maps the file read-only and returns the
+  /// body from the mapping, as if it had been read from the socket. The large bodies are thus
+  /// never copied through the socket buffers, and the sender is not blocked by a slow receiver.
+  /// The receiving side needs no setting. Where memfd is not available, the bodies are sent
+  /// through the socket.
+  ///
+  /// Not available on Windows, where CreateServer() and ConnectToServer() fail.
+  ///
+  /// Typical use:
+  ///
+  ///   // Server
+  ///   serverSocket->CreateServer("/tmp/igtl-tracker.sock");
+  ///   igtl::LocalSocket::Pointer socket = serverSocket->WaitForConnection(10000);
+  ///   socket->SetDescriptorPassing(true);
+  ///
+  ///   // Client
+  ///   socket->ConnectToServer("/tmp/igtl-tracker.sock");
+  ///   sessionManager->Connect(socket);
+  class IGTLCommon_EXPORT LocalSocket: public Socket
+  {
+  public:
+    igtlTypeMacro(igtl::LocalSocket, igtl::Socket)
+    igtlNewMacro(igtl::LocalSocket);
+
+  public:
+    /// Creates a server socket bound to 'path'. A socket file left by a server that has
+    /// exited is replaced. Returns 0 on success, -1 on error (e.g. the path is used).
+    int CreateServer(const char* path);
+
+    /// Waits for a connection for msec milliseconds (0: no timeout) and returns the connected
+    /// socket, which inherits the descriptor passing settings of the server. Returns NULL on
+    /// timeout or error.
+    LocalSocket::Pointer WaitForConnection(unsigned long msec = 0);
+
+    /// Connects to the server socket bound to 'path'. Returns 0 on success, -1 on error.
+    int ConnectToServer(const char* path);
+
+    /// Closes the socket. A server socket removes its path.
+    virtual void CloseSocket();
+
+    /// Enables passing the large IMAGE and VIDEO bodies sent as file descriptors. Must be set
+    /// before sending the first message.
+    void SetDescriptorPassing(bool passing) { this->m_DescriptorPassing = passing; }
+    bool GetDescriptorPassing() { return this->m_DescriptorPassing; }
+
+    /// Sets the size of the smallest body passed as a file descriptor.
+    void SetDescriptorPassingSize(igtl_uint64 size) { this->m_DescriptorPassingSize = size; }
+    igtl_uint64 GetDescriptorPassingSize() { return this->m_DescriptorPassingSize; }
+
+    /// Same as Socket::Send(). With descriptor passing, the data must be whole messages, which
+    /// may be split across calls.
+    virtual int Send(const void* data, int length);
+    virtual int Send(const void* const* data, const int* length, int numberOfFragments);
+
+    /// Same as Socket::SendNonBlocking(), except that with descriptor passing the data are
+    /// sent as by Send(): the call returns 'length' once they are sent, or -1 on error.
+    virtual int SendNonBlocking(const void* data, int length);
+
+    virtual int Receive(void* data, int length, int readFully=1);
+    virtual int Skip(int length, int skipFully=1);
+
+  protected:
+    LocalSocket();
+    ~LocalSocket();
+
+    void PrintSelf(std::ostream& os) const;
+
+    /// Sends the data of messages, capturing the bodies to pass as file descriptors.
+    int SendMessageData(const char* data, int length);
+
+    /// Creates the memory file of a body of 'size' bytes and maps it for writing.
+    bool CreateBodyFile(igtl_uint64 size);
+
+    /// Sends the header held with the descriptor of the body file, which is then closed.
+    int SendBodyFile();
+
+    /// Maps read-only the body file received with the header. Returns false on error.
+    bool MapBodyFile(int fd, igtl_uint64 size);
+
+    /// Receives (or discards if data is NULL) the data of messages, returning the bodies
+    /// passed as file descriptors from their mappings. Same return values as Receive().
+    int ReceiveMessageData(char* data, int length, int readFully);
+
+    /// Releases the body files being sent and received.
+    void ReleaseBodyFiles();
+
+  private:
+    /// Path bound by a server socket, removed when it is closed
+    std::string   m_Path;
+
+    bool          m_DescriptorPassing;
+    igtl_uint64   m_DescriptorPassingSize;
+
+    /// Messages sent: header being sent, number of bytes of the body still to send,
+    /// and file of the body being captured (-1 if the body is sent through the socket)
+    igtl_uint8    m_SendHeader[IGTL_HEADER_SIZE];
+    int           m_SendHeaderSize;
+    igtl_uint64   m_SendBodyRemaining;
+    int           m_SendBodyFile;
+    char*         m_SendBody;
+    igtl_uint64   m_SendBodySize;
+
+    /// Messages received: header being received, number of bytes of the body still to
+    /// receive, descriptor received with the header, and mapping of the body received
+    igtl_uint8    m_ReceiveHeader[IGTL_HEADER_SIZE];
+    int           m_ReceiveHeaderSize;
+    igtl_uint64   m_ReceiveBodyRemaining;
+    int           m_ReceiveBodyFile;
+    const char*   m_ReceiveBody;
+    igtl_uint64   m_ReceiveBodySize;
+  };
+
+} // namespace igtl
+
+#endif // __igtlLocalSocket_h
@@ -14,17 +14,108 @@
 
 #include "igtlMessageBase.h"
 #include "igtlMessageFactory.h"
+#include "igtlThreadPool.h"
 #include "igtl_header.h"
 #include "igtl_util.h"
 
 #include <algorithm>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
 
 namespace
 {
   static const int META_DATA_INDEX_COUNT_SIZE = sizeof(igtlUint16);
+
+  // Chunks of a body whose CRC64 are computed by ComputeChunkCRCs(). The body may be made of
+  // several fragments, which the chunks span.
+  struct ChunkCRCData
+  {
+    const std::vector<const unsigned char*>* fragments;
+    const std::vector<igtlUint64>*           sizes;
+    igtlUint64                size;
+    igtlUint64                chunkSize;
+    std::vector<igtlUint64>*  crcs;
+  };
+
+  void ComputeChunkCRCs(int begin, int end, void* ptr)
+  {
+    ChunkCRCData* chunks = static_cast<ChunkCRCData*>(ptr);
+    const std::vector<const unsigned char*>& fragments = *chunks->fragments;
+    const std::vector<igtlUint64>& sizes = *chunks->sizes;
+
+    // Fragment holding the first chunk, and its offset in the body
+    igtlUint64 offset = (igtlUint64)begin * chunks->chunkSize;
+    size_t f = 0;
+    igtlUint64 fragmentOffset = 0;
+    while (f < sizes.size() && fragmentOffset + sizes[f] <= offset)
+      {
+      fragmentOffset += sizes[f];
+      f ++;
+      }
+
+    for (int i = begin; i < end; i ++)
+      {
+      igtlUint64 remaining = std::min(chunks->chunkSize, chunks->size - offset);
+      igtlUint64 crc = crc64(0, 0, 0LL);
+      while (remaining > 0)
+        {
+        igtlUint64 n = std::min(remaining, fragmentOffset + sizes[f] - offset);
+        crc = crc64((unsigned char*)fragments[f] + (offset - fragmentOffset), n, crc);
+        offset += n;
+        remaining -= n;
+        if (offset == fragmentOffset + sizes[f])
+          {
+          fragmentOffset += sizes[f];
+          f ++;
+          }
+        }
+      (*chunks->crcs)[i] = crc;
+      }
+  }
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+  // The chunk table is the chunk size and the CRC64 of the chunks in hexadecimal,
+  // e.g. "1048576:0123456789ABCDEF,...". Its size only depends on the number of chunks.
+  std::string FormatChunkTable(igtlUint64 chunkSize, const std::vector<igtlUint64>& crcs)
+  {
+    char buf[32];
+    sprintf(buf, "%llu:", (unsigned long long)chunkSize);
+    std::string table(buf);
+    for (size_t i = 0; i < crcs.size(); i ++)
+      {
+      sprintf(buf, i == 0 ? "%016llX" : ",%016llX", (unsigned long long)crcs[i]);
+      table += buf;
+      }
+    return table;
+  }
+
+  bool ParseChunkTable(const std::string& table, igtlUint64& chunkSize, std::vector<igtlUint64>& crcs)
+  {
+    const char* p = table.c_str();
+    char* end = NULL;
+    chunkSize = strtoull(p, &end, 10);
+    if (end == p || *end != ':' || chunkSize == 0)
+      {
+      return false;
+      }
+    crcs.clear();
+    p = end + 1;
+    while (*p != '\0')
+      {
+      igtlUint64 crc = strtoull(p, &end, 16);
+      if (end - p != 16 || (*end != ',' && *end != '\0'))
+        {
+        return false;
+        }
+      crcs.push_back(crc);
+      p = (*end == ',') ? end + 1 : end;
+      }
+    return !crcs.empty();
+  }
+#endif
 }
 
 namespace igtl
@@ -45,13 +136,18 @@ MessageBase::MessageBase()
     , m_TimeStampSecFraction(0)
     , m_IsHeaderUnpacked(false)
     , m_IsBodyUnpacked(false)
+    , m_IsMetaDataUnpacked(false)
     , m_IsBodyPacked(false)
+    , m_BodyCRC(0)
+    , m_IntegrityMode(INTEGRITY_CRC64)
+    , m_IntegrityChunkSize(MessageBaseDefaultIntegrityChunkSize)
+    , m_AcceptIntegrityNone(false)
 #if OpenIGTLink_HEADER_VERSION >= 2
     , m_ExtendedHeader(NULL)
     , m_IsExtendedHeaderUnpacked(false)
     , m_MetaData(NULL)
     , m_MessageId(0)
-    , m_MetaDataMap(MetaDataMap())
+    , m_IsMetaDataUnpackPending(false)
 #endif
 {
 }
@@ -81,6 +177,9 @@ int MessageBase::CalculateContentBufferSize()
 igtl::MessageBase::Pointer MessageBase::Clone()
 {
   igtl::MessageBase::Pointer clone;
+#if OpenIGTLink_HEADER_VERSION >= 2
+  UnpackPendingMetaData();
+#endif
     {
     igtl::MessageFactory::Pointer factory = igtl::MessageFactory::New();
     clone = factory->CreateSendMessage(this->GetMessageType(), this->GetHeaderVersion());
@@ -88,8 +187,10 @@ igtl::MessageBase::Pointer MessageBase::Clone()
 
     int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
     clone->InitBuffer();
-    clone->CopyHeader(this);
+    // The buffer is allocated before the header is copied, since the size of the message
+    // copied does not match the buffer of the clone.
     clone->AllocateBuffer(bodySize);
+    clone->CopyHeader(this);
     if (bodySize > 0)
       {
       clone->CopyBody(this);
@@ -97,7 +198,7 @@ igtl::MessageBase::Pointer MessageBase::Clone()
 
 #if OpenIGTLink_HEADER_VERSION >= 2
     clone->m_MetaDataHeader = this->m_MetaDataHeader;
-    clone->m_MetaDataMap = this->m_MetaDataMap;
+    clone->m_MetaDataStore = this->m_MetaDataStore;
     clone->m_IsExtendedHeaderUnpacked = this->m_IsExtendedHeaderUnpacked;
 #endif
 
@@ -173,15 +274,10 @@ std::string MessageBase::GetMessageType() const
 #if OpenIGTLink_HEADER_VERSION >= 2
 igtlUint32 MessageBase::GetMetaDataSize()
 {
+  UnpackPendingMetaData();
   if( m_HeaderVersion >= IGTL_HEADER_VERSION_2 )
     {
-    igtlUint32 metaDataSize(0);
-    for (MetaDataMap::const_iterator it = m_MetaDataMap.begin(); it != m_MetaDataMap.end(); ++it)
-      {
-      metaDataSize += it->first.length() + it->second.second.length();
-      }
-
-    return metaDataSize;
+    return m_MetaDataStore.GetDataSize();
     }
   else
     {
@@ -191,9 +287,10 @@ igtlUint32 MessageBase::GetMetaDataSize()
 
 igtlUint16 MessageBase::GetMetaDataHeaderSize()
 {
+  UnpackPendingMetaData();
   if( m_HeaderVersion >= IGTL_HEADER_VERSION_2 )
     {
-    return (m_MetaDataMap.size()*sizeof(igtl_metadata_header_entry)) + sizeof(igtlUint16); // index_count is at beginning of header
+    return m_MetaDataStore.GetHeaderSize(); // index_count is at beginning of header
     }
   else
     {
@@ -214,90 +311,97 @@ void MessageBase::SetMessageID(igtlUint32 idValue)
 
 bool MessageBase::SetMetaDataElement(const std::string& key, IANA_ENCODING_TYPE encodingScheme, std::string value)
 {
-  igtl_metadata_header_entry entry;
-  if (key.length() > std::numeric_limits<igtl_uint16>::max())
+  UnpackPendingMetaData();
+  igtlUint32 revision = m_MetaDataStore.GetRevision();
+  if (!m_MetaDataStore.SetElement(key, encodingScheme, value))
     {
     return false;
     }
-  entry.key_size = static_cast<igtl_uint16>(key.length());
-  entry.value_encoding = static_cast<igtlUint16>(encodingScheme);
-  entry.value_size = value.length();
-
-  m_MetaDataMap[key] = std::pair<IANA_ENCODING_TYPE, std::string>(encodingScheme, value);
-
-  m_IsBodyPacked = false;
-
+  if (m_MetaDataStore.GetRevision() != revision)
+    {
+    m_IsBodyPacked = false;
+    }
   return true;
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_uint8 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_uint64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_int8 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_int64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_uint16 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_uint64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_int16 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_int64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_uint32 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_uint64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_int32 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<igtl_int64>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_uint64 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  UnpackPendingMetaData();
+  igtlUint32 revision = m_MetaDataStore.GetRevision();
+  if (!m_MetaDataStore.SetUnsignedIntegerElement(key, value))
+    {
+    return false;
+    }
+  if (m_MetaDataStore.GetRevision() != revision)
+    {
+    m_IsBodyPacked = false;
+    }
+  return true;
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, igtl_int64 value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  UnpackPendingMetaData();
+  igtlUint32 revision = m_MetaDataStore.GetRevision();
+  if (!m_MetaDataStore.SetIntegerElement(key, value))
+    {
+    return false;
+    }
+  if (m_MetaDataStore.GetRevision() != revision)
+    {
+    m_IsBodyPacked = false;
+    }
+  return true;
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, float value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  return SetMetaDataElement(key, static_cast<double>(value));
 }
 
 bool MessageBase::SetMetaDataElement(const std::string& key, double value)
 {
-  std::stringstream ss;
-  ss << value;
-  return SetMetaDataElement(key, IANA_TYPE_US_ASCII, ss.str());
+  UnpackPendingMetaData();
+  igtlUint32 revision = m_MetaDataStore.GetRevision();
+  if (!m_MetaDataStore.SetRealElement(key, value))
+    {
+    return false;
+    }
+  if (m_MetaDataStore.GetRevision() != revision)
+    {
+    m_IsBodyPacked = false;
+    }
+  return true;
 }
 
 bool MessageBase::GetMetaDataElement(const std::string& key, std::string& value) const
@@ -308,19 +412,53 @@ bool MessageBase::GetMetaDataElement(const std::string& key, std::string& value)
 
 bool MessageBase::GetMetaDataElement(const std::string& key, IANA_ENCODING_TYPE& encoding, std::string& value) const
 {
-  if (m_MetaDataMap.find(key) != m_MetaDataMap.end())
+  const_cast<MessageBase*>(this)->UnpackPendingMetaData();
+  return m_MetaDataStore.GetElement(key, encoding, value);
+}
+
+bool MessageBase::GetMetaDataElement(const std::string& key, igtl_uint64& value) const
+{
+  const_cast<MessageBase*>(this)->UnpackPendingMetaData();
+  return m_MetaDataStore.GetUnsignedIntegerElement(key, value);
+}
+
+bool MessageBase::GetMetaDataElement(const std::string& key, igtl_int64& value) const
+{
+  const_cast<MessageBase*>(this)->UnpackPendingMetaData();
+  return m_MetaDataStore.GetIntegerElement(key, value);
+}
+
+bool MessageBase::GetMetaDataElement(const std::string& key, double& value) const
+{
+  const_cast<MessageBase*>(this)->UnpackPendingMetaData();
+  return m_MetaDataStore.GetRealElement(key, value);
+}
+
+bool MessageBase::RemoveMetaDataElement(const std::string& key)
+{
+  UnpackPendingMetaData();
+  if (!m_MetaDataStore.RemoveElement(key))
     {
-    encoding = m_MetaDataMap.find(key)->second.first;
-    value = m_MetaDataMap.find(key)->second.second;
-    return true;
+    return false;
     }
+  m_IsBodyPacked = false;
+  return true;
+}
 
-  return false;
+void MessageBase::ClearMetaData()
+{
+  if (m_MetaDataStore.GetNumberOfElements() > 0 || m_IsMetaDataUnpackPending)
+    {
+    m_IsMetaDataUnpackPending = false;
+    m_MetaDataStore.Clear();
+    m_IsBodyPacked = false;
+    }
 }
 
 const MessageBase::MetaDataMap& MessageBase::GetMetaData() const
 {
-  return this->m_MetaDataMap;
+  const_cast<MessageBase*>(this)->UnpackPendingMetaData();
+  return this->m_MetaDataStore.GetMap();
 }
 
 bool MessageBase::PackExtendedHeader()
@@ -351,62 +489,11 @@ bool MessageBase::PackMetaData()
 {
   if( m_HeaderVersion == IGTL_HEADER_VERSION_2 )
     {
-    if (m_MetaDataMap.size() > std::numeric_limits<igtl_uint16>::max())
-      {
-      return false;
-      }
-    igtl_uint16 index_count = static_cast<igtl_uint16>(m_MetaDataMap.size()); // first two byte are the total number of meta data
-    if(igtl_is_little_endian())
-      {
-      index_count = BYTE_SWAP_INT16(index_count);
-      }
-
-    // Pack meta data header key/encoding/value trios
-    memcpy(m_MetaDataHeader, &index_count, META_DATA_INDEX_COUNT_SIZE);
-
-    if (m_MetaDataMap.size() > 0)
-      {
-      unsigned char* entryPointer = &m_MetaDataHeader[META_DATA_INDEX_COUNT_SIZE];
-      for (MetaDataMap::const_iterator it = m_MetaDataMap.begin(); it != m_MetaDataMap.end();++it)
-        {
-        igtl_metadata_header_entry entry;
-        entry.key_size = it->first.length();
-        entry.value_encoding = it->second.first;
-        entry.value_size = it->second.second.length();
-
-        if(igtl_is_little_endian())
-          {
-          entry.key_size = BYTE_SWAP_INT16(entry.key_size);
-          entry.value_encoding = BYTE_SWAP_INT16(entry.value_encoding);
-          entry.value_size = BYTE_SWAP_INT32(entry.value_size);
-          }
-        memcpy(&entryPointer[0], &entry.key_size, sizeof(igtlUint16));
-        memcpy(&entryPointer[2], &entry.value_encoding, sizeof(igtlUint16));
-        memcpy(&entryPointer[4], &entry.value_size, sizeof(igtlUint32));
-
-        entryPointer += sizeof(igtl_metadata_header_entry);
-        }
-
-      // Pack meta data key/value pairs
-      std::string key("");
-      std::string value("");
-
-      unsigned char* metaDataPointer = m_MetaData;
-      int i(0);
-      for (MetaDataMap::iterator it = m_MetaDataMap.begin(); it != m_MetaDataMap.end(); ++it, ++i)
-        {
-        memcpy(metaDataPointer, it->first.c_str(), it->first.length());
-        metaDataPointer += it->first.length();
-        memcpy(metaDataPointer, it->second.second.c_str(), it->second.second.length());
-        metaDataPointer += it->second.second.length();
-        }
-
-      return true;
-      }
-    else
-      {
-      return true;
-      }
+    // Copies the serialized meta data cached by the store, they are only
+    // serialized again if an element has been changed.
+    UnpackPendingMetaData();
+    m_MetaDataStore.Pack(m_MetaDataHeader, m_MetaData);
+    return true;
     }
 
   return false;
@@ -439,60 +526,32 @@ bool MessageBase::UnpackExtendedHeader()
 
 bool MessageBase::UnpackMetaData()
 {
+  m_IsMetaDataUnpackPending = false;
   if (m_HeaderVersion == IGTL_HEADER_VERSION_2)
     {
-    // Parse the header
-    igtl_uint16 index_count = 0; // first two byte are the total number of meta data
-    memcpy(&index_count, m_MetaDataHeader, META_DATA_INDEX_COUNT_SIZE);
-    if(igtl_is_little_endian())
-      {
-      index_count = BYTE_SWAP_INT16(index_count);
-      }
-
-    if( index_count == 0 )
-      {
-      return true;
-      }
-
-    std::vector<igtl_metadata_header_entry> metaDataEntries;
-    igtl_metadata_header_entry entry;
-    unsigned char* entryPointer = &m_MetaDataHeader[META_DATA_INDEX_COUNT_SIZE];
-    for (int i = 0; i < index_count; i++)
-      {
-      memcpy(&entry.key_size, &entryPointer[0], sizeof(igtlUint16));
-      memcpy(&entry.value_encoding, &entryPointer[2], sizeof(igtlUint16));
-      memcpy(&entry.value_size, &entryPointer[4], sizeof(igtlUint32));
-      if(igtl_is_little_endian())
-        {
-        entry.key_size = BYTE_SWAP_INT16(entry.key_size);
-        entry.value_encoding = BYTE_SWAP_INT16(entry.value_encoding);
-        entry.value_size = BYTE_SWAP_INT32(entry.value_size);
-        }
-      metaDataEntries.push_back(entry);
-
-      entryPointer += sizeof(igtl_metadata_header_entry);
-      }
-
-    // Parse the meta data
-    m_MetaDataMap.clear();
-
-    unsigned char* metaDataPointer = m_MetaData;
-    for (int i = 0; i < index_count; i++)
+    igtl_extended_header* extended_header = (igtl_extended_header*)m_ExtendedHeader;
+    if (static_cast<igtlUint64>(extended_header->extended_header_size) + extended_header->meta_data_header_size
+        + extended_header->meta_data_size > static_cast<igtlUint64>(GetBufferBodySize()))
       {
-      std::string key;
-      key.assign(metaDataPointer, metaDataPointer + metaDataEntries[i].key_size);
-      metaDataPointer += metaDataEntries[i].key_size;
-      std::string value;
-      value.assign(metaDataPointer, metaDataPointer + metaDataEntries[i].value_size);
-      metaDataPointer += metaDataEntries[i].value_size;
-      m_MetaDataMap[key] = std::pair<IANA_ENCODING_TYPE, std::string>((IANA_ENCODING_TYPE)metaDataEntries[i].value_encoding, value);
+      m_MetaDataStore.Clear();
+      return false;
       }
-
-    return true;
+    return m_MetaDataStore.Unpack(m_MetaDataHeader, extended_header->meta_data_header_size,
+                                  m_MetaData, extended_header->meta_data_size);
     }
 
   return false;
 }
+
+void MessageBase::UnpackPendingMetaData()
+{
+  m_MetaDataUnpackLock.Lock();
+  if (m_IsMetaDataUnpackPending)
+    {
+    UnpackMetaData();
+    }
+  m_MetaDataUnpackLock.Unlock();
+}
 #endif
 
 
@@ -523,11 +582,34 @@ void MessageBase::GetTimeStamp(igtl::TimeStamp::Pointer& ts)
 }
 
 
+void MessageBase::SetIntegrityMode(int mode)
+{
+  if (mode != m_IntegrityMode)
+    {
+    m_IntegrityMode = mode;
+    m_IsBodyPacked = false;
+    }
+}
+
+void MessageBase::SetIntegrityChunkSize(int size)
+{
+  if (size > 0 && size != m_IntegrityChunkSize)
+    {
+    m_IntegrityChunkSize = size;
+    if (m_IntegrityMode == INTEGRITY_CHUNKED)
+      {
+      m_IsBodyPacked = false;
+      }
+    }
+}
+
 int MessageBase::Pack()
 {
   if (m_IsBodyPacked)
     {
-    // Allow for multiple packs
+    // The body has not changed: only the header (e.g. the time stamp) is packed again,
+    // with the CRC of the body computed before.
+    PackHeader();
     return 1;
     }
 
@@ -538,41 +620,251 @@ int MessageBase::Pack()
     return 0;
     }
 
+  // A received message is packed as a new one: its buffer is allocated for its content
+  // and meta data, rather than for the body received.
+  m_BodySizeToRead = 0;
+
 #if OpenIGTLink_HEADER_VERSION >= 2
+  PackIntegrityMetaData();
   PackExtendedHeader();
 #endif
 
   // Derived classes will re-call allocate pack with their required content size
   PackContent();
 
+  // The body is in one piece; with header version 2, the meta data are in the last fragment.
+  std::vector<const unsigned char*> fragments(1, m_Body);
+  std::vector<igtlUint64> sizes(1, GetBufferBodySize());
 #if OpenIGTLink_HEADER_VERSION >= 2
-  PackMetaData();
+  if (m_HeaderVersion == IGTL_HEADER_VERSION_2)
+    {
+    sizes[0] = m_MetaDataHeader - m_Body;
+    fragments.push_back(m_MetaDataHeader);
+    sizes.push_back(GetBufferBodySize() - sizes[0]);
+    }
 #endif
+  PackMetaDataAndBodyCRC(fragments, sizes);
 
   m_IsBodyPacked = true;
 
-  // pack header
+  PackHeader();
+
+  return 1;
+}
+
+void MessageBase::PackMetaDataAndBodyCRC(const std::vector<const unsigned char*>& fragments,
+                                         const std::vector<igtlUint64>& sizes)
+{
+#if OpenIGTLink_HEADER_VERSION >= 2
+  if (m_IntegrityMode == INTEGRITY_CHUNKED && m_HeaderVersion == IGTL_HEADER_VERSION_2)
+    {
+    // The chunks cover the extended header and the content; the chunk table is
+    // written in the meta data, whose CRC is combined with the CRC of the chunks.
+    std::vector<const unsigned char*> chunkedFragments(fragments.begin(), fragments.end() - 1);
+    std::vector<igtlUint64> chunkedSizes(sizes.begin(), sizes.end() - 1);
+    std::vector<igtlUint64> crcs;
+    igtlUint64 crc = ComputeChunkedCRC(chunkedFragments, chunkedSizes, m_IntegrityChunkSize, &crcs);
+    SetMetaDataElement(IGTL_INTEGRITY_CHUNKS, IANA_TYPE_US_ASCII, FormatChunkTable(m_IntegrityChunkSize, crcs));
+    PackMetaData();
+    igtlUint64 metaDataSize = sizes.back();
+    m_BodyCRC = crc64_combine(crc, crc64((unsigned char*)fragments.back(), metaDataSize, crc64(0, 0, 0LL)),
+                              metaDataSize);
+    return;
+    }
+  PackMetaData();
+#endif
+
+  if (m_IntegrityMode == INTEGRITY_NONE)
+    {
+    m_BodyCRC = 0;
+    }
+  else if (m_IntegrityMode == INTEGRITY_CHUNKED)
+    {
+    m_BodyCRC = ComputeChunkedCRC(fragments, sizes, m_IntegrityChunkSize, NULL);
+    }
+  else
+    {
+    m_BodyCRC = crc64(0, 0, 0LL);
+    for (size_t i = 0; i < fragments.size(); i ++)
+      {
+      m_BodyCRC = crc64((unsigned char*)fragments[i], sizes[i], m_BodyCRC);
+      }
+    }
+}
+
+void MessageBase::PackHeader()
+{
+  PackHeader(GetBufferBodySize());
+}
+
+void MessageBase::PackHeader(igtlUint64 bodySize)
+{
   igtl_header* h = (igtl_header*) m_Header;
 
-  igtl_uint64 crc = crc64(0, 0, 0LL); // initial crc
   h->header_version   = m_HeaderVersion;
 
   igtl_uint64 ts  =  m_TimeStampSec & 0xFFFFFFFF;
   ts = (ts << 32) | (m_TimeStampSecFraction & 0xFFFFFFFF);
 
   h->timestamp = ts;
-  h->body_size = GetBufferBodySize();
-  h->crc       = crc64((unsigned char*)m_Body, h->body_size, crc);
+  h->body_size = bodySize;
+  h->crc       = m_BodyCRC;
 
   strncpy(h->name, m_SendMessageType.c_str(), 12);
 
   strncpy(h->device_name, m_DeviceName.c_str(), 20);
 
   igtl_header_convert_byte_order(h);
+}
 
-  return 1;
+igtlUint64 MessageBase::ComputeChunkedCRC(const unsigned char* data, igtlUint64 size, int chunkSize,
+                                          std::vector<igtlUint64>* chunkCRCs)
+{
+  return ComputeChunkedCRC(std::vector<const unsigned char*>(1, data), std::vector<igtlUint64>(1, size),
+                           chunkSize, chunkCRCs);
 }
 
+igtlUint64 MessageBase::ComputeChunkedCRC(const std::vector<const unsigned char*>& fragments,
+                                          const std::vector<igtlUint64>& sizes, int chunkSize,
+                                          std::vector<igtlUint64>* chunkCRCs)
+{
+  std::vector<igtlUint64> crcs;
+  std::vector<igtlUint64>& chunks = chunkCRCs ? *chunkCRCs : crcs;
+
+  igtlUint64 size = 0;
+  for (size_t i = 0; i < sizes.size(); i ++)
+    {
+    size += sizes[i];
+    }
+
+  ChunkCRCData chunkData;
+  chunkData.fragments = &fragments;
+  chunkData.sizes     = &sizes;
+  chunkData.size      = size;
+  chunkData.chunkSize = chunkSize;
+  chunkData.crcs      = &chunks;
+
+  int nChunks = size == 0 ? 0 : (int)((size - 1) / chunkSize + 1);
+  chunks.resize(nChunks);
+  if (nChunks > 1)
+    {
+    ThreadPool::GetGlobalThreadPool()->ParallelFor(0, nChunks, 1, ComputeChunkCRCs, &chunkData);
+    }
+  else
+    {
+    ComputeChunkCRCs(0, nChunks, &chunkData);
+    }
+
+  igtlUint64 crc = crc64(0, 0, 0LL);
+  for (int i = 0; i < nChunks; i ++)
+    {
+    igtlUint64 offset = (igtlUint64)i * chunkSize;
+    crc = crc64_combine(crc, chunks[i], std::min((igtlUint64)chunkSize, size - offset));
+    }
+  return crc;
+}
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+void MessageBase::PackIntegrityMetaData()
+{
+  if (m_HeaderVersion != IGTL_HEADER_VERSION_2)
+    {
+    return;
+    }
+
+  if (m_IntegrityMode == INTEGRITY_NONE)
+    {
+    SetMetaDataElement(IGTL_INTEGRITY, IANA_TYPE_US_ASCII, IGTL_INTEGRITY_NONE);
+    }
+  else
+    {
+    RemoveMetaDataElement(IGTL_INTEGRITY);
+    }
+
+  if (m_IntegrityMode == INTEGRITY_CHUNKED)
+    {
+    // The table of the chunks of the extended header and the content is set with
+    // null CRCs to allocate the meta data; it has the same size once filled.
+    igtlUint64 chunkedSize = sizeof(igtl_extended_header) + CalculateContentBufferSize();
+    std::vector<igtlUint64> crcs((size_t)((chunkedSize - 1) / m_IntegrityChunkSize + 1), 0);
+    SetMetaDataElement(IGTL_INTEGRITY_CHUNKS, IANA_TYPE_US_ASCII, FormatChunkTable(m_IntegrityChunkSize, crcs));
+    }
+  else
+    {
+    RemoveMetaDataElement(IGTL_INTEGRITY_CHUNKS);
+    }
+}
+
+bool MessageBase::PeekMetaData(MetaDataStore& store)
+{
+  int bodySize = m_BodySizeToRead;
+  if (m_HeaderVersion != IGTL_HEADER_VERSION_2 || m_Body == NULL ||
+      bodySize < static_cast<int>(sizeof(igtl_extended_header)) ||
+      m_MessageSize < IGTL_HEADER_SIZE + bodySize)
+    {
+    return false;
+    }
+
+  // The extended header is still in the network byte order
+  igtl_extended_header extendedHeader;
+  memcpy(&extendedHeader, m_Body, sizeof(igtl_extended_header));
+  igtl_extended_header_convert_byte_order(&extendedHeader);
+  igtlUint64 metaDataSize = (igtlUint64)extendedHeader.meta_data_header_size + extendedHeader.meta_data_size;
+  if (extendedHeader.extended_header_size != sizeof(igtl_extended_header) ||
+      metaDataSize + sizeof(igtl_extended_header) > (igtlUint64)bodySize)
+    {
+    return false;
+    }
+
+  const unsigned char* metaDataHeader = &m_Body[bodySize - metaDataSize];
+  return store.Unpack(metaDataHeader, extendedHeader.meta_data_header_size,
+                      metaDataHeader + extendedHeader.meta_data_header_size, extendedHeader.meta_data_size);
+}
+
+int MessageBase::CheckIntegrityChunks(std::vector<int>& corrupted)
+{
+  corrupted.clear();
+
+  MetaDataStore store;
+  IANA_ENCODING_TYPE encoding;
+  std::string table;
+  if (m_IsBodyUnpacked || m_IsMetaDataUnpacked || !PeekMetaData(store) ||
+      !store.GetElement(IGTL_INTEGRITY_CHUNKS, encoding, table))
+    {
+    return -1;
+    }
+
+  igtlUint64 chunkSize;
+  std::vector<igtlUint64> crcs;
+  if (!ParseChunkTable(table, chunkSize, crcs))
+    {
+    return -1;
+    }
+
+  // The chunks cover the body except the meta data header and the meta data.
+  igtl_extended_header extendedHeader;
+  memcpy(&extendedHeader, m_Body, sizeof(igtl_extended_header));
+  igtl_extended_header_convert_byte_order(&extendedHeader);
+  igtlUint64 chunkedSize = (igtlUint64)m_BodySizeToRead - extendedHeader.meta_data_header_size - extendedHeader.meta_data_size;
+  if ((chunkedSize + chunkSize - 1) / chunkSize != crcs.size())
+    {
+    return -1;
+    }
+
+  std::vector<igtlUint64> received;
+  ComputeChunkedCRC(m_Body, chunkedSize, (int)chunkSize, &received);
+  for (size_t i = 0; i < crcs.size(); i ++)
+    {
+    if (received[i] != crcs[i])
+      {
+      corrupted.push_back((int)i);
+      }
+    }
+
+  return (int)crcs.size();
+}
+#endif
+
 int MessageBase::Unpack(int crccheck)
 {
   int r = UNPACK_UNDEF;
@@ -609,6 +901,31 @@ int MessageBase::Unpack(int crccheck)
   return r;
 }
 
+int MessageBase::UnpackHeaderAndMetaData(int crccheck)
+{
+  int r = UNPACK_UNDEF;
+
+  if (m_Header != NULL && m_MessageSize >= IGTL_HEADER_SIZE && !m_IsHeaderUnpacked )
+    {
+    InitBuffer();
+    UnpackHeader(r);
+    }
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+  if( m_HeaderVersion >= IGTL_HEADER_VERSION_2 &&
+      GetBufferBodySize() > static_cast<int>(sizeof(igtl_extended_header)) + META_DATA_INDEX_COUNT_SIZE &&
+      !m_IsBodyUnpacked && !m_IsMetaDataUnpacked && CheckBodyCRC(crccheck) )
+    {
+    // The meta data are parsed on the first access.
+    m_IsMetaDataUnpackPending = UnpackExtendedHeader();
+    m_IsMetaDataUnpacked = true;
+    r |= UNPACK_META_DATA;
+    }
+#endif
+
+  return r;
+}
+
 void* MessageBase::GetBufferPointer()
 {
   return (void*) m_Header;
@@ -681,9 +998,19 @@ void MessageBase::AllocateBuffer()
 
 void MessageBase::InitBuffer()
 {
+#if OpenIGTLink_HEADER_VERSION >= 2
+  // The buffer is reset for a new message, the meta data of the previous one are dropped.
+  if (m_IsMetaDataUnpackPending)
+    {
+    m_IsMetaDataUnpackPending = false;
+    m_MetaDataStore.Clear();
+    }
+#endif
+
   m_IsHeaderUnpacked = false;
   m_IsBodyPacked     = false;
   m_IsBodyUnpacked   = false;
+  m_IsMetaDataUnpacked = false;
   m_BodySizeToRead   = 0;
 
   m_DeviceName       = "";
@@ -708,6 +1035,7 @@ void MessageBase::InitBuffer()
     memcpy(m_Header, old, std::min<int>(m_MessageSize, message_size));
     delete [] old;
     m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = false;
     }
   m_Body   = &m_Header[IGTL_HEADER_SIZE];
 #if OpenIGTLink_HEADER_VERSION >= 2
@@ -748,6 +1076,7 @@ void MessageBase::AllocateBuffer(int contentSize)
     m_Header = new unsigned char [message_size];
     m_IsHeaderUnpacked = false;
     m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = false;
     m_IsBodyPacked = false;
     }
   else if (m_MessageSize != message_size)
@@ -759,6 +1088,7 @@ void MessageBase::AllocateBuffer(int contentSize)
     memcpy(m_Header, old, std::min<int>(m_MessageSize, message_size));
     delete [] old;
     m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = false;
     }
   m_Body   = &m_Header[IGTL_HEADER_SIZE];
 
@@ -799,7 +1129,12 @@ int MessageBase::CopyHeader(const MessageBase* mb)
   m_TimeStampSecFraction = mb->m_TimeStampSecFraction;
   m_IsHeaderUnpacked     = mb->m_IsHeaderUnpacked;
   m_IsBodyUnpacked       = mb->m_IsBodyUnpacked;
+  m_IsMetaDataUnpacked   = mb->m_IsMetaDataUnpacked;
   m_IsBodyPacked         = mb->m_IsBodyPacked;
+  m_BodyCRC              = mb->m_BodyCRC;
+  m_IntegrityMode        = mb->m_IntegrityMode;
+  m_IntegrityChunkSize   = mb->m_IntegrityChunkSize;
+  m_AcceptIntegrityNone  = mb->m_AcceptIntegrityNone;
   m_BodySizeToRead       = mb->m_BodySizeToRead;
   m_HeaderVersion        = mb->m_HeaderVersion;
 
@@ -825,6 +1160,7 @@ int MessageBase::CopyBody(const MessageBase *mb)
       m_Content = &m_Body[other_ext_header->extended_header_size];
       m_MetaDataHeader = &m_Body[bodySize - other_ext_header->meta_data_header_size - other_ext_header->meta_data_size];
       m_MetaData = &m_Body[bodySize - other_ext_header->meta_data_size];
+      m_IsMetaDataUnpackPending = mb->m_IsMetaDataUnpackPending;
       }
     else
       {
@@ -871,42 +1207,65 @@ void MessageBase::UnpackHeader(int& r)
   r |= UNPACK_HEADER;
 }
 
-void MessageBase::UnpackBody(int crccheck, int& r)
+bool MessageBase::CheckBodyCRC(int crccheck)
 {
-  igtl_header* h   = (igtl_header*) m_Header;
-  igtl_uint64  crc = crc64(0, 0, 0LL); // initial crc
-
-  if (crccheck)
+  if (!crccheck)
     {
-    // Calculate CRC of the body
-    crc = crc64((unsigned char*)m_Body, m_BodySizeToRead, crc);
+    return true;
     }
-  else
+
+  igtl_header* h   = (igtl_header*) m_Header;
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+  // Messages packed with INTEGRITY_NONE have no CRC, and are marked in the meta data. The
+  // marking is only trusted if the receiver has chosen to accept them.
+  MetaDataStore store;
+  IANA_ENCODING_TYPE encoding;
+  std::string integrity;
+  if (m_AcceptIntegrityNone && h->crc == 0 && PeekMetaData(store) &&
+      store.GetElement(IGTL_INTEGRITY, encoding, integrity) && integrity == IGTL_INTEGRITY_NONE)
     {
-    crc = h->crc;
+    return true;
     }
+#endif
 
-  if (crc == h->crc)
+  // Calculate CRC of the body
+  igtl_uint64  crc = crc64(0, 0, 0LL); // initial crc
+  crc = crc64((unsigned char*)m_Body, m_BodySizeToRead, crc);
+  return crc == h->crc;
+}
+
+void MessageBase::UnpackBody(int crccheck, int& r)
+{
+  // If the meta data have been unpacked by UnpackHeaderAndMetaData(), the CRC
+  // has been checked and only the content remains.
+  if (!m_IsMetaDataUnpacked)
     {
-    // Unpack (deserialize) the Body
-#if OpenIGTLink_HEADER_VERSION >= 2
-    UnpackExtendedHeader();
-#endif
-    UnpackContent();
+    if (!CheckBodyCRC(crccheck))
+      {
+      m_IsBodyUnpacked = false;
+      return;
+      }
 #if OpenIGTLink_HEADER_VERSION >= 2
-    UnpackMetaData();
+    // The meta data are parsed on the first access.
+    m_IsMetaDataUnpackPending = UnpackExtendedHeader();
 #endif
-    m_IsBodyUnpacked = true;
-    r |= UNPACK_BODY;
-    }
-  else
-    {
-    m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = true;
     }
+
+  // Unpack (deserialize) the content
+  UnpackContent();
+  m_IsBodyUnpacked = true;
+  r |= UNPACK_BODY;
 }
 
 void MessageBase::AllocateUnpack(int bodySizeToRead)
 {
+#if OpenIGTLink_HEADER_VERSION >= 2
+  // The meta data left in the buffer are parsed before it is reallocated.
+  UnpackPendingMetaData();
+#endif
+
   if (bodySizeToRead <= 0)
     {
     bodySizeToRead = 0;
@@ -921,6 +1280,7 @@ void MessageBase::AllocateUnpack(int bodySizeToRead)
     m_Header = new unsigned char [message_size];
     m_IsHeaderUnpacked = false;
     m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = false;
     m_IsBodyPacked = false;
     }
   else if (m_MessageSize != message_size)
@@ -932,6 +1292,7 @@ void MessageBase::AllocateUnpack(int bodySizeToRead)
     memcpy(m_Header, old, std::min<int>(m_MessageSize, message_size));
     delete [] old;
     m_IsBodyUnpacked = false;
+    m_IsMetaDataUnpacked = false;
     }
   m_Body   = &m_Header[IGTL_HEADER_SIZE];
 
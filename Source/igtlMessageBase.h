@@ -18,6 +18,8 @@
 #include "igtlMacro.h"
 #include "igtlMath.h"
 #include "igtlMessageHeader.h"
+#include "igtlMetaDataStore.h"
+#include "igtlMutexLock.h"
 #include "igtlObject.h"
 #include "igtlObjectFactory.h"
 #include "igtlTimeStamp.h"
@@ -28,6 +30,16 @@
 #include <map>
 #include <vector>
 
+/// Default size of the chunks of the body with MessageBase::INTEGRITY_CHUNKED
+#define MessageBaseDefaultIntegrityChunkSize 1048576
+
+/// Meta data elements set by MessageBase::Pack() for the integrity modes
+#define IGTL_INTEGRITY                  "Integrity"
+#define IGTL_INTEGRITY_CHUNKS           "IntegrityChunks"
+
+/// Value of the IGTL_INTEGRITY meta data element of the messages without CRC
+#define IGTL_INTEGRITY_NONE             "none"
+
 namespace igtl
 {
 
@@ -81,7 +93,7 @@ namespace igtl
 
 #if OpenIGTLink_HEADER_VERSION >= 2
     // Types for managing meta data
-    typedef std::map<std::string, std::pair<IANA_ENCODING_TYPE, std::string> > MetaDataMap;
+    typedef MetaDataStore::MetaDataMap MetaDataMap;
 #endif
 
     igtlTypeMacro(MessageBase, Object)
@@ -92,7 +104,16 @@ namespace igtl
     {
       UNPACK_UNDEF   = 0x0000,
       UNPACK_HEADER  = 0x0001,
-      UNPACK_BODY    = 0x0002
+      UNPACK_BODY    = 0x0002,
+      UNPACK_META_DATA = 0x0004
+    };
+
+    /// Integrity modes of the body. They are set by SetIntegrityMode().
+    enum
+    {
+      INTEGRITY_CRC64   = 0,
+      INTEGRITY_CHUNKED = 1,
+      INTEGRITY_NONE    = 2
     };
 
   public:
@@ -138,7 +159,8 @@ namespace igtl
     /// Sets the message ID
     void SetMessageID(igtlUint32 idValue);
 
-    /// Add Meta data element
+    /// Add Meta data element. The numeric values are formatted as US-ASCII text. Setting an element
+    /// to its current value does not require the message to be packed again.
     bool SetMetaDataElement(const std::string& key, IANA_ENCODING_TYPE encodingScheme, std::string value);
     bool SetMetaDataElement(const std::string& key, igtl_uint8);
     bool SetMetaDataElement(const std::string& key, igtl_int8);
@@ -151,10 +173,23 @@ namespace igtl
     bool SetMetaDataElement(const std::string& key, float);
     bool SetMetaDataElement(const std::string& key, double);
 
-    /// Get meta data element
+    /// Get meta data element. The const getters may be called from several threads at once:
+    /// the meta data of a received message are parsed once, by the first of them.
     bool GetMetaDataElement(const std::string& key, std::string& value) const;
     bool GetMetaDataElement(const std::string& key, IANA_ENCODING_TYPE& encoding, std::string& value) const;
 
+    /// Get meta data element as a number. The elements set as numbers are returned without parsing.
+    /// Returns false if the element does not exist or is not a number in the range of the type.
+    bool GetMetaDataElement(const std::string& key, igtl_uint64& value) const;
+    bool GetMetaDataElement(const std::string& key, igtl_int64& value) const;
+    bool GetMetaDataElement(const std::string& key, double& value) const;
+
+    /// Remove meta data element. Returns false if the element does not exist.
+    bool RemoveMetaDataElement(const std::string& key);
+
+    /// Remove all the meta data elements.
+    void ClearMetaData();
+
     /// Get meta data map
     const MetaDataMap& GetMetaData() const;
 
@@ -189,6 +224,35 @@ namespace igtl
     /// PackContent() must be implemented in the child class.
     virtual int Pack();
 
+    /// Sets how Pack() protects the body:
+    ///
+    ///   INTEGRITY_CRC64   : The CRC64 of the body is in the header (default).
+    ///   INTEGRITY_CHUNKED : The CRC64 of the body is in the header, computed from the CRC64
+    ///                       of chunks of the body (SetIntegrityChunkSize()) computed in
+    ///                       parallel. Messages with header version 2 carry the CRC64 of the
+    ///                       chunks in the IGTL_INTEGRITY_CHUNKS meta data element, to locate
+    ///                       corrupted chunks with CheckIntegrityChunks().
+    ///   INTEGRITY_NONE    : No CRC is computed and the CRC in the header is 0, e.g. for loopback
+    ///                       or local links. Messages with header version 2 are marked by the
+    ///                       IGTL_INTEGRITY meta data element, and are accepted by Unpack()
+    ///                       with crccheck = 1 by the receivers that SetAcceptIntegrityNone().
+    ///                       Other receivers must not check the CRC.
+    ///
+    /// In all the modes, the CRC is only computed when the body changes: packing again a
+    /// message whose body has not changed (e.g. with a new time stamp) only packs the header.
+    void SetIntegrityMode(int mode);
+    int  GetIntegrityMode() const { return m_IntegrityMode; }
+
+    /// Sets the size of the chunks of the body with INTEGRITY_CHUNKED.
+    void SetIntegrityChunkSize(int size);
+    int  GetIntegrityChunkSize() const { return m_IntegrityChunkSize; }
+
+    /// Sets whether Unpack() with crccheck = 1 accepts a received message marked by the sender
+    /// as packed with INTEGRITY_NONE, without checking its CRC (default: false, the message is
+    /// rejected unless the CRC of its body is 0). The setting is copied by SetMessageHeader().
+    void SetAcceptIntegrityNone(bool accept) { m_AcceptIntegrityNone = accept; }
+    bool GetAcceptIntegrityNone() const { return m_AcceptIntegrityNone; }
+
     /// Unpack() deserializes the header and/or body, extracting data from
     /// the byte stream. If the header has already been deserilized, Unpack()
     /// deserializes only the body part. UnpackBody() must be implemented to
@@ -205,6 +269,24 @@ namespace igtl
     ///                              deserialized
     int Unpack(int crccheck = 0);
 
+    /// UnpackHeaderAndMetaData() deserializes the header, the extended header and the
+    /// meta data, but not the content, e.g. to route or filter messages by device name
+    /// or meta data without decoding large bodies. The content can be deserialized later
+    /// by calling Unpack(). The CRC is checked here when crccheck = 1, and is not checked
+    /// again by Unpack(). It returns UNPACK_HEADER and UNPACK_META_DATA as Unpack().
+    /// Messages with header version 1 have no meta data, only their header is deserialized.
+    int UnpackHeaderAndMetaData(int crccheck = 0);
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    /// Checks the CRC64 of the chunks of a received body against the IGTL_INTEGRITY_CHUNKS
+    /// meta data element of a message packed with INTEGRITY_CHUNKED, e.g. to request only the
+    /// corrupted chunks again. The chunk i is the bytes from i * chunk size of the body. It must
+    /// be called before the body is unpacked (or after Unpack() has failed the CRC check).
+    /// Returns the number of chunks and the indices of the corrupted chunks, or -1 if the
+    /// message has no valid chunk table or its body has been unpacked.
+    int CheckIntegrityChunks(std::vector<int>& corrupted);
+#endif
+
     /// Gets a pointer to the raw byte array for the serialized data including the header and the body.
     void* GetBufferPointer();
     void* GetPackPointer() { return GetBufferPointer(); }
@@ -290,6 +372,47 @@ namespace igtl
     /// If it's a v3 message, body is ext header + content + metadataheader + metadata<optional>
     void UnpackBody(int crccheck, int& r);
 
+    /// Returns true if the CRC of the body matches the header, or if crccheck = 0, or if the
+    /// message is packed with INTEGRITY_NONE and accepted by SetAcceptIntegrityNone().
+    bool CheckBodyCRC(int crccheck);
+
+    /// Packs the header, with the CRC of the body computed by Pack(). The size of the body is
+    /// the size of the buffer, or 'bodySize' for a body serialized in fragments.
+    void PackHeader();
+    void PackHeader(igtlUint64 bodySize);
+
+    /// Packs the meta data and computes the CRC of the body according to the integrity mode.
+    /// The body is given as fragments, e.g. to avoid copying data it does not own; with header
+    /// version 2, the last fragment is the meta data header and the meta data.
+    void PackMetaDataAndBodyCRC(const std::vector<const unsigned char*>& fragments,
+                                const std::vector<igtlUint64>& sizes);
+
+    /// Computes the CRC64 of 'size' bytes from 'data', or of the fragments of a body, from the
+    /// CRC64 of chunks computed in parallel. The CRC64 of the chunks are returned in 'chunkCRCs'
+    /// if not NULL.
+    igtlUint64 ComputeChunkedCRC(const unsigned char* data, igtlUint64 size, int chunkSize,
+                                 std::vector<igtlUint64>* chunkCRCs);
+    igtlUint64 ComputeChunkedCRC(const std::vector<const unsigned char*>& fragments,
+                                 const std::vector<igtlUint64>& sizes, int chunkSize,
+                                 std::vector<igtlUint64>* chunkCRCs);
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    /// Sets or removes the meta data elements of the integrity mode, before the buffer is
+    /// allocated. The chunk table is set with the right size, and filled by Pack().
+    void PackIntegrityMetaData();
+
+    /// Reads the meta data of a received body before they are unpacked. Returns false if the
+    /// message has no meta data or they are inconsistent.
+    bool PeekMetaData(MetaDataStore& store);
+#endif
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    /// Parses the meta data left in the buffer by UnpackBody(). Called before any access to
+    /// the meta data and before the buffer is reallocated. Thread-safe, as it is called by the
+    /// const getters.
+    void UnpackPendingMetaData();
+#endif
+
   protected:
     int            m_MessageSize;
 
@@ -337,9 +460,23 @@ namespace igtl
     /// Unpacking (deserialization) status for the body
     bool           m_IsBodyUnpacked;
 
+    /// Unpacking (deserialization) status for the extended header and meta data,
+    /// which may be unpacked without the content by UnpackHeaderAndMetaData()
+    bool           m_IsMetaDataUnpacked;
+
     /// Packing (serialization) status for the body
     bool           m_IsBodyPacked;
 
+    /// The CRC of the packed body, packed again in the header when only the header changes
+    igtlUint64     m_BodyCRC;
+
+    /// Integrity mode and size of the chunks, see SetIntegrityMode()
+    int            m_IntegrityMode;
+    int            m_IntegrityChunkSize;
+
+    /// Whether the received messages packed with INTEGRITY_NONE are accepted, see SetAcceptIntegrityNone()
+    bool           m_AcceptIntegrityNone;
+
 #if OpenIGTLink_HEADER_VERSION >= 2
   protected:
     /// A pointer to the serialized extended header.
@@ -357,8 +494,14 @@ namespace igtl
     /// Message ID
     igtlUint32                                                                m_MessageId;
 
-    /// Map storing the key value pairs
-    MetaDataMap                                                               m_MetaDataMap;
+    /// Meta data elements, with their serialized form cached
+    MetaDataStore                                                             m_MetaDataStore;
+
+    /// True if the meta data have been received but not parsed yet. They are parsed on the first access.
+    bool                                                                      m_IsMetaDataUnpackPending;
+
+    /// Serializes the parsing of the meta data by concurrent readers
+    SimpleMutexLock                                                           m_MetaDataUnpackLock;
 
 #endif // if OpenIGTLink_HEADER_VERSION >= 2
 
@@ -0,0 +1,503 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageBroker.h"
+#include "igtlMessageHeader.h"
+#include "igtl_header.h"
+
+#include <string.h>
+
+// Interval (ms) at which the accept thread checks whether the broker is stopped
+#define MessageBrokerAcceptTimeout 100
+
+namespace igtl {
+
+  // Returns true if the type starts with the prefix.
+  static bool HasTypePrefix(const std::string& type, const char* prefix)
+  {
+    return type.compare(0, strlen(prefix), prefix) == 0;
+  }
+
+  // Returns the type of the messages queried by a GET_ message.
+  static std::string GetQueriedType(const std::string& type)
+  {
+    std::string queried = type.substr(4);
+    // GET_TRANSFORM does not fit in the type field.
+    if (queried == "TRANS")
+      {
+      return "TRANSFORM";
+      }
+    return queried;
+  }
+
+  MessageBroker::MessageBroker():Object()
+  {
+    this->m_Port = 0;
+    this->m_Threader = MultiThreader::New();
+    this->m_AcceptThreadID = -1;
+    this->m_Running = false;
+    this->m_StateLock = MutexLock::New();
+    this->m_ClientsLock = MutexLock::New();
+    this->m_CacheLock = MutexLock::New();
+    this->m_MaximumQueueLength = MessageBrokerDefaultMaximumQueueLength;
+    this->m_DropPolicy = DROP_OLDEST;
+    this->m_NumberOfMessagesReceived = 0;
+    this->m_NumberOfMessagesSent = 0;
+    this->m_NumberOfMessagesDropped = 0;
+  }
+
+  MessageBroker::~MessageBroker()
+  {
+    this->Stop();
+  }
+
+  int MessageBroker::Start(int port)
+  {
+    this->Stop();
+    this->m_ServerSocket = ServerSocket::New();
+    if (this->m_ServerSocket->CreateServer(port) != 0)
+      {
+      this->m_ServerSocket = NULL;
+      return 0;
+      }
+    this->m_Port = this->m_ServerSocket->GetServerPort();
+
+    this->m_StateLock->Lock();
+    this->m_Running = true;
+    this->m_StateLock->Unlock();
+    this->m_AcceptThreadID = this->m_Threader->SpawnThread((ThreadFunctionType)&MessageBroker::AcceptThread, this);
+    if (this->m_AcceptThreadID < 0)
+      {
+      this->Stop();
+      return 0;
+      }
+    return 1;
+  }
+
+  int MessageBroker::Stop()
+  {
+    this->m_StateLock->Lock();
+    bool running = this->m_Running;
+    this->m_Running = false;
+    this->m_StateLock->Unlock();
+
+    if (this->m_AcceptThreadID >= 0)
+      {
+      this->m_Threader->TerminateThread(this->m_AcceptThreadID);
+      this->m_AcceptThreadID = -1;
+      }
+
+    // No client is added once the accept thread has stopped.
+    this->m_ClientsLock->Lock();
+    std::vector<Client::Pointer> clients = this->m_Clients;
+    this->m_ClientsLock->Unlock();
+    for (unsigned int i = 0; i < clients.size(); i++)
+      {
+      this->CloseClient(clients[i]);
+      }
+    this->RemoveClosedClients();
+
+    if (this->m_ServerSocket.IsNotNull())
+      {
+      this->m_ServerSocket->CloseSocket();
+      this->m_ServerSocket = NULL;
+      }
+    return running ? 1 : 0;
+  }
+
+  bool MessageBroker::IsRunning()
+  {
+    this->m_StateLock->Lock();
+    bool running = this->m_Running;
+    this->m_StateLock->Unlock();
+    return running;
+  }
+
+  int MessageBroker::GetPort()
+  {
+    return this->m_Port;
+  }
+
+  void MessageBroker::SetMaximumQueueLength(unsigned int length)
+  {
+    this->m_StateLock->Lock();
+    this->m_MaximumQueueLength = length < 1 ? 1 : length;
+    this->m_StateLock->Unlock();
+  }
+
+  unsigned int MessageBroker::GetMaximumQueueLength()
+  {
+    this->m_StateLock->Lock();
+    unsigned int length = this->m_MaximumQueueLength;
+    this->m_StateLock->Unlock();
+    return length;
+  }
+
+  int MessageBroker::Publish(MessageBase* message)
+  {
+    PackedMessage::Pointer packed = PackedMessage::Create(message);
+    if (packed.IsNull())
+      {
+      return 0;
+      }
+    this->Dispatch(NULL, packed);
+    return 1;
+  }
+
+  int MessageBroker::GetCachedMessage(const char* type, const char* name, MessageBase* message)
+  {
+    if (type == NULL || name == NULL || message == NULL)
+      {
+      return 0;
+      }
+    PackedMessage::Pointer packed;
+    this->m_CacheLock->Lock();
+    std::map<std::pair<std::string, std::string>, PackedMessage::Pointer>::iterator it =
+      this->m_Cache.find(std::pair<std::string, std::string>(type, name));
+    if (it != this->m_Cache.end())
+      {
+      packed = it->second;
+      }
+    this->m_CacheLock->Unlock();
+    if (packed.IsNull())
+      {
+      return 0;
+      }
+
+    // The cached messages are not modified once cached, they can be read without the lock.
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitPack();
+    const igtl_uint8* buffer = static_cast<const igtl_uint8*>(packed->GetPackPointer());
+    memcpy(headerMsg->GetPackPointer(), buffer, IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+    message->SetMessageHeader(headerMsg);
+    message->AllocatePack();
+    if (packed->GetPackSize() > IGTL_HEADER_SIZE)
+      {
+      memcpy(message->GetPackBodyPointer(), buffer + IGTL_HEADER_SIZE, packed->GetPackSize() - IGTL_HEADER_SIZE);
+      }
+    return 1;
+  }
+
+  int MessageBroker::GetNumberOfCachedMessages()
+  {
+    this->m_CacheLock->Lock();
+    int n = this->m_Cache.size();
+    this->m_CacheLock->Unlock();
+    return n;
+  }
+
+  int MessageBroker::GetNumberOfClients()
+  {
+    // The closed clients are removed by the accept thread.
+    int n = 0;
+    this->m_ClientsLock->Lock();
+    for (unsigned int i = 0; i < this->m_Clients.size(); i++)
+      {
+      this->m_Clients[i]->lock.Lock();
+      n += this->m_Clients[i]->closed ? 0 : 1;
+      this->m_Clients[i]->lock.Unlock();
+      }
+    this->m_ClientsLock->Unlock();
+    return n;
+  }
+
+  igtl_uint64 MessageBroker::GetNumberOfMessagesReceived()
+  {
+    this->m_StateLock->Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesReceived;
+    this->m_StateLock->Unlock();
+    return n;
+  }
+
+  igtl_uint64 MessageBroker::GetNumberOfMessagesSent()
+  {
+    this->m_StateLock->Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesSent;
+    this->m_StateLock->Unlock();
+    return n;
+  }
+
+  igtl_uint64 MessageBroker::GetNumberOfMessagesDropped()
+  {
+    this->m_StateLock->Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesDropped;
+    this->m_StateLock->Unlock();
+    return n;
+  }
+
+  void MessageBroker::Dispatch(Client* source, PackedMessage* message)
+  {
+    this->m_StateLock->Lock();
+    this->m_NumberOfMessagesReceived++;
+    this->m_StateLock->Unlock();
+
+    const std::string& messageType = message->GetMessageType();
+    const std::string& deviceName = message->GetDeviceName();
+    if (HasTypePrefix(messageType, "GET_"))
+      {
+      std::string type = GetQueriedType(messageType);
+      std::vector<PackedMessage::Pointer> answers;
+      this->m_CacheLock->Lock();
+      std::map<std::pair<std::string, std::string>, PackedMessage::Pointer>::iterator it;
+      for (it = this->m_Cache.begin(); it != this->m_Cache.end(); ++it)
+        {
+        if (it->first.first == type && (deviceName.empty() || it->first.second == deviceName))
+          {
+          answers.push_back(it->second);
+          }
+        }
+      this->m_CacheLock->Unlock();
+
+      if (!answers.empty())
+        {
+        // A query published by the application has no client to answer.
+        for (unsigned int i = 0; source != NULL && i < answers.size(); i++)
+          {
+          this->Enqueue(source, answers[i]);
+          }
+        return;
+        }
+      }
+    else if (!HasTypePrefix(messageType, "STT_") && !HasTypePrefix(messageType, "STP_") &&
+             !HasTypePrefix(messageType, "RTS_"))
+      {
+      this->m_CacheLock->Lock();
+      this->m_Cache[std::pair<std::string, std::string>(messageType, deviceName)] = message;
+      this->m_CacheLock->Unlock();
+      }
+
+    this->m_ClientsLock->Lock();
+    for (unsigned int i = 0; i < this->m_Clients.size(); i++)
+      {
+      if (this->m_Clients[i].GetPointer() != source)
+        {
+        this->Enqueue(this->m_Clients[i], message);
+        }
+      }
+    this->m_ClientsLock->Unlock();
+  }
+
+  void MessageBroker::Enqueue(Client* client, PackedMessage* message)
+  {
+    unsigned int maximumQueueLength = this->GetMaximumQueueLength();
+    bool dropped = false;
+
+    client->lock.Lock();
+    if (client->closed)
+      {
+      client->lock.Unlock();
+      return;
+      }
+    if (client->queue.size() >= maximumQueueLength)
+      {
+      dropped = true;
+      if (this->m_DropPolicy == DROP_OLDEST)
+        {
+        client->queue.pop_front();
+        client->queue.push_back(message);
+        }
+      }
+    else
+      {
+      client->queue.push_back(message);
+      }
+    client->condition->Signal();
+    client->lock.Unlock();
+
+    if (dropped)
+      {
+      this->m_StateLock->Lock();
+      this->m_NumberOfMessagesDropped++;
+      this->m_StateLock->Unlock();
+      }
+  }
+
+  void MessageBroker::CloseClient(Client* client)
+  {
+    client->lock.Lock();
+    bool closed = client->closed;
+    client->closed = true;
+    client->queue.clear();
+    client->condition->Broadcast();
+    client->lock.Unlock();
+
+    // Shutting down the socket also unblocks the receiving thread.
+    if (!closed)
+      {
+      client->socket->CloseSocket();
+      }
+  }
+
+  void MessageBroker::RemoveClosedClients()
+  {
+    std::vector<Client::Pointer> closedClients;
+    this->m_ClientsLock->Lock();
+    std::vector<Client::Pointer>::iterator it = this->m_Clients.begin();
+    while (it != this->m_Clients.end())
+      {
+      (*it)->lock.Lock();
+      bool closed = (*it)->closed;
+      (*it)->lock.Unlock();
+      if (closed)
+        {
+        closedClients.push_back(*it);
+        it = this->m_Clients.erase(it);
+        }
+      else
+        {
+        ++it;
+        }
+      }
+    this->m_ClientsLock->Unlock();
+
+    for (unsigned int i = 0; i < closedClients.size(); i++)
+      {
+      if (closedClients[i]->receiveThreadID >= 0)
+        {
+        this->m_Threader->TerminateThread(closedClients[i]->receiveThreadID);
+        }
+      if (closedClients[i]->sendThreadID >= 0)
+        {
+        this->m_Threader->TerminateThread(closedClients[i]->sendThreadID);
+        }
+      }
+  }
+
+  void* MessageBroker::AcceptThread(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    static_cast<MessageBroker*>(info->UserData)->AcceptLoop();
+    return NULL;
+  }
+
+  void* MessageBroker::ReceiveThread(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    Client* client = static_cast<Client*>(info->UserData);
+    client->broker->ReceiveLoop(client);
+    return NULL;
+  }
+
+  void* MessageBroker::SendThread(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    Client* client = static_cast<Client*>(info->UserData);
+    client->broker->SendLoop(client);
+    return NULL;
+  }
+
+  void MessageBroker::AcceptLoop()
+  {
+    while (this->IsRunning())
+      {
+      this->RemoveClosedClients();
+      ClientSocket::Pointer socket = this->m_ServerSocket->WaitForConnection(MessageBrokerAcceptTimeout);
+      if (socket.IsNull())
+        {
+        continue;
+        }
+      Client::Pointer client = Client::New();
+      client->broker = this;
+      client->socket = socket;
+
+      // The client is registered before its threads start, so that it is closed by Stop().
+      this->m_ClientsLock->Lock();
+      this->m_Clients.push_back(client);
+      this->m_ClientsLock->Unlock();
+      client->sendThreadID = this->m_Threader->SpawnThread((ThreadFunctionType)&MessageBroker::SendThread, client.GetPointer());
+      client->receiveThreadID = this->m_Threader->SpawnThread((ThreadFunctionType)&MessageBroker::ReceiveThread, client.GetPointer());
+      if (client->sendThreadID < 0 || client->receiveThreadID < 0)
+        {
+        // Too many clients
+        this->CloseClient(client);
+        }
+      }
+  }
+
+  void MessageBroker::ReceiveLoop(Client* client)
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    igtl::MessageBase::Pointer receivedMsg = igtl::MessageBase::New();
+    while (true)
+      {
+      // The header is kept as received (network byte order) and unpacked in a copy.
+      igtl_uint8 header[IGTL_HEADER_SIZE];
+      if (client->socket->Receive(header, IGTL_HEADER_SIZE) != IGTL_HEADER_SIZE)
+        {
+        break;
+        }
+      headerMsg->InitPack();
+      memcpy(headerMsg->GetPackPointer(), header, IGTL_HEADER_SIZE);
+      headerMsg->Unpack();
+      int bodySize = headerMsg->GetBodySizeToRead();
+      if (bodySize < 0)
+        {
+        break;
+        }
+
+      // The message is relayed as received, with the header in the network byte order.
+      receivedMsg->SetMessageHeader(headerMsg);
+      receivedMsg->AllocatePack();
+      memcpy(receivedMsg->GetPackPointer(), header, IGTL_HEADER_SIZE);
+      if (bodySize > 0 &&
+          client->socket->Receive(receivedMsg->GetPackBodyPointer(), bodySize) != bodySize)
+        {
+        break;
+        }
+      PackedMessage::Pointer message = PackedMessage::Create(receivedMsg);
+      if (message.IsNull())
+        {
+        break;
+        }
+      this->Dispatch(client, message);
+      }
+    this->CloseClient(client);
+  }
+
+  void MessageBroker::SendLoop(Client* client)
+  {
+    client->lock.Lock();
+    while (true)
+      {
+      while (!client->closed && client->queue.empty())
+        {
+        client->condition->Wait(&client->lock);
+        }
+      if (client->closed)
+        {
+        break;
+        }
+      PackedMessage::Pointer message = client->queue.front();
+      client->queue.pop_front();
+      client->lock.Unlock();
+
+      int r = message->Send(client->socket);
+      if (r)
+        {
+        this->m_StateLock->Lock();
+        this->m_NumberOfMessagesSent++;
+        this->m_StateLock->Unlock();
+        }
+      client->lock.Lock();
+      if (!r)
+        {
+        break;
+        }
+      }
+    client->lock.Unlock();
+    this->CloseClient(client);
+  }
+
+} // namespace igtl
@@ -0,0 +1,189 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageBroker_h
+#define __igtlMessageBroker_h
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlClientSocket.h"
+#include "igtlConditionVariable.h"
+#include "igtlMessageBase.h"
+#include "igtlMultiThreader.h"
+#include "igtlMutexLock.h"
+#include "igtlPackedMessage.h"
+#include "igtlServerSocket.h"
+#include "igtl_types.h"
+
+#define MessageBrokerDefaultMaximumQueueLength 32
+
+namespace igtl
+{
+  /// The MessageBroker class is a server relaying the messages between the connected clients
+  /// (publish/subscribe hub), so that a producer holds a single connection however many consumers
+  /// receive its messages.
+  ///
+  /// Each message received from a client is sent to all the other clients, as received, without
+  /// being unpacked or packed again. The latest message of each type and device name is cached.
+  /// A GET_<TYPE> query (e.g. GET_IMAGE, GET_TRANSFORM) is answered from the cache with the latest
+  /// message of the type and device name, or of the type for all the devices if the query has no
+  /// device name. A query that cannot be answered from the cache is relayed to the other clients,
+  /// so that a producer can answer it. The STT_, STP_ and RTS_ messages are relayed but not cached.
+  ///
+  /// Each client has a queue of messages to be sent, served by its own thread, so that a slow client
+  /// does not delay the others. When the queue of a client is full, a message is dropped according
+  /// to the drop policy: by default the oldest message of the queue, so that the client receives the
+  /// latest values as soon as it catches up.
+  ///
+  /// Each client uses two threads of the broker, which limits the number of clients to
+  /// (IGTL_MAX_THREADS - 1) / 2.
+  ///
+  /// Typical use:
+  ///
+  ///   broker->Start(18944);
+  ///   ...
+  ///   broker->Publish(transformMsg); // messages of the application, if any
+  ///   ...
+  ///   broker->Stop();
+  class IGTLCommon_EXPORT MessageBroker: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageBroker, Object)
+    igtlNewMacro(igtl::MessageBroker);
+
+    enum DropPolicy
+    {
+      DROP_OLDEST, ///< drops the oldest queued message to queue the new one
+      DROP_NEWEST  ///< drops the new message
+    };
+
+  public:
+    /// Starts accepting clients on the port (any free port if 0). Returns 1 if successful.
+    int Start(int port);
+
+    /// Disconnects the clients and stops the server. The cache is kept. Returns 0 if not running.
+    int Stop();
+
+    bool IsRunning();
+
+    /// Gets the port the server listens to.
+    int GetPort();
+
+    /// Sets the maximum number of messages queued for a client.
+    void SetMaximumQueueLength(unsigned int length);
+    unsigned int GetMaximumQueueLength();
+
+    void SetDropPolicy(int policy) { this->m_DropPolicy = policy; }
+    int GetDropPolicy() { return this->m_DropPolicy; }
+
+    /// Publishes a packed message of the application to all the clients and caches it. Returns 0 if
+    /// the message is not packed.
+    int Publish(MessageBase* message);
+
+    /// Copies the latest message of the type and device name to a message and unpacks its header.
+    /// Returns 0 if no message is cached.
+    int GetCachedMessage(const char* type, const char* name, MessageBase* message);
+
+    int GetNumberOfCachedMessages();
+
+    int GetNumberOfClients();
+
+    /// Gets the number of messages received from the clients or published.
+    igtl_uint64 GetNumberOfMessagesReceived();
+
+    /// Gets the number of messages sent to the clients.
+    igtl_uint64 GetNumberOfMessagesSent();
+
+    /// Gets the number of messages dropped because the queue of a client was full.
+    igtl_uint64 GetNumberOfMessagesDropped();
+
+  protected:
+    MessageBroker();
+    ~MessageBroker();
+
+    /// Connection of a client
+    class Client: public Object
+    {
+    public:
+      igtlTypeMacro(igtl::MessageBroker::Client, Object)
+      igtlNewMacro(igtl::MessageBroker::Client);
+
+      MessageBroker*                            broker;
+      ClientSocket::Pointer                     socket;
+      std::deque<PackedMessage::Pointer>        queue;
+      SimpleMutexLock                           lock;
+      ConditionVariable::Pointer                condition;
+      bool                                      closed;
+      int                                       receiveThreadID;
+      int                                       sendThreadID;
+
+    protected:
+      Client() : broker(NULL), closed(false), receiveThreadID(-1), sendThreadID(-1)
+        { this->condition = ConditionVariable::New(); };
+      ~Client() {};
+    };
+
+    /// Relays a message received from a client (NULL if published by the application).
+    void Dispatch(Client* source, PackedMessage* message);
+
+    /// Queues a message for a client, applying the drop policy.
+    void Enqueue(Client* client, PackedMessage* message);
+
+    /// Closes the connection of a client. Its threads stop by themselves.
+    void CloseClient(Client* client);
+
+    /// Joins the threads of the clients whose connection is closed, and removes them.
+    /// Only called by the accept thread, or by Stop() once the accept thread has stopped.
+    void RemoveClosedClients();
+
+    static void* AcceptThread(void* ptr);
+    static void* ReceiveThread(void* ptr);
+    static void* SendThread(void* ptr);
+
+    void AcceptLoop();
+    void ReceiveLoop(Client* client);
+    void SendLoop(Client* client);
+
+  private:
+    ServerSocket::Pointer                     m_ServerSocket;
+    int                                       m_Port;
+    MultiThreader::Pointer                    m_Threader;
+    int                                       m_AcceptThreadID;
+    bool                                      m_Running;
+    MutexLock::Pointer                        m_StateLock;
+
+    std::vector<Client::Pointer>              m_Clients;
+    MutexLock::Pointer                        m_ClientsLock;
+
+    /// Latest message of each type and device name
+    std::map<std::pair<std::string, std::string>, PackedMessage::Pointer> m_Cache;
+    MutexLock::Pointer                        m_CacheLock;
+
+    unsigned int                              m_MaximumQueueLength;
+    int                                       m_DropPolicy;
+
+    igtl_uint64                               m_NumberOfMessagesReceived;
+    igtl_uint64                               m_NumberOfMessagesSent;
+    igtl_uint64                               m_NumberOfMessagesDropped;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageBroker_h
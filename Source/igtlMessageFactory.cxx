@@ -34,6 +34,7 @@ PURPOSE.  See the above copyright notices for more information.
 
 #if OpenIGTLink_HEADER_VERSION >= 2
 #include "igtlCommandMessage.h"
+#include "igtlClockSyncMessage.h"
 #endif // OpenIGTLink_PROTOCOL_VERSION >= 3
 
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
@@ -90,6 +91,8 @@ MessageFactory::MessageFactory()
 #if OpenIGTLink_PROTOCOL_VERSION >= 3
   this->AddMessageType("COMMAND", (PointerToMessageBaseNew)&igtl::CommandMessage::New);
   this->AddMessageType("RTS_COMMAND", (PointerToMessageBaseNew)&igtl::RTSCommandMessage::New);
+  this->AddMessageType("GET_CLKSYNC", (PointerToMessageBaseNew)&igtl::GetClockSyncMessage::New);
+  this->AddMessageType("RTS_CLKSYNC", (PointerToMessageBaseNew)&igtl::RTSClockSyncMessage::New);
 #endif
 
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
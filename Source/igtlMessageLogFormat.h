@@ -0,0 +1,42 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageLogFormat_h
+#define __igtlMessageLogFormat_h
+
+#include "igtl_header.h"
+
+/// Layout of the message log files written by MessageLogWriter and read by MessageLogReader.
+/// All the values are big endian, as in the OpenIGTLink messages:
+///
+///   file header: magic "IGTLLOG1" (8 bytes), version (2 bytes), reserved (6 bytes),
+///   records, in the order the messages were written:
+///     arrival time in ns (8 bytes), message size (8 bytes), packed message (header, body and meta data),
+///   index, one entry per record:
+///     arrival time in ns (8 bytes), offset of the record (8 bytes), type (12 bytes), device name (20 bytes),
+///   trailer: offset of the index (8 bytes), number of entries (8 bytes), magic "IGTLIDX1" (8 bytes).
+///
+/// The arrival times never decrease from a record to the next, so that the index can be searched by time.
+/// The index and the trailer are written when the log is closed. A log without them, e.g. because the
+/// recording was interrupted, is still readable: the reader rebuilds the index from the record headers.
+#define IGTL_MESSAGE_LOG_MAGIC              "IGTLLOG1"
+#define IGTL_MESSAGE_LOG_INDEX_MAGIC        "IGTLIDX1"
+#define IGTL_MESSAGE_LOG_MAGIC_SIZE         8
+#define IGTL_MESSAGE_LOG_VERSION            1
+#define IGTL_MESSAGE_LOG_HEADER_SIZE        16
+#define IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE 16
+#define IGTL_MESSAGE_LOG_INDEX_ENTRY_SIZE   (16 + IGTL_HEADER_TYPE_SIZE + IGTL_HEADER_NAME_SIZE)
+#define IGTL_MESSAGE_LOG_TRAILER_SIZE       24
+
+#endif // __igtlMessageLogFormat_h
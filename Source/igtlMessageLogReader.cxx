@@ -0,0 +1,388 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageLogReader.h"
+#include "igtlMessageHeader.h"
+#include "igtl_header.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  #include <windows.h>
+#else
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#include <string.h>
+
+namespace igtl {
+
+  // Reads a big endian 64-bit value.
+  static igtl_uint64 ReadUint64(const igtl_uint8* p)
+  {
+    igtl_uint64 value = 0;
+    for (int i = 0; i < 8; i++)
+      {
+      value = (value << 8) | p[i];
+      }
+    return value;
+  }
+
+  // Gets a header field, which is null-terminated unless it fills the field.
+  static std::string GetHeaderField(const igtl_uint8* p, int size)
+  {
+    int length = 0;
+    while (length < size && p[length] != '\0')
+      {
+      length++;
+      }
+    return std::string((const char*)p, length);
+  }
+
+  MessageLogReader::MessageLogReader():Object()
+  {
+    this->m_Data = NULL;
+    this->m_Size = 0;
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    this->m_FileHandle = NULL;
+    this->m_MappingHandle = NULL;
+#endif
+    this->m_Indexed = false;
+    this->m_NumberOfMessages = 0;
+    this->m_RecordsEnd = 0;
+    this->m_Index = NULL;
+    this->m_DeviceIndexBuilt = false;
+  }
+
+  MessageLogReader::~MessageLogReader()
+  {
+    this->Close();
+  }
+
+  int MessageLogReader::Open(const char* filename)
+  {
+    this->Close();
+    if (filename == NULL)
+      {
+      return 0;
+      }
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      {
+      return 0;
+      }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < IGTL_MESSAGE_LOG_HEADER_SIZE)
+      {
+      CloseHandle(file);
+      return 0;
+      }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* data = NULL;
+    if (mapping != NULL)
+      {
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      }
+    if (data == NULL)
+      {
+      if (mapping != NULL)
+        {
+        CloseHandle(mapping);
+        }
+      CloseHandle(file);
+      return 0;
+      }
+    this->m_FileHandle = file;
+    this->m_MappingHandle = mapping;
+    this->m_Size = (igtl_uint64)size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+      {
+      return 0;
+      }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < IGTL_MESSAGE_LOG_HEADER_SIZE ||
+        (igtl_uint64)st.st_size != (igtl_uint64)(size_t)st.st_size)
+      {
+      close(fd);
+      return 0;
+      }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (data == MAP_FAILED)
+      {
+      return 0;
+      }
+    this->m_Size = (igtl_uint64)st.st_size;
+#endif
+    this->m_Data = (const igtl_uint8*)data;
+
+    igtl_uint16 version = (igtl_uint16)((this->m_Data[IGTL_MESSAGE_LOG_MAGIC_SIZE] << 8) |
+                                        this->m_Data[IGTL_MESSAGE_LOG_MAGIC_SIZE+1]);
+    if (memcmp(this->m_Data, IGTL_MESSAGE_LOG_MAGIC, IGTL_MESSAGE_LOG_MAGIC_SIZE) != 0 ||
+        version != IGTL_MESSAGE_LOG_VERSION)
+      {
+      this->Close();
+      return 0;
+      }
+
+    this->m_Indexed = this->ReadIndex() != 0;
+    if (!this->m_Indexed)
+      {
+      this->RebuildIndex();
+      }
+    return 1;
+  }
+
+  void MessageLogReader::Close()
+  {
+    if (this->m_Data != NULL)
+      {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+      UnmapViewOfFile(this->m_Data);
+      CloseHandle((HANDLE)this->m_MappingHandle);
+      CloseHandle((HANDLE)this->m_FileHandle);
+      this->m_MappingHandle = NULL;
+      this->m_FileHandle = NULL;
+#else
+      munmap((void*)this->m_Data, (size_t)this->m_Size);
+#endif
+      }
+    this->m_Data = NULL;
+    this->m_Size = 0;
+    this->m_Indexed = false;
+    this->m_NumberOfMessages = 0;
+    this->m_RecordsEnd = 0;
+    this->m_Index = NULL;
+    this->m_RebuiltIndex.clear();
+    this->m_DeviceIndex.clear();
+    this->m_DeviceIndexBuilt = false;
+  }
+
+  int MessageLogReader::ReadIndex()
+  {
+    if (this->m_Size < IGTL_MESSAGE_LOG_HEADER_SIZE + IGTL_MESSAGE_LOG_TRAILER_SIZE)
+      {
+      return 0;
+      }
+    const igtl_uint8* trailer = this->m_Data + this->m_Size - IGTL_MESSAGE_LOG_TRAILER_SIZE;
+    if (memcmp(trailer + 16, IGTL_MESSAGE_LOG_INDEX_MAGIC, IGTL_MESSAGE_LOG_MAGIC_SIZE) != 0)
+      {
+      return 0;
+      }
+    igtl_uint64 indexOffset = ReadUint64(trailer);
+    igtl_uint64 numberOfEntries = ReadUint64(trailer + 8);
+    igtl_uint64 indexEnd = this->m_Size - IGTL_MESSAGE_LOG_TRAILER_SIZE;
+    if (indexOffset < IGTL_MESSAGE_LOG_HEADER_SIZE || indexOffset > indexEnd ||
+        numberOfEntries != (indexEnd - indexOffset) / IGTL_MESSAGE_LOG_INDEX_ENTRY_SIZE ||
+        (indexEnd - indexOffset) % IGTL_MESSAGE_LOG_INDEX_ENTRY_SIZE != 0)
+      {
+      return 0;
+      }
+    this->m_Index = this->m_Data + indexOffset;
+    this->m_NumberOfMessages = numberOfEntries;
+    this->m_RecordsEnd = indexOffset;
+    return 1;
+  }
+
+  void MessageLogReader::RebuildIndex()
+  {
+    // Only the record headers and the message headers are read, the bodies are skipped.
+    this->m_RebuiltIndex.clear();
+    igtl_uint64 offset = IGTL_MESSAGE_LOG_HEADER_SIZE;
+    igtl_uint64 numberOfMessages = 0;
+    while (offset + IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE + IGTL_HEADER_SIZE <= this->m_Size)
+      {
+      const igtl_uint8* record = this->m_Data + offset;
+      igtl_uint64 size = ReadUint64(record + 8);
+      if (size < IGTL_HEADER_SIZE || size > this->m_Size - offset - IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE)
+        {
+        // Truncated record, e.g. the recording was interrupted while writing it.
+        break;
+        }
+      const igtl_header* header = (const igtl_header*)(record + IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE);
+      this->m_RebuiltIndex.insert(this->m_RebuiltIndex.end(), record, record + 8);
+      for (int i = 7; i >= 0; i--)
+        {
+        this->m_RebuiltIndex.push_back((igtl_uint8)((offset >> (i * 8)) & 0xFF));
+        }
+      this->m_RebuiltIndex.insert(this->m_RebuiltIndex.end(), header->name, header->name + IGTL_HEADER_TYPE_SIZE);
+      this->m_RebuiltIndex.insert(this->m_RebuiltIndex.end(), header->device_name, header->device_name + IGTL_HEADER_NAME_SIZE);
+      offset += IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE + size;
+      numberOfMessages++;
+      }
+    this->m_Index = this->m_RebuiltIndex.empty() ? NULL : &this->m_RebuiltIndex[0];
+    this->m_NumberOfMessages = numberOfMessages;
+    this->m_RecordsEnd = offset;
+  }
+
+  const igtl_uint8* MessageLogReader::GetIndexEntry(igtl_uint64 i)
+  {
+    if (i >= this->m_NumberOfMessages)
+      {
+      return NULL;
+      }
+    return this->m_Index + i * IGTL_MESSAGE_LOG_INDEX_ENTRY_SIZE;
+  }
+
+  igtl_uint64 MessageLogReader::GetArrivalTime(igtl_uint64 i)
+  {
+    const igtl_uint8* entry = this->GetIndexEntry(i);
+    return entry ? ReadUint64(entry) : 0;
+  }
+
+  std::string MessageLogReader::GetMessageType(igtl_uint64 i)
+  {
+    const igtl_uint8* entry = this->GetIndexEntry(i);
+    return entry ? GetHeaderField(entry + 16, IGTL_HEADER_TYPE_SIZE) : std::string();
+  }
+
+  std::string MessageLogReader::GetDeviceName(igtl_uint64 i)
+  {
+    const igtl_uint8* entry = this->GetIndexEntry(i);
+    return entry ? GetHeaderField(entry + 16 + IGTL_HEADER_TYPE_SIZE, IGTL_HEADER_NAME_SIZE) : std::string();
+  }
+
+  const void* MessageLogReader::GetMessagePointer(igtl_uint64 i)
+  {
+    const igtl_uint8* entry = this->GetIndexEntry(i);
+    if (entry == NULL)
+      {
+      return NULL;
+      }
+    igtl_uint64 offset = ReadUint64(entry + 8);
+    if (offset < IGTL_MESSAGE_LOG_HEADER_SIZE || offset > this->m_RecordsEnd ||
+        this->m_RecordsEnd - offset < IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE + IGTL_HEADER_SIZE)
+      {
+      return NULL;
+      }
+    igtl_uint64 size = ReadUint64(this->m_Data + offset + 8);
+    if (size < IGTL_HEADER_SIZE || size > this->m_RecordsEnd - offset - IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE)
+      {
+      return NULL;
+      }
+    return this->m_Data + offset + IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE;
+  }
+
+  igtl_uint64 MessageLogReader::GetMessageSize(igtl_uint64 i)
+  {
+    const igtl_uint8* message = (const igtl_uint8*)this->GetMessagePointer(i);
+    if (message == NULL)
+      {
+      return 0;
+      }
+    return ReadUint64(message - IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE + 8);
+  }
+
+  int MessageLogReader::ReadMessage(igtl_uint64 i, MessageBase* message)
+  {
+    const igtl_uint8* packed = (const igtl_uint8*)this->GetMessagePointer(i);
+    if (message == NULL || packed == NULL)
+      {
+      return 0;
+      }
+    igtl_uint64 size = this->GetMessageSize(i);
+
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitPack();
+    memcpy(headerMsg->GetPackPointer(), packed, IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+    if ((igtl_uint64)headerMsg->GetBodySizeToRead() != size - IGTL_HEADER_SIZE)
+      {
+      return 0;
+      }
+    message->SetMessageHeader(headerMsg);
+    message->AllocatePack();
+    if (size > IGTL_HEADER_SIZE)
+      {
+      memcpy(message->GetPackBodyPointer(), packed + IGTL_HEADER_SIZE, (size_t)(size - IGTL_HEADER_SIZE));
+      }
+    return 1;
+  }
+
+  igtl_uint64 MessageLogReader::FindMessage(igtl_uint64 time)
+  {
+    // Lower bound on the arrival times, which never decrease in the log.
+    igtl_uint64 first = 0;
+    igtl_uint64 count = this->m_NumberOfMessages;
+    while (count > 0)
+      {
+      igtl_uint64 step = count / 2;
+      if (this->GetArrivalTime(first + step) < time)
+        {
+        first += step + 1;
+        count -= step + 1;
+        }
+      else
+        {
+        count = step;
+        }
+      }
+    return first;
+  }
+
+  igtl_uint64 MessageLogReader::FindMessage(igtl_uint64 time, const char* type, const char* name)
+  {
+    if (type == NULL || name == NULL)
+      {
+      return this->m_NumberOfMessages;
+      }
+    this->BuildDeviceIndex();
+    std::map<std::pair<std::string, std::string>, std::vector<igtl_uint64> >::iterator it =
+      this->m_DeviceIndex.find(std::pair<std::string, std::string>(type, name));
+    if (it == this->m_DeviceIndex.end())
+      {
+      return this->m_NumberOfMessages;
+      }
+    const std::vector<igtl_uint64>& messages = it->second;
+    igtl_uint64 first = 0;
+    igtl_uint64 count = messages.size();
+    while (count > 0)
+      {
+      igtl_uint64 step = count / 2;
+      if (this->GetArrivalTime(messages[first + step]) < time)
+        {
+        first += step + 1;
+        count -= step + 1;
+        }
+      else
+        {
+        count = step;
+        }
+      }
+    return first < messages.size() ? messages[first] : this->m_NumberOfMessages;
+  }
+
+  void MessageLogReader::BuildDeviceIndex()
+  {
+    if (this->m_DeviceIndexBuilt)
+      {
+      return;
+      }
+    for (igtl_uint64 i = 0; i < this->m_NumberOfMessages; i++)
+      {
+      std::pair<std::string, std::string> key(this->GetMessageType(i), this->GetDeviceName(i));
+      this->m_DeviceIndex[key].push_back(i);
+      }
+    this->m_DeviceIndexBuilt = true;
+  }
+
+} // namespace igtl
@@ -0,0 +1,132 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageLogReader_h
+#define __igtlMessageLogReader_h
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlMessageLogFormat.h"
+#include "igtl_types.h"
+
+namespace igtl
+{
+  /// The MessageLogReader class reads the message logs written by MessageLogWriter.
+  ///
+  /// The log file is memory-mapped: opening a log only reads its index, and the messages are
+  /// accessed in place, without being copied, until they are unpacked. The messages are numbered
+  /// in the order they were recorded, which is also the order of their arrival times, and a message
+  /// can be found by its arrival time in O(log n).
+  ///
+  /// Typical use:
+  ///
+  ///   reader->Open("session.igtllog");
+  ///   for (igtl_uint64 i = reader->FindMessage(startTime); i < reader->GetNumberOfMessages(); i++)
+  ///     {
+  ///     if (reader->GetMessageType(i) == "TRANSFORM")
+  ///       {
+  ///       reader->ReadMessage(i, transformMsg);
+  ///       transformMsg->Unpack();
+  ///       }
+  ///     }
+  class IGTLCommon_EXPORT MessageLogReader: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageLogReader, Object)
+    igtlNewMacro(igtl::MessageLogReader);
+
+  public:
+    /// Maps the log file and reads its index. The index is rebuilt from the records if the log was not
+    /// closed by the writer. Returns 1 if successful.
+    int Open(const char* filename);
+
+    void Close();
+
+    bool IsOpen() { return this->m_Data != NULL; }
+
+    /// Returns true if the index was read from the file, false if it was rebuilt from the records.
+    bool IsIndexed() { return this->m_Indexed; }
+
+    igtl_uint64 GetNumberOfMessages() { return this->m_NumberOfMessages; }
+
+    /// Gets the arrival time of a message in nanoseconds since the Unix epoch.
+    igtl_uint64 GetArrivalTime(igtl_uint64 i);
+
+    std::string GetMessageType(igtl_uint64 i);
+
+    std::string GetDeviceName(igtl_uint64 i);
+
+    /// Gets a pointer to the packed message (header, body and meta data) in the mapped file.
+    /// The pointer is valid until the log is closed. Returns NULL if the record is truncated.
+    const void* GetMessagePointer(igtl_uint64 i);
+
+    /// Gets the size of the packed message.
+    igtl_uint64 GetMessageSize(igtl_uint64 i);
+
+    /// Copies the packed message to a message and unpacks its header. The body is unpacked by the caller.
+    /// Returns 1 if successful.
+    int ReadMessage(igtl_uint64 i, MessageBase* message);
+
+    /// Finds the first message that arrived at or after the time. Returns GetNumberOfMessages() if none.
+    igtl_uint64 FindMessage(igtl_uint64 time);
+
+    /// Finds the first message of the type and device name that arrived at or after the time.
+    /// Returns GetNumberOfMessages() if none. The index by type and device name is built on the first call.
+    igtl_uint64 FindMessage(igtl_uint64 time, const char* type, const char* name);
+
+  protected:
+    MessageLogReader();
+    ~MessageLogReader();
+
+    /// Gets the index entry of a message, in the file layout.
+    const igtl_uint8* GetIndexEntry(igtl_uint64 i);
+
+    /// Reads the index from the trailer. Returns 0 if the log has no valid index.
+    int ReadIndex();
+
+    /// Rebuilds the index by scanning the record headers.
+    void RebuildIndex();
+
+    void BuildDeviceIndex();
+
+  private:
+    const igtl_uint8*           m_Data;
+    igtl_uint64                 m_Size;
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    void*                       m_FileHandle;
+    void*                       m_MappingHandle;
+#endif
+
+    bool                        m_Indexed;
+    igtl_uint64                 m_NumberOfMessages;
+    /// End of the records, i.e. offset of the index
+    igtl_uint64                 m_RecordsEnd;
+    /// Index entries, in the mapped file or in m_RebuiltIndex
+    const igtl_uint8*           m_Index;
+    std::vector<igtl_uint8>     m_RebuiltIndex;
+
+    /// Messages of each type and device name, built on demand
+    std::map<std::pair<std::string, std::string>, std::vector<igtl_uint64> > m_DeviceIndex;
+    bool                        m_DeviceIndexBuilt;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageLogReader_h
@@ -0,0 +1,169 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageLogReplayer.h"
+#include "igtlOSUtil.h"
+#include "igtlTimeStamp.h"
+#include "igtl_header.h"
+
+#include <string.h>
+
+// Below this delay (ns), the replayer yields instead of sleeping, as sleeping may take longer than a millisecond.
+#define MessageLogReplayerSpinThreshold 2000000
+
+namespace igtl {
+
+  MessageLogReplayer::MessageLogReplayer():Object()
+  {
+    this->m_Speed = 1.0;
+    this->m_Message = MessageBase::New();
+    this->m_Lock = MutexLock::New();
+    this->m_Aborted = false;
+    this->m_MaximumLateness = 0;
+  }
+
+  MessageLogReplayer::~MessageLogReplayer()
+  {
+  }
+
+  int MessageLogReplayer::Replay()
+  {
+    if (this->m_Reader.IsNull())
+      {
+      return -1;
+      }
+    if (this->m_Reader->GetNumberOfMessages() == 0)
+      {
+      return 0;
+      }
+    igtl_uint64 last = this->m_Reader->GetNumberOfMessages() - 1;
+    return this->Replay(this->m_Reader->GetArrivalTime(0), this->m_Reader->GetArrivalTime(last) + 1);
+  }
+
+  int MessageLogReplayer::Replay(igtl_uint64 startTime, igtl_uint64 endTime)
+  {
+    if (this->m_Reader.IsNull() || (this->m_Socket.IsNull() && this->m_SessionManager.IsNull()))
+      {
+      return -1;
+      }
+    this->m_Lock->Lock();
+    this->m_Aborted = false;
+    this->m_Lock->Unlock();
+    this->m_MaximumLateness = 0;
+
+    igtl_uint64 first = this->m_Reader->FindMessage(startTime);
+    igtl_uint64 numberOfMessages = this->m_Reader->GetNumberOfMessages();
+    if (first >= numberOfMessages)
+      {
+      return 0;
+      }
+
+    // The messages are due relative to the first one, so that the replay does not drift
+    // when sending a message takes time.
+    igtl_uint64 firstArrival = this->m_Reader->GetArrivalTime(first);
+    igtl_uint64 origin = TimeStamp::GetMonotonicTimeInNanoseconds();
+    int numberOfMessagesSent = 0;
+    for (igtl_uint64 i = first; i < numberOfMessages; i++)
+      {
+      igtl_uint64 arrival = this->m_Reader->GetArrivalTime(i);
+      if (arrival >= endTime)
+        {
+        break;
+        }
+      if (this->m_Speed > 0.0)
+        {
+        igtl_uint64 due = origin + (igtl_uint64)((double)(arrival - firstArrival) / this->m_Speed);
+        if (!this->WaitUntil(due))
+          {
+          break;
+          }
+        igtl_uint64 now = TimeStamp::GetMonotonicTimeInNanoseconds();
+        if (now - due > this->m_MaximumLateness)
+          {
+          this->m_MaximumLateness = now - due;
+          }
+        }
+      else if (this->IsAborted())
+        {
+        break;
+        }
+      if (!this->SendLoggedMessage(i))
+        {
+        return -1;
+        }
+      numberOfMessagesSent++;
+      }
+    return numberOfMessagesSent;
+  }
+
+  void MessageLogReplayer::Abort()
+  {
+    this->m_Lock->Lock();
+    this->m_Aborted = true;
+    this->m_Lock->Unlock();
+  }
+
+  bool MessageLogReplayer::IsAborted()
+  {
+    this->m_Lock->Lock();
+    bool aborted = this->m_Aborted;
+    this->m_Lock->Unlock();
+    return aborted;
+  }
+
+  int MessageLogReplayer::SendLoggedMessage(igtl_uint64 i)
+  {
+    if (this->m_Socket.IsNotNull())
+      {
+      const void* packed = this->m_Reader->GetMessagePointer(i);
+      igtl_uint64 size = this->m_Reader->GetMessageSize(i);
+      // Socket::Send() takes the length as an int.
+      if (packed == NULL || size > 0x7FFFFFFF)
+        {
+        return 0;
+        }
+      return this->m_Socket->Send(packed, (int)size);
+      }
+    if (!this->m_Reader->ReadMessage(i, this->m_Message))
+      {
+      return 0;
+      }
+    // The header of the message has been unpacked in place, it is restored as recorded (network byte order)
+    // before the message is pushed.
+    memcpy(this->m_Message->GetPackPointer(), this->m_Reader->GetMessagePointer(i), IGTL_HEADER_SIZE);
+    return this->m_SessionManager->PushMessage(this->m_Message);
+  }
+
+  bool MessageLogReplayer::WaitUntil(igtl_uint64 time)
+  {
+    while (!this->IsAborted())
+      {
+      igtl_uint64 now = TimeStamp::GetMonotonicTimeInNanoseconds();
+      if (now >= time)
+        {
+        return true;
+        }
+      if (time - now > MessageLogReplayerSpinThreshold)
+        {
+        igtl::Sleep((int)((time - now - MessageLogReplayerSpinThreshold / 2) / 1000000));
+        }
+      else
+        {
+        igtl::Sleep(0);
+        }
+      }
+    return false;
+  }
+
+} // namespace igtl
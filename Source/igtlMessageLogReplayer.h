@@ -0,0 +1,103 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageLogReplayer_h
+#define __igtlMessageLogReplayer_h
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlMessageLogReader.h"
+#include "igtlMutexLock.h"
+#include "igtlSessionManager.h"
+#include "igtlSocket.h"
+#include "igtl_types.h"
+
+namespace igtl
+{
+  /// The MessageLogReplayer class sends the messages of a log read by MessageLogReader, with the
+  /// intervals between their arrival times, to a socket or a session manager.
+  ///
+  /// The messages are sent to the socket directly from the mapped log file, without being copied.
+  /// They are copied to a message before being pushed to a session manager.
+  ///
+  /// Typical use:
+  ///
+  ///   reader->Open("session.igtllog");
+  ///   replayer->SetReader(reader);
+  ///   replayer->SetSocket(socket);
+  ///   replayer->SetSpeed(2.0); // twice as fast as recorded
+  ///   replayer->Replay();
+  class IGTLCommon_EXPORT MessageLogReplayer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageLogReplayer, Object)
+    igtlNewMacro(igtl::MessageLogReplayer);
+
+  public:
+    void SetReader(MessageLogReader* reader) { this->m_Reader = reader; }
+
+    /// Sets the socket the messages are sent to. The socket is used instead of the session manager if both are set.
+    void SetSocket(Socket* socket) { this->m_Socket = socket; }
+
+    /// Sets the session manager the messages are pushed to.
+    void SetSessionManager(SessionManager* manager) { this->m_SessionManager = manager; }
+
+    /// Sets the speed of the replay relative to the recording. The messages are sent without waiting if the speed is 0.
+    void SetSpeed(double speed) { this->m_Speed = speed < 0.0 ? 0.0 : speed; }
+    double GetSpeed() { return this->m_Speed; }
+
+    /// Replays the whole log. Returns the number of messages sent, or -1 if a message could not be sent.
+    int Replay();
+
+    /// Replays the messages that arrived from startTime (included) to endTime (excluded), in nanoseconds
+    /// since the Unix epoch. Blocks until the last message is sent or the replay is aborted.
+    int Replay(igtl_uint64 startTime, igtl_uint64 endTime);
+
+    /// Stops the replay running in another thread after the message being sent.
+    void Abort();
+
+    /// Gets the maximum delay (ns) between the time a message was due and the time it was sent
+    /// during the last replay.
+    igtl_uint64 GetMaximumLateness() { return this->m_MaximumLateness; }
+
+  protected:
+    MessageLogReplayer();
+    ~MessageLogReplayer();
+
+    /// Sends a message of the log. Returns 0 if the message could not be sent.
+    int SendLoggedMessage(igtl_uint64 i);
+
+    /// Waits until the monotonic clock reaches the time. Returns false if the replay was aborted.
+    bool WaitUntil(igtl_uint64 time);
+
+    bool IsAborted();
+
+  private:
+    MessageLogReader::Pointer           m_Reader;
+    Socket::Pointer                     m_Socket;
+    SessionManager::Pointer             m_SessionManager;
+    double                              m_Speed;
+
+    /// Message reused to push the messages to the session manager
+    MessageBase::Pointer                m_Message;
+
+    MutexLock::Pointer                  m_Lock;
+    bool                                m_Aborted;
+    igtl_uint64                         m_MaximumLateness;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageLogReplayer_h
@@ -0,0 +1,152 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageLogWriter.h"
+#include "igtlTimeStamp.h"
+#include "igtl_header.h"
+
+#include <string.h>
+
+namespace igtl {
+
+  // Appends a big endian 64-bit value.
+  static void AppendUint64(std::vector<igtl_uint8>& buffer, igtl_uint64 value)
+  {
+    for (int i = 7; i >= 0; i--)
+      {
+      buffer.push_back((igtl_uint8)((value >> (i * 8)) & 0xFF));
+      }
+  }
+
+  MessageLogWriter::MessageLogWriter():Object()
+  {
+    this->m_File = NULL;
+    this->m_Offset = 0;
+    this->m_NumberOfMessages = 0;
+    this->m_LastArrivalTime = 0;
+  }
+
+  MessageLogWriter::~MessageLogWriter()
+  {
+    this->Close();
+  }
+
+  int MessageLogWriter::Open(const char* filename)
+  {
+    this->Close();
+    if (filename == NULL)
+      {
+      return 0;
+      }
+    this->m_File = fopen(filename, "wb");
+    if (this->m_File == NULL)
+      {
+      return 0;
+      }
+
+    std::vector<igtl_uint8> header(IGTL_MESSAGE_LOG_HEADER_SIZE, 0);
+    memcpy(&header[0], IGTL_MESSAGE_LOG_MAGIC, IGTL_MESSAGE_LOG_MAGIC_SIZE);
+    header[IGTL_MESSAGE_LOG_MAGIC_SIZE] = (IGTL_MESSAGE_LOG_VERSION >> 8) & 0xFF;
+    header[IGTL_MESSAGE_LOG_MAGIC_SIZE+1] = IGTL_MESSAGE_LOG_VERSION & 0xFF;
+    if (fwrite(&header[0], 1, header.size(), this->m_File) != header.size())
+      {
+      fclose(this->m_File);
+      this->m_File = NULL;
+      return 0;
+      }
+    this->m_Offset = IGTL_MESSAGE_LOG_HEADER_SIZE;
+    this->m_NumberOfMessages = 0;
+    this->m_LastArrivalTime = 0;
+    this->m_Index.clear();
+    return 1;
+  }
+
+  int MessageLogWriter::Close()
+  {
+    if (this->m_File == NULL)
+      {
+      return 0;
+      }
+    std::vector<igtl_uint8> trailer;
+    AppendUint64(trailer, this->m_Offset);
+    AppendUint64(trailer, this->m_NumberOfMessages);
+    trailer.insert(trailer.end(), IGTL_MESSAGE_LOG_INDEX_MAGIC, IGTL_MESSAGE_LOG_INDEX_MAGIC + IGTL_MESSAGE_LOG_MAGIC_SIZE);
+
+    int r = 1;
+    if ((!this->m_Index.empty() &&
+         fwrite(&this->m_Index[0], 1, this->m_Index.size(), this->m_File) != this->m_Index.size()) ||
+        fwrite(&trailer[0], 1, trailer.size(), this->m_File) != trailer.size())
+      {
+      r = 0;
+      }
+    if (fclose(this->m_File) != 0)
+      {
+      r = 0;
+      }
+    this->m_File = NULL;
+    this->m_Index.clear();
+    return r;
+  }
+
+  int MessageLogWriter::Write(MessageBase* message)
+  {
+    igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+    ts->GetTime();
+    return this->Write(message, ts->GetTimeStampInNanoseconds());
+  }
+
+  int MessageLogWriter::Write(MessageBase* message, igtl_uint64 arrivalTime)
+  {
+    if (message == NULL || message->GetBufferPointer() == NULL)
+      {
+      return 0;
+      }
+    return this->WriteBuffer(message->GetBufferPointer(), message->GetBufferSize(), arrivalTime);
+  }
+
+  int MessageLogWriter::WriteBuffer(const void* buffer, igtl_uint64 size, igtl_uint64 arrivalTime)
+  {
+    if (this->m_File == NULL || buffer == NULL || size < IGTL_HEADER_SIZE)
+      {
+      return 0;
+      }
+    if (arrivalTime < this->m_LastArrivalTime)
+      {
+      arrivalTime = this->m_LastArrivalTime;
+      }
+
+    std::vector<igtl_uint8> recordHeader;
+    AppendUint64(recordHeader, arrivalTime);
+    AppendUint64(recordHeader, size);
+    if (fwrite(&recordHeader[0], 1, recordHeader.size(), this->m_File) != recordHeader.size() ||
+        fwrite(buffer, 1, (size_t)size, this->m_File) != size)
+      {
+      return 0;
+      }
+
+    // The type and the device name are copied as they are in the header, without the terminating null
+    // character if they fill the field.
+    const igtl_header* header = (const igtl_header*)buffer;
+    AppendUint64(this->m_Index, arrivalTime);
+    AppendUint64(this->m_Index, this->m_Offset);
+    this->m_Index.insert(this->m_Index.end(), header->name, header->name + IGTL_HEADER_TYPE_SIZE);
+    this->m_Index.insert(this->m_Index.end(), header->device_name, header->device_name + IGTL_HEADER_NAME_SIZE);
+
+    this->m_Offset += IGTL_MESSAGE_LOG_RECORD_HEADER_SIZE + size;
+    this->m_NumberOfMessages++;
+    this->m_LastArrivalTime = arrivalTime;
+    return 1;
+  }
+
+} // namespace igtl
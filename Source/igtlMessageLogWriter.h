@@ -0,0 +1,95 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageLogWriter_h
+#define __igtlMessageLogWriter_h
+
+#include <cstdio>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlMessageLogFormat.h"
+#include "igtl_types.h"
+
+namespace igtl
+{
+  /// The MessageLogWriter class records OpenIGTLink messages in an append-only log file, with their
+  /// arrival times, so that a session can be replayed later by MessageLogReplayer. The messages are
+  /// recorded as packed (header, body and meta data), as sent on the socket.
+  ///
+  /// The index of the log, by arrival time, type and device name, is kept in memory and written when
+  /// the log is closed. See igtlMessageLogFormat.h for the layout of the file.
+  ///
+  /// Typical use:
+  ///
+  ///   writer->Open("session.igtllog");
+  ///   // For each message received
+  ///   headerMsg->Unpack();
+  ///   msg->SetMessageHeader(headerMsg);
+  ///   msg->AllocatePack();
+  ///   socket->Receive(msg->GetPackBodyPointer(), msg->GetPackBodySize());
+  ///   writer->Write(msg);
+  ///   ...
+  ///   writer->Close();
+  class IGTLCommon_EXPORT MessageLogWriter: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageLogWriter, Object)
+    igtlNewMacro(igtl::MessageLogWriter);
+
+  public:
+    /// Creates the log file, overwriting any existing file. Returns 1 if successful.
+    int Open(const char* filename);
+
+    /// Writes the index and closes the log file. Returns 1 if successful.
+    int Close();
+
+    bool IsOpen() { return this->m_File != NULL; }
+
+    /// Records a packed message, arrived now. Returns 1 if successful.
+    int Write(MessageBase* message);
+
+    /// Records a packed message with its arrival time, in nanoseconds since the Unix epoch
+    /// (TimeStamp::GetTimeStampInNanoseconds()). An arrival time earlier than the one of the previous
+    /// message is recorded as the previous one, so that the log stays ordered by time.
+    int Write(MessageBase* message, igtl_uint64 arrivalTime);
+
+    /// Records a packed message from a raw buffer starting with the OpenIGTLink header.
+    int WriteBuffer(const void* buffer, igtl_uint64 size, igtl_uint64 arrivalTime);
+
+    /// Gets the number of messages recorded since the log was opened.
+    igtl_uint64 GetNumberOfMessages() { return this->m_NumberOfMessages; }
+
+    /// Gets the size of the file header and the records written since the log was opened, in bytes.
+    igtl_uint64 GetFileSize() { return this->m_Offset; }
+
+  protected:
+    MessageLogWriter();
+    ~MessageLogWriter();
+
+  private:
+    FILE*                       m_File;
+    igtl_uint64                 m_Offset;
+    igtl_uint64                 m_NumberOfMessages;
+    igtl_uint64                 m_LastArrivalTime;
+
+    /// Index entries in the file layout, written on Close()
+    std::vector<igtl_uint8>     m_Index;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageLogWriter_h
@@ -0,0 +1,213 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageRTPDemultiplexer.h"
+#include <string.h>
+
+
+namespace igtl {
+
+  MessageRTPDemultiplexer::MessageRTPDemultiplexer():Object()
+  {
+    this->contextsLock = MutexLock::New();
+    this->threader = MultiThreader::New();
+    this->NumberOfThreads = 1;
+    this->RTPPayloadLength = RTP_PAYLOAD_LENGTH;
+    this->NACKEnabled = false;
+  }
+
+  MessageRTPDemultiplexer::~MessageRTPDemultiplexer()
+  {
+    this->contextsLock->Lock();
+    this->contexts.clear();
+    this->contextsLock->Unlock();
+  }
+
+  int MessageRTPDemultiplexer::PushDataIntoPacketBuffer(igtlUint8* UDPPacket, igtlUint16 PacketLen)
+  {
+    if (UDPPacket == NULL || PacketLen < RTP_HEADER_LENGTH)
+      {
+      return 0;
+      }
+    igtl_uint32 ssrc;
+    memcpy(&ssrc, UDPPacket + 2*sizeof(igtl_uint32), sizeof(ssrc));
+    if (igtl_is_little_endian())
+      {
+      ssrc = BYTE_SWAP_INT32(ssrc);
+      }
+    // The demultiplexer lock only covers the lookup, the packet is copied under the lock of its context.
+    this->contextsLock->Lock();
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it = this->contexts.find(ssrc);
+    if (it == this->contexts.end())
+      {
+      MessageRTPWrapper::Pointer context = MessageRTPWrapper::New();
+      context->SetRTPPayloadLength(this->RTPPayloadLength);
+      context->SetNACKEnabled(this->NACKEnabled);
+      it = this->contexts.insert(std::pair<igtl_uint32, MessageRTPWrapper::Pointer>(ssrc, context)).first;
+      }
+    MessageRTPWrapper::Pointer context = it->second;
+    this->contextsLock->Unlock();
+    context->PushDataIntoPacketBuffer(UDPPacket, PacketLen);
+    return 1;
+  }
+
+  void* MessageRTPDemultiplexer::UnWrapThreadFunction(void* ptr)
+  {
+    MultiThreader::ThreadInfo* info = static_cast<MultiThreader::ThreadInfo*>(ptr);
+    UnWrapJob* job = static_cast<UnWrapJob*>(info->UserData);
+    int numberOfProcessedPackets = 0;
+    // contexts are assigned round robin, so a context is never shared by two threads.
+    for (unsigned int i = info->ThreadID; i < job->contexts.size(); i += info->NumberOfThreads)
+      {
+      while (job->contexts[i]->UnWrapPacketWithTypeAndName(job->deviceType, job->deviceName))
+        {
+        numberOfProcessedPackets++;
+        }
+      }
+    job->numberOfProcessedPackets[info->ThreadID] = numberOfProcessedPackets;
+    return NULL;
+  }
+
+  int MessageRTPDemultiplexer::UnWrapPacketsWithTypeAndName(const char *deviceType, const char * deviceName)
+  {
+    // Hold a reference to the contexts, RemoveContext() may be called during the unwrapping.
+    std::vector<MessageRTPWrapper::Pointer> contextReferences;
+    this->contextsLock->Lock();
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it;
+    for (it = this->contexts.begin(); it != this->contexts.end(); ++it)
+      {
+      contextReferences.push_back(it->second);
+      }
+    this->contextsLock->Unlock();
+
+    UnWrapJob job;
+    job.deviceType = deviceType;
+    job.deviceName = deviceName;
+    for (unsigned int i = 0; i < contextReferences.size(); i++)
+      {
+      job.contexts.push_back(contextReferences[i].GetPointer());
+      }
+    int numberOfThreads = this->NumberOfThreads;
+    if (numberOfThreads > (int)job.contexts.size())
+      {
+      numberOfThreads = job.contexts.size();
+      }
+    if (numberOfThreads == 0)
+      {
+      return 0;
+      }
+    job.numberOfProcessedPackets.assign(numberOfThreads, 0);
+
+    if (numberOfThreads == 1)
+      {
+      MultiThreader::ThreadInfo info;
+      info.ThreadID = 0;
+      info.NumberOfThreads = 1;
+      info.UserData = &job;
+      UnWrapThreadFunction(&info);
+      }
+    else
+      {
+      this->threader->SetNumberOfThreads(numberOfThreads);
+      this->threader->SetSingleMethod((ThreadFunctionType) &MessageRTPDemultiplexer::UnWrapThreadFunction, &job);
+      this->threader->SingleMethodExecute();
+      }
+
+    int numberOfProcessedPackets = 0;
+    for (int i = 0; i < numberOfThreads; i++)
+      {
+      numberOfProcessedPackets += job.numberOfProcessedPackets[i];
+      }
+    return numberOfProcessedPackets;
+  }
+
+  MessageRTPWrapper::Pointer MessageRTPDemultiplexer::GetContext(igtl_uint32 ssrc)
+  {
+    MessageRTPWrapper::Pointer context;
+    this->contextsLock->Lock();
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it = this->contexts.find(ssrc);
+    if (it != this->contexts.end())
+      {
+      context = it->second;
+      }
+    this->contextsLock->Unlock();
+    return context;
+  }
+
+  void MessageRTPDemultiplexer::GetSSRCs(std::vector<igtl_uint32>& ssrcs)
+  {
+    ssrcs.clear();
+    this->contextsLock->Lock();
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it;
+    for (it = this->contexts.begin(); it != this->contexts.end(); ++it)
+      {
+      ssrcs.push_back(it->first);
+      }
+    this->contextsLock->Unlock();
+  }
+
+  int MessageRTPDemultiplexer::GetNumberOfContexts()
+  {
+    this->contextsLock->Lock();
+    int numberOfContexts = this->contexts.size();
+    this->contextsLock->Unlock();
+    return numberOfContexts;
+  }
+
+  int MessageRTPDemultiplexer::RemoveContext(igtl_uint32 ssrc)
+  {
+    this->contextsLock->Lock();
+    int numberOfRemovedContexts = this->contexts.erase(ssrc);
+    this->contextsLock->Unlock();
+    return numberOfRemovedContexts;
+  }
+
+  void MessageRTPDemultiplexer::SetNumberOfThreads(int numberOfThreads)
+  {
+    if (numberOfThreads < 1)
+      {
+      numberOfThreads = 1;
+      }
+    if (numberOfThreads > IGTL_MAX_THREADS)
+      {
+      numberOfThreads = IGTL_MAX_THREADS;
+      }
+    this->NumberOfThreads = numberOfThreads;
+  }
+
+  void MessageRTPDemultiplexer::SetRTPPayloadLength(unsigned int payloadLength)
+  {
+    this->contextsLock->Lock();
+    this->RTPPayloadLength = payloadLength;
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it;
+    for (it = this->contexts.begin(); it != this->contexts.end(); ++it)
+      {
+      it->second->SetRTPPayloadLength(payloadLength);
+      }
+    this->contextsLock->Unlock();
+  }
+
+  void MessageRTPDemultiplexer::SetNACKEnabled(bool enable)
+  {
+    this->contextsLock->Lock();
+    this->NACKEnabled = enable;
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer>::iterator it;
+    for (it = this->contexts.begin(); it != this->contexts.end(); ++it)
+      {
+      it->second->SetNACKEnabled(enable);
+      }
+    this->contextsLock->Unlock();
+  }
+
+} // namespace igtl
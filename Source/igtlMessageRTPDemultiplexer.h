@@ -0,0 +1,108 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageRTPDemultiplexer_h
+#define __igtlMessageRTPDemultiplexer_h
+
+#include <map>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageRTPWrapper.h"
+#include "igtlMultiThreader.h"
+#include "igtlMutexLock.h"
+
+namespace igtl
+{
+  /// The MessageRTPDemultiplexer class splits the RTP packets received from several senders
+  /// by their synchronization source identifier (SSRC). Each SSRC gets its own reassembly context,
+  /// a MessageRTPWrapper with its own packet buffer, reorder buffers and lock, so that the packets
+  /// of different senders never compete for the same lock and can be unwrapped on separate threads.
+  ///
+  /// Typical use on the receiver side:
+  ///
+  ///   demultiplexer->SetNumberOfThreads(4);
+  ///   while (receiving)
+  ///     {
+  ///     int len = socket->ReadSocket(buffer, RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH);
+  ///     demultiplexer->PushDataIntoPacketBuffer(buffer, len);
+  ///     demultiplexer->UnWrapPacketsWithTypeAndName("IMAGE", "Imager");
+  ///     // the messages of each sender are in GetContext(ssrc)->unWrappedMessages
+  ///     }
+  class IGTLCommon_EXPORT MessageRTPDemultiplexer: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageRTPDemultiplexer, Object)
+    igtlNewMacro(igtl::MessageRTPDemultiplexer);
+
+  public:
+    /// Routes a UDP packet to the reassembly context of its SSRC. The context is created on the first packet of the SSRC.
+    /// Returns 1 on success, 0 if the packet is too short to carry an RTP header.
+    int PushDataIntoPacketBuffer(igtlUint8* UDPPacket, igtlUint16 PacketLen);
+
+    /// Unwraps the buffered packets of all the contexts. The contexts are distributed over NumberOfThreads threads,
+    /// each context is processed by a single thread. Returns the number of processed packets.
+    int UnWrapPacketsWithTypeAndName(const char *deviceType, const char * deviceName);
+
+    /// Gets the reassembly context of the SSRC. Returns a null pointer if no packet has been received from the SSRC.
+    MessageRTPWrapper::Pointer GetContext(igtl_uint32 ssrc);
+
+    /// Gets the SSRCs received so far.
+    void GetSSRCs(std::vector<igtl_uint32>& ssrcs);
+
+    int GetNumberOfContexts();
+
+    /// Removes the context of the SSRC, e.g. when the sender left the session. Returns 0 if the SSRC is unknown.
+    int RemoveContext(igtl_uint32 ssrc);
+
+    /// Sets the number of threads used by UnWrapPacketsWithTypeAndName(), clamped to 1 - IGTL_MAX_THREADS.
+    void SetNumberOfThreads(int numberOfThreads);
+
+    int GetNumberOfThreads(){return this->NumberOfThreads;};
+
+    /// Sets the RTP payload length of the current and future contexts.
+    void SetRTPPayloadLength(unsigned int payloadLength);
+
+    /// Enables the NACK gap detection of the current and future contexts.
+    void SetNACKEnabled(bool enable);
+
+  protected:
+    MessageRTPDemultiplexer();
+    ~MessageRTPDemultiplexer();
+
+    static void* UnWrapThreadFunction(void* ptr);
+
+  private:
+    /// Data shared by the threads of one UnWrapPacketsWithTypeAndName() call.
+    class UnWrapJob
+    {
+    public:
+      std::vector<MessageRTPWrapper*> contexts;
+      std::vector<int> numberOfProcessedPackets;
+      const char* deviceType;
+      const char* deviceName;
+    };
+
+    std::map<igtl_uint32, MessageRTPWrapper::Pointer> contexts;
+    MutexLock::Pointer contextsLock;
+    MultiThreader::Pointer threader;
+    int NumberOfThreads;
+    unsigned int RTPPayloadLength;
+    bool NACKEnabled;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageRTPDemultiplexer_h
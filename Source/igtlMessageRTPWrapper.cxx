@@ -45,35 +45,29 @@ namespace igtl {
     this->packetIntervalTime = 1;
     this->SSRC = 0;
     this->RTPPayloadType = 96; // https://tools.ietf.org/html/rfc3551#page-32 ,96 to 127 is for dynamic allocated type.
+    this->retransmitCacheSize = 0;
+    this->messageDeadline = 200000000; // 200 ms
+    this->NACKRetryInterval = 20000000; // 20 ms
+    this->NACKEnabled = false;
+    this->numberOfAbandonedPackets = 0;
+    this->numberOfRetransmittedPackets = 0;
   }
   
   MessageRTPWrapper::~MessageRTPWrapper()
   {
     glock->Lock();
-    std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator itr = this->reorderBufferMap.begin();
-    while (itr != this->reorderBufferMap.end())
+    std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator itr;
+    for (itr = this->reorderBufferMap.begin(); itr != this->reorderBufferMap.end(); ++itr)
       {
-      // found it - delete it
-      itr->second->~ReorderBuffer();
-      this->reorderBufferMap.erase(itr);
-      if(this->reorderBufferMap.size()==0)
-        {
-        break;
-        }
-      itr++;
+      delete itr->second;
       }
-    std::map<igtl_uint32, igtl::UnWrappedMessage*>::iterator itr2 = this->unWrappedMessages.begin();
-    while (itr2 != this->unWrappedMessages.end())
+    this->reorderBufferMap.clear();
+    std::map<igtl_uint32, igtl::UnWrappedMessage*>::iterator itr2;
+    for (itr2 = this->unWrappedMessages.begin(); itr2 != this->unWrappedMessages.end(); ++itr2)
       {
-      // found it - delete it
-      itr2->second->~UnWrappedMessage();
-      this->unWrappedMessages.erase(itr2);
-      if(this->unWrappedMessages.size()==0)
-        {
-        break;
-        }
-      itr2++;
+      delete itr2->second;
       }
+    this->unWrappedMessages.clear();
     glock->Unlock();
     glock = NULL;
   }
@@ -119,6 +113,15 @@ namespace igtl {
   
   int MessageRTPWrapper::PushDataIntoPacketBuffer(igtlUint8* UDPPacket, igtlUint16 PacketLen)
   {
+    if (this->latencyRecorder.IsNotNull() && PacketLen >= RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE)
+      {
+      // The lower two bytes of the message ID precede the fragment field, see SetMSGHeader().
+      igtl_uint8* messageIDBytes = UDPPacket + RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE-sizeof(messageID);
+      igtl_uint32 frameID = (messageIDBytes[0] << 8) | messageIDBytes[1];
+      igtl_uint64 now = igtl::LatencyRecorder::GetCurrentTimeInNanoseconds();
+      this->latencyRecorder->StampIfUnset(frameID, igtl::LatencyRecorder::STAGE_FIRST_PACKET_RECEIVED, now);
+      this->latencyRecorder->SetStamp(frameID, igtl::LatencyRecorder::STAGE_LAST_PACKET_RECEIVED, now);
+      }
     this->glock->Lock();
     if(this->incommingPackets.pPacketLengthInByte.size()>PacketMaximumBufferNum)
       {
@@ -191,6 +194,11 @@ namespace igtl {
   
   int MessageRTPWrapper::WrapMessageAndPushToBuffer(igtl_uint8* messagePackPointer, int msgtotalLen)
   {
+    if (this->latencyRecorder.IsNotNull())
+      {
+      igtl_uint8* messageIDBytes = messagePackPointer+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE-sizeof(messageID);
+      this->latencyRecorder->SetStamp((messageIDBytes[2] << 8) | messageIDBytes[3], igtl::LatencyRecorder::STAGE_WRAP, igtl::LatencyRecorder::GetCurrentTimeInNanoseconds());
+      }
     igtl_uint8* messageContentPointer = messagePackPointer+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE;
     this->SetMSGHeader((igtl_uint8*)messagePackPointer);
     int MSGContentLength = msgtotalLen - IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE; // this is the m_content size + meta data size
@@ -202,6 +210,7 @@ namespace igtl {
       status = this->WrapMessage(leftmessageContent, leftMsgLen);
       if (status == igtl::MessageRTPWrapper::ProcessFragment || status == igtl::MessageRTPWrapper::PacketReady)
         {
+        this->CachePacketForRetransmission(this->GetPackPointer(), this->GetPackedMSGLocation());
         this->glock->Lock();
         if(this->outgoingPackets.pPacketLengthInByte.size()>PacketMaximumBufferNum)
           {
@@ -233,9 +242,9 @@ namespace igtl {
   
   int MessageRTPWrapper::UnWrapPacketWithTypeAndName(const char *deviceType, const char * deviceName)
   {
+    this->glock->Lock();
     if (this->incommingPackets.pPacketLengthInByte.size())
       {
-      this->glock->Lock();
       igtlUint8 * UDPPacket;
       igtlUint16 totMsgLen;
       if(this->FCFS==true)
@@ -270,6 +279,25 @@ namespace igtl {
         timeIncrement = BYTE_SWAP_INT32(timeIncrement);
         SSRC = BYTE_SWAP_INT32(SSRC);
         }
+      igtl_uint64 now = 0;
+      if (this->NACKEnabled)
+        {
+        now = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+        this->glock->Lock();
+        this->PurgeStaleData(now);
+        int sequenceState = this->UpdateSequenceState(SSRC, rtpProfileBytes & 0xFFFF, now);
+        this->glock->Unlock();
+        if (sequenceState == 0)
+          {
+          // duplicated packet, e.g. a retransmission of a packet which arrived late.
+          delete[] UDPPacket;
+          return 1;
+          }
+        if (sequenceState == 2 && this->feedbackSocket.IsNotNull())
+          {
+          this->SendNACK(this->feedbackSocket);
+          }
+        }
       int curPackedMSGLocation = RTP_HEADER_LENGTH;
       status = WaitingForAnotherPacket;
       while(curPackedMSGLocation<totMsgLen)
@@ -303,9 +331,10 @@ namespace igtl {
         std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator it = this->reorderBufferMap.find(messageID);
         if (it == this->reorderBufferMap.end())
           {
-          this->reorderBufferMap.insert(std::pair<igtl_uint32,igtl::ReorderBuffer*>(messageID,new igtl::ReorderBuffer()));
+          igtl::ReorderBuffer* newBuffer = new igtl::ReorderBuffer();
+          newBuffer->firstArrivalTime = now;
+          this->reorderBufferMap.insert(std::pair<igtl_uint32,igtl::ReorderBuffer*>(messageID,newBuffer));
           it = this->reorderBufferMap.find(messageID);
-          
           }
         this->reorderBuffer = it->second;
         header->Unpack();
@@ -318,9 +347,9 @@ namespace igtl {
             reorderBuffer->receivedFirstFrag = true;
             reorderBuffer->receivedLastFrag = true;
             reorderBuffer->firstPacketLen = header->GetBodySizeToRead()+IGTL_HEADER_SIZE;
-            igtl::UnWrappedMessage* message = new igtl::UnWrappedMessage();
-            message->messageDataLength = reorderBuffer->firstPacketLen;
+            igtl::UnWrappedMessage* message = new igtl::UnWrappedMessage(reorderBuffer->firstPacketLen);
             memcpy(message->messagePackPointer, reorderBuffer->firstFragBuffer, reorderBuffer->firstPacketLen);
+            this->StampReassembledMessage(message);
             glock->Lock();
             unWrappedMessages.insert(std::pair<igtl_uint32, igtl::UnWrappedMessage*>(it->first,message));
             glock->Unlock();
@@ -338,7 +367,7 @@ namespace igtl {
             int bodyMsgLength = (RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE);//this is the length of the body within a full fragment Packet
             if(fragmentField==FragmentBeginIndicator)// To do, fix the issue when later fragment arrives earlier than the beginning fragment
               {
-              *(UDPPacket + curPackedMSGLocation + IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE-FragmentIndexBytes) = NoFragmentIndicator; // set the fragment no. to 0000
+              // The fragment field has already been replaced by the lower bytes of the message ID.
               memcpy(reorderBuffer->firstFragBuffer, UDPPacket + curPackedMSGLocation, totMsgLen-curPackedMSGLocation);
               reorderBuffer->firstPacketLen = totMsgLen-curPackedMSGLocation;
               curPackedMSGLocation = totMsgLen;
@@ -357,38 +386,56 @@ namespace igtl {
             else if(fragmentField>FragmentBeginIndicator && fragmentField<FragmentEndIndicator)
               {
               int curFragNumber = fragmentField - FragmentBeginIndicator;
-              memcpy(reorderBuffer->buffer+(curFragNumber-1)*bodyMsgLength, UDPPacket + RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE, totMsgLen-(RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE));
+              unsigned int fragmentEnd = curFragNumber*bodyMsgLength;
+              if (reorderBuffer->buffer.size() < fragmentEnd)
+                {
+                reorderBuffer->buffer.resize(fragmentEnd);
+                }
+              memcpy(&reorderBuffer->buffer[(curFragNumber-1)*bodyMsgLength], UDPPacket + RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE, totMsgLen-(RTP_HEADER_LENGTH+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE));
               status = WaitingForAnotherPacket;
               }
             reorderBuffer->filledPacketNum++;
             if(reorderBuffer->receivedFirstFrag == true && reorderBuffer->receivedLastFrag == true && reorderBuffer->filledPacketNum == reorderBuffer->totFragNumber)
               {
-              igtl::UnWrappedMessage* message = new igtl::UnWrappedMessage();
-              message->messageDataLength = reorderBuffer->lastPacketLen+reorderBuffer->firstPacketLen+ (reorderBuffer->totFragNumber-2)*(RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE);
+              igtl::UnWrappedMessage* message = new igtl::UnWrappedMessage(reorderBuffer->lastPacketLen+reorderBuffer->firstPacketLen+ (reorderBuffer->totFragNumber-2)*(RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE));
               memcpy(message->messagePackPointer, reorderBuffer->firstFragBuffer, reorderBuffer->firstPacketLen);
-              memcpy(message->messagePackPointer+reorderBuffer->firstPacketLen, reorderBuffer->buffer, (RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE)*(reorderBuffer->totFragNumber-2));
+              if (reorderBuffer->totFragNumber > 2)
+                {
+                memcpy(message->messagePackPointer+reorderBuffer->firstPacketLen, &reorderBuffer->buffer[0], (RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE)*(reorderBuffer->totFragNumber-2));
+                }
               memcpy(message->messagePackPointer+reorderBuffer->firstPacketLen+(RTPPayloadLength-IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE)*(reorderBuffer->totFragNumber-2), reorderBuffer->lastFragBuffer, reorderBuffer->lastPacketLen);
+              this->StampReassembledMessage(message);
               glock->Lock();
               unWrappedMessages.insert(std::pair<igtl_uint32, igtl::UnWrappedMessage*>(it->first,message));
               glock->Unlock();
-              std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator it_forDelete= this->reorderBufferMap.begin();
-              while(it_forDelete != this->reorderBufferMap.end())
+              if (this->NACKEnabled)
+                {
+                // Older incomplete messages may still be completed by retransmissions, they are purged by the message deadline.
+                delete it->second;
+                it->second = NULL;
+                this->reorderBufferMap.erase(it);
+                }
+              else
                 {
-                delete it_forDelete->second;
-                it_forDelete->second = NULL;
-                this->reorderBufferMap.erase(it_forDelete);
-                if (this->reorderBufferMap.size())
+                std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator it_forDelete= this->reorderBufferMap.begin();
+                while(it_forDelete != this->reorderBufferMap.end())
                   {
-                  if (it_forDelete->first == it->first)
+                  delete it_forDelete->second;
+                  it_forDelete->second = NULL;
+                  this->reorderBufferMap.erase(it_forDelete);
+                  if (this->reorderBufferMap.size())
+                    {
+                    if (it_forDelete->first == it->first)
+                      {
+                      break;
+                      }
+                    }
+                  else
                     {
                     break;
                     }
+                  it_forDelete = this->reorderBufferMap.begin();
                   }
-                else
-                  {
-                  break;
-                  }
-                it_forDelete = this->reorderBufferMap.begin();
                 }
               status = MessageReady;
               }
@@ -403,12 +450,20 @@ namespace igtl {
       delete[] UDPPacket;
       return 1;
       }
+    this->glock->Unlock();
     return 0;
   }
   
   int MessageRTPWrapper::WrapMessageAndSend(igtl::UDPServerSocket::Pointer &socket, igtl_uint8* messagePackPointer, int msgtotalLen)
   {
     igtl_uint8* messageContentPointer = messagePackPointer+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE;
+    igtl_uint32 frameID = 0;
+    if (this->latencyRecorder.IsNotNull())
+      {
+      igtl_uint8* messageIDBytes = messagePackPointer+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE-sizeof(messageID);
+      frameID = (messageIDBytes[2] << 8) | messageIDBytes[3];
+      this->latencyRecorder->SetStamp(frameID, igtl::LatencyRecorder::STAGE_WRAP, igtl::LatencyRecorder::GetCurrentTimeInNanoseconds());
+      }
     this->SetMSGHeader((igtl_uint8*)messagePackPointer);
     int MSGContentLength = msgtotalLen- IGTL_HEADER_SIZE-IGTL_EXTENDED_HEADER_SIZE; // this is the m_content size + meta data size
     int leftMsgLen = MSGContentLength;
@@ -424,6 +479,7 @@ namespace igtl {
         {
         this->wrapperTimer->GetTime();
         this->PacketBeforeSendTimeStampList.push_back(this->wrapperTimer->GetTimeStampInNanoseconds());
+        this->CachePacketForRetransmission(this->GetPackPointer(), this->GetPackedMSGLocation());
         this->glock->Lock();
         int numByteSent = socket->WriteSocket(this->GetPackPointer(), this->GetPackedMSGLocation());
         this->glock->Unlock();
@@ -436,6 +492,11 @@ namespace igtl {
       leftmessageContent = messageContentPointer + this->GetCurMSGLocation();
       leftMsgLen = MSGContentLength - this->GetCurMSGLocation();
       }while(leftMsgLen>0 && status!=igtl::MessageRTPWrapper::PacketReady); // to do when bodyMsgLen
+    if (this->latencyRecorder.IsNotNull() && this->PacketSendTimeStampList.size())
+      {
+      this->latencyRecorder->SetStamp(frameID, igtl::LatencyRecorder::STAGE_FIRST_PACKET_SENT, this->PacketSendTimeStampList.front());
+      this->latencyRecorder->SetStamp(frameID, igtl::LatencyRecorder::STAGE_LAST_PACKET_SENT, this->PacketSendTimeStampList.back());
+      }
     return 1;
   }
   
@@ -598,6 +659,307 @@ namespace igtl {
   }
   
   
+  void MessageRTPWrapper::SetRetransmitCacheSize(unsigned int numPackets)
+  {
+    if (numPackets > RetransmitCacheMaximumSize)
+      {
+      numPackets = RetransmitCacheMaximumSize;
+      }
+    this->glock->Lock();
+    this->retransmitCacheSize = numPackets;
+    while (this->retransmitCacheOrder.size() > this->retransmitCacheSize)
+      {
+      this->retransmitCache.erase(this->retransmitCacheOrder.front());
+      this->retransmitCacheOrder.pop_front();
+      }
+    this->glock->Unlock();
+  }
+  
+  void MessageRTPWrapper::CachePacketForRetransmission(igtl_uint8* packet, int packetLen)
+  {
+    if (this->retransmitCacheSize == 0 || packetLen < RTP_HEADER_LENGTH)
+      {
+      return;
+      }
+    // the sequence number is read back from the RTP header, so it is the one seen by the receiver.
+    igtl_uint16 seqNum = (igtl_uint16)((packet[2] << 8) | packet[3]);
+    igtl_uint64 now = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+    this->glock->Lock();
+    RetransmitPacket& cachedPacket = this->retransmitCache[seqNum];
+    cachedPacket.data.assign(packet, packet + packetLen);
+    cachedPacket.sendTime = now;
+    this->retransmitCacheOrder.push_back(seqNum);
+    while (this->retransmitCacheOrder.size() > this->retransmitCacheSize)
+      {
+      this->retransmitCache.erase(this->retransmitCacheOrder.front());
+      this->retransmitCacheOrder.pop_front();
+      }
+    this->glock->Unlock();
+  }
+  
+  int MessageRTPWrapper::UpdateSequenceState(igtl_uint32 ssrc, igtl_uint16 seqNum, igtl_uint64 now)
+  {
+    RTPStreamState& state = this->streamStates[ssrc];
+    if (!state.initialized)
+      {
+      state.initialized = true;
+      state.highestSeqNum = seqNum;
+      return 1;
+      }
+    // sequence numbers wrap around at 2^16, the signed difference gives the distance to the highest received number.
+    igtl_int16 distance = (igtl_int16)(igtl_uint16)(seqNum - state.highestSeqNum);
+    if (distance == 0)
+      {
+      return 0;
+      }
+    if (distance > NACKMaximumSequenceGap || distance < -NACKMaximumSequenceGap)
+      {
+      // the sender was restarted or has been silent for too long, resynchronize.
+      this->numberOfAbandonedPackets += state.missingPackets.size();
+      state.missingPackets.clear();
+      state.highestSeqNum = seqNum;
+      return 1;
+      }
+    if (distance > 0)
+      {
+      int gapDetected = 1;
+      for (igtl_uint16 missingSeqNum = state.highestSeqNum + 1; missingSeqNum != seqNum; missingSeqNum++)
+        {
+        state.missingPackets[missingSeqNum] = MissingPacket(now);
+        gapDetected = 2;
+        }
+      state.highestSeqNum = seqNum;
+      return gapDetected;
+      }
+    std::map<igtl_uint16, MissingPacket>::iterator it = state.missingPackets.find(seqNum);
+    if (it == state.missingPackets.end())
+      {
+      // already received, or already abandoned.
+      return 0;
+      }
+    state.missingPackets.erase(it);
+    return 1;
+  }
+  
+  void MessageRTPWrapper::PurgeStaleData(igtl_uint64 now)
+  {
+    if (this->messageDeadline == 0)
+      {
+      return;
+      }
+    std::map<igtl_uint32, RTPStreamState>::iterator stateIt;
+    for (stateIt = this->streamStates.begin(); stateIt != this->streamStates.end(); ++stateIt)
+      {
+      std::map<igtl_uint16, MissingPacket>& missingPackets = stateIt->second.missingPackets;
+      std::map<igtl_uint16, MissingPacket>::iterator it = missingPackets.begin();
+      while (it != missingPackets.end())
+        {
+        if (now - it->second.detectedTime > this->messageDeadline)
+          {
+          missingPackets.erase(it++);
+          this->numberOfAbandonedPackets++;
+          }
+        else
+          {
+          ++it;
+          }
+        }
+      }
+    std::map<igtl_uint32, igtl::ReorderBuffer*>::iterator bufferIt = this->reorderBufferMap.begin();
+    while (bufferIt != this->reorderBufferMap.end())
+      {
+      if (bufferIt->second && now - bufferIt->second->firstArrivalTime > this->messageDeadline)
+        {
+        delete bufferIt->second;
+        this->reorderBufferMap.erase(bufferIt++);
+        }
+      else
+        {
+        ++bufferIt;
+        }
+      }
+  }
+  
+  int MessageRTPWrapper::GetNumberOfMissingPackets()
+  {
+    int numberOfMissingPackets = 0;
+    this->glock->Lock();
+    std::map<igtl_uint32, RTPStreamState>::iterator it;
+    for (it = this->streamStates.begin(); it != this->streamStates.end(); ++it)
+      {
+      numberOfMissingPackets += it->second.missingPackets.size();
+      }
+    this->glock->Unlock();
+    return numberOfMissingPackets;
+  }
+  
+  static void WriteUint32InNetworkOrder(igtl_uint8* destination, igtl_uint32 value)
+  {
+    if (igtl_is_little_endian())
+      {
+      value = BYTE_SWAP_INT32(value);
+      }
+    memcpy(destination, &value, sizeof(value));
+  }
+  
+  static igtl_uint32 ReadUint32InNetworkOrder(const igtl_uint8* source)
+  {
+    igtl_uint32 value;
+    memcpy(&value, source, sizeof(value));
+    if (igtl_is_little_endian())
+      {
+      value = BYTE_SWAP_INT32(value);
+      }
+    return value;
+  }
+  
+  int MessageRTPWrapper::SendNACK(igtl::UDPServerSocket::Pointer &socket)
+  {
+    if (socket.IsNull())
+      {
+      return -1;
+      }
+    igtl_uint64 now = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+    std::vector<std::vector<igtl_uint8> > NACKPackets;
+    int numberOfRequests = 0;
+    this->glock->Lock();
+    std::map<igtl_uint32, RTPStreamState>::iterator stateIt;
+    for (stateIt = this->streamStates.begin(); stateIt != this->streamStates.end(); ++stateIt)
+      {
+      // Generic NACK feedback control information: packet ID of the lost packet
+      // followed by a bit mask of the lost packets among the following 16.
+      std::vector<igtl_uint32> FCIs;
+      std::map<igtl_uint16, MissingPacket>::iterator it;
+      for (it = stateIt->second.missingPackets.begin(); it != stateIt->second.missingPackets.end(); ++it)
+        {
+        if (it->second.numberOfNACKs > 0 && now - it->second.lastNACKTime < this->NACKRetryInterval)
+          {
+          continue;
+          }
+        if (this->messageDeadline > 0 && now - it->second.detectedTime > this->messageDeadline)
+          {
+          // stale, it will be abandoned by the next UnWrapPacketWithTypeAndName() call.
+          continue;
+          }
+        igtl_uint16 distance = 0;
+        if (FCIs.size())
+          {
+          distance = it->first - (igtl_uint16)(FCIs.back() >> 16);
+          }
+        if (FCIs.size() && distance >= 1 && distance <= 16)
+          {
+          FCIs.back() |= (1 << (distance - 1));
+          }
+        else if (FCIs.size() < NACKMaximumFCINum)
+          {
+          FCIs.push_back((igtl_uint32)it->first << 16);
+          }
+        else
+          {
+          break;
+          }
+        it->second.lastNACKTime = now;
+        it->second.numberOfNACKs++;
+        numberOfRequests++;
+        }
+      if (FCIs.size() == 0)
+        {
+        continue;
+        }
+      std::vector<igtl_uint8> packet(RTCP_NACK_HEADER_LENGTH + FCIs.size() * sizeof(igtl_uint32));
+      // V=2, P=0, FMT, PT, length in 32-bit words minus one
+      igtl_uint32 commonHeader = 0x80000000 | (RTCP_FMT_GENERIC_NACK << 24) | (RTCP_PAYLOAD_TYPE_RTPFB << 16) | (igtl_uint32)(packet.size() / 4 - 1);
+      WriteUint32InNetworkOrder(&packet[0], commonHeader);
+      memcpy(&packet[4], &this->SSRC, sizeof(this->SSRC)); // SSRC is stored in network byte order
+      WriteUint32InNetworkOrder(&packet[8], stateIt->first);
+      for (unsigned int i = 0; i < FCIs.size(); i++)
+        {
+        WriteUint32InNetworkOrder(&packet[RTCP_NACK_HEADER_LENGTH + i * sizeof(igtl_uint32)], FCIs[i]);
+        }
+      NACKPackets.push_back(packet);
+      }
+    this->glock->Unlock();
+    for (unsigned int i = 0; i < NACKPackets.size(); i++)
+      {
+      if (socket->WriteSocket(&NACKPackets[i][0], NACKPackets[i].size()) <= 0)
+        {
+        return -1;
+        }
+      }
+    return numberOfRequests;
+  }
+  
+  int MessageRTPWrapper::ProcessNACKPacket(igtl::UDPServerSocket::Pointer &socket, igtl_uint8* packet, int packetLen)
+  {
+    if (packet == NULL || packetLen < RTCP_NACK_HEADER_LENGTH)
+      {
+      return -1;
+      }
+    igtl_uint32 commonHeader = ReadUint32InNetworkOrder(packet);
+    if ((commonHeader >> 30) != 2
+        || ((commonHeader >> 24) & 0x1F) != RTCP_FMT_GENERIC_NACK
+        || ((commonHeader >> 16) & 0xFF) != RTCP_PAYLOAD_TYPE_RTPFB)
+      {
+      return -1;
+      }
+    int packetLenInHeader = ((commonHeader & 0xFFFF) + 1) * 4;
+    if (packetLenInHeader > packetLen || memcmp(packet + 8, &this->SSRC, sizeof(this->SSRC)) != 0)
+      {
+      return -1;
+      }
+    igtl_uint64 now = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+    std::vector<std::vector<igtl_uint8> > resentPackets;
+    this->glock->Lock();
+    for (int offset = RTCP_NACK_HEADER_LENGTH; offset + 4 <= packetLenInHeader; offset += 4)
+      {
+      igtl_uint32 FCI = ReadUint32InNetworkOrder(packet + offset);
+      igtl_uint16 packetID = (igtl_uint16)(FCI >> 16);
+      igtl_uint16 bitMask = (igtl_uint16)(FCI & 0xFFFF);
+      for (int i = 0; i <= 16; i++)
+        {
+        if (i > 0 && !(bitMask & (1 << (i - 1))))
+          {
+          continue;
+          }
+        std::map<igtl_uint16, RetransmitPacket>::iterator it = this->retransmitCache.find((igtl_uint16)(packetID + i));
+        if (it == this->retransmitCache.end())
+          {
+          continue;
+          }
+        if (this->messageDeadline > 0 && now - it->second.sendTime > this->messageDeadline)
+          {
+          continue;
+          }
+        resentPackets.push_back(it->second.data);
+        }
+      }
+    this->glock->Unlock();
+    int numberOfResentPackets = 0;
+    for (unsigned int i = 0; i < resentPackets.size(); i++)
+      {
+      this->glock->Lock();
+      int numByteSent = socket->WriteSocket(&resentPackets[i][0], resentPackets[i].size());
+      this->glock->Unlock();
+      if (numByteSent == (int)resentPackets[i].size())
+        {
+        numberOfResentPackets++;
+        }
+      }
+    this->numberOfRetransmittedPackets += numberOfResentPackets;
+    return numberOfResentPackets;
+  }
+  
+  void MessageRTPWrapper::StampReassembledMessage(igtl::UnWrappedMessage* message)
+  {
+    if (this->latencyRecorder.IsNull() || message->messageDataLength < IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE)
+      {
+      return;
+      }
+    igtl_uint8* messageIDBytes = message->messagePackPointer+IGTL_HEADER_SIZE+IGTL_EXTENDED_HEADER_SIZE-sizeof(messageID);
+    igtl_uint32 frameID = (messageIDBytes[2] << 8) | messageIDBytes[3];
+    this->latencyRecorder->SetStamp(frameID, igtl::LatencyRecorder::STAGE_REASSEMBLED, igtl::LatencyRecorder::GetCurrentTimeInNanoseconds());
+  }
+  
   igtl::MessageBase::Pointer MessageRTPWrapper::UnWrapMessage(igtl_uint8* messageContent, int bodyMsgLen)
   {
     return NULL;
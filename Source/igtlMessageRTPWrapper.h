@@ -16,6 +16,7 @@
 #define __igtlMessageRTPWrapper_h
 
 #include <string>
+#include <deque>
 
 #include "igtlObject.h"
 #include "igtlMacro.h"
@@ -28,6 +29,7 @@
 #include "igtl_header.h"
 #include "igtl_util.h"
 #include "igtlTimeStamp.h"
+#include "igtlLatencyRecorder.h"
 #include "igtlOSUtil.h"
 
 
@@ -38,6 +40,17 @@
 #define FragmentBeginIndicator 0X8000
 #define FragmentEndIndicator 0XE000
 #define NoFragmentIndicator 0X0000
+/// Upper bound of the send-side retransmit cache, in packets. It is kept well below 2^15 so that a sequence number
+/// can never be reused while an older packet with the same number is still cached.
+#define RetransmitCacheMaximumSize 16384
+/// Sequence number jumps larger than this are treated as a stream restart rather than packet loss.
+#define NACKMaximumSequenceGap 512
+/// Maximum number of (PID, BLP) entries carried by one NACK packet.
+#define NACKMaximumFCINum 256
+/// RTCP transport layer feedback packet type and the generic NACK format, see RFC 4585 section 6.2.1
+#define RTCP_PAYLOAD_TYPE_RTPFB 205
+#define RTCP_FMT_GENERIC_NACK 1
+#define RTCP_NACK_HEADER_LENGTH 12
 
 namespace igtl
 {
@@ -122,10 +135,10 @@ namespace igtl
   class ReorderBuffer
   {
   public:
-    ReorderBuffer(){firstPacketLen=0;lastPacketLen=0;filledPacketNum=0; totFragNumber = 0;receivedLastFrag=false;receivedFirstFrag=false;};
-    ReorderBuffer(ReorderBuffer const &anotherBuffer){firstPacketLen=anotherBuffer.firstPacketLen;lastPacketLen=anotherBuffer.lastPacketLen;filledPacketNum=anotherBuffer.filledPacketNum;receivedLastFrag=anotherBuffer.receivedLastFrag;receivedFirstFrag=anotherBuffer.receivedFirstFrag;};
+    ReorderBuffer(){firstPacketLen=0;lastPacketLen=0;filledPacketNum=0; totFragNumber = 0;receivedLastFrag=false;receivedFirstFrag=false;firstArrivalTime=0;};
+    ReorderBuffer(ReorderBuffer const &anotherBuffer){firstPacketLen=anotherBuffer.firstPacketLen;lastPacketLen=anotherBuffer.lastPacketLen;filledPacketNum=anotherBuffer.filledPacketNum;receivedLastFrag=anotherBuffer.receivedLastFrag;receivedFirstFrag=anotherBuffer.receivedFirstFrag;firstArrivalTime=anotherBuffer.firstArrivalTime;};
     ~ReorderBuffer(){};
-    unsigned char buffer[RTP_PAYLOAD_LENGTH*(16384-2)];  // we use 14 bits for fragment number, 2^14 = 16384. maximum
+    std::vector<unsigned char> buffer;  // middle fragments, grows with the fragments received. we use 14 bits for fragment number, 2^14 = 16384. maximum
     unsigned char firstFragBuffer[RTP_PAYLOAD_LENGTH];
     unsigned char lastFragBuffer[RTP_PAYLOAD_LENGTH];
     igtl_uint32 firstPacketLen;
@@ -134,12 +147,45 @@ namespace igtl
     igtl_uint32 totFragNumber;
     bool receivedLastFrag;
     bool receivedFirstFrag;
+    igtl_uint64 firstArrivalTime; ///< time in nanosecond when the first fragment of the message arrived
+  };
+  
+  /// A sent packet kept by the sender until it is evicted or requested again by a NACK.
+  class RetransmitPacket
+  {
+  public:
+    RetransmitPacket(){sendTime = 0;};
+    std::vector<unsigned char> data;
+    igtl_uint64 sendTime;
+  };
+  
+  /// A sequence number detected as missing by the receiver.
+  class MissingPacket
+  {
+  public:
+    MissingPacket(){detectedTime = 0; lastNACKTime = 0; numberOfNACKs = 0;};
+    MissingPacket(igtl_uint64 time){detectedTime = time; lastNACKTime = 0; numberOfNACKs = 0;};
+    igtl_uint64 detectedTime;
+    igtl_uint64 lastNACKTime;
+    int numberOfNACKs;
+  };
+  
+  /// Receiver side sequence number state of one synchronization source.
+  class RTPStreamState
+  {
+  public:
+    RTPStreamState(){initialized = false; highestSeqNum = 0;};
+    bool initialized;
+    igtl_uint16 highestSeqNum;
+    std::map<igtl_uint16, MissingPacket> missingPackets;
   };
   
   class UnWrappedMessage
   {
   public:
     UnWrappedMessage(){messageDataLength = 0; messagePackPointer = new unsigned char[RTP_PAYLOAD_LENGTH*(16384-2)];};
+    /// Allocates only the length of the reassembled message.
+    UnWrappedMessage(igtl_uint32 length){messageDataLength = length; messagePackPointer = new unsigned char[length];};
     UnWrappedMessage(UnWrappedMessage const &anotherMessage){};
     ~UnWrappedMessage(){
       if(messagePackPointer)
@@ -238,6 +284,61 @@ namespace igtl
     
     unsigned int GetRTPPayloadLength(){return this->RTPPayloadLength;};
     
+    /// Selective retransmission (NACK) support.
+    ///
+    /// Sender side: packets produced by WrapMessageAndSend() and WrapMessageAndPushToBuffer() are kept in a
+    /// retransmit cache of SetRetransmitCacheSize() packets. NACK packets received from the feedback channel are
+    /// passed to ProcessNACKPacket(), which resends the requested packets that are still in the cache and younger
+    /// than the message deadline.
+    ///
+    /// Receiver side: with SetNACKEnabled(true), UnWrapPacketWithTypeAndName() tracks the RTP sequence numbers of each SSRC,
+    /// records gaps as missing packets and drops duplicated packets. SendNACK() sends a generic NACK (RFC 4585) for the
+    /// missing packets to the sender. Missing packets and incomplete messages older than the message deadline are abandoned.
+    
+    ///Set the number of sent packets kept for retransmission. 0 disables the retransmit cache.
+    void SetRetransmitCacheSize(unsigned int numPackets);
+    
+    unsigned int GetRetransmitCacheSize(){return this->retransmitCacheSize;};
+    
+    ///Set the time in nanosecond after which a message is considered stale, it will not be requested or resent anymore.
+    void SetMessageDeadline(igtl_uint64 nanoSecond){this->messageDeadline = nanoSecond;};
+    
+    igtl_uint64 GetMessageDeadline(){return this->messageDeadline;};
+    
+    ///Set the minimum time in nanosecond between two NACKs for the same missing packet.
+    void SetNACKRetryInterval(igtl_uint64 nanoSecond){this->NACKRetryInterval = nanoSecond;};
+    
+    igtl_uint64 GetNACKRetryInterval(){return this->NACKRetryInterval;};
+    
+    ///Enable the gap detection at the receiver side.
+    void SetNACKEnabled(bool enable){this->NACKEnabled = enable;};
+    
+    bool GetNACKEnabled(){return this->NACKEnabled;};
+    
+    ///Set the socket used to send a NACK as soon as a gap is detected by UnWrapPacketWithTypeAndName().
+    void SetFeedbackSocket(igtl::UDPServerSocket::Pointer &socket){this->feedbackSocket = socket;};
+    
+    ///Send NACK packets for the missing packets to the sender. Returns the number of requested packets, -1 on error.
+    int SendNACK(igtl::UDPServerSocket::Pointer &socket);
+    
+    ///Resend the packets requested by a NACK packet. Returns the number of resent packets, -1 if the packet is not a NACK for this sender.
+    int ProcessNACKPacket(igtl::UDPServerSocket::Pointer &socket, igtl_uint8* packet, int packetLen);
+    
+    ///Get the number of packets currently detected as missing.
+    int GetNumberOfMissingPackets();
+    
+    ///Get the number of missing packets given up after the message deadline.
+    igtl_uint64 GetNumberOfAbandonedPackets(){return this->numberOfAbandonedPackets;};
+    
+    ///Get the number of packets resent after NACK requests.
+    igtl_uint64 GetNumberOfRetransmittedPackets(){return this->numberOfRetransmittedPackets;};
+    
+    ///Set the recorder of the wrap, packet sent, packet received and reassembly stages of each message.
+    ///The messages are identified by the lower 16 bits of their message ID. A null pointer disables the recording.
+    void SetLatencyRecorder(igtl::LatencyRecorder::Pointer recorder){this->latencyRecorder = recorder;};
+    
+    igtl::LatencyRecorder::Pointer GetLatencyRecorder(){return this->latencyRecorder;};
+    
     std::map<igtl_uint32, igtl::UnWrappedMessage*> unWrappedMessages;
     
     igtl::SimpleMutexLock* glock;
@@ -252,6 +353,18 @@ namespace igtl
     
     int WrapMessage(igtl_uint8* messageContent, int bodyMsgLen);
     
+    /// Keeps a copy of the packet just wrapped in the retransmit cache.
+    void CachePacketForRetransmission(igtl_uint8* packet, int packetLen);
+    
+    /// Updates the sequence number state of the source, returns 0 if the packet is a duplicate.
+    int UpdateSequenceState(igtl_uint32 ssrc, igtl_uint16 seqNum, igtl_uint64 now);
+    
+    /// Gives up the missing packets and incomplete messages older than the message deadline.
+    void PurgeStaleData(igtl_uint64 now);
+    
+    /// Records the reassembly time of the message in the latency recorder.
+    void StampReassembledMessage(igtl::UnWrappedMessage* message);
+    
     
   private:
     unsigned int RTPPayloadLength;
@@ -275,6 +388,17 @@ namespace igtl
     PacketBuffer outgoingPackets;
     igtl::TimeStamp::Pointer wrapperTimer;
     bool FCFS; //first come first serve
+    unsigned int retransmitCacheSize;
+    std::map<igtl_uint16, RetransmitPacket> retransmitCache;
+    std::deque<igtl_uint16> retransmitCacheOrder;
+    igtl_uint64 messageDeadline;
+    igtl_uint64 NACKRetryInterval;
+    bool NACKEnabled;
+    std::map<igtl_uint32, RTPStreamState> streamStates;
+    igtl::UDPServerSocket::Pointer feedbackSocket;
+    igtl_uint64 numberOfAbandonedPackets;
+    igtl_uint64 numberOfRetransmittedPackets;
+    igtl::LatencyRecorder::Pointer latencyRecorder;
     void SleepInNanoSecond(int nanoSecond);
   };
   
@@ -0,0 +1,232 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageReader.h"
+#include "igtl_header.h"
+
+#include <string.h>
+
+namespace igtl {
+
+  MessageReader::MessageReader():Object()
+  {
+    this->m_Buffer.resize(MessageReaderDefaultBufferSize);
+    this->m_Begin = 0;
+    this->m_End = 0;
+    this->m_HeaderPointer = NULL;
+    this->m_BodySize = 0;
+    this->m_BodyOffset = 0;
+    this->m_NumberOfReceiveCalls = 0;
+  }
+
+  MessageReader::~MessageReader()
+  {
+  }
+
+  void MessageReader::SetSocket(Socket* socket)
+  {
+    this->m_Socket = socket;
+    this->m_Begin = 0;
+    this->m_End = 0;
+    this->m_HeaderPointer = NULL;
+    this->m_BodySize = 0;
+    this->m_BodyOffset = 0;
+    this->m_NumberOfReceiveCalls = 0;
+  }
+
+  void MessageReader::SetBufferSize(int size)
+  {
+    // At least a header
+    this->m_Buffer.resize(size < IGTL_HEADER_SIZE ? IGTL_HEADER_SIZE : size);
+    this->SetSocket(this->m_Socket);
+  }
+
+  int MessageReader::ReadHeader(MessageHeader* header)
+  {
+    if (header == NULL)
+      {
+      return 0;
+      }
+    if (this->GetBodySizeToRead() > 0)
+      {
+      int r = this->SkipBody();
+      if (r != 1)
+        {
+        return r;
+        }
+      }
+    int r = this->Fill(IGTL_HEADER_SIZE);
+    if (r != 1)
+      {
+      return r;
+      }
+
+    this->m_HeaderPointer = &this->m_Buffer[this->m_Begin];
+    header->InitPack();
+    memcpy(header->GetPackPointer(), this->m_HeaderPointer, IGTL_HEADER_SIZE);
+    this->m_Begin += IGTL_HEADER_SIZE;
+    header->Unpack();
+    this->m_BodySize = header->GetBodySizeToRead();
+    this->m_BodyOffset = 0;
+    if (this->m_BodySize < 0)
+      {
+      this->m_BodySize = 0;
+      return 0;
+      }
+    return 1;
+  }
+
+  int MessageReader::ReadBody(MessageBase* message)
+  {
+    if (message == NULL || message->GetPackBodySize() < this->m_BodySize)
+      {
+      return 0;
+      }
+    char* body = static_cast<char*>(message->GetPackBodyPointer());
+    int bufferSize = (int)this->m_Buffer.size();
+
+    while (this->m_BodyOffset < this->m_BodySize)
+      {
+      int remaining = this->m_BodySize - this->m_BodyOffset;
+      if (this->m_Begin == this->m_End && remaining >= bufferSize)
+        {
+        // Large body: read directly into the message.
+        int r = this->ReceiveBody(body + this->m_BodyOffset, remaining);
+        if (r != 1)
+          {
+          return r;
+          }
+        continue;
+        }
+      if (this->m_Begin == this->m_End)
+        {
+        // Small body: read through the buffer, with the following messages if they have arrived.
+        int r = this->Fill(remaining);
+        if (r != 1)
+          {
+          return r;
+          }
+        }
+      int n = this->m_End - this->m_Begin;
+      n = n < remaining ? n : remaining;
+      memcpy(body + this->m_BodyOffset, &this->m_Buffer[this->m_Begin], n);
+      this->m_Begin += n;
+      this->m_BodyOffset += n;
+      }
+    return 1;
+  }
+
+  const void* MessageReader::GetBodyPointer()
+  {
+    if (this->m_BodyOffset > 0 || this->m_BodySize > (int)this->m_Buffer.size())
+      {
+      return NULL;
+      }
+    if (this->Fill(this->m_BodySize) != 1)
+      {
+      return NULL;
+      }
+    const void* body = &this->m_Buffer[this->m_Begin];
+    this->m_Begin += this->m_BodySize;
+    this->m_BodyOffset = this->m_BodySize;
+    return body;
+  }
+
+  int MessageReader::SkipBody()
+  {
+    while (this->m_BodyOffset < this->m_BodySize)
+      {
+      int remaining = this->m_BodySize - this->m_BodyOffset;
+      if (this->m_Begin == this->m_End && remaining >= (int)this->m_Buffer.size())
+        {
+        // Large body: discarded by the socket without going through the buffer.
+        this->m_NumberOfReceiveCalls++;
+        int r = this->m_Socket.IsNull() ? 0 : this->m_Socket->Skip(remaining, 0);
+        if (r <= 0)
+          {
+          return r;
+          }
+        this->m_BodyOffset += r;
+        continue;
+        }
+      if (this->m_Begin == this->m_End)
+        {
+        int r = this->Fill(1);
+        if (r != 1)
+          {
+          return r;
+          }
+        }
+      int n = this->m_End - this->m_Begin;
+      n = n < remaining ? n : remaining;
+      this->m_Begin += n;
+      this->m_BodyOffset += n;
+      }
+    return 1;
+  }
+
+  int MessageReader::Fill(int size)
+  {
+    if (this->m_Socket.IsNull())
+      {
+      return 0;
+      }
+    if (this->m_End - this->m_Begin >= size)
+      {
+      return 1;
+      }
+    // The data read before is overwritten or moved.
+    this->m_HeaderPointer = NULL;
+    if (this->m_Begin == this->m_End)
+      {
+      this->m_Begin = 0;
+      this->m_End = 0;
+      }
+    else if (this->m_Begin + size > (int)this->m_Buffer.size())
+      {
+      memmove(&this->m_Buffer[0], &this->m_Buffer[this->m_Begin], this->m_End - this->m_Begin);
+      this->m_End -= this->m_Begin;
+      this->m_Begin = 0;
+      }
+
+    while (this->m_End - this->m_Begin < size)
+      {
+      this->m_NumberOfReceiveCalls++;
+      int r = this->m_Socket->Receive(&this->m_Buffer[this->m_End], (int)this->m_Buffer.size() - this->m_End, 0);
+      if (r <= 0)
+        {
+        return r;
+        }
+      this->m_End += r;
+      }
+    return 1;
+  }
+
+  int MessageReader::ReceiveBody(void* data, int length)
+  {
+    if (this->m_Socket.IsNull())
+      {
+      return 0;
+      }
+    this->m_NumberOfReceiveCalls++;
+    int r = this->m_Socket->Receive(data, length, 0);
+    if (r <= 0)
+      {
+      return r;
+      }
+    this->m_BodyOffset += r;
+    return 1;
+  }
+
+} // namespace igtl
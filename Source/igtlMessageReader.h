@@ -0,0 +1,127 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageReader_h
+#define __igtlMessageReader_h
+
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlMessageHeader.h"
+#include "igtlSocket.h"
+#include "igtl_types.h"
+
+#define MessageReaderDefaultBufferSize 65536
+
+namespace igtl
+{
+  /// The MessageReader class receives the messages from a socket through a buffer, so that the
+  /// small messages arriving together (e.g. TRANSFORM or STATUS streamed at 1 kHz) are read by a
+  /// single recv() instead of one for the header and one for the body of each message.
+  ///
+  /// A body that does not fit in the buffer is copied from the buffer as far as it was received,
+  /// then read directly into the message.
+  ///
+  /// Typical use:
+  ///
+  ///   reader->SetSocket(socket);
+  ///   while (reader->ReadHeader(headerMsg) == 1)
+  ///     {
+  ///     if (strcmp(headerMsg->GetDeviceType(), "TRANSFORM") == 0)
+  ///       {
+  ///       transformMsg->SetMessageHeader(headerMsg);
+  ///       transformMsg->AllocatePack();
+  ///       reader->ReadBody(transformMsg);
+  ///       transformMsg->Unpack(1);
+  ///       ...
+  ///       }
+  ///     else
+  ///       {
+  ///       reader->SkipBody(); // or left unread, skipped by the next ReadHeader()
+  ///       }
+  ///     }
+  ///
+  /// Like Socket::Receive(), the methods return 1 on success, 0 if the connection is lost, and -1
+  /// if the receive timeout of the socket expired. The bytes received before a timeout are kept,
+  /// and the call can be repeated with the same arguments.
+  class IGTLCommon_EXPORT MessageReader: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageReader, Object)
+    igtlNewMacro(igtl::MessageReader);
+
+  public:
+    /// Sets the socket the messages are received from. The buffered data, if any, is discarded.
+    void SetSocket(Socket* socket);
+
+    /// Sets the size of the buffer. The buffered data, if any, is discarded.
+    void SetBufferSize(int size);
+    int GetBufferSize() { return (int)this->m_Buffer.size(); }
+
+    /// Reads the header of the next message and unpacks it. The body of the previous message is
+    /// skipped if it has not been read.
+    int ReadHeader(MessageHeader* header);
+
+    /// Gets the header read by the last ReadHeader() (network byte order), without copying it.
+    /// The pointer is valid until the next call to the reader.
+    const void* GetHeaderPointer() { return this->m_HeaderPointer; }
+
+    /// Reads the body of the message into a message whose buffer has been allocated from the header
+    /// (SetMessageHeader() and AllocatePack()).
+    int ReadBody(MessageBase* message);
+
+    /// Reads the body of the message into the buffer and returns it without copying it, or NULL if
+    /// the body does not fit in the buffer, has been partly read by ReadBody(), or could not be
+    /// received. The pointer is valid until the next call to the reader.
+    const void* GetBodyPointer();
+
+    /// Discards the body of the message.
+    int SkipBody();
+
+    /// Gets the size of the body that remains to be read.
+    int GetBodySizeToRead() { return this->m_BodySize - this->m_BodyOffset; }
+
+    /// Gets the number of calls to Socket::Receive() since the socket was set.
+    igtl_uint64 GetNumberOfReceiveCalls() { return this->m_NumberOfReceiveCalls; }
+
+  protected:
+    MessageReader();
+    ~MessageReader();
+
+    /// Receives data until at least 'size' bytes (at most the size of the buffer) are buffered.
+    int Fill(int size);
+
+    /// Receives the data available, at most 'length' bytes, directly into the body of a message.
+    int ReceiveBody(void* data, int length);
+
+  private:
+    Socket::Pointer         m_Socket;
+
+    std::vector<char>       m_Buffer;
+    /// Range of the buffer received and not read yet
+    int                     m_Begin;
+    int                     m_End;
+
+    const void*             m_HeaderPointer;
+    int                     m_BodySize;
+    int                     m_BodyOffset;
+
+    igtl_uint64             m_NumberOfReceiveCalls;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageReader_h
@@ -0,0 +1,106 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageSender.h"
+
+namespace igtl {
+
+  MessageSender::MessageSender():Object()
+  {
+    this->m_Data = NULL;
+    this->m_Length = 0;
+    this->m_CurrentWriteIndex = 0;
+  }
+
+  MessageSender::~MessageSender()
+  {
+  }
+
+  void MessageSender::SetSocket(Socket* socket)
+  {
+    this->Cancel();
+    this->m_Socket = socket;
+  }
+
+  int MessageSender::Start(MessageBase* message)
+  {
+    if (message == NULL || message->GetPackPointer() == NULL)
+      {
+      return -1;
+      }
+    int r = this->Start(message->GetPackPointer(), message->GetPackSize());
+    if (r == 0)
+      {
+      this->m_Message = message;
+      }
+    return r;
+  }
+
+  int MessageSender::Start(PackedMessage* message)
+  {
+    if (message == NULL)
+      {
+      return -1;
+      }
+    int r = this->Start(message->GetPackPointer(), (int)message->GetPackSize());
+    if (r == 0)
+      {
+      this->m_PackedMessage = message;
+      }
+    return r;
+  }
+
+  int MessageSender::Start(const void* data, int length)
+  {
+    if (this->IsPending() || this->m_Socket.IsNull() || data == NULL || length < 0)
+      {
+      return -1;
+      }
+    this->m_Data = static_cast<const char*>(data);
+    this->m_Length = length;
+    this->m_CurrentWriteIndex = 0;
+    return this->Resume();
+  }
+
+  int MessageSender::Resume()
+  {
+    while (this->IsPending())
+      {
+      int n = this->m_Socket->SendNonBlocking(this->m_Data + this->m_CurrentWriteIndex,
+                                              this->m_Length - this->m_CurrentWriteIndex);
+      if (n < 0)
+        {
+        this->Cancel();
+        return -1;
+        }
+      if (n == 0)
+        {
+        return 0; // Socket buffer full
+        }
+      this->m_CurrentWriteIndex += n;
+      }
+    this->Cancel();
+    return 1;
+  }
+
+  void MessageSender::Cancel()
+  {
+    this->m_Message = NULL;
+    this->m_PackedMessage = NULL;
+    this->m_Data = NULL;
+    this->m_Length = 0;
+    this->m_CurrentWriteIndex = 0;
+  }
+
+} // namespace igtl
@@ -0,0 +1,98 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlMessageSender_h
+#define __igtlMessageSender_h
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlPackedMessage.h"
+#include "igtlSocket.h"
+
+namespace igtl
+{
+  /// The MessageSender class sends messages to a socket without blocking, keeping the progress
+  /// of the message being sent between the calls, as SessionManager::ProcessMessage() does for
+  /// the message being received. A single thread can then send messages to many sockets.
+  ///
+  /// Typical use, in an event loop:
+  ///
+  ///   if (!sender->IsPending())
+  ///     {
+  ///     transformMsg->Pack();
+  ///     sender->Start(transformMsg);
+  ///     }
+  ///   if (sender->Resume() < 0)
+  ///     {
+  ///     // disconnected
+  ///     }
+  ///
+  /// The message must not be modified or packed again until it is sent.
+  class IGTLCommon_EXPORT MessageSender: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::MessageSender, Object)
+    igtlNewMacro(igtl::MessageSender);
+
+  public:
+    /// Sets the socket the messages are sent to. The pending message, if any, is discarded.
+    void SetSocket(Socket* socket);
+    Socket* GetSocket() { return this->m_Socket; }
+
+    /// Starts sending a packed message, and sends as much of it as the socket accepts.
+    /// Returns 1 if the message has been sent entirely, 0 if a part of it remains to be sent by
+    /// Resume(), or -1 on error, or if another message is pending.
+    int Start(MessageBase* message);
+
+    /// Same as Start(MessageBase*) for a packed message, which is kept until sent: the same
+    /// packed message can be sent by the senders of all the clients.
+    int Start(PackedMessage* message);
+
+    /// Same as Start(MessageBase*) for a packed message in a buffer, which must be kept until sent.
+    int Start(const void* data, int length);
+
+    /// Sends as much of the pending message as the socket accepts. Returns 1 if the message has
+    /// been sent entirely (or if no message is pending), 0 if a part of it remains to be sent,
+    /// or -1 on error (e.g. disconnected).
+    int Resume();
+
+    /// Returns true if a part of a message remains to be sent.
+    bool IsPending() { return this->m_CurrentWriteIndex < this->m_Length; }
+
+    int GetBytesSent() { return this->m_CurrentWriteIndex; }
+    int GetBytesRemaining() { return this->m_Length - this->m_CurrentWriteIndex; }
+
+    /// Discards the pending message. The remote end cannot parse the following messages if a part
+    /// of the message has been sent: the connection must be closed.
+    void Cancel();
+
+  protected:
+    MessageSender();
+    ~MessageSender();
+
+  private:
+    Socket::Pointer         m_Socket;
+
+    /// Pending message, kept so that its buffer is not released before it is sent
+    MessageBase::Pointer    m_Message;
+    PackedMessage::Pointer  m_PackedMessage;
+    const char*             m_Data;
+    int                     m_Length;
+    int                     m_CurrentWriteIndex;
+  };
+
+} // namespace igtl
+
+#endif // __igtlMessageSender_h
@@ -0,0 +1,478 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtlMetaDataStore.h"
+#include "igtl_util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// Size of the index count at the beginning of the meta data header
+#define MetaDataStoreIndexCountSize 2
+
+// Size of a serialized meta data header entry: key size (2), value encoding (2), value size (4)
+#define MetaDataStoreEntrySize 8
+
+namespace igtl
+{
+
+namespace
+{
+  // Formats an unsigned integer in decimal at the end of a buffer of at least 21 bytes.
+  // Returns a pointer to the first digit.
+  char* FormatUnsignedInteger(igtl_uint64 value, char* end)
+  {
+    char* p = end;
+    do
+      {
+      *--p = (char)('0' + value % 10);
+      value /= 10;
+      }
+    while (value != 0);
+    return p;
+  }
+
+  void PutUint16(unsigned char* p, igtl_uint16 v)
+  {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)(v);
+  }
+
+  void PutUint32(unsigned char* p, igtl_uint32 v)
+  {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)(v);
+  }
+
+  igtl_uint16 GetUint16(const unsigned char* p)
+  {
+    return (igtl_uint16)((p[0] << 8) | p[1]);
+  }
+
+  igtl_uint32 GetUint32(const unsigned char* p)
+  {
+    return ((igtl_uint32)p[0] << 24) | ((igtl_uint32)p[1] << 16) | ((igtl_uint32)p[2] << 8) | (igtl_uint32)p[3];
+  }
+}
+
+MetaDataStore::MetaDataStore()
+{
+  this->m_DataSize = 0;
+  this->m_Revision = 0;
+  this->m_Modified = true;
+  this->m_MapModified = true;
+}
+
+MetaDataStore::~MetaDataStore()
+{
+}
+
+unsigned int MetaDataStore::LowerBound(const std::string& key) const
+{
+  unsigned int first = 0;
+  unsigned int count = this->m_Elements.size();
+  while (count > 0)
+    {
+    unsigned int step = count / 2;
+    if (this->m_Elements[first + step].Key < key)
+      {
+      first += step + 1;
+      count -= step + 1;
+      }
+    else
+      {
+      count = step;
+      }
+    }
+  return first;
+}
+
+const MetaDataStore::Element* MetaDataStore::FindElement(const std::string& key) const
+{
+  unsigned int i = this->LowerBound(key);
+  if (i < this->m_Elements.size() && this->m_Elements[i].Key == key)
+    {
+    return &this->m_Elements[i];
+    }
+  return NULL;
+}
+
+bool MetaDataStore::SetElement(const std::string& key, IANA_ENCODING_TYPE encoding, const std::string& value, int type,
+                               igtl_uint64 u, igtl_int64 i, double r)
+{
+  if (key.length() > std::numeric_limits<igtl_uint16>::max() ||
+      value.length() > std::numeric_limits<igtl_uint32>::max())
+    {
+    return false;
+    }
+
+  unsigned int index = this->LowerBound(key);
+  if (index < this->m_Elements.size() && this->m_Elements[index].Key == key)
+    {
+    Element& element = this->m_Elements[index];
+    if (element.Encoding == encoding && element.Value == value)
+      {
+      // Unchanged, the binary value is updated in case the text of a number was set.
+      element.Type = type;
+      element.UnsignedInteger = u;
+      element.Integer = i;
+      element.Real = r;
+      return true;
+      }
+    this->m_DataSize -= element.Value.length();
+    element.Encoding = encoding;
+    element.Value = value;
+    }
+  else
+    {
+    if (this->m_Elements.size() >= std::numeric_limits<igtl_uint16>::max())
+      {
+      return false;
+      }
+    Element element;
+    element.Key = key;
+    element.Encoding = encoding;
+    element.Value = value;
+    this->m_Elements.insert(this->m_Elements.begin() + index, element);
+    this->m_DataSize += key.length();
+    }
+
+  Element& element = this->m_Elements[index];
+  element.Type = type;
+  element.UnsignedInteger = u;
+  element.Integer = i;
+  element.Real = r;
+  this->m_DataSize += value.length();
+  this->m_Modified = true;
+  this->m_MapModified = true;
+  this->m_Revision++;
+  return true;
+}
+
+bool MetaDataStore::SetElement(const std::string& key, IANA_ENCODING_TYPE encoding, const std::string& value)
+{
+  return this->SetElement(key, encoding, value, VALUE_TEXT, 0, 0, 0.0);
+}
+
+bool MetaDataStore::SetUnsignedIntegerElement(const std::string& key, igtl_uint64 value)
+{
+  char buffer[32];
+  char* end = buffer + sizeof(buffer);
+  char* begin = FormatUnsignedInteger(value, end);
+  return this->SetElement(key, IANA_TYPE_US_ASCII, std::string(begin, end), VALUE_UNSIGNED_INTEGER,
+                          value, (igtl_int64)value, (double)value);
+}
+
+bool MetaDataStore::SetIntegerElement(const std::string& key, igtl_int64 value)
+{
+  char buffer[32];
+  char* end = buffer + sizeof(buffer);
+  // The magnitude is computed in unsigned arithmetic, so that the minimum value does not overflow.
+  igtl_uint64 magnitude = value < 0 ? (igtl_uint64)0 - (igtl_uint64)value : (igtl_uint64)value;
+  char* begin = FormatUnsignedInteger(magnitude, end);
+  if (value < 0)
+    {
+    *--begin = '-';
+    }
+  return this->SetElement(key, IANA_TYPE_US_ASCII, std::string(begin, end), VALUE_INTEGER,
+                          (igtl_uint64)value, value, (double)value);
+}
+
+bool MetaDataStore::SetRealElement(const std::string& key, double value)
+{
+  // Same text as the default formatting of std::ostream, at most 13 characters
+  char buffer[64];
+  int n = sprintf(buffer, "%g", value);
+  if (n < 0)
+    {
+    return false;
+    }
+  return this->SetElement(key, IANA_TYPE_US_ASCII, std::string(buffer, n), VALUE_REAL,
+                          0, 0, value);
+}
+
+bool MetaDataStore::GetElement(const std::string& key, IANA_ENCODING_TYPE& encoding, std::string& value) const
+{
+  const Element* element = this->FindElement(key);
+  if (element == NULL)
+    {
+    return false;
+    }
+  encoding = element->Encoding;
+  value = element->Value;
+  return true;
+}
+
+bool MetaDataStore::GetUnsignedIntegerElement(const std::string& key, igtl_uint64& value) const
+{
+  const Element* element = this->FindElement(key);
+  if (element == NULL)
+    {
+    return false;
+    }
+  switch (element->Type)
+    {
+    case VALUE_UNSIGNED_INTEGER:
+      value = element->UnsignedInteger;
+      return true;
+    case VALUE_INTEGER:
+      if (element->Integer < 0)
+        {
+        return false;
+        }
+      value = (igtl_uint64)element->Integer;
+      return true;
+    case VALUE_REAL:
+      return false;
+    default:
+      {
+      const char* begin = element->Value.c_str();
+      if (*begin < '0' || *begin > '9')
+        {
+        return false;
+        }
+      char* end = NULL;
+      igtl_uint64 v = strtoull(begin, &end, 10);
+      if (end != begin + element->Value.length())
+        {
+        return false;
+        }
+      value = v;
+      return true;
+      }
+    }
+}
+
+bool MetaDataStore::GetIntegerElement(const std::string& key, igtl_int64& value) const
+{
+  const Element* element = this->FindElement(key);
+  if (element == NULL)
+    {
+    return false;
+    }
+  switch (element->Type)
+    {
+    case VALUE_INTEGER:
+      value = element->Integer;
+      return true;
+    case VALUE_UNSIGNED_INTEGER:
+      if (element->UnsignedInteger > (igtl_uint64)std::numeric_limits<igtl_int64>::max())
+        {
+        return false;
+        }
+      value = (igtl_int64)element->UnsignedInteger;
+      return true;
+    case VALUE_REAL:
+      return false;
+    default:
+      {
+      const char* begin = element->Value.c_str();
+      if (element->Value.length() == 0)
+        {
+        return false;
+        }
+      char* end = NULL;
+      igtl_int64 v = strtoll(begin, &end, 10);
+      if (end != begin + element->Value.length())
+        {
+        return false;
+        }
+      value = v;
+      return true;
+      }
+    }
+}
+
+bool MetaDataStore::GetRealElement(const std::string& key, double& value) const
+{
+  const Element* element = this->FindElement(key);
+  if (element == NULL)
+    {
+    return false;
+    }
+  switch (element->Type)
+    {
+    case VALUE_REAL:
+      value = element->Real;
+      return true;
+    case VALUE_INTEGER:
+      value = (double)element->Integer;
+      return true;
+    case VALUE_UNSIGNED_INTEGER:
+      value = (double)element->UnsignedInteger;
+      return true;
+    default:
+      {
+      const char* begin = element->Value.c_str();
+      if (element->Value.length() == 0)
+        {
+        return false;
+        }
+      char* end = NULL;
+      double v = strtod(begin, &end);
+      if (end != begin + element->Value.length())
+        {
+        return false;
+        }
+      value = v;
+      return true;
+      }
+    }
+}
+
+bool MetaDataStore::RemoveElement(const std::string& key)
+{
+  unsigned int index = this->LowerBound(key);
+  if (index >= this->m_Elements.size() || this->m_Elements[index].Key != key)
+    {
+    return false;
+    }
+  this->m_DataSize -= this->m_Elements[index].Key.length() + this->m_Elements[index].Value.length();
+  this->m_Elements.erase(this->m_Elements.begin() + index);
+  this->m_Modified = true;
+  this->m_MapModified = true;
+  this->m_Revision++;
+  return true;
+}
+
+void MetaDataStore::Clear()
+{
+  if (this->m_Elements.size() == 0)
+    {
+    return;
+    }
+  this->m_Elements.clear();
+  this->m_DataSize = 0;
+  this->m_Modified = true;
+  this->m_MapModified = true;
+  this->m_Revision++;
+}
+
+igtl_uint16 MetaDataStore::GetHeaderSize() const
+{
+  return (igtl_uint16)(MetaDataStoreIndexCountSize + MetaDataStoreEntrySize * this->m_Elements.size());
+}
+
+void MetaDataStore::Pack(unsigned char* header, unsigned char* data) const
+{
+  if (this->m_Modified)
+    {
+    this->m_PackedHeader.resize(this->GetHeaderSize());
+    this->m_PackedData.resize(this->m_DataSize);
+
+    unsigned char* entry = &this->m_PackedHeader[0];
+    PutUint16(entry, (igtl_uint16)this->m_Elements.size());
+    entry += MetaDataStoreIndexCountSize;
+    unsigned char* p = this->m_DataSize > 0 ? &this->m_PackedData[0] : NULL;
+    for (unsigned int i = 0; i < this->m_Elements.size(); i++)
+      {
+      const Element& element = this->m_Elements[i];
+      PutUint16(&entry[0], (igtl_uint16)element.Key.length());
+      PutUint16(&entry[2], (igtl_uint16)element.Encoding);
+      PutUint32(&entry[4], (igtl_uint32)element.Value.length());
+      entry += MetaDataStoreEntrySize;
+      memcpy(p, element.Key.data(), element.Key.length());
+      p += element.Key.length();
+      memcpy(p, element.Value.data(), element.Value.length());
+      p += element.Value.length();
+      }
+    this->m_Modified = false;
+    }
+
+  memcpy(header, &this->m_PackedHeader[0], this->m_PackedHeader.size());
+  if (this->m_PackedData.size() > 0)
+    {
+    memcpy(data, &this->m_PackedData[0], this->m_PackedData.size());
+    }
+}
+
+bool MetaDataStore::Unpack(const unsigned char* header, igtl_uint32 headerSize, const unsigned char* data, igtl_uint32 dataSize)
+{
+  this->Clear();
+  this->m_Revision++;
+  this->m_Modified = true;
+  this->m_MapModified = true;
+
+  if (headerSize < MetaDataStoreIndexCountSize)
+    {
+    return headerSize == 0 && dataSize == 0;
+    }
+  igtl_uint16 count = GetUint16(header);
+  if (headerSize < MetaDataStoreIndexCountSize + (igtl_uint32)count * MetaDataStoreEntrySize)
+    {
+    return false;
+    }
+
+  const unsigned char* entry = header + MetaDataStoreIndexCountSize;
+  const unsigned char* p = data;
+  igtl_uint32 remaining = dataSize;
+  this->m_Elements.reserve(count);
+  for (unsigned int i = 0; i < count; i++, entry += MetaDataStoreEntrySize)
+    {
+    igtl_uint16 keySize = GetUint16(&entry[0]);
+    igtl_uint16 encoding = GetUint16(&entry[2]);
+    igtl_uint32 valueSize = GetUint32(&entry[4]);
+    if ((igtl_uint64)keySize + valueSize > remaining)
+      {
+      this->Clear();
+      return false;
+      }
+    std::string key((const char*)p, keySize);
+    std::string value((const char*)p + keySize, valueSize);
+    p += keySize + valueSize;
+    remaining -= keySize + valueSize;
+
+    // The elements are normally received in order; SetElement() keeps the keys sorted and unique otherwise.
+    if (this->m_Elements.size() == 0 || this->m_Elements.back().Key < key)
+      {
+      Element element;
+      element.Key = key;
+      element.Encoding = (IANA_ENCODING_TYPE)encoding;
+      element.Value = value;
+      element.Type = VALUE_TEXT;
+      element.UnsignedInteger = 0;
+      element.Integer = 0;
+      element.Real = 0.0;
+      this->m_Elements.push_back(element);
+      this->m_DataSize += keySize + valueSize;
+      }
+    else
+      {
+      this->SetElement(key, (IANA_ENCODING_TYPE)encoding, value);
+      }
+    }
+  return true;
+}
+
+const MetaDataStore::MetaDataMap& MetaDataStore::GetMap() const
+{
+  if (this->m_MapModified)
+    {
+    this->m_Map.clear();
+    for (unsigned int i = 0; i < this->m_Elements.size(); i++)
+      {
+      const Element& element = this->m_Elements[i];
+      this->m_Map.insert(this->m_Map.end(), MetaDataMap::value_type(element.Key,
+        std::pair<IANA_ENCODING_TYPE, std::string>(element.Encoding, element.Value)));
+      }
+    this->m_MapModified = false;
+    }
+  return this->m_Map;
+}
+
+} // namespace igtl
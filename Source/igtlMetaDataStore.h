@@ -0,0 +1,136 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __igtlMetaDataStore_h
+#define __igtlMetaDataStore_h
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "igtlWin32Header.h"
+#include "igtl_types.h"
+
+namespace igtl
+{
+
+/// MetaDataStore holds the meta data of a message (header version 2) in a flat array sorted by key,
+/// which is the order of the elements in the serialized message.
+///
+/// The numeric values are kept in binary along with their text, so that they can be read back
+/// without parsing. The serialized meta data header and meta data are cached and only rebuilt when
+/// an element has been added, removed or changed, so that a message sent repeatedly with the same
+/// meta data copies them with a memcpy(). Setting an element to its current value does not
+/// invalidate the cache.
+///
+/// The values are sent as text (US-ASCII for the numeric values), as defined by the protocol.
+class IGTLCommon_EXPORT MetaDataStore
+{
+public:
+  typedef std::map<std::string, std::pair<IANA_ENCODING_TYPE, std::string> > MetaDataMap;
+
+  MetaDataStore();
+  ~MetaDataStore();
+
+  /// Sets an element. Returns false if the key or the value are too long to be serialized.
+  bool SetElement(const std::string& key, IANA_ENCODING_TYPE encoding, const std::string& value);
+
+  /// Sets an element to a numeric value, formatted as US-ASCII text.
+  bool SetUnsignedIntegerElement(const std::string& key, igtl_uint64 value);
+  bool SetIntegerElement(const std::string& key, igtl_int64 value);
+  bool SetRealElement(const std::string& key, double value);
+
+  bool GetElement(const std::string& key, IANA_ENCODING_TYPE& encoding, std::string& value) const;
+
+  /// Gets the value of an element as a number. The numeric elements are returned without parsing,
+  /// the text elements are parsed. Returns false if the element does not exist or is not a number.
+  bool GetUnsignedIntegerElement(const std::string& key, igtl_uint64& value) const;
+  bool GetIntegerElement(const std::string& key, igtl_int64& value) const;
+  bool GetRealElement(const std::string& key, double& value) const;
+
+  /// Removes an element. Returns false if it does not exist.
+  bool RemoveElement(const std::string& key);
+
+  void Clear();
+
+  int GetNumberOfElements() const { return (int)this->m_Elements.size(); };
+
+  /// Gets the size of the serialized meta data header, including the index count.
+  igtl_uint16 GetHeaderSize() const;
+
+  /// Gets the size of the serialized meta data (keys and values).
+  igtl_uint32 GetDataSize() const { return this->m_DataSize; };
+
+  /// Writes the serialized meta data header and meta data, which must have GetHeaderSize()
+  /// and GetDataSize() bytes.
+  void Pack(unsigned char* header, unsigned char* data) const;
+
+  /// Reads the elements from a serialized meta data header and meta data. Returns false if
+  /// they are inconsistent with the sizes, in which case the store is left empty.
+  bool Unpack(const unsigned char* header, igtl_uint32 headerSize, const unsigned char* data, igtl_uint32 dataSize);
+
+  /// Gets the elements as a map, built on demand.
+  const MetaDataMap& GetMap() const;
+
+  /// Gets a number incremented each time the elements change.
+  igtl_uint32 GetRevision() const { return this->m_Revision; };
+
+protected:
+
+  enum ValueType
+  {
+    VALUE_TEXT,
+    VALUE_UNSIGNED_INTEGER,
+    VALUE_INTEGER,
+    VALUE_REAL
+  };
+
+  class Element
+  {
+  public:
+    std::string         Key;
+    IANA_ENCODING_TYPE  Encoding;
+    std::string         Value;
+    int                 Type;
+    igtl_uint64         UnsignedInteger;
+    igtl_int64          Integer;
+    double              Real;
+  };
+
+  /// Returns the index of the first element whose key is not less than the key.
+  unsigned int LowerBound(const std::string& key) const;
+
+  const Element* FindElement(const std::string& key) const;
+
+  /// Sets an element of the given type. The store is left unchanged if the element already has the value.
+  bool SetElement(const std::string& key, IANA_ENCODING_TYPE encoding, const std::string& value, int type,
+                  igtl_uint64 u, igtl_int64 i, double r);
+
+private:
+  std::vector<Element>               m_Elements;
+  igtl_uint32                        m_DataSize;
+  igtl_uint32                        m_Revision;
+
+  /// Serialized meta data header and meta data, valid unless m_Modified.
+  mutable std::vector<unsigned char> m_PackedHeader;
+  mutable std::vector<unsigned char> m_PackedData;
+  mutable bool                       m_Modified;
+
+  mutable MetaDataMap                m_Map;
+  mutable bool                       m_MapModified;
+};
+
+} // namespace igtl
+
+#endif // __igtlMetaDataStore_h
@@ -236,25 +236,48 @@ void MultiThreader::SetMultipleMethod( int index,
     }
 }
 
+namespace
+{
+  // A thread of SingleMethodExecute() or MultipleMethodExecute() run as a task of the thread pool.
+  class MultiThreaderPoolJob
+  {
+  public:
+    ThreadFunctionType Method;
+    void*              ThreadInfo;
+  };
+
+  void* MultiThreaderPoolTask(void* ptr)
+  {
+    MultiThreaderPoolJob* job = static_cast<MultiThreaderPoolJob*>(ptr);
+    job->Method(job->ThreadInfo);
+    return NULL;
+  }
+
+  // Runs methods[i] with threadInfo[i] for 0 <= i < numberOfThreads. The calling thread runs the
+  // thread 0, and each other thread runs on a worker of the global thread pool that is not running
+  // anything else, as the methods may wait for each other (see ThreadPool::RunConcurrently()).
+  void ExecuteOnThreadPool(int numberOfThreads, const ThreadFunctionType* methods,
+                           void* const* data, MultiThreader::ThreadInfo* threadInfo)
+  {
+    MultiThreaderPoolJob jobs[IGTL_MAX_THREADS];
+    void* jobPointers[IGTL_MAX_THREADS];
+    for (int i = 0; i < numberOfThreads; i++)
+      {
+      threadInfo[i].UserData        = data[i];
+      threadInfo[i].NumberOfThreads = numberOfThreads;
+      jobs[i].Method     = methods[i];
+      jobs[i].ThreadInfo = (void *)(&threadInfo[i]);
+      jobPointers[i]     = &jobs[i];
+      }
+    ThreadPool::GetGlobalThreadPool()->RunConcurrently(numberOfThreads, &MultiThreaderPoolTask, jobPointers);
+  }
+}
+
 // Execute the method set as the SingleMethod on NumberOfThreads threads.
+// The threads are taken from the global thread pool, so that repeated calls
+// do not create and join threads.
 void MultiThreader::SingleMethodExecute()
 {
-  int                thread_loop = 0;
-
-#ifdef OpenIGTLink_USE_WIN32_THREADS
-  DWORD              threadId;
-  HANDLE             process_id[IGTL_MAX_THREADS];
-#endif
-
-#ifdef OpenIGTLink_USE_SPROC
-  siginfo_t          info_ptr;
-  int                process_id[IGTL_MAX_THREADS];
-#endif
-
-#ifdef OpenIGTLink_USE_PTHREADS
-  pthread_t          process_id[IGTL_MAX_THREADS];
-#endif
-
   if ( !this->m_SingleMethod )
     {
     igtlErrorMacro( << "No single method set!" );
@@ -267,180 +290,23 @@ void MultiThreader::SingleMethodExecute()
     {
     this->m_NumberOfThreads = MultiThreaderGlobalMaximumNumberOfThreads;
     }
-  
-    
-  // We are using sproc (on SGIs), pthreads(on Suns), or a single thread
-  // (the default)  
-
-#ifdef OpenIGTLink_USE_WIN32_THREADS
-  // Using CreateThread on a PC
-  //
-  // We want to use CreateThread to start this->m_NumberOfThreads - 1 
-  // additional threads which will be used to call this->SingleMethod().
-  // The parent thread will also call this routine.  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the waitid call
-  for (thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData        = this->m_SingleData;
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-    process_id[thread_loop] = 
-      CreateThread(NULL, 0, this->m_SingleMethod, 
-             ((void *)(&this->m_ThreadInfoArray[thread_loop])), 0, &threadId);
-    if (process_id[thread_loop] == NULL)
-      {
-      igtlErrorMacro("Error in thread creation !!!");
-      } 
-    }
-  
-  // Now, the parent thread calls this->SingleMethod() itself
-  this->m_ThreadInfoArray[0].UserData = this->m_SingleData;
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  this->m_SingleMethod((void *)(&this->m_ThreadInfoArray[0]));
-
-  // The parent thread has finished this->SingleMethod() - so now it
-  // waits for each of the other processes to exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    WaitForSingleObject(process_id[thread_loop], INFINITE);
-    }
 
-  // close the threads
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
+  ThreadFunctionType methods[IGTL_MAX_THREADS];
+  void*              data[IGTL_MAX_THREADS];
+  for (int thread_loop = 0; thread_loop < this->m_NumberOfThreads; thread_loop++ )
     {
-    CloseHandle(process_id[thread_loop]);
+    methods[thread_loop] = this->m_SingleMethod;
+    data[thread_loop]    = this->m_SingleData;
     }
-#endif
-
-#ifdef OpenIGTLink_USE_SPROC
-  // Using sproc() on an SGI
-  //
-  // We want to use sproc to start this->m_NumberOfThreads - 1 additional
-  // threads which will be used to call this->SingleMethod(). The
-  // parent thread will also call this routine.  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the waitid call
-
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData        = this->m_SingleData;
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-    process_id[thread_loop] = 
-      sproc( this->m_SingleMethod, PR_SADDR, 
-             ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-    if ( process_id[thread_loop] == -1)
-      {
-      igtlErrorMacro("sproc call failed. Code: " << errno << endl);
-      }
-    }
-  
-  // Now, the parent thread calls this->m_SingleMethod() itself
-  this->m_ThreadInfoArray[0].UserData        = this->m_SingleData;
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  this->m_SingleMethod((void *)(&this->m_ThreadInfoArray[0]) );
-
-  // The parent thread has finished this->m_SingleMethod() - so now it
-  // waits for each of the other processes to exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    waitid( P_PID, (id_t) process_id[thread_loop], &info_ptr, WEXITED );
-    }
-#endif
-
-#ifdef OpenIGTLink_USE_PTHREADS
-  // Using POSIX threads
-  //
-  // We want to use pthread_create to start this->m_NumberOfThreads-1 additional
-  // threads which will be used to call this->m_SingleMethod(). The
-  // parent thread will also call this routine.  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the pthread_join call
-
-  pthread_attr_t attr;
-
-#ifdef OpenIGTLink_HP_PTHREADS
-  pthread_attr_create( &attr );
-#else  
-  pthread_attr_init(&attr);
-#if !defined(__CYGWIN__)
-  pthread_attr_setscope(&attr, PTHREAD_SCOPE_PROCESS);
-#endif
-#endif
-  
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData        = this->m_SingleData;
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-
-#ifdef OpenIGTLink_HP_PTHREADS
-    pthread_create( &(process_id[thread_loop]),
-                    attr, this->m_SingleMethod,  
-                    ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-#else
-    int                threadError;
-    threadError =
-      pthread_create( &(process_id[thread_loop]), &attr,
-                      reinterpret_cast<igtlExternCThreadFunctionType>(
-                        this->m_SingleMethod),
-                      ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-    if (threadError != 0)
-      {
-      igtlErrorMacro(<< "Unable to create a thread.  pthread_create() returned "
-                    << threadError);
-      }
-#endif
-    }
-  
-  // Now, the parent thread calls this->m_SingleMethod() itself
-  this->m_ThreadInfoArray[0].UserData        = this->m_SingleData;
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  this->m_SingleMethod((void *)(&this->m_ThreadInfoArray[0]) );
-
-  // The parent thread has finished this->m_SingleMethod() - so now it
-  // waits for each of the other processes to exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    pthread_join( process_id[thread_loop], NULL );
-    }
-#endif
-
-#ifndef OpenIGTLink_USE_WIN32_THREADS
-#ifndef OpenIGTLink_USE_SPROC
-#ifndef OpenIGTLink_USE_PTHREADS
-  // There is no multi threading, so there is only one thread.
-  this->m_ThreadInfoArray[0].UserData        = this->m_SingleData;
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  this->m_SingleMethod( (void *)(&this->m_ThreadInfoArray[0]) );
-#endif
-#endif
-#endif
+  ExecuteOnThreadPool(this->m_NumberOfThreads, methods, data, this->m_ThreadInfoArray);
 }
 
+// Execute the methods set by SetMultipleMethod() on NumberOfThreads threads
+// taken from the global thread pool.
 void MultiThreader::MultipleMethodExecute()
 {
   int                thread_loop;
 
-#ifdef OpenIGTLink_USE_WIN32_THREADS
-  DWORD              threadId;
-  HANDLE             process_id[IGTL_MAX_THREADS];
-#endif
-
-#ifdef OpenIGTLink_USE_SPROC
-  siginfo_t          info_ptr;
-  int                process_id[IGTL_MAX_THREADS];
-#endif
-
-#ifdef OpenIGTLink_USE_PTHREADS
-  pthread_t          process_id[IGTL_MAX_THREADS];
-#endif
-
-
   // obey the global maximum number of threads limit
   if (MultiThreaderGlobalMaximumNumberOfThreads &&
       this->m_NumberOfThreads > MultiThreaderGlobalMaximumNumberOfThreads)
@@ -457,154 +323,27 @@ void MultiThreader::MultipleMethodExecute()
       }
     }
 
-  // We are using sproc (on SGIs), pthreads(on Suns), CreateThread
-  // on a PC or a single thread (the default)  
-
-#ifdef OpenIGTLink_USE_WIN32_THREADS
-  // Using CreateThread on a PC
-  //
-  // We want to use CreateThread to start this->m_NumberOfThreads - 1 
-  // additional threads which will be used to call the m_NumberOfThreads-1
-  // methods defined in this->m_MultipleMethods[](). The parent thread
-  // will call this->m_MultipleMethods[m_NumberOfThreads-1]().  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the waitid call
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData = 
-      this->m_MultipleData[thread_loop];
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-    process_id[thread_loop] = 
-      CreateThread(NULL, 0, this->m_MultipleMethod[thread_loop], 
-             ((void *)(&this->m_ThreadInfoArray[thread_loop])), 0, &threadId);
-    if (process_id[thread_loop] == NULL)
-      {
-      igtlErrorMacro("Error in thread creation !!!");
-      } 
-    }
-  
-  // Now, the parent thread calls the last method itself
-  this->m_ThreadInfoArray[0].UserData        = this->m_MultipleData[0];
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  (this->m_MultipleMethod[0])((void *)(&this->m_ThreadInfoArray[0]) );
-
-  // The parent thread has finished its method - so now it
-  // waits for each of the other processes (created with sproc) to
-  // exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    WaitForSingleObject(process_id[thread_loop], INFINITE);
-    }
-
-  // close the threads
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    CloseHandle(process_id[thread_loop]);
-    }
-#endif
-
-#ifdef OpenIGTLink_USE_SPROC
-  // Using sproc() on an SGI
-  //
-  // We want to use sproc to start this->m_NumberOfThreads - 1 additional
-  // threads which will be used to call the m_NumberOfThreads-1 methods
-  // defined in this->m_MultipleMethods[](). The parent thread
-  // will call this->m_MultipleMethods[m_NumberOfThreads-1]().  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the waitid call
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData = 
-      this->m_MultipleData[thread_loop];
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-    process_id[thread_loop] = 
-      sproc( this->m_MultipleMethod[thread_loop], PR_SADDR, 
-             ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-    }
-  
-  // Now, the parent thread calls the last method itself
-  this->m_ThreadInfoArray[0].UserData        = this->m_MultipleData[0];
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  (this->m_MultipleMethod[0])((void *)(&this->m_ThreadInfoArray[0]) );
-
-  // The parent thread has finished its method - so now it
-  // waits for each of the other processes (created with sproc) to
-  // exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    waitid( P_PID, (id_t) process_id[thread_loop], &info_ptr, WEXITED );
-    }
-#endif
-
-#ifdef OpenIGTLink_USE_PTHREADS
-  // Using POSIX threads
-  //
-  // We want to use pthread_create to start this->m_NumberOfThreads - 1 
-  // additional
-  // threads which will be used to call the NumberOfThreads-1 methods
-  // defined in this->m_MultipleMethods[](). The parent thread
-  // will call this->m_MultipleMethods[NumberOfThreads-1]().  When it is done,
-  // it will wait for all the children to finish. 
-  //
-  // First, start up the this->m_NumberOfThreads-1 processes.  Keep track
-  // of their process ids for use later in the pthread_join call
-
-  pthread_attr_t attr;
-
-#ifdef OpenIGTLink_HP_PTHREADS
-  pthread_attr_create( &attr );
-#else  
-  pthread_attr_init(&attr);
-#ifndef __CYGWIN__
-  pthread_attr_setscope(&attr, PTHREAD_SCOPE_PROCESS);
-#endif
-#endif
+  ExecuteOnThreadPool(this->m_NumberOfThreads, this->m_MultipleMethod,
+                      this->m_MultipleData, this->m_ThreadInfoArray);
+}
 
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
-    {
-    this->m_ThreadInfoArray[thread_loop].UserData = 
-      this->m_MultipleData[thread_loop];
-    this->m_ThreadInfoArray[thread_loop].NumberOfThreads = this->m_NumberOfThreads;
-#ifdef OpenIGTLink_HP_PTHREADS
-    pthread_create( &(process_id[thread_loop]),
-                    attr, this->m_MultipleMethod[thread_loop],  
-                    ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-#else
-    pthread_create( &(process_id[thread_loop]),
-                    &attr,
-                    reinterpret_cast<igtlExternCThreadFunctionType>(
-                      this->m_MultipleMethod[thread_loop]),
-                    ( (void *)(&this->m_ThreadInfoArray[thread_loop]) ) );
-#endif
-    }
-  
-  // Now, the parent thread calls the last method itself
-  this->m_ThreadInfoArray[0].UserData = this->m_MultipleData[0];
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  (this->m_MultipleMethod[0])((void *)(&this->m_ThreadInfoArray[0]) );
-
-  // The parent thread has finished its method - so now it
-  // waits for each of the other processes to exit
-  for ( thread_loop = 1; thread_loop < this->m_NumberOfThreads; thread_loop++ )
+void MultiThreader::ParallelFor(int begin, int end, int grainSize, ParallelForFunctionType f, void *data)
+{
+  int numberOfThreads = this->GetNumberOfThreads();
+  ThreadPool* pool = ThreadPool::GetGlobalThreadPool();
+  // The ranges do not wait for each other, so busy workers only slow the loop down: the calling
+  // thread takes the ranges left.
+  pool->ReserveWorkers(numberOfThreads - 1);
+  if (grainSize <= 0 && end > begin)
     {
-    pthread_join( process_id[thread_loop], NULL );
+    grainSize = (end - begin + numberOfThreads - 1) / numberOfThreads;
     }
-#endif
+  pool->ParallelFor(begin, end, grainSize, f, data);
+}
 
-#ifndef OpenIGTLink_USE_WIN32_THREADS
-#ifndef OpenIGTLink_USE_SPROC
-#ifndef OpenIGTLink_USE_PTHREADS
-  // There is no multi threading, so there is only one thread.
-  this->m_ThreadInfoArray[0].UserData        = this->m_MultipleData[0];
-  this->m_ThreadInfoArray[0].NumberOfThreads = this->m_NumberOfThreads;
-  (this->m_MultipleMethod[0])( (void *)(&this->m_ThreadInfoArray[0]) );
-#endif
-#endif
-#endif
+ThreadPool* MultiThreader::GetThreadPool()
+{
+  return ThreadPool::GetGlobalThreadPool();
 }
 
 int MultiThreader::SpawnThread( ThreadFunctionType f, void *userdata )
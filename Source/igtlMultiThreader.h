@@ -39,6 +39,7 @@
 #include "igtlObjectFactory.h"
 #include "igtlMacro.h"
 #include "igtlMutexLock.h"
+#include "igtlThreadPool.h"
 
 
 #ifdef OpenIGTLink_USE_SPROC
@@ -188,14 +189,29 @@ public:
   
   // Description:
   // Execute the SingleMethod (as define by SetSingleMethod) using
-  // this->NumberOfThreads threads.
+  // this->NumberOfThreads threads. The calling thread runs the thread 0,
+  // the others run on idle workers of the global ThreadPool, started as
+  // needed, so that the threads may wait for each other.
   void SingleMethodExecute();
 
   // Description:
   // Execute the MultipleMethods (as define by calling SetMultipleMethod
   // for each of the required this->NumberOfThreads methods) using
-  // this->NumberOfThreads threads.
+  // this->NumberOfThreads threads taken from the global ThreadPool.
   void MultipleMethodExecute();
+
+  // Description:
+  // Call f(i0, i1, data) over ranges of at most grainSize indices covering
+  // [begin, end) on the threads of the global ThreadPool. A grainSize of 0
+  // or less splits the range over this->NumberOfThreads threads. The ranges
+  // must not wait for each other.
+  // See ThreadPool::ParallelFor().
+  void ParallelFor(int begin, int end, int grainSize, ParallelForFunctionType f, void *data);
+
+  // Description:
+  // Get the thread pool running SingleMethodExecute(), MultipleMethodExecute()
+  // and ParallelFor(), e.g. to submit tasks or to set the affinity of its workers.
+  static ThreadPool* GetThreadPool();
   
   // Description:
   // Set the SingleMethod to f() and the UserData field of the
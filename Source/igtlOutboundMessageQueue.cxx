@@ -0,0 +1,321 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlOutboundMessageQueue.h"
+#include "igtl_header.h"
+
+namespace igtl {
+
+  OutboundMessageQueue::OutboundMessageQueue():Object()
+  {
+    this->m_Threader = MultiThreader::New();
+    this->m_ThreadID = -1;
+    this->m_Running = false;
+    this->m_Condition = ConditionVariable::New();
+    this->m_QueuedSize = 0;
+    this->m_HighWatermark = OutboundMessageQueueDefaultHighWatermark;
+    this->m_LowWatermark = OutboundMessageQueueDefaultLowWatermark;
+    this->m_Congested = false;
+    this->m_NumberOfMessagesSent = 0;
+    this->m_NumberOfMessagesConflated = 0;
+    this->m_NumberOfMessagesDropped = 0;
+
+    this->m_ConflatedTypes.insert("TRANSFORM");
+    this->m_ConflatedTypes.insert("TDATA");
+    this->m_ConflatedTypes.insert("QTDATA");
+    this->m_ConflatedTypes.insert("POSITION");
+    this->m_ConflatedTypes.insert("IMAGE");
+  }
+
+  OutboundMessageQueue::~OutboundMessageQueue()
+  {
+    this->Stop();
+  }
+
+  int OutboundMessageQueue::Start()
+  {
+    this->Stop();
+    if (this->m_Socket.IsNull())
+      {
+      return 0;
+      }
+    this->m_Lock.Lock();
+    this->m_Running = true;
+    this->m_Lock.Unlock();
+    this->m_ThreadID = this->m_Threader->SpawnThread((ThreadFunctionType)&OutboundMessageQueue::SendThread, this);
+    if (this->m_ThreadID < 0)
+      {
+      this->Stop();
+      return 0;
+      }
+    return 1;
+  }
+
+  int OutboundMessageQueue::Stop()
+  {
+    this->m_Lock.Lock();
+    bool running = this->m_Running;
+    this->m_Running = false;
+    this->Clear();
+    this->m_Condition->Broadcast();
+    this->m_Lock.Unlock();
+
+    if (this->m_ThreadID >= 0)
+      {
+      this->m_Threader->TerminateThread(this->m_ThreadID);
+      this->m_ThreadID = -1;
+      }
+    return running ? 1 : 0;
+  }
+
+  bool OutboundMessageQueue::IsRunning()
+  {
+    this->m_Lock.Lock();
+    bool running = this->m_Running;
+    this->m_Lock.Unlock();
+    return running;
+  }
+
+  int OutboundMessageQueue::Push(MessageBase* message)
+  {
+    PackedMessage::Pointer packed = PackedMessage::Create(message);
+    if (packed.IsNull())
+      {
+      return 0;
+      }
+    return this->Push(packed);
+  }
+
+  int OutboundMessageQueue::Push(PackedMessage* message)
+  {
+    if (message == NULL)
+      {
+      return 0;
+      }
+    KeyType key(message->GetMessageType(), message->GetDeviceName());
+    igtl_uint64 size = message->GetPackSize();
+
+    this->m_Lock.Lock();
+    if (!this->m_Running)
+      {
+      this->m_Lock.Unlock();
+      return 0;
+      }
+
+    bool conflated = this->m_ConflatedTypes.find(key.first) != this->m_ConflatedTypes.end();
+    if (conflated)
+      {
+      std::map<KeyType, QueueType::iterator>::iterator it = this->m_ConflatedEntries.find(key);
+      if (it != this->m_ConflatedEntries.end())
+        {
+        // Replaced at its place in the queue, so that a device sending often is not delayed.
+        PackedMessage::Pointer& queued = it->second->message;
+        this->m_QueuedSize -= queued->GetPackSize();
+        queued = message;
+        this->m_QueuedSize += size;
+        this->m_NumberOfMessagesConflated++;
+        this->m_Lock.Unlock();
+        return 1;
+        }
+      }
+
+    if (this->m_Congested)
+      {
+      this->m_NumberOfMessagesDropped++;
+      this->m_Lock.Unlock();
+      return 0;
+      }
+
+    this->m_Queue.push_back(Entry());
+    QueueType::iterator entry = --this->m_Queue.end();
+    entry->key = key;
+    entry->conflated = conflated;
+    entry->message = message;
+    if (conflated)
+      {
+      this->m_ConflatedEntries[key] = entry;
+      }
+    this->m_QueuedSize += size;
+    if (this->m_QueuedSize >= this->m_HighWatermark)
+      {
+      this->m_Congested = true;
+      }
+    this->m_Condition->Signal();
+    this->m_Lock.Unlock();
+    return 1;
+  }
+
+  void OutboundMessageQueue::AddConflatedType(const char* type)
+  {
+    this->m_Lock.Lock();
+    this->m_ConflatedTypes.insert(type);
+    this->m_Lock.Unlock();
+  }
+
+  void OutboundMessageQueue::RemoveConflatedType(const char* type)
+  {
+    this->m_Lock.Lock();
+    this->m_ConflatedTypes.erase(type);
+    // The queued messages of the type are not replaced anymore.
+    std::map<KeyType, QueueType::iterator>::iterator it = this->m_ConflatedEntries.begin();
+    while (it != this->m_ConflatedEntries.end())
+      {
+      if (it->first.first == type)
+        {
+        it->second->conflated = false;
+        this->m_ConflatedEntries.erase(it++);
+        }
+      else
+        {
+        ++it;
+        }
+      }
+    this->m_Lock.Unlock();
+  }
+
+  void OutboundMessageQueue::SetWatermarks(igtl_uint64 high, igtl_uint64 low)
+  {
+    this->m_Lock.Lock();
+    this->m_HighWatermark = high;
+    this->m_LowWatermark = low < high ? low : high;
+    this->m_Lock.Unlock();
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetHighWatermark()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 high = this->m_HighWatermark;
+    this->m_Lock.Unlock();
+    return high;
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetLowWatermark()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 low = this->m_LowWatermark;
+    this->m_Lock.Unlock();
+    return low;
+  }
+
+  bool OutboundMessageQueue::IsCongested()
+  {
+    this->m_Lock.Lock();
+    bool congested = this->m_Congested;
+    this->m_Lock.Unlock();
+    return congested;
+  }
+
+  int OutboundMessageQueue::GetNumberOfQueuedMessages()
+  {
+    this->m_Lock.Lock();
+    int n = this->m_Queue.size();
+    this->m_Lock.Unlock();
+    return n;
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetQueuedSize()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 size = this->m_QueuedSize;
+    this->m_Lock.Unlock();
+    return size;
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetNumberOfMessagesSent()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesSent;
+    this->m_Lock.Unlock();
+    return n;
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetNumberOfMessagesConflated()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesConflated;
+    this->m_Lock.Unlock();
+    return n;
+  }
+
+  igtl_uint64 OutboundMessageQueue::GetNumberOfMessagesDropped()
+  {
+    this->m_Lock.Lock();
+    igtl_uint64 n = this->m_NumberOfMessagesDropped;
+    this->m_Lock.Unlock();
+    return n;
+  }
+
+  void OutboundMessageQueue::Clear()
+  {
+    this->m_Queue.clear();
+    this->m_ConflatedEntries.clear();
+    this->m_QueuedSize = 0;
+    this->m_Congested = false;
+  }
+
+  void* OutboundMessageQueue::SendThread(void* ptr)
+  {
+    igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+    static_cast<OutboundMessageQueue*>(info->UserData)->SendLoop();
+    return NULL;
+  }
+
+  void OutboundMessageQueue::SendLoop()
+  {
+    PackedMessage::Pointer message;
+    this->m_Lock.Lock();
+    while (true)
+      {
+      while (this->m_Running && this->m_Queue.empty())
+        {
+        this->m_Condition->Wait(&this->m_Lock);
+        }
+      if (!this->m_Running)
+        {
+        break;
+        }
+
+      // The message is moved out of the queue, so that a newer message of the device is queued
+      // rather than replacing the message being sent.
+      Entry& entry = this->m_Queue.front();
+      message = entry.message;
+      if (entry.conflated)
+        {
+        this->m_ConflatedEntries.erase(entry.key);
+        }
+      this->m_Queue.pop_front();
+      this->m_QueuedSize -= message->GetPackSize();
+      if (this->m_Congested && this->m_QueuedSize < this->m_LowWatermark)
+        {
+        this->m_Congested = false;
+        }
+      this->m_Lock.Unlock();
+
+      int r = message->Send(this->m_Socket);
+      message = NULL;
+
+      this->m_Lock.Lock();
+      if (!r)
+        {
+        // The client is disconnected, or the send timeout expired.
+        this->m_Running = false;
+        this->Clear();
+        break;
+        }
+      this->m_NumberOfMessagesSent++;
+      }
+    this->m_Lock.Unlock();
+  }
+
+} // namespace igtl
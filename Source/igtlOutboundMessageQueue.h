@@ -0,0 +1,163 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlOutboundMessageQueue_h
+#define __igtlOutboundMessageQueue_h
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlConditionVariable.h"
+#include "igtlMessageBase.h"
+#include "igtlMultiThreader.h"
+#include "igtlMutexLock.h"
+#include "igtlPackedMessage.h"
+#include "igtlSocket.h"
+#include "igtl_types.h"
+
+// Default watermarks (bytes queued)
+#define OutboundMessageQueueDefaultHighWatermark (16 * 1024 * 1024)
+#define OutboundMessageQueueDefaultLowWatermark  (4 * 1024 * 1024)
+
+namespace igtl
+{
+  /// The OutboundMessageQueue class sends the messages to a socket from its own thread, so that
+  /// the producer is not blocked by a client reading slowly.
+  ///
+  /// Push() copies the packed message to the queue and returns immediately. A message of a
+  /// conflated type (TRANSFORM, TDATA, QTDATA, POSITION and IMAGE by default) replaces the queued
+  /// message of the same type and device name, if any, at its place in the queue: a slow client
+  /// receives the latest value of each device rather than all the values late.
+  ///
+  /// When the size of the queue reaches the high watermark, the messages that do not replace a
+  /// queued message are dropped until the queue is drained below the low watermark.
+  ///
+  /// Typical use:
+  ///
+  ///   queue->SetSocket(socket);
+  ///   queue->Start();
+  ///   ...
+  ///   transformMsg->Pack();
+  ///   queue->Push(transformMsg);
+  ///   ...
+  ///   queue->Stop();
+  ///
+  /// The application must not send other messages on the same socket while the queue is started.
+  class IGTLCommon_EXPORT OutboundMessageQueue: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::OutboundMessageQueue, Object)
+    igtlNewMacro(igtl::OutboundMessageQueue);
+
+  public:
+    /// Sets the socket the messages are sent to. Must be called before Start().
+    void SetSocket(Socket* socket) { this->m_Socket = socket; }
+
+    /// Starts the sending thread. Returns 0 if no socket is set or the thread could not be started.
+    int Start();
+
+    /// Stops the sending thread after the message being sent, and discards the queued messages.
+    /// Sending a message to a stalled client is only interrupted by the send timeout of the socket,
+    /// or by closing the socket.
+    int Stop();
+
+    bool IsRunning();
+
+    /// Queues a packed message. Returns 1 if the message is queued or replaces a queued message,
+    /// and 0 if it is dropped, not packed, or the queue is not running (e.g. the client disconnected).
+    int Push(MessageBase* message);
+
+    /// Same as Push(MessageBase*) for a packed message, which is queued without being copied:
+    /// the same packed message can be queued to the queues of all the clients.
+    int Push(PackedMessage* message);
+
+    /// Adds or removes a type of the messages replacing the queued message of the same device.
+    void AddConflatedType(const char* type);
+    void RemoveConflatedType(const char* type);
+
+    /// Sets the size of the queue (bytes) from which the messages that do not replace a queued
+    /// message are dropped, and the size below which they are queued again.
+    void SetWatermarks(igtl_uint64 high, igtl_uint64 low);
+    igtl_uint64 GetHighWatermark();
+    igtl_uint64 GetLowWatermark();
+
+    /// Returns true from the time the high watermark is reached until the queue is drained below
+    /// the low watermark.
+    bool IsCongested();
+
+    int GetNumberOfQueuedMessages();
+    igtl_uint64 GetQueuedSize();
+
+    igtl_uint64 GetNumberOfMessagesSent();
+
+    /// Gets the number of messages replaced in the queue by a newer message of the same device.
+    igtl_uint64 GetNumberOfMessagesConflated();
+
+    /// Gets the number of messages dropped because the queue was congested.
+    igtl_uint64 GetNumberOfMessagesDropped();
+
+  protected:
+    OutboundMessageQueue();
+    ~OutboundMessageQueue();
+
+    typedef std::pair<std::string, std::string> KeyType;
+
+    /// Queued message
+    struct Entry
+    {
+      KeyType                   key;
+      bool                      conflated;
+      PackedMessage::Pointer    message;
+    };
+    typedef std::list<Entry> QueueType;
+
+    static void* SendThread(void* ptr);
+    void SendLoop();
+
+    /// Clears the queue. Called with the lock held.
+    void Clear();
+
+  private:
+    Socket::Pointer                     m_Socket;
+    MultiThreader::Pointer              m_Threader;
+    int                                 m_ThreadID;
+    bool                                m_Running;
+
+    SimpleMutexLock                     m_Lock;
+    ConditionVariable::Pointer          m_Condition;
+
+    QueueType                           m_Queue;
+    /// Queued message of each conflated type and device name
+    std::map<KeyType, QueueType::iterator> m_ConflatedEntries;
+    std::set<std::string>               m_ConflatedTypes;
+
+    igtl_uint64                         m_QueuedSize;
+    igtl_uint64                         m_HighWatermark;
+    igtl_uint64                         m_LowWatermark;
+    bool                                m_Congested;
+
+    igtl_uint64                         m_NumberOfMessagesSent;
+    igtl_uint64                         m_NumberOfMessagesConflated;
+    igtl_uint64                         m_NumberOfMessagesDropped;
+  };
+
+} // namespace igtl
+
+#endif // __igtlOutboundMessageQueue_h
@@ -0,0 +1,132 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlPackedMessage.h"
+#include "igtlThreadPool.h"
+#include "igtl_header.h"
+
+#include <cstring>
+
+namespace
+{
+  // Sockets a packed message is sent to by SendToSockets()
+  struct SendData
+  {
+    const igtl::PackedMessage*                message;
+    const std::vector<igtl::Socket::Pointer>* sockets;
+    std::vector<int>*                         results;
+  };
+
+  void SendToSockets(int begin, int end, void* ptr)
+  {
+    SendData* data = static_cast<SendData*>(ptr);
+    for (int i = begin; i < end; i ++)
+      {
+      (*data->results)[i] = data->message->Send((*data->sockets)[i]);
+      }
+  }
+
+  // Field of the header, which is not null-terminated if it fills the field
+  std::string GetHeaderString(const char* field, size_t size)
+  {
+    size_t length = 0;
+    while (length < size && field[length] != '\0')
+      {
+      length ++;
+      }
+    return std::string(field, length);
+  }
+}
+
+namespace igtl {
+
+  PackedMessage::PackedMessage():Object()
+  {
+  }
+
+  PackedMessage::~PackedMessage()
+  {
+  }
+
+  PackedMessage::Pointer PackedMessage::Create(MessageBase* message)
+  {
+    if (message == NULL || message->GetPackPointer() == NULL)
+      {
+      return NULL;
+      }
+    return Create(message->GetPackPointer(), message->GetPackSize());
+  }
+
+  PackedMessage::Pointer PackedMessage::Create(const void* data, igtl_uint64 length)
+  {
+    if (data == NULL || length < IGTL_HEADER_SIZE)
+      {
+      return NULL;
+      }
+    igtl_header header;
+    memcpy(&header, data, IGTL_HEADER_SIZE);
+    igtl_header_convert_byte_order(&header);
+    if (header.body_size > length - IGTL_HEADER_SIZE)
+      {
+      return NULL;
+      }
+
+    Pointer packed = new PackedMessage;
+    packed->UnRegister();
+    const igtl_uint8* bytes = static_cast<const igtl_uint8*>(data);
+    packed->m_Buffer.assign(bytes, bytes + IGTL_HEADER_SIZE + header.body_size);
+    packed->m_MessageType = GetHeaderString(header.name, IGTL_HEADER_TYPE_SIZE);
+    packed->m_DeviceName = GetHeaderString(header.device_name, IGTL_HEADER_NAME_SIZE);
+    return packed;
+  }
+
+  int PackedMessage::Send(Socket* socket) const
+  {
+    if (socket == NULL)
+      {
+      return 0;
+      }
+    return socket->Send(&this->m_Buffer[0], (int)this->m_Buffer.size());
+  }
+
+  int PackedMessage::Send(const std::vector<Socket::Pointer>& sockets, std::vector<int>* results) const
+  {
+    std::vector<int> sent(sockets.size(), 0);
+
+    SendData data;
+    data.message = this;
+    data.sockets = &sockets;
+    data.results = &sent;
+    if (sockets.size() > 1 && this->m_Buffer.size() >= PackedMessageParallelSendSize)
+      {
+      ThreadPool::GetGlobalThreadPool()->ParallelFor(0, (int)sockets.size(), 1, SendToSockets, &data);
+      }
+    else
+      {
+      SendToSockets(0, (int)sockets.size(), &data);
+      }
+
+    int n = 0;
+    for (size_t i = 0; i < sent.size(); i ++)
+      {
+      n += sent[i] ? 1 : 0;
+      }
+    if (results)
+      {
+      results->swap(sent);
+      }
+    return n;
+  }
+
+} // namespace igtl
@@ -0,0 +1,88 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlPackedMessage_h
+#define __igtlPackedMessage_h
+
+#include <string>
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlSocket.h"
+#include "igtl_types.h"
+
+// Size of the messages from which Send() sends to the sockets in parallel
+#define PackedMessageParallelSendSize 65536
+
+namespace igtl
+{
+  /// The PackedMessage class is an immutable copy of a packed message (header, body and meta
+  /// data), to send the same message to many clients without packing it for each of them.
+  ///
+  /// A packed message is never modified once created: it can be shared by several threads,
+  /// queues (OutboundMessageQueue::Push()) and senders (MessageSender::Start()) without locking,
+  /// and is released with its last reference. The message it was created from can be modified
+  /// and packed again meanwhile.
+  ///
+  /// Typical use:
+  ///
+  ///   transformMsg->Pack();
+  ///   igtl::PackedMessage::Pointer packed = igtl::PackedMessage::Create(transformMsg);
+  ///   packed->Send(sockets);
+  class IGTLCommon_EXPORT PackedMessage: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::PackedMessage, Object)
+
+    /// Copies a packed message. Returns NULL if the message is not packed.
+    static Pointer Create(MessageBase* message);
+
+    /// Copies a packed message from a buffer holding its header (network byte order) and body.
+    /// Returns NULL if the buffer is smaller than its header and body.
+    static Pointer Create(const void* data, igtl_uint64 length);
+
+  public:
+    const void* GetPackPointer() const { return &this->m_Buffer[0]; }
+    igtl_uint64 GetPackSize() const { return this->m_Buffer.size(); }
+
+    /// Gets the message type and the device name of the header.
+    const std::string& GetMessageType() const { return this->m_MessageType; }
+    const std::string& GetDeviceName() const { return this->m_DeviceName; }
+
+    /// Sends the message to a socket. Returns 1 on success, or 0 if the send fails.
+    int Send(Socket* socket) const;
+
+    /// Sends the message to sockets, in parallel on the global thread pool from
+    /// PackedMessageParallelSendSize bytes, so that the message is sent to the other sockets while
+    /// a socket is blocked. 'results', if not NULL, is set to the result of Send() for each socket.
+    /// Returns the number of sockets the message has been sent to.
+    int Send(const std::vector<Socket::Pointer>& sockets, std::vector<int>* results = NULL) const;
+
+  protected:
+    PackedMessage();
+    ~PackedMessage();
+
+  private:
+    /// Header (network byte order), body and meta data
+    std::vector<igtl_uint8>     m_Buffer;
+
+    std::string                 m_MessageType;
+    std::string                 m_DeviceName;
+  };
+
+} // namespace igtl
+
+#endif // __igtlPackedMessage_h
@@ -0,0 +1,783 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlScalarCodec.h"
+
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtl_util.h"
+
+#include <string.h>
+
+#define IGTL_SCALAR_CODEC_HEADER_SIZE   16
+#define IGTL_SCALAR_CODEC_VERSION       1
+#define IGTL_SCALAR_CODEC_STORED        0x80000000U
+
+// LZ parameters: 4-byte minimum match, 64 KB window, the last 5 bytes are literals
+// and no match starts in the last 12 bytes.
+#define IGTL_SCALAR_CODEC_MIN_MATCH     4
+#define IGTL_SCALAR_CODEC_MAX_OFFSET    65535
+#define IGTL_SCALAR_CODEC_LAST_LITERALS 5
+#define IGTL_SCALAR_CODEC_MATCH_LIMIT   12
+#define IGTL_SCALAR_CODEC_HASH_BITS     14
+
+namespace igtl {
+
+  static void ScalarCodecWrite32(unsigned char* p, igtl_uint32 v)
+  {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+  }
+
+  static igtl_uint32 ScalarCodecRead32(const unsigned char* p)
+  {
+    return ((igtl_uint32)p[0] << 24) | ((igtl_uint32)p[1] << 16) | ((igtl_uint32)p[2] << 8) | (igtl_uint32)p[3];
+  }
+
+  static igtl_uint32 ScalarCodecLoad32(const unsigned char* p)
+  {
+    igtl_uint32 v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+
+  // Groups the bytes of the scalars by their position in the scalars. The trailing bytes
+  // that do not make a whole scalar are copied.
+  static void ScalarCodecShuffle(const unsigned char* src, unsigned char* dst, int size, int elementSize)
+  {
+    int count = size / elementSize;
+    for (int b = 0; b < elementSize; b ++)
+      {
+      const unsigned char* s = src + b;
+      unsigned char* d = dst + (size_t)b * count;
+      for (int i = 0; i < count; i ++)
+        {
+        d[i] = s[(size_t)i * elementSize];
+        }
+      }
+    memcpy(dst + (size_t)count * elementSize, src + (size_t)count * elementSize, size - count * elementSize);
+  }
+
+  static void ScalarCodecUnshuffle(const unsigned char* src, unsigned char* dst, int size, int elementSize)
+  {
+    int count = size / elementSize;
+    for (int b = 0; b < elementSize; b ++)
+      {
+      const unsigned char* s = src + (size_t)b * count;
+      unsigned char* d = dst + b;
+      for (int i = 0; i < count; i ++)
+        {
+        d[(size_t)i * elementSize] = s[i];
+        }
+      }
+    memcpy(dst + (size_t)count * elementSize, src + (size_t)count * elementSize, size - count * elementSize);
+  }
+
+  static unsigned char* ScalarCodecWriteLength(unsigned char* op, int length)
+  {
+    while (length >= 255)
+      {
+      *(op ++) = 255;
+      length -= 255;
+      }
+    *(op ++) = (unsigned char)length;
+    return op;
+  }
+
+  // Compresses a chunk. The output must hold at least size + size / 255 + 16 bytes.
+  // Returns the size of the compressed chunk.
+  static int ScalarCodecCompressChunk(const unsigned char* src, int size, unsigned char* dst)
+  {
+    std::vector<int> table(1 << IGTL_SCALAR_CODEC_HASH_BITS, -1);
+    unsigned char* op = dst;
+    int anchor = 0;
+    int ip = 0;
+    int limit = size - IGTL_SCALAR_CODEC_MATCH_LIMIT;
+    int matchLimit = size - IGTL_SCALAR_CODEC_LAST_LITERALS;
+    while (ip < limit)
+      {
+      igtl_uint32 sequence = ScalarCodecLoad32(src + ip);
+      igtl_uint32 h = (sequence * 2654435761U) >> (32 - IGTL_SCALAR_CODEC_HASH_BITS);
+      int ref = table[h];
+      table[h] = ip;
+      if (ref < 0 || ip - ref > IGTL_SCALAR_CODEC_MAX_OFFSET || ScalarCodecLoad32(src + ref) != sequence)
+        {
+        // Skip faster over incompressible data
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+        }
+
+      int length = IGTL_SCALAR_CODEC_MIN_MATCH;
+      while (ip + length < matchLimit && src[ref + length] == src[ip + length])
+        {
+        length ++;
+        }
+
+      int literals = ip - anchor;
+      int matchCode = length - IGTL_SCALAR_CODEC_MIN_MATCH;
+      unsigned char* token = op ++;
+      *token = (unsigned char)(((literals < 15 ? literals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+      if (literals >= 15)
+        {
+        op = ScalarCodecWriteLength(op, literals - 15);
+        }
+      memcpy(op, src + anchor, literals);
+      op += literals;
+      int offset = ip - ref;
+      *(op ++) = (unsigned char)offset;
+      *(op ++) = (unsigned char)(offset >> 8);
+      if (matchCode >= 15)
+        {
+        op = ScalarCodecWriteLength(op, matchCode - 15);
+        }
+      ip += length;
+      anchor = ip;
+      }
+
+    // Last literals
+    int literals = size - anchor;
+    *(op ++) = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+      {
+      op = ScalarCodecWriteLength(op, literals - 15);
+      }
+    memcpy(op, src + anchor, literals);
+    op += literals;
+    return (int)(op - dst);
+  }
+
+  // Reads the extension of a length. Returns false past the end of the input.
+  static bool ScalarCodecReadLength(const unsigned char*& ip, const unsigned char* iend, int& length)
+  {
+    unsigned char b;
+    do
+      {
+      if (ip >= iend || length > 0x7FFFFF00)
+        {
+        return false;
+        }
+      b = *(ip ++);
+      length += b;
+      }
+    while (b == 255);
+    return true;
+  }
+
+  // Decompresses a chunk to exactly size bytes. Returns false if the chunk is corrupted.
+  static bool ScalarCodecDecompressChunk(const unsigned char* src, int srcSize, unsigned char* dst, int size)
+  {
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + size;
+    while (ip < iend)
+      {
+      unsigned char token = *(ip ++);
+      int literals = token >> 4;
+      if (literals == 15 && !ScalarCodecReadLength(ip, iend, literals))
+        {
+        return false;
+        }
+      if (literals > iend - ip || literals > oend - op)
+        {
+        return false;
+        }
+      memcpy(op, ip, literals);
+      ip += literals;
+      op += literals;
+      if (ip == iend)
+        {
+        break;
+        }
+
+      if (iend - ip < 2)
+        {
+        return false;
+        }
+      int offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      int length = token & 15;
+      if (length == 15 && !ScalarCodecReadLength(ip, iend, length))
+        {
+        return false;
+        }
+      length += IGTL_SCALAR_CODEC_MIN_MATCH;
+      if (offset == 0 || offset > op - dst || length > oend - op)
+        {
+        return false;
+        }
+      // A match overlapping the output (e.g. a run) is copied byte by byte.
+      const unsigned char* match = op - offset;
+      if (offset >= length)
+        {
+        memcpy(op, match, length);
+        }
+      else
+        {
+        for (int n = 0; n < length; n ++)
+          {
+          op[n] = match[n];
+          }
+        }
+      op += length;
+      }
+    return op == oend;
+  }
+
+  // Chunks of a Compress() or a Decompress(), processed in parallel
+  struct ScalarCodecJob
+  {
+    const unsigned char*                     Data;
+    int                                      Size;
+    int                                      ElementSize;
+    int                                      ChunkSize;
+    std::vector<std::vector<unsigned char> > Compressed;
+    const unsigned char*                     Encoded;
+    std::vector<int>                         Offsets;
+    unsigned char*                           Output;
+    std::vector<char>                        Errors;
+  };
+
+  static void ScalarCodecCompressChunks(int begin, int end, void* data)
+  {
+    ScalarCodecJob* job = static_cast<ScalarCodecJob*>(data);
+    std::vector<unsigned char> shuffled;
+    for (int c = begin; c < end; c ++)
+      {
+      int offset = c * job->ChunkSize;
+      int size = job->Size - offset < job->ChunkSize ? job->Size - offset : job->ChunkSize;
+      const unsigned char* src = job->Data + offset;
+      if (job->ElementSize > 1)
+        {
+        shuffled.resize(size);
+        ScalarCodecShuffle(src, &shuffled[0], size, job->ElementSize);
+        src = &shuffled[0];
+        }
+      std::vector<unsigned char>& out = job->Compressed[c];
+      out.resize(4 + size + size / 255 + 16);
+      int compressed = ScalarCodecCompressChunk(src, size, &out[4]);
+      if (compressed >= size)
+        {
+        // Stored: the scalars are copied unshuffled.
+        ScalarCodecWrite32(&out[0], (igtl_uint32)size | IGTL_SCALAR_CODEC_STORED);
+        memcpy(&out[4], job->Data + offset, size);
+        compressed = size;
+        }
+      else
+        {
+        ScalarCodecWrite32(&out[0], (igtl_uint32)compressed);
+        }
+      out.resize(4 + compressed);
+      }
+  }
+
+  static void ScalarCodecDecompressChunks(int begin, int end, void* data)
+  {
+    ScalarCodecJob* job = static_cast<ScalarCodecJob*>(data);
+    std::vector<unsigned char> shuffled;
+    for (int c = begin; c < end; c ++)
+      {
+      int offset = c * job->ChunkSize;
+      int size = job->Size - offset < job->ChunkSize ? job->Size - offset : job->ChunkSize;
+      const unsigned char* src = job->Encoded + job->Offsets[c];
+      igtl_uint32 length = ScalarCodecRead32(src);
+      int compressed = (int)(length & ~IGTL_SCALAR_CODEC_STORED);
+      src += 4;
+      unsigned char* dst = job->Output + offset;
+      if (length & IGTL_SCALAR_CODEC_STORED)
+        {
+        if (compressed != size)
+          {
+          job->Errors[c] = 1;
+          continue;
+          }
+        memcpy(dst, src, size);
+        continue;
+        }
+      unsigned char* out = dst;
+      if (job->ElementSize > 1)
+        {
+        shuffled.resize(size);
+        out = &shuffled[0];
+        }
+      if (!ScalarCodecDecompressChunk(src, compressed, out, size))
+        {
+        job->Errors[c] = 1;
+        continue;
+        }
+      if (job->ElementSize > 1)
+        {
+        ScalarCodecUnshuffle(out, dst, size, job->ElementSize);
+        }
+      }
+  }
+
+  ScalarCodec::ScalarCodec():Object()
+  {
+    this->m_ChunkSize = ScalarCodecDefaultChunkSize;
+    this->m_NumberOfThreads = 0;
+    this->m_ThreadPool = NULL;
+  }
+
+  ScalarCodec::~ScalarCodec()
+  {
+  }
+
+  void ScalarCodec::SetNumberOfThreads(int numberOfThreads)
+  {
+    this->m_NumberOfThreads = numberOfThreads < 0 ? 0 : numberOfThreads;
+    this->m_ThreadPool = NULL;
+    if (this->m_NumberOfThreads > 1)
+      {
+      // The calling thread takes part in the parallel regions.
+      this->m_ThreadPool = ThreadPool::New();
+      this->m_ThreadPool->ReserveWorkers(this->m_NumberOfThreads - 1);
+      }
+  }
+
+  void ScalarCodec::ParallelFor(int n, ParallelForFunctionType function, void* data)
+  {
+    if (this->m_NumberOfThreads == 1 || n == 1)
+      {
+      function(0, n, data);
+      }
+    else if (this->m_ThreadPool.IsNotNull())
+      {
+      this->m_ThreadPool->ParallelFor(0, n, 1, function, data);
+      }
+    else
+      {
+      ThreadPool::GetGlobalThreadPool()->ParallelFor(0, n, 1, function, data);
+      }
+  }
+
+  int ScalarCodec::Compress(const void* data, int size, int elementSize, int chunkSize,
+                            std::vector<unsigned char>& output)
+  {
+    if ((data == NULL && size > 0) || size < 0 || elementSize < 1 || elementSize > 255 || chunkSize < 1)
+      {
+      return 0;
+      }
+    chunkSize = (chunkSize + elementSize - 1) / elementSize * elementSize;
+    if (size > 0 && chunkSize > size)
+      {
+      chunkSize = size;
+      }
+
+    ScalarCodecJob job;
+    job.Data = static_cast<const unsigned char*>(data);
+    job.Size = size;
+    job.ElementSize = elementSize;
+    job.ChunkSize = chunkSize;
+    int numberOfChunks = (size + chunkSize - 1) / chunkSize;
+    job.Compressed.resize(numberOfChunks);
+    if (numberOfChunks > 0)
+      {
+      this->ParallelFor(numberOfChunks, &ScalarCodecCompressChunks, &job);
+      }
+
+    size_t start = output.size();
+    size_t encodedSize = IGTL_SCALAR_CODEC_HEADER_SIZE;
+    for (int c = 0; c < numberOfChunks; c ++)
+      {
+      encodedSize += job.Compressed[c].size();
+      }
+    if (encodedSize > 0x7FFFFFFF)
+      {
+      return 0;
+      }
+    output.resize(start + encodedSize);
+    unsigned char* p = &output[start];
+    p[0] = 'I';
+    p[1] = 'G';
+    p[2] = 'L';
+    p[3] = 'Z';
+    p[4] = IGTL_SCALAR_CODEC_VERSION;
+    p[5] = (unsigned char)elementSize;
+    p[6] = 0;
+    p[7] = 0;
+    ScalarCodecWrite32(p + 8, (igtl_uint32)size);
+    ScalarCodecWrite32(p + 12, (igtl_uint32)chunkSize);
+    p += IGTL_SCALAR_CODEC_HEADER_SIZE;
+    for (int c = 0; c < numberOfChunks; c ++)
+      {
+      memcpy(p, &job.Compressed[c][0], job.Compressed[c].size());
+      p += job.Compressed[c].size();
+      }
+    return (int)encodedSize;
+  }
+
+  int ScalarCodec::GetDecompressedSize(const void* encoded, int size)
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(encoded);
+    if (p == NULL || size < IGTL_SCALAR_CODEC_HEADER_SIZE ||
+        p[0] != 'I' || p[1] != 'G' || p[2] != 'L' || p[3] != 'Z' || p[4] != IGTL_SCALAR_CODEC_VERSION ||
+        p[5] == 0)
+      {
+      return -1;
+      }
+    igtl_uint32 rawSize = ScalarCodecRead32(p + 8);
+    igtl_uint32 chunkSize = ScalarCodecRead32(p + 12);
+    if (rawSize > 0x7FFFFFFF || chunkSize == 0 || chunkSize > 0x7FFFFFFF)
+      {
+      return -1;
+      }
+    return (int)rawSize;
+  }
+
+  int ScalarCodec::Decompress(const void* encoded, int size, void* data, int dataSize)
+  {
+    int rawSize = GetDecompressedSize(encoded, size);
+    if (rawSize < 0 || rawSize != dataSize || (data == NULL && rawSize > 0))
+      {
+      return 0;
+      }
+    const unsigned char* p = static_cast<const unsigned char*>(encoded);
+    ScalarCodecJob job;
+    job.Size = rawSize;
+    job.ElementSize = p[5];
+    job.ChunkSize = (int)ScalarCodecRead32(p + 12);
+    job.Encoded = p;
+    job.Output = static_cast<unsigned char*>(data);
+
+    // Offsets of the chunks
+    int numberOfChunks = (int)(((igtl_uint64)rawSize + job.ChunkSize - 1) / job.ChunkSize);
+    job.Offsets.resize(numberOfChunks);
+    job.Errors.resize(numberOfChunks, 0);
+    int offset = IGTL_SCALAR_CODEC_HEADER_SIZE;
+    for (int c = 0; c < numberOfChunks; c ++)
+      {
+      if (size - offset < 4)
+        {
+        return 0;
+        }
+      igtl_uint32 length = ScalarCodecRead32(p + offset) & ~IGTL_SCALAR_CODEC_STORED;
+      if (length > (igtl_uint32)(size - offset - 4))
+        {
+        return 0;
+        }
+      job.Offsets[c] = offset;
+      offset += 4 + (int)length;
+      }
+    if (offset != size)
+      {
+      return 0;
+      }
+
+    if (numberOfChunks > 0)
+      {
+      this->ParallelFor(numberOfChunks, &ScalarCodecDecompressChunks, &job);
+      }
+    for (int c = 0; c < numberOfChunks; c ++)
+      {
+      if (job.Errors[c])
+        {
+        return 0;
+        }
+      }
+    return rawSize;
+  }
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+
+  // Packed message whose content is given as bytes
+  class ScalarCodecMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::ScalarCodecMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::ScalarCodecMessage);
+
+    void SetMessageType(const std::string& type) { this->m_SendMessageType = type; }
+
+    std::vector<unsigned char> Content;
+
+  protected:
+    ScalarCodecMessage() : MessageBase() {}
+    ~ScalarCodecMessage() {}
+
+    virtual int CalculateContentBufferSize() { return (int)this->Content.size(); }
+    virtual int PackContent()
+    {
+      AllocateBuffer();
+      if (!this->Content.empty())
+        {
+        memcpy(this->m_Content, &this->Content[0], this->Content.size());
+        }
+      return 1;
+    }
+    virtual int UnpackContent() { return 1; }
+  };
+
+  // Gets the size of the scalars of an IMAGE or NDARRAY type.
+  static int ScalarCodecGetScalarSize(int type)
+  {
+    switch (type)
+      {
+      case 2:  // INT8
+      case 3:  // UINT8
+        return 1;
+      case 4:  // INT16
+      case 5:  // UINT16
+        return 2;
+      case 6:  // INT32
+      case 7:  // UINT32
+      case 10: // FLOAT32
+        return 4;
+      case 11: // FLOAT64
+      case 13: // COMPLEX (2 x FLOAT64)
+        return 8;
+      default:
+        return 0;
+      }
+  }
+
+  // Finds the content of a packed or received message with the header version 2, and the
+  // sizes of the extended header and of the meta data around it.
+  // The extended header of a packed message is in the network byte order, and the one of
+  // a message whose meta data are unpacked in the host byte order (unpacked).
+  static bool ScalarCodecGetContent(MessageBase* msg, bool unpacked, unsigned char*& content, int& contentSize,
+                                    int& extendedHeaderSize, int& metaDataSize)
+  {
+    unsigned char* body = static_cast<unsigned char*>(msg->GetPackBodyPointer());
+    int bodySize = msg->GetPackBodySize();
+    if (msg->GetHeaderVersion() < IGTL_HEADER_VERSION_2 || body == NULL ||
+        bodySize < (int)sizeof(igtl_extended_header))
+      {
+      return false;
+      }
+    igtl_extended_header extendedHeader;
+    memcpy(&extendedHeader, body, sizeof(igtl_extended_header));
+    if (!unpacked)
+      {
+      igtl_extended_header_convert_byte_order(&extendedHeader);
+      }
+    extendedHeaderSize = extendedHeader.extended_header_size;
+    metaDataSize = extendedHeader.meta_data_header_size + (int)extendedHeader.meta_data_size;
+    contentSize = bodySize - extendedHeaderSize - metaDataSize;
+    if (extendedHeaderSize < (int)sizeof(igtl_extended_header) || metaDataSize < 0 || contentSize < 0)
+      {
+      return false;
+      }
+    content = body + extendedHeaderSize;
+    return true;
+  }
+
+  // Gets the size of the content header, the size of the scalars and the size of a slice of
+  // the content of an IMAGE or NDARRAY message.
+  static bool ScalarCodecGetLayout(const std::string& type, const unsigned char* content, int contentSize,
+                                   int& headerSize, int& scalarSize, int& sliceSize)
+  {
+    if (type == "IMAGE")
+      {
+      if (contentSize < IGTL_IMAGE_HEADER_SIZE)
+        {
+        return false;
+        }
+      igtl_image_header imageHeader;
+      memcpy(&imageHeader, content, IGTL_IMAGE_HEADER_SIZE);
+      igtl_image_convert_byte_order(&imageHeader);
+      headerSize = IGTL_IMAGE_HEADER_SIZE;
+      scalarSize = ScalarCodecGetScalarSize(imageHeader.scalar_type);
+      sliceSize = imageHeader.subvol_size[0] * imageHeader.subvol_size[1] * imageHeader.num_components * scalarSize;
+      }
+    else if (type == "NDARRAY")
+      {
+      if (contentSize < 2)
+        {
+        return false;
+        }
+      headerSize = 2 + 2 * content[1];
+      scalarSize = ScalarCodecGetScalarSize(content[0]);
+      sliceSize = scalarSize;
+      }
+    else
+      {
+      return false;
+      }
+    return scalarSize > 0 && headerSize <= contentSize;
+  }
+
+  MessageBase::Pointer ScalarCodec::Encode(MessageBase* msg)
+  {
+    if (msg == NULL || msg->GetHeaderVersion() < IGTL_HEADER_VERSION_2 || !msg->Pack())
+      {
+      return NULL;
+      }
+    unsigned char* content;
+    int contentSize;
+    int extendedHeaderSize;
+    int metaDataSize;
+    int headerSize;
+    int scalarSize;
+    int sliceSize;
+    std::string type = msg->GetMessageType();
+    if (!ScalarCodecGetContent(msg, false, content, contentSize, extendedHeaderSize, metaDataSize) ||
+        !ScalarCodecGetLayout(type, content, contentSize, headerSize, scalarSize, sliceSize))
+      {
+      return NULL;
+      }
+
+    ScalarCodecMessage::Pointer encoded = ScalarCodecMessage::New();
+    encoded->SetMessageType(type);
+    encoded->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    encoded->SetDeviceName(msg->GetDeviceName());
+    unsigned int sec;
+    unsigned int frac;
+    msg->GetTimeStamp(&sec, &frac);
+    encoded->SetTimeStamp(sec, frac);
+    const MessageBase::MetaDataMap& metaData = msg->GetMetaData();
+    for (MessageBase::MetaDataMap::const_iterator it = metaData.begin(); it != metaData.end(); ++it)
+      {
+      encoded->SetMetaDataElement(it->first, it->second.first, it->second.second);
+      }
+    encoded->SetMetaDataElement(IGTL_CONTENT_ENCODING, IANA_TYPE_US_ASCII, IGTL_CONTENT_ENCODING_SHUFFLE_LZ);
+
+    // Chunks of whole slices
+    int chunkSize = this->m_ChunkSize;
+    if (sliceSize > 0 && chunkSize % sliceSize != 0)
+      {
+      chunkSize = (chunkSize / sliceSize + 1) * sliceSize;
+      }
+    encoded->Content.assign(content, content + headerSize);
+    if (this->Compress(content + headerSize, contentSize - headerSize, scalarSize, chunkSize, encoded->Content) == 0)
+      {
+      return NULL;
+      }
+    encoded->Pack();
+    return encoded.GetPointer();
+  }
+
+  int ScalarCodec::Decode(MessageBase* received, MessageBase* target, int crccheck)
+  {
+    if (received == NULL || target == NULL || received->GetPackPointer() == NULL)
+      {
+      return 0;
+      }
+    // The header of a received message is unpacked in place (host byte order).
+    igtl_header header;
+    memcpy(&header, received->GetPackPointer(), IGTL_HEADER_SIZE);
+    unsigned char* body = static_cast<unsigned char*>(received->GetPackBodyPointer());
+    if ((int)header.body_size != received->GetPackBodySize() ||
+        (crccheck && crc64(body, header.body_size, crc64(0, 0, 0LL)) != header.crc))
+      {
+      return 0;
+      }
+    // Unpacking the meta data converts the extended header to the host byte order.
+    received->UnpackHeaderAndMetaData(0);
+    if (!IsEncoded(received))
+      {
+      return 0;
+      }
+
+    unsigned char* content;
+    int contentSize;
+    int extendedHeaderSize;
+    int metaDataSize;
+    int headerSize;
+    int scalarSize;
+    int sliceSize;
+    if (!ScalarCodecGetContent(received, true, content, contentSize, extendedHeaderSize, metaDataSize) ||
+        !ScalarCodecGetLayout(received->GetMessageType(), content, contentSize, headerSize, scalarSize, sliceSize))
+      {
+      return 0;
+      }
+    const unsigned char* encoded = content + headerSize;
+    int encodedSize = contentSize - headerSize;
+    int rawSize = GetDecompressedSize(encoded, encodedSize);
+    if (rawSize < 0 || (igtl_uint64)extendedHeaderSize + headerSize + rawSize + metaDataSize > 0x7FFFFFFF)
+      {
+      return 0;
+      }
+
+    // Message of the target type, with the decompressed body
+    int bodySize = extendedHeaderSize + headerSize + rawSize + metaDataSize;
+    header.body_size = bodySize;
+    header.crc = 0;
+    igtl_header packedHeader = header;
+    igtl_header_convert_byte_order(&packedHeader);
+    MessageHeader::Pointer headerMsg = MessageHeader::New();
+    headerMsg->InitPack();
+    memcpy(headerMsg->GetPackPointer(), &packedHeader, IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+    target->SetMessageHeader(headerMsg);
+    target->AllocatePack();
+
+    unsigned char* dst = static_cast<unsigned char*>(target->GetPackBodyPointer());
+    memcpy(dst, body, extendedHeaderSize + headerSize);
+    igtl_extended_header_convert_byte_order(reinterpret_cast<igtl_extended_header*>(dst));
+    if (this->Decompress(encoded, encodedSize, dst + extendedHeaderSize + headerSize, rawSize) != rawSize)
+      {
+      return 0;
+      }
+    memcpy(dst + extendedHeaderSize + headerSize + rawSize, content + contentSize, metaDataSize);
+    header.crc = crc64(dst, bodySize, crc64(0, 0, 0LL));
+    memcpy(target->GetPackPointer(), &header, IGTL_HEADER_SIZE);
+
+    if (!(target->Unpack(0) & MessageHeader::UNPACK_BODY))
+      {
+      return 0;
+      }
+    target->RemoveMetaDataElement(IGTL_CONTENT_ENCODING);
+    return 1;
+  }
+
+  bool ScalarCodec::IsEncoded(MessageBase* received)
+  {
+    std::string encoding;
+    return received != NULL && received->GetMetaDataElement(IGTL_CONTENT_ENCODING, encoding) &&
+           encoding == IGTL_CONTENT_ENCODING_SHUFFLE_LZ;
+  }
+
+  void ScalarCodec::SetAcceptEncoding(MessageBase* request)
+  {
+    if (request != NULL)
+      {
+      request->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+      request->SetMetaDataElement(IGTL_ACCEPT_CONTENT_ENCODING, IANA_TYPE_US_ASCII, IGTL_CONTENT_ENCODING_SHUFFLE_LZ);
+      }
+  }
+
+  bool ScalarCodec::IsEncodingAccepted(MessageBase* request)
+  {
+    std::string encodings;
+    if (request == NULL || !request->GetMetaDataElement(IGTL_ACCEPT_CONTENT_ENCODING, encodings))
+      {
+      return false;
+      }
+    // Comma-separated list
+    std::string::size_type begin = 0;
+    while (begin <= encodings.size())
+      {
+      std::string::size_type end = encodings.find(',', begin);
+      if (end == std::string::npos)
+        {
+        end = encodings.size();
+        }
+      std::string encoding = encodings.substr(begin, end - begin);
+      std::string::size_type first = encoding.find_first_not_of(' ');
+      std::string::size_type last = encoding.find_last_not_of(' ');
+      if (first != std::string::npos && encoding.substr(first, last - first + 1) == IGTL_CONTENT_ENCODING_SHUFFLE_LZ)
+        {
+        return true;
+        }
+      begin = end + 1;
+      }
+    return false;
+  }
+
+#endif // OpenIGTLink_HEADER_VERSION >= 2
+
+} // namespace igtl
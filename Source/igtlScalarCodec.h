@@ -0,0 +1,144 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlScalarCodec_h
+#define __igtlScalarCodec_h
+
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMessageBase.h"
+#include "igtlThreadPool.h"
+
+#define ScalarCodecDefaultChunkSize  262144
+
+/// Meta data element announcing the encoding of the content of a message.
+#define IGTL_CONTENT_ENCODING           "ContentEncoding"
+/// Meta data element listing the encodings accepted by a receiver, set on its requests
+/// (e.g. GET_IMAGE, STT_IMAGE or GET_CAPABIL).
+#define IGTL_ACCEPT_CONTENT_ENCODING    "AcceptContentEncoding"
+/// Byte shuffle followed by LZ compression (see ScalarCodec)
+#define IGTL_CONTENT_ENCODING_SHUFFLE_LZ "shuffle-lz"
+
+namespace igtl
+{
+  /// The ScalarCodec class compresses losslessly the scalars of IMAGE and NDARRAY messages.
+  ///
+  /// The scalars are split into chunks (by default, whole slices of at least 256 KB), compressed
+  /// and decompressed in parallel. The bytes of each chunk are shuffled, i.e. grouped by their
+  /// position in the scalars (e.g. all the high bytes of 16-bit scalars, then all the low bytes),
+  /// then compressed with an LZ77 coder. A chunk that does not shrink is stored.
+  ///
+  /// The encoded message has the type, the header, the content header (e.g. the image header)
+  /// and the meta data of the original message, followed by the compressed scalars, and the
+  /// meta data element ContentEncoding = "shuffle-lz". As a stock receiver cannot read it, it
+  /// must only be sent to the receivers that announced the encoding in the meta data element
+  /// AcceptContentEncoding of their requests. The encoding requires the header version 2.
+  ///
+  /// The encoded scalars are a 16-byte header, then the chunks; all the integers are big endian.
+  ///
+  ///   Offset  Size  Field
+  ///   0       4     "IGLZ"
+  ///   4       1     Version (1)
+  ///   5       1     Size of the scalars (bytes)
+  ///   6       2     Reserved (0)
+  ///   8       4     Size of the scalars before compression (bytes)
+  ///   12      4     Size of a chunk before compression (bytes), except the last one
+  ///
+  /// Each chunk is its size after compression (4 bytes, the highest bit set if the chunk is
+  /// stored), followed by the compressed bytes. A compressed chunk is a sequence of LZ4-style
+  /// sequences: a token, whose high and low 4 bits are the number of literals and the length
+  /// of the match minus 4 (15 followed by bytes added up to the first one below 255 for longer
+  /// ones), the literals, and the offset of the match (2 bytes, little endian). The last
+  /// sequence has literals only.
+  ///
+  /// Typical use:
+  ///
+  ///   // Sender, for a receiver whose request accepts the encoding
+  ///   imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  ///   igtl::MessageBase::Pointer encoded = codec->Encode(imageMsg);
+  ///   socket->Send(encoded->GetPackPointer(), encoded->GetPackSize());
+  ///
+  ///   // Receiver, once the body is received into a message
+  ///   if (igtl::ScalarCodec::IsEncoded(receivedMsg))
+  ///     {
+  ///     igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  ///     codec->Decode(receivedMsg, imageMsg);
+  ///     }
+  class IGTLCommon_EXPORT ScalarCodec: public Object
+  {
+  public:
+    igtlTypeMacro(igtl::ScalarCodec, Object)
+    igtlNewMacro(igtl::ScalarCodec);
+
+  public:
+    /// Sets the minimum size of a chunk (bytes). The chunks of an IMAGE are whole slices.
+    void SetChunkSize(int size) { this->m_ChunkSize = size < 1 ? 1 : size; }
+    int GetChunkSize() { return this->m_ChunkSize; }
+
+    /// Sets the number of threads compressing and decompressing the chunks, on a pool of the
+    /// codec. 0 (default) uses the global thread pool, and 1 the calling thread only.
+    void SetNumberOfThreads(int numberOfThreads);
+    int GetNumberOfThreads() { return this->m_NumberOfThreads; }
+
+    /// Compresses scalars, whose size is a multiple of elementSize (1 to 255 bytes), into chunks
+    /// of chunkSize bytes, rounded up to a multiple of elementSize. The encoded scalars are
+    /// appended to the output. Returns the size of the encoded scalars, or 0 on error.
+    int Compress(const void* data, int size, int elementSize, int chunkSize, std::vector<unsigned char>& output);
+
+    /// Gets the size of encoded scalars before compression, or -1 if the header is not valid.
+    static int GetDecompressedSize(const void* encoded, int size);
+
+    /// Decompresses encoded scalars to an area of GetDecompressedSize() bytes.
+    /// Returns the size of the scalars, or 0 if the encoded scalars are corrupted.
+    int Decompress(const void* encoded, int size, void* data, int dataSize);
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    /// Packs an IMAGE or NDARRAY message with the header version 2, and creates the packed
+    /// message with the compressed scalars. Returns NULL for the other messages.
+    MessageBase::Pointer Encode(MessageBase* msg);
+
+    /// Decompresses a received message (its header set and its body received, not unpacked)
+    /// into a message of its type (ImageMessage or NDArrayMessage), which is then unpacked.
+    /// Returns 0 if the message is not encoded, its CRC is wrong with crccheck, or the
+    /// encoded scalars are corrupted.
+    int Decode(MessageBase* received, MessageBase* target, int crccheck = 1);
+
+    /// Returns true if a received message has encoded content.
+    static bool IsEncoded(MessageBase* received);
+
+    /// Adds the encodings accepted by the receiver to its request.
+    static void SetAcceptEncoding(MessageBase* request);
+
+    /// Returns true if the sender of a request accepts the encoded content.
+    static bool IsEncodingAccepted(MessageBase* request);
+#endif
+
+  protected:
+    ScalarCodec();
+    ~ScalarCodec();
+
+    /// Calls function(i0, i1, data) over [0, n) on the threads of the codec.
+    void ParallelFor(int n, ParallelForFunctionType function, void* data);
+
+  private:
+    int                 m_ChunkSize;
+    int                 m_NumberOfThreads;
+    ThreadPool::Pointer m_ThreadPool;
+  };
+
+} // namespace igtl
+
+#endif // __igtlScalarCodec_h
@@ -19,6 +19,7 @@
 #include <cstring>
 
 #include "igtlSessionManager.h"
+#include "igtlMessageFactory.h"
 #include "igtlMessageHandler.h"
 #include "igtlClientSocket.h"
 #include "igtlServerSocket.h"
@@ -33,12 +34,14 @@ SessionManager::SessionManager()
 {
   this->m_MessageHandlerList.clear();
   this->m_Mode = MODE_SERVER;
+  this->m_IntegrityMode = MessageBase::INTEGRITY_CRC64;
 
   this->m_Header = igtl::MessageHeader::New();
   this->m_TimeStamp = igtl::TimeStamp::New();
 
   this->m_CurrentReadIndex = 0;
   this->m_HeaderDeserialized = 0;
+  this->m_BytesToSkip = 0;
 }
 
 
@@ -82,6 +85,26 @@ int SessionManager::RemoveMessageHandler(MessageHandler* handler)
 }
 
 
+int SessionManager::AddSubscription(const char* type)
+{
+  if (type == NULL)
+    {
+    return 0;
+    }
+  return this->m_Subscriptions.insert(type).second ? 1 : 0;
+}
+
+
+int SessionManager::RemoveSubscription(const char* type)
+{
+  if (type == NULL)
+    {
+    return 0;
+    }
+  return this->m_Subscriptions.erase(type) > 0 ? 1 : 0;
+}
+
+
 int SessionManager::Connect()
 {
   
@@ -134,9 +157,22 @@ int SessionManager::Connect()
       }
     }
 
+  return this->Connect(this->m_Socket);
+}
+
+
+int SessionManager::Connect(Socket* socket)
+{
+  if (socket == NULL || !socket->GetConnected())
+    {
+    return 0;
+    }
+
+  this->m_Socket = socket;
   this->m_Socket->SetReceiveBlocking(0); // Psuedo non-blocking
   this->m_CurrentReadIndex = 0;
   this->m_HeaderDeserialized = 0;
+  this->m_BytesToSkip = 0;
   return 1;
 }
 
@@ -178,6 +214,13 @@ int SessionManager::ProcessMessage()
   //       continue to read the body
   //
 
+  //--------------------------------------------------
+  // Body being discarded
+  if (this->m_BytesToSkip > 0)
+    {
+    return this->SkipBody();
+    }
+
   //--------------------------------------------------
   // Header
   if (this->m_CurrentReadIndex == 0)
@@ -251,6 +294,21 @@ int SessionManager::ProcessMessage()
     //          << sec << "." << std::setw(9) << std::setfill('0') 
     //          << nanosec << std::endl;
 
+    // Discard the messages of the types not subscribed before reading their bodies.
+#if OpenIGTLink_HEADER_VERSION >= 2
+    std::string messageType = this->m_Header->GetMessageType();
+#else
+    std::string messageType = this->m_Header->GetDeviceType();
+#endif
+    if (!this->m_Subscriptions.empty() &&
+        this->m_Subscriptions.find(messageType) == this->m_Subscriptions.end())
+      {
+      this->m_CurrentReadIndex = 0;
+      this->m_HeaderDeserialized = 0;
+      this->m_BytesToSkip = this->m_Header->GetBodySizeToRead();
+      return this->SkipBody();
+      }
+
     // Look for a message handler that matches to the message type.
     int found = 0;
     std::vector< MessageHandler* >::iterator iter;
@@ -276,11 +334,11 @@ int SessionManager::ProcessMessage()
 #else
       std::cerr << "Receiving: " << this->m_Header->GetDeviceType() << std::endl;
 #endif
-      this->m_Socket->Skip(this->m_Header->GetBodySizeToRead(), 0);
       // Reset the index counter to be ready for the next message
       this->m_CurrentReadIndex = 0;
       this->m_HeaderDeserialized = 0;
-      return 1;
+      this->m_BytesToSkip = this->m_Header->GetBodySizeToRead();
+      return this->SkipBody();
       }
 
     this->m_HeaderDeserialized = 1;
@@ -302,11 +360,54 @@ int SessionManager::ProcessMessage()
 }  
   
 
+int SessionManager::SkipBody()
+{
+  if (this->m_BytesToSkip <= 0)
+    {
+    this->m_BytesToSkip = 0;
+    return 1;
+    }
+  int r = this->m_Socket->Skip(this->m_BytesToSkip, 0);
+  if (r == 0)
+    {
+    this->m_BytesToSkip = 0;
+    return 0; // Disconnected
+    }
+  if (r > 0)
+    {
+    this->m_BytesToSkip -= r;
+    }
+  // The rest of the body is skipped by the next call, if the transfer was interrupted.
+  return this->m_BytesToSkip > 0 ? -1 : 1;
+}
+
+
+int SessionManager::PushMessage(PackedMessage* message)
+{
+  if (message && this->m_Socket.IsNotNull() && this->m_Socket->GetConnected()) // if client connected
+    {
+    return message->Send(this->m_Socket);
+    }
+  else
+    {
+    return 0;
+    }
+}
+
+
 int SessionManager::PushMessage(MessageBase* message)
 {
   
   if (message && this->m_Socket.IsNotNull() && this->m_Socket->GetConnected()) // if client connected
     {
+    if (message->GetIntegrityMode() != this->m_IntegrityMode)
+      {
+      MessageBase::Pointer copy = this->PackCopy(message);
+      if (copy.IsNotNull())
+        {
+        return this->m_Socket->Send(copy->GetBufferPointer(), copy->GetBufferSize());
+        }
+      }
     return this->m_Socket->Send(message->GetBufferPointer(), message->GetBufferSize());
     }
   else
@@ -316,6 +417,45 @@ int SessionManager::PushMessage(MessageBase* message)
 }
 
 
+MessageBase::Pointer SessionManager::PackCopy(MessageBase* message)
+{
+  if (message->GetBufferPointer() == NULL || message->GetBufferSize() < IGTL_HEADER_SIZE)
+    {
+    return NULL;
+    }
+
+  // The copy is unpacked from the packed message, as if it had been received.
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  memcpy(headerMsg->GetPackPointer(), message->GetBufferPointer(), IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  igtl::MessageFactory::Pointer factory = igtl::MessageFactory::New();
+  if (!factory->IsValid(headerMsg) ||
+      headerMsg->GetBodySizeToRead() != message->GetBufferBodySize())
+    {
+    return NULL;
+    }
+  MessageBase::Pointer copy = factory->CreateReceiveMessage(headerMsg);
+  if (copy.IsNull())
+    {
+    return NULL;
+    }
+  memcpy(copy->GetPackBodyPointer(), (unsigned char*)message->GetBufferPointer() + IGTL_HEADER_SIZE,
+         copy->GetPackBodySize());
+  if (!(copy->Unpack() & MessageBase::UNPACK_BODY))
+    {
+    return NULL;
+    }
+
+  copy->SetIntegrityMode(this->m_IntegrityMode);
+  if (!copy->Pack())
+    {
+    return NULL;
+    }
+  return copy;
+}
+
+
 }
 
 
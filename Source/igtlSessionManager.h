@@ -18,8 +18,11 @@
 #include "igtlObject.h"
 #include "igtlMacro.h"
 #include "igtlMessageHandler.h"
+#include "igtlPackedMessage.h"
 
 
+#include <set>
+#include <string>
 #include <vector>
 
 namespace igtl
@@ -52,22 +55,67 @@ class IGTLCommon_EXPORT SessionManager: public Object
   int            AddMessageHandler(MessageHandler*);
   int            RemoveMessageHandler(MessageHandler*);
 
+  // Description:
+  // Restrict the message types processed to the subscribed types. The bodies of
+  // the other messages are discarded without being read, even if a handler is
+  // registered for their type. All the types are processed if no type is subscribed.
+  int            AddSubscription(const char* type);
+  int            RemoveSubscription(const char* type);
+  void           ClearSubscriptions() { this->m_Subscriptions.clear(); }
+
   // Description:
   // Functions to manage the session
   int            Connect();
   int            Disconnect();
+
+  // Description:
+  // Start the session on a socket connected by the application, e.g. a
+  // SharedMemorySocket, instead of connecting with the mode, host name and port.
+  // Returns 1 on success, or 0 if the socket is not connected.
+  int            Connect(Socket* socket);
+
   int            ProcessMessage();
   int            PushMessage(MessageBase*);
+  int            PushMessage(PackedMessage*);
+
+  // Description:
+  // Set the integrity mode (MessageBase::INTEGRITY_*) of the messages sent by PushMessage()
+  // on this connection, e.g. INTEGRITY_NONE on a loopback connection. The message passed
+  // to PushMessage() is not modified: a message packed with another mode is copied and
+  // the copy is packed with the mode of the connection, unless its type is not known by
+  // MessageFactory. Setting the mode of the messages avoids the copy. A PackedMessage
+  // is sent as it has been packed.
+  void           SetIntegrityMode(int mode) { this->m_IntegrityMode = mode; }
+  int            GetIntegrityMode() { return this->m_IntegrityMode; }
+
+  // Description:
+  // Set whether the messages received and marked by the sender as packed with INTEGRITY_NONE
+  // are accepted without CRC check by the handlers (default: false, they are rejected unless
+  // the CRC of their body is 0). The setting is passed to the messages of the handlers with
+  // the header received.
+  void           SetAcceptIntegrityNone(bool accept) { this->m_Header->SetAcceptIntegrityNone(accept); }
+  bool           GetAcceptIntegrityNone() { return this->m_Header->GetAcceptIntegrityNone(); }
 
  protected:
   SessionManager();
   ~SessionManager();
 
+  // Description:
+  // Discard the body of the current message, or what remains of it.
+  // Returns 1 when the body has been discarded, -1 if it is interrupted, 0 if disconnected.
+  int            SkipBody();
+
+  // Description:
+  // Copy a packed message and pack the copy with the integrity mode of the connection.
+  // Returns NULL if the type is not known by MessageFactory or the message cannot be unpacked.
+  MessageBase::Pointer PackCopy(MessageBase* message);
+
  protected:
   bool           m_ConfigurationUpdated;
   std::string    m_Hostname;
   int            m_Port;
   int            m_Mode;
+  int            m_IntegrityMode;
 
   // Description:
   // m_CurrentReadIndex is used to save the current position of the message.
@@ -76,6 +124,13 @@ class IGTLCommon_EXPORT SessionManager: public Object
   int            m_CurrentReadIndex;
   int            m_HeaderDeserialized;
 
+  // Description:
+  // m_BytesToSkip is the size of the body being discarded, which remains to be
+  // skipped when the transfer is interrupted.
+  int            m_BytesToSkip;
+
+  std::set< std::string > m_Subscriptions;
+
   MessageHandler* m_CurrentMessageHandler;
 
   std::vector< MessageHandler* > m_MessageHandlerList;
@@ -0,0 +1,650 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlSharedMemorySocket.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#define IGTL_SHARED_MEMORY_SUPPORTED
+#endif
+
+#define IGTL_SHARED_MEMORY_MAGIC        0x4D534749 // "IGSM"
+#define IGTL_SHARED_MEMORY_VERSION      1
+
+// Number of checks of a ring before a side sleeps, when the processes can run in parallel
+#define IGTL_SHARED_MEMORY_SPIN_COUNT   20000
+
+// Longest sleep (microseconds) between the checks that the other process is alive
+#define IGTL_SHARED_MEMORY_CHECK_PERIOD 100000
+
+namespace igtl
+{
+  /// Ring buffer of one direction. The positions are the numbers of bytes written and read,
+  /// modulo 2^32. As the size of the buffers is a power of two, it divides 2^32 and the offset
+  /// of a position in the buffer is its low bits, across the wrap of the positions. The fields of the sender and of the receiver are on separate cache lines.
+  struct SharedMemoryRing
+  {
+    // Written by the sender
+    volatile igtl_uint32  head;
+    volatile igtl_uint32  dataSequence;     // incremented when data are written (futex)
+    volatile igtl_uint32  senderWaiting;
+    igtl_uint32           senderPadding[13];
+
+    // Written by the receiver
+    volatile igtl_uint32  tail;
+    volatile igtl_uint32  spaceSequence;    // incremented when data are read (futex)
+    volatile igtl_uint32  receiverWaiting;
+    igtl_uint32           receiverPadding[13];
+  };
+
+  /// Beginning of the segment, followed by the buffers of the rings
+  struct SharedMemoryControl
+  {
+    igtl_uint32           magic;
+    igtl_uint32           version;
+    igtl_uint32           bufferSize;
+    volatile igtl_uint32  connected;        // set by the client (futex)
+    volatile igtl_int32   pid[2];           // server, client
+    volatile igtl_uint32  closed[2];        // server, client
+    igtl_uint32           padding[8];
+
+    // Ring 0 is sent by the server, ring 1 by the client.
+    SharedMemoryRing      ring[2];
+  };
+}
+
+namespace
+{
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+  igtl_uint64 GetMicroseconds()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (igtl_uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  // Sleeps until the word differs from value, it is woken, or timeoutUs elapsed.
+  void WaitWord(volatile igtl_uint32* word, igtl_uint32 value, long timeoutUs)
+  {
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = timeoutUs / 1000000;
+    ts.tv_nsec = (timeoutUs % 1000000) * 1000;
+    syscall(SYS_futex, (igtl_uint32*)word, FUTEX_WAIT, value, &ts, NULL, 0);
+#else
+    if (*word == value)
+      {
+      usleep((useconds_t)std::min(timeoutUs, 50L));
+      }
+#endif
+  }
+
+  void WakeWord(volatile igtl_uint32* word)
+  {
+#if defined(__linux__)
+    syscall(SYS_futex, (igtl_uint32*)word, FUTEX_WAKE, 0x7FFFFFFF, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+  }
+
+  // Increments the sequence of a ring, and wakes the other side if it sleeps on it.
+  void Signal(volatile igtl_uint32* sequence, volatile igtl_uint32* waiting)
+  {
+    __sync_fetch_and_add(sequence, 1);
+    if (*waiting)
+      {
+      WakeWord(sequence);
+      }
+  }
+
+  bool IsProcessAlive(igtl_int32 pid)
+  {
+    return pid <= 0 || kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+  }
+
+  igtl_uint64 GetControlSize()
+  {
+    // The buffers start on a page boundary.
+    return (sizeof(igtl::SharedMemoryControl) + 4095) & ~(igtl_uint64)4095;
+  }
+#endif
+}
+
+namespace igtl {
+
+  SharedMemorySocket::SharedMemorySocket():Socket()
+  {
+    this->m_NameLinked = false;
+    this->m_Control = NULL;
+    this->m_SegmentSize = 0;
+    this->m_Side = 0;
+    this->m_SendRing = NULL;
+    this->m_SendBuffer = NULL;
+    this->m_ReceiveRing = NULL;
+    this->m_ReceiveBuffer = NULL;
+    this->m_SendTimeoutUs = 0;
+    this->m_ReceiveTimeoutUs = 0;
+  }
+
+  SharedMemorySocket::~SharedMemorySocket()
+  {
+    this->CloseSocket();
+  }
+
+  int SharedMemorySocket::CreateServer(const char* name, int bufferSize)
+  {
+    this->CloseSocket();
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    if (name == NULL || bufferSize <= 0 || bufferSize > 0x40000000)
+      {
+      return -1;
+      }
+    // Rounded up to a power of two
+    int roundedSize = 1;
+    while (roundedSize < bufferSize)
+      {
+      roundedSize <<= 1;
+      }
+    bufferSize = roundedSize;
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST)
+      {
+      // A segment left by a server that has exited is replaced.
+      int old = shm_open(name, O_RDWR, 0600);
+      struct stat st;
+      bool stale = false;
+      if (old >= 0 && fstat(old, &st) == 0 && (igtl_uint64)st.st_size >= sizeof(SharedMemoryControl))
+        {
+        void* p = mmap(NULL, sizeof(SharedMemoryControl), PROT_READ, MAP_SHARED, old, 0);
+        if (p != MAP_FAILED)
+          {
+          SharedMemoryControl* control = static_cast<SharedMemoryControl*>(p);
+          stale = control->magic != IGTL_SHARED_MEMORY_MAGIC || !IsProcessAlive(control->pid[0]);
+          munmap(p, sizeof(SharedMemoryControl));
+          }
+        }
+      if (old >= 0)
+        {
+        close(old);
+        }
+      if (!stale)
+        {
+        igtlErrorMacro("Shared memory " << name << " is used by another server.");
+        return -1;
+        }
+      shm_unlink(name);
+      fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+      }
+    if (fd < 0)
+      {
+      return -1;
+      }
+
+    igtl_uint64 size = GetControlSize() + 2 * (igtl_uint64)bufferSize;
+    if (ftruncate(fd, (off_t)size) != 0)
+      {
+      close(fd);
+      shm_unlink(name);
+      return -1;
+      }
+    this->m_Name = name;
+    this->m_NameLinked = true;
+    if (this->MapSegment(fd, size, 0) != 0)
+      {
+      close(fd);
+      this->CloseSocket();
+      return -1;
+      }
+    close(fd);
+
+    // The memory of a new segment is zero: only the identification is set, the magic last.
+    this->m_Control->version = IGTL_SHARED_MEMORY_VERSION;
+    this->m_Control->bufferSize = bufferSize;
+    this->m_Control->pid[0] = (igtl_int32)getpid();
+    __sync_synchronize();
+    this->m_Control->magic = IGTL_SHARED_MEMORY_MAGIC;
+    return 0;
+#else
+    (void)name;
+    (void)bufferSize;
+    return -1;
+#endif
+  }
+
+  int SharedMemorySocket::WaitForConnection(unsigned long msec)
+  {
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    if (this->m_Control == NULL || this->m_Side != 0)
+      {
+      return -1;
+      }
+    igtl_uint64 deadline = GetMicroseconds() + (igtl_uint64)msec * 1000;
+    while (!this->m_Control->connected)
+      {
+      long timeout = IGTL_SHARED_MEMORY_CHECK_PERIOD;
+      if (msec > 0)
+        {
+        igtl_uint64 now = GetMicroseconds();
+        if (now >= deadline)
+          {
+          return -1;
+          }
+        timeout = (long)std::min<igtl_uint64>(deadline - now, timeout);
+        }
+      WaitWord(&this->m_Control->connected, 0, timeout);
+      }
+
+    // The name is removed, so that it can be used by a new server.
+    if (this->m_NameLinked)
+      {
+      shm_unlink(this->m_Name.c_str());
+      this->m_NameLinked = false;
+      }
+    return 0;
+#else
+    (void)msec;
+    return -1;
+#endif
+  }
+
+  int SharedMemorySocket::ConnectToServer(const char* name)
+  {
+    this->CloseSocket();
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    if (name == NULL)
+      {
+      return -1;
+      }
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+      {
+      return -1;
+      }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (igtl_uint64)st.st_size < GetControlSize() ||
+        this->MapSegment(fd, st.st_size, 1) != 0)
+      {
+      close(fd);
+      this->CloseSocket();
+      return -1;
+      }
+    close(fd);
+
+    SharedMemoryControl* control = this->m_Control;
+    if (control->magic != IGTL_SHARED_MEMORY_MAGIC || control->version != IGTL_SHARED_MEMORY_VERSION ||
+        control->bufferSize == 0 || (control->bufferSize & (control->bufferSize - 1)) != 0 ||
+        GetControlSize() + 2 * (igtl_uint64)control->bufferSize != this->m_SegmentSize ||
+        control->closed[0])
+      {
+      this->CloseSocket();
+      return -1;
+      }
+    if (!__sync_bool_compare_and_swap(&control->connected, 0, 1))
+      {
+      // Another client has connected meanwhile.
+      this->m_Control = NULL;
+      munmap(control, this->m_SegmentSize);
+      return -1;
+      }
+    control->pid[1] = (igtl_int32)getpid();
+    WakeWord(&control->connected);
+    return 0;
+#else
+    (void)name;
+    return -1;
+#endif
+  }
+
+  int SharedMemorySocket::MapSegment(int fd, igtl_uint64 size, int side)
+  {
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    void* p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      {
+      return -1;
+      }
+    this->m_Control = static_cast<SharedMemoryControl*>(p);
+    this->m_SegmentSize = size;
+    this->m_Side = side;
+
+    igtl_uint64 bufferSize = (size - GetControlSize()) / 2;
+    char* buffers = static_cast<char*>(p) + GetControlSize();
+    this->m_SendRing = &this->m_Control->ring[side];
+    this->m_SendBuffer = buffers + side * bufferSize;
+    this->m_ReceiveRing = &this->m_Control->ring[1 - side];
+    this->m_ReceiveBuffer = buffers + (1 - side) * bufferSize;
+    return 0;
+#else
+    (void)fd;
+    (void)size;
+    (void)side;
+    return -1;
+#endif
+  }
+
+  bool SharedMemorySocket::GetConnected()
+  {
+    return this->m_Control != NULL && this->m_Control->connected;
+  }
+
+  void SharedMemorySocket::CloseSocket()
+  {
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    if (this->m_Control != NULL)
+      {
+      // Wakes the other side, which may be waiting for data or space.
+      this->m_Control->closed[this->m_Side] = 1;
+      __sync_synchronize();
+      for (int i = 0; i < 2; i ++)
+        {
+        __sync_fetch_and_add(&this->m_Control->ring[i].dataSequence, 1);
+        __sync_fetch_and_add(&this->m_Control->ring[i].spaceSequence, 1);
+        WakeWord(&this->m_Control->ring[i].dataSequence);
+        WakeWord(&this->m_Control->ring[i].spaceSequence);
+        }
+      munmap(this->m_Control, (size_t)this->m_SegmentSize);
+      }
+    if (this->m_NameLinked)
+      {
+      shm_unlink(this->m_Name.c_str());
+      }
+#endif
+    this->m_NameLinked = false;
+    this->m_Control = NULL;
+    this->m_SegmentSize = 0;
+    this->m_SendRing = NULL;
+    this->m_SendBuffer = NULL;
+    this->m_ReceiveRing = NULL;
+    this->m_ReceiveBuffer = NULL;
+  }
+
+  bool SharedMemorySocket::IsPeerClosed()
+  {
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    int peer = 1 - this->m_Side;
+    return this->m_Control->closed[peer] || !IsProcessAlive(this->m_Control->pid[peer]);
+#else
+    return true;
+#endif
+  }
+
+  int SharedMemorySocket::Wait(SharedMemoryRing* ring, bool forData, igtl_uint32 position, long timeoutUs)
+  {
+#if defined(IGTL_SHARED_MEMORY_SUPPORTED)
+    volatile igtl_uint32* sequence = forData ? &ring->dataSequence : &ring->spaceSequence;
+    volatile igtl_uint32* waiting = forData ? &ring->receiverWaiting : &ring->senderWaiting;
+    igtl_uint32 bufferSize = this->m_Control->bufferSize;
+    int peer = 1 - this->m_Side;
+
+    // Spins briefly first: a TRANSFORM is usually answered within a few microseconds.
+    static const long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    int spin = nCPUs > 1 ? IGTL_SHARED_MEMORY_SPIN_COUNT : 0;
+    igtl_uint64 deadline = timeoutUs > 0 ? GetMicroseconds() + timeoutUs : 0;
+    while (true)
+      {
+      igtl_uint32 value = *sequence;
+      __sync_synchronize();
+      bool ready = forData ? ring->head != position : (igtl_uint32)(position - ring->tail) < bufferSize;
+      if (ready)
+        {
+        return 1;
+        }
+      if (this->m_Control->closed[peer] || this->m_Control->closed[this->m_Side])
+        {
+        return 0;
+        }
+      if (spin > 0)
+        {
+        spin --;
+        continue;
+        }
+
+      long timeout = IGTL_SHARED_MEMORY_CHECK_PERIOD;
+      if (deadline)
+        {
+        igtl_uint64 now = GetMicroseconds();
+        if (now >= deadline)
+          {
+          return -1;
+          }
+        timeout = (long)std::min<igtl_uint64>(deadline - now, timeout);
+        }
+
+      // The other side signals after updating its position: either the position is seen
+      // after the flag is set, or the sequence has changed and the wait returns at once.
+      *waiting = 1;
+      __sync_synchronize();
+      ready = forData ? ring->head != position : (igtl_uint32)(position - ring->tail) < bufferSize;
+      if (!ready)
+        {
+        WaitWord(sequence, value, timeout);
+        }
+      *waiting = 0;
+      if (!ready && *sequence == value && this->IsPeerClosed())
+        {
+        return 0;
+        }
+      }
+#else
+    (void)ring;
+    (void)forData;
+    (void)position;
+    (void)timeoutUs;
+    return 0;
+#endif
+  }
+
+  int SharedMemorySocket::Write(const char* data, int length, bool wait)
+  {
+    if (!this->GetConnected())
+      {
+      return -1;
+      }
+    SharedMemoryRing* ring = this->m_SendRing;
+    igtl_uint32 bufferSize = this->m_Control->bufferSize;
+    int peer = 1 - this->m_Side;
+    int total = 0;
+    while (total < length)
+      {
+      if (this->m_Control->closed[peer])
+        {
+        return -1;
+        }
+      igtl_uint32 head = ring->head;
+      igtl_uint32 space = bufferSize - (igtl_uint32)(head - ring->tail);
+      if (space == 0)
+        {
+        if (!wait)
+          {
+          break;
+          }
+        int r = this->Wait(ring, false, head, this->m_SendTimeoutUs);
+        if (r <= 0)
+          {
+          return (r < 0 && total > 0) ? total : -1;
+          }
+        continue;
+        }
+
+      // The data are copied, then published by moving the head.
+      __sync_synchronize();
+      igtl_uint32 n = std::min(space, (igtl_uint32)(length - total));
+      igtl_uint32 offset = head & (bufferSize - 1);
+      igtl_uint32 first = std::min(n, bufferSize - offset);
+      memcpy(this->m_SendBuffer + offset, data + total, first);
+      memcpy(this->m_SendBuffer, data + total + first, n - first);
+      __sync_synchronize();
+      ring->head = head + n;
+      Signal(&ring->dataSequence, &ring->receiverWaiting);
+      total += n;
+      }
+    return total;
+  }
+
+  int SharedMemorySocket::Read(char* data, int length, int readFully)
+  {
+    if (!this->GetConnected() || length <= 0)
+      {
+      return 0;
+      }
+    SharedMemoryRing* ring = this->m_ReceiveRing;
+    igtl_uint32 bufferSize = this->m_Control->bufferSize;
+    int total = 0;
+    while (total < length)
+      {
+      igtl_uint32 tail = ring->tail;
+      igtl_uint32 available = (igtl_uint32)(ring->head - tail);
+      if (available == 0)
+        {
+        int r = this->Wait(ring, true, tail, this->m_ReceiveTimeoutUs);
+        if (r <= 0)
+          {
+          // Disconnected (0) or timeout (-1)
+          return total > 0 ? total : r;
+          }
+        continue;
+        }
+
+      // The data are copied, then released by moving the tail.
+      __sync_synchronize();
+      igtl_uint32 n = std::min(available, (igtl_uint32)(length - total));
+      if (data != NULL)
+        {
+        igtl_uint32 offset = tail & (bufferSize - 1);
+        igtl_uint32 first = std::min(n, bufferSize - offset);
+        memcpy(data + total, this->m_ReceiveBuffer + offset, first);
+        memcpy(data + total + first, this->m_ReceiveBuffer, n - first);
+        }
+      __sync_synchronize();
+      ring->tail = tail + n;
+      Signal(&ring->spaceSequence, &ring->senderWaiting);
+      total += n;
+      if (!readFully)
+        {
+        break;
+        }
+      }
+    return total;
+  }
+
+  int SharedMemorySocket::Send(const void* data, int length)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    if (length <= 0)
+      {
+      return 1;
+      }
+    return this->Write(static_cast<const char*>(data), length, true) == length ? 1 : 0;
+  }
+
+  int SharedMemorySocket::Send(const void* const* data, const int* length, int numberOfFragments)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    for (int i = 0; i < numberOfFragments; i ++)
+      {
+      if (length[i] > 0 && this->Write(static_cast<const char*>(data[i]), length[i], true) != length[i])
+        {
+        return 0;
+        }
+      }
+    return 1;
+  }
+
+  int SharedMemorySocket::SendNonBlocking(const void* data, int length)
+  {
+    if (!this->GetConnected())
+      {
+      return -1;
+      }
+    if (length <= 0)
+      {
+      return 0;
+      }
+    return this->Write(static_cast<const char*>(data), length, false);
+  }
+
+  int SharedMemorySocket::Receive(void* data, int length, int readFully/*=1*/)
+  {
+    return this->Read(static_cast<char*>(data), length, readFully);
+  }
+
+  int SharedMemorySocket::Skip(int length, int /*skipFully=1*/)
+  {
+    // As Socket::Skip(), the data are skipped until 'length' bytes or the timeout, whatever skipFully.
+    return this->Read(NULL, length, 1);
+  }
+
+  int SharedMemorySocket::SetReceiveTimeout(int timeout)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    this->m_ReceiveTimeoutUs = timeout > 0 ? (long)timeout * 1000 : 0;
+    return timeout;
+  }
+
+  int SharedMemorySocket::SetSendTimeout(int timeout)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    this->m_SendTimeoutUs = timeout > 0 ? (long)timeout * 1000 : 0;
+    return timeout;
+  }
+
+  int SharedMemorySocket::SetReceiveBlocking(int sw)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    // As for a TCP socket, the pseudo non-blocking mode waits for 1 microsecond.
+    this->m_ReceiveTimeoutUs = sw ? 0 : 1;
+    return sw;
+  }
+
+  int SharedMemorySocket::SetSendBlocking(int sw)
+  {
+    if (!this->GetConnected())
+      {
+      return 0;
+      }
+    this->m_SendTimeoutUs = sw ? 0 : 1;
+    return sw;
+  }
+
+} // namespace igtl
@@ -0,0 +1,139 @@
+/*=========================================================================
+
+ Program:   The OpenIGTLink Library
+ Language:  C++
+ Web page:  http://openigtlink.org/
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#ifndef __igtlSharedMemorySocket_h
+#define __igtlSharedMemorySocket_h
+
+#include <string>
+
+#include "igtlSocket.h"
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtl_types.h"
+
+// Default size of the ring buffer of each direction (bytes)
+#define SharedMemorySocketDefaultBufferSize (8 * 1024 * 1024)
+
+namespace igtl
+{
+  struct SharedMemoryControl;
+  struct SharedMemoryRing;
+
+  /// The SharedMemorySocket class connects two processes of the same host through a shared
+  /// memory segment rather than the TCP loopback. It implements the transfer methods of Socket,
+  /// so that it can be used by SessionManager::Connect(Socket*), the message handlers and the
+  /// other classes sending to or receiving from a socket.
+  ///
+  /// The segment holds a ring buffer for each direction. The sender copies the data into the
+  /// ring and the receiver copies them out, without system call as long as neither has to wait:
+  /// a receiver waiting for data, or a sender waiting for space, spins briefly and then sleeps
+  /// on a futex (Linux) until it is woken by the other side.
+  ///
+  /// The server creates the segment, a POSIX shared memory object named like "/igtl-tracker",
+  /// and waits for a client. The name is removed once the client is connected, and the memory
+  /// is released when both sides have closed. A single client connects to a segment. The end of
+  /// the other process is detected when it closes the socket or exits.
+  ///
+  /// Not available on Windows, where CreateServer() and ConnectToServer() fail.
+  ///
+  /// Typical use:
+  ///
+  ///   // Server
+  ///   socket->CreateServer("/igtl-tracker");
+  ///   socket->WaitForConnection(10000);
+  ///   sessionManager->Connect(socket);
+  ///
+  ///   // Client
+  ///   socket->ConnectToServer("/igtl-tracker");
+  class IGTLCommon_EXPORT SharedMemorySocket: public Socket
+  {
+  public:
+    igtlTypeMacro(igtl::SharedMemorySocket, igtl::Socket)
+    igtlNewMacro(igtl::SharedMemorySocket);
+
+  public:
+    /// Creates the segment with ring buffers of bufferSize bytes, rounded up to a power of two
+    /// (at most 1 GiB). A segment left by a server that has exited is replaced. Returns 0 on
+    /// success, -1 on error (e.g. the name is used).
+    int CreateServer(const char* name, int bufferSize = SharedMemorySocketDefaultBufferSize);
+
+    /// Waits for a client to connect to the segment created by CreateServer(), for msec
+    /// milliseconds (0: no timeout). Returns 0 when a client is connected, -1 on timeout or error.
+    int WaitForConnection(unsigned long msec = 0);
+
+    /// Connects to the segment of a server. Returns 0 on success, -1 on error (e.g. no server,
+    /// or a client is already connected).
+    int ConnectToServer(const char* name);
+
+    /// Returns true from the connection until the socket is closed.
+    virtual bool GetConnected();
+
+    /// Closes the connection: the other side receives the data sent so far, then 0.
+    virtual void CloseSocket();
+
+    virtual int Send(const void* data, int length);
+    virtual int Send(const void* const* data, const int* length, int numberOfFragments);
+    virtual int SendNonBlocking(const void* data, int length);
+    virtual int Receive(void* data, int length, int readFully=1);
+    virtual int Skip(int length, int skipFully=1);
+
+    virtual int SetReceiveTimeout(int timeout);
+    virtual int SetSendTimeout(int timeout);
+    virtual int SetReceiveBlocking(int sw);
+    virtual int SetSendBlocking(int sw);
+
+  protected:
+    SharedMemorySocket();
+    ~SharedMemorySocket();
+
+    /// Maps the segment opened as 'fd' of 'size' bytes and sets the rings of the side.
+    int MapSegment(int fd, igtl_uint64 size, int side);
+
+    /// Copies up to 'length' bytes into the send ring, waiting for space if 'wait' is set.
+    /// Returns the number of bytes written, or -1 if the other side is closed or the send
+    /// timeout expired before any byte is written.
+    int Write(const char* data, int length, bool wait);
+
+    /// Copies (or discards if data is NULL) up to 'length' bytes from the receive ring.
+    /// Same return values as Receive().
+    int Read(char* data, int length, int readFully);
+
+    /// Waits until the ring has data (forData) or space, after 'position' (the tail or the head
+    /// of this side). Returns 1 when ready, 0 if the other side is closed, -1 on timeout.
+    int Wait(SharedMemoryRing* ring, bool forData, igtl_uint32 position, long timeoutUs);
+
+    /// Returns true if the other side has closed or exited.
+    bool IsPeerClosed();
+
+  private:
+    std::string            m_Name;
+    bool                   m_NameLinked;
+
+    SharedMemoryControl*   m_Control;
+    igtl_uint64            m_SegmentSize;
+    int                    m_Side;
+
+    SharedMemoryRing*      m_SendRing;
+    char*                  m_SendBuffer;
+    SharedMemoryRing*      m_ReceiveRing;
+    char*                  m_ReceiveBuffer;
+
+    /// Timeouts in microseconds, 0 if none
+    long                   m_SendTimeoutUs;
+    long                   m_ReceiveTimeoutUs;
+  };
+
+} // namespace igtl
+
+#endif // __igtlSharedMemorySocket_h
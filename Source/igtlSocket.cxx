@@ -40,9 +40,14 @@
   #include <netdb.h>
   #include <unistd.h>
   #include <sys/time.h>
+  #include <sys/uio.h>
+  #include <limits.h>
+  #include <errno.h>
 #endif
 
 #include <string.h>
+#include <algorithm>
+#include <vector>
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 #define WSA_VERSION MAKEWORD(1,1)
@@ -55,9 +60,31 @@
       }
 #endif
 
+// Maximum number of fragments passed to a single sendmsg() call
+#if defined(IOV_MAX)
+#define igtlSocketMaxFragments IOV_MAX
+#else
+#define igtlSocketMaxFragments 16
+#endif
+
+// Size of the blocks read to skip data, where the kernel cannot discard it
+#define igtlSocketSkipBlockSize 65536
+
 namespace igtl
 {
 
+// Returns true if the last send() or recv() failed because it would block or its timeout expired.
+static bool IsSocketTimeout()
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  int error = WSAGetLastError();
+  return error == WSAEWOULDBLOCK || error == WSAETIMEDOUT;
+#else
+  // EAGAIN is also returned when the timeout set by SO_SNDTIMEO or SO_RCVTIMEO expires.
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 Socket::Socket()
 {
@@ -296,6 +323,36 @@ void Socket::CloseSocket(int socketdescriptor)
   igtlCloseSocketMacro(socketdescriptor);
 }
 
+//-----------------------------------------------------------------------------
+int Socket::GetSendFlags()
+{
+  int flags;
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  flags = 0;
+#else
+  // On unix boxes if the client disconnects and the server attempts
+  // to send data through the socket then the application crashes
+  // due to SIGPIPE signal. Disable the signal to prevent crash.
+  //#ifndef __sun
+  //  flags = MSG_NOSIGNAL;
+  //#else
+  //  // Signal is not present on SUN systems, the signal has
+  //  // to be managed at application level.
+  //  flags = 0;
+  //#endif
+#if defined(MSG_NOSIGNAL) // For Linux > 2.2
+  flags = MSG_NOSIGNAL;
+#else
+  #if defined(SO_NOSIGPIPE) // Mac OS X
+  int set = 1;
+  setsockopt(this->m_SocketDescriptor, SOL_SOCKET, SO_NOSIGPIPE, (void *)&set, sizeof(int));    
+  #endif
+  flags = 0;
+#endif
+#endif
+  return flags;
+}
+
 //-----------------------------------------------------------------------------
 int Socket::Send(const void* data, int length)
 {
@@ -312,30 +369,7 @@ int Socket::Send(const void* data, int length)
   int total = 0;
   do
     {
-    int flags;
-#if defined(_WIN32) && !defined(__CYGWIN__)
-    flags = 0;
-#else
-    // On unix boxes if the client disconnects and the server attempts
-    // to send data through the socket then the application crashes
-    // due to SIGPIPE signal. Disable the signal to prevent crash.
-    //#ifndef __sun
-    //  flags = MSG_NOSIGNAL;
-    //#else
-    //  // Signal is not present on SUN systems, the signal has
-    //  // to be managed at application level.
-    //  flags = 0;
-    //#endif
-  #if defined(MSG_NOSIGNAL) // For Linux > 2.2
-    flags = MSG_NOSIGNAL;
-  #else
-    #if defined(SO_NOSIGPIPE) // Mac OS X
-    int set = 1;
-    setsockopt(this->m_SocketDescriptor, SOL_SOCKET, SO_NOSIGPIPE, (void *)&set, sizeof(int));    
-    #endif
-    flags = 0;
-  #endif
-#endif
+    int flags = this->GetSendFlags();
     int n = send(this->m_SocketDescriptor, buffer+total, length-total, flags);
     if(n < 0)
       {
@@ -347,6 +381,121 @@ int Socket::Send(const void* data, int length)
   return 1;
 }
 
+//-----------------------------------------------------------------------------
+int Socket::Send(const void* const* data, const int* length, int numberOfFragments)
+{
+  if (!this->GetConnected())
+    {
+    return 0;
+    }
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  std::vector<WSABUF> fragments;
+  for (int i = 0; i < numberOfFragments; i ++)
+    {
+    if (length[i] > 0)
+      {
+      WSABUF fragment;
+      fragment.buf = (char*)data[i];
+      fragment.len = length[i];
+      fragments.push_back(fragment);
+      }
+    }
+
+  size_t first = 0;
+  while (first < fragments.size())
+    {
+    DWORD n = 0;
+    if (WSASend(this->m_SocketDescriptor, &fragments[first], (DWORD)(fragments.size() - first), &n, 0, NULL, NULL) != 0)
+      {
+      return 0;
+      }
+    // Skip the fragments sent, a partial send resumes in the middle of a fragment.
+    while (n > 0 && first < fragments.size())
+      {
+      if (n >= fragments[first].len)
+        {
+        n -= fragments[first].len;
+        first ++;
+        }
+      else
+        {
+        fragments[first].buf += n;
+        fragments[first].len -= n;
+        n = 0;
+        }
+      }
+    }
+#else
+  std::vector<struct iovec> fragments;
+  for (int i = 0; i < numberOfFragments; i ++)
+    {
+    if (length[i] > 0)
+      {
+      struct iovec fragment;
+      fragment.iov_base = (void*)data[i];
+      fragment.iov_len = length[i];
+      fragments.push_back(fragment);
+      }
+    }
+
+  size_t first = 0;
+  while (first < fragments.size())
+    {
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &fragments[first];
+    message.msg_iovlen = std::min<size_t>(fragments.size() - first, igtlSocketMaxFragments);
+    int flags = this->GetSendFlags();
+    ssize_t n = sendmsg(this->m_SocketDescriptor, &message, flags);
+    if (n < 0)
+      {
+      return 0;
+      }
+    // Skip the fragments sent, a partial send resumes in the middle of a fragment.
+    while (n > 0 && first < fragments.size())
+      {
+      if ((size_t)n >= fragments[first].iov_len)
+        {
+        n -= fragments[first].iov_len;
+        first ++;
+        }
+      else
+        {
+        fragments[first].iov_base = (char*)fragments[first].iov_base + n;
+        fragments[first].iov_len -= n;
+        n = 0;
+        }
+      }
+    }
+#endif
+
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int Socket::SendNonBlocking(const void* data, int length)
+{
+  if (!this->GetConnected())
+    {
+    return -1;
+    }
+  if (length <= 0)
+    {
+    return 0;
+    }
+  int flags = this->GetSendFlags();
+#if defined(MSG_DONTWAIT)
+  flags |= MSG_DONTWAIT;
+#endif
+  int n = send(this->m_SocketDescriptor, reinterpret_cast<const char*>(data), length, flags);
+  if (n >= 0)
+    {
+    return n;
+    }
+  return IsSocketTimeout() ? 0 : -1;
+}
+
 //-----------------------------------------------------------------------------
 int Socket::Receive(void* data, int length, int readFully/*=1*/)
 {
@@ -619,37 +768,45 @@ int Socket::GetSocketAddressAndPort(std::string& address, int& port)
 
 
 //-----------------------------------------------------------------------------
-int Socket::Skip(int length, int skipFully/*=1*/)
+int Socket::Skip(int length, int /*skipFully=1*/)
 {
-
-  if (length == 0)
+  if (length <= 0 || !this->GetConnected())
     {
     return 0;
     }
 
-  unsigned char dummy[256];
-  int block  = 256;
-  int n      = 0;
-  int remain = length;
+#if defined(__linux__) && defined(MSG_TRUNC)
+  // TCP data received with MSG_TRUNC is discarded without being copied.
+  char* scratch = NULL;
+  int block = length;
+  int flags = MSG_TRUNC;
+#else
+  int block = std::min(length, igtlSocketSkipBlockSize);
+  std::vector<char> buffer(block);
+  char* scratch = &buffer[0];
+  int flags = 0;
+#endif
 
-  do
+  int total = 0;
+  while (total < length)
     {
-    if (remain < block)
+    int n = recv(this->m_SocketDescriptor, scratch, std::min(length - total, block), flags);
+    if (n == 0)
       {
-      block = remain;
+      break; // Disconnected
       }
-    
-    n = this->Receive(dummy, block, skipFully);
-    if (!skipFully && n <= 0)
+    if (n < 0)
       {
+      // Timeout or error: the call returns what has been skipped.
+      if (total == 0)
+        {
+        return IsSocketTimeout() ? -1 : 0;
+        }
       break;
       }
-    remain -= n;
+    total += n;
     }
-  while (remain > 0 || (skipFully && n < block));
-
-  return (length - remain);
-
+  return total;
 }
 
 //-----------------------------------------------------------------------------
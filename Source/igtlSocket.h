@@ -35,6 +35,9 @@
  * This class was largely based on the igtlSocket class
  * from the Visualization Toolkit VTK.
  *
+ * The connection and transfer methods are virtual, so that other transports
+ * (e.g. SharedMemorySocket) can be used wherever a socket is expected.
+ *
  */
 
 #ifndef __igtlSocket_h
@@ -67,10 +70,10 @@ class IGTLCommon_EXPORT Socket : public Object
 public:
 
   /// Check is the socket is alive.
-  bool GetConnected() { return (this->m_SocketDescriptor >=0); }
+  virtual bool GetConnected() { return (this->m_SocketDescriptor >=0); }
   
   /// Close the socket.
-  void CloseSocket() {
+  virtual void CloseSocket() {
     this->CloseSocket(this->m_SocketDescriptor);
     this->m_SocketDescriptor = -1;
   }
@@ -79,7 +82,20 @@ public:
   /// Returns 1 on success, 0 on error and raises vtkCommand::ErrorEvent.
   /// SIGPIPE or other signal may be raised on systems (e.g., Sun Solaris) where
   /// MSG_NOSIGNAL flag is not supported for the socket send method.
-  int Send(const void* data, int length);
+  virtual int Send(const void* data, int length);
+
+  /// Sends a message split into several fragments, e.g. a header and bodies kept in separate
+  /// buffers, as if they were concatenated, without copying them into a single buffer
+  /// (scatter-gather). 'data' and 'length' are arrays of 'numberOfFragments' pointers and sizes.
+  /// Returns 1 on success, 0 on error.
+  virtual int Send(const void* const* data, const int* length, int numberOfFragments);
+
+  /// Sends as much of the data as the socket accepts without waiting for the receiver, in a
+  /// single send() call (with MSG_DONTWAIT where available, and within the send timeout set by
+  /// SetSendBlocking(0) or SetSendTimeout() otherwise). Returns the number of bytes sent, 0 if
+  /// the socket buffer is full, or -1 on error (e.g. disconnected).
+  /// The rest of the data must be sent by later calls, before any other data; see MessageSender.
+  virtual int SendNonBlocking(const void* data, int length);
 
   /// Receive data from the socket.
   /// This call blocks until some data is read from the socket, unless timeout is set
@@ -87,7 +103,7 @@ public:
   /// When the readFully flag is set, this call will block until all the requested data is
   /// read from the socket. The readFully flag will be ignored if the timeout is active.
   /// 0 on error, -1 on timeout, else number of bytes read is returned.
-  int Receive(void* data, int length, int readFully=1);
+  virtual int Receive(void* data, int length, int readFully=1);
 
   /// Set sending/receiving timeout for the existing socket in millisecond.
   /// This function should be called after opening the socket.
@@ -95,19 +111,19 @@ public:
 
   /// Set reciving timeout for the existing socket in millisecond.
   /// This function should be called after opening the socket.
-  int SetReceiveTimeout(int timeout);
+  virtual int SetReceiveTimeout(int timeout);
 
   /// Set sending timeout for the existing socket in millisecond.
   /// This function should be called after opening the socket.
-  int SetSendTimeout(int timeout);
+  virtual int SetSendTimeout(int timeout);
 
   /// Set  (psuedo) non-blocking mode for recv(). When sw=1, the time out is set to
   /// minimum value (1 microsecond in UNIX, 1 millisecond in Windows) for receiving.
-  int SetReceiveBlocking(int sw);
+  virtual int SetReceiveBlocking(int sw);
 
   /// Set (psuedo) non-blocking mode for recv(). When sw=1, the time out is set to
   /// minimum value (1 microsecond in UNIX, 1 millisecond in Windows) for sending.
-  int SetSendBlocking(int sw);
+  virtual int SetSendBlocking(int sw);
 
   /// Get socket address
   int GetSocketAddressAndPort(std::string& address, int & port);
@@ -116,7 +132,12 @@ public:
   /// The Skip() call has been newly introduced to the igtlSocket,
   /// after the class is imported from VTK, thus the call is
   /// not available in vtkSocket class.
-  int Skip(int length, int skipFully=1);
+  /// On Linux, the data is discarded by the kernel without being copied (MSG_TRUNC).
+  /// Elsewhere, it is read by blocks of 64 KB. Whether the skipFully flag is set or not, the call
+  /// keeps skipping until 'length' bytes are skipped, and stops earlier only when the receive
+  /// timeout expires, on error or when disconnected. Returns the number of bytes skipped, or, if
+  /// no byte could be skipped, 0 on error (e.g. disconnected) and -1 on timeout.
+  virtual int Skip(int length, int skipFully=1);
 
 protected:
   Socket();
@@ -124,6 +145,9 @@ protected:
 
   void PrintSelf(std::ostream& os) const;
 
+  /// Gets the flags passed to send(), disabling SIGPIPE where possible.
+  int GetSendFlags();
+
   int m_SocketDescriptor;
   igtlGetMacro(SocketDescriptor, int);
 
@@ -132,8 +132,11 @@ int StatusMessage::UnpackContent()
   this->m_ErrorName[IGTL_STATUS_ERROR_NAME_LENGTH-1] = '\0';
   strncpy(this->m_ErrorName, status_header->error_name, IGTL_STATUS_ERROR_NAME_LENGTH);
 
-  // make sure that the status message in the pack ends with '\0'
-  if (m_StatusMessage[this->m_BodySizeToRead-IGTL_STATUS_HEADER_SIZE-1] == '\0')
+  // make sure that the status message in the pack ends with '\0'. The content is followed by
+  // the meta data with header version 2, the body size cannot be used.
+  int contentSize = this->CalculateReceiveContentSize();
+  if (contentSize > IGTL_STATUS_HEADER_SIZE &&
+      m_StatusMessage[contentSize-IGTL_STATUS_HEADER_SIZE-1] == '\0')
     {
     this->m_StatusMessageString = m_StatusMessage;
     }
@@ -0,0 +1,677 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifdef _WIN32
+#include "igtlWindows.h"
+#endif
+
+#include "igtlThreadPool.h"
+#include "igtlMultiThreader.h"
+
+#include <deque>
+
+#if defined(OpenIGTLink_USE_PTHREADS)
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+extern "C" { typedef void *(*igtlExternCPoolThreadFunctionType)(void *); }
+#endif
+
+// Time a thread waiting for a future sleeps before looking for pending tasks again (ms)
+#define ThreadPoolFutureWaitInterval 1
+
+namespace igtl
+{
+
+//----------------------------------------------------------------------------
+// ThreadPoolFuture
+
+ThreadPoolFuture::ThreadPoolFuture()
+{
+  this->m_Pool = NULL;
+  this->m_NumberOfPendingTasks = 0;
+  this->m_Result = NULL;
+  this->m_Condition = ConditionVariable::New();
+}
+
+ThreadPoolFuture::~ThreadPoolFuture()
+{
+}
+
+void ThreadPoolFuture::AddTask(ThreadPool* pool)
+{
+  this->m_Lock.Lock();
+  this->m_Pool = pool;
+  this->m_NumberOfPendingTasks++;
+  this->m_Lock.Unlock();
+}
+
+void ThreadPoolFuture::TaskDone(void* result)
+{
+  this->m_Lock.Lock();
+  this->m_Result = result;
+  this->m_NumberOfPendingTasks--;
+  if (this->m_NumberOfPendingTasks == 0)
+    {
+    this->m_Condition->Broadcast();
+    }
+  this->m_Lock.Unlock();
+}
+
+bool ThreadPoolFuture::IsDone()
+{
+  this->m_Lock.Lock();
+  bool done = (this->m_NumberOfPendingTasks == 0);
+  this->m_Lock.Unlock();
+  return done;
+}
+
+void* ThreadPoolFuture::GetResult()
+{
+  this->m_Lock.Lock();
+  void* result = this->m_Result;
+  this->m_Lock.Unlock();
+  return result;
+}
+
+void* ThreadPoolFuture::Wait()
+{
+  while (!this->IsDone())
+    {
+    // Help with the pending tasks, which may be the tasks of this future.
+    if (this->m_Pool && this->m_Pool->RunPendingTask())
+      {
+      continue;
+      }
+    // The remaining tasks are running. The wait is bounded, so that the tasks queued in the meantime
+    // are picked up even if all the workers are waiting as well.
+    this->m_Lock.Lock();
+    if (this->m_NumberOfPendingTasks > 0)
+      {
+      this->m_Condition->Wait(&this->m_Lock, ThreadPoolFutureWaitInterval);
+      }
+    this->m_Lock.Unlock();
+    }
+  return this->GetResult();
+}
+
+
+//----------------------------------------------------------------------------
+// ThreadPool
+
+class ThreadPool::Task
+{
+public:
+  Task() : Function(NULL), Data(NULL), Future(NULL) {};
+  PoolTaskFunctionType Function;
+  void*                Data;
+  ThreadPoolFuture*    Future;
+};
+
+class ThreadPool::Worker
+{
+public:
+  ThreadPool*            Pool;
+  int                    Index;
+  std::deque<Task>       Tasks;
+  SimpleMutexLock        TasksLock;
+  bool                   Started;
+  bool                   Temporary;
+  /// Waiting for a task, until a thread clears the flag and signals the condition
+  bool                   Idle;
+  ConditionVariable::Pointer Condition;
+  /// Task of RunConcurrently() given to this worker only
+  bool                   HasAssignedTask;
+  Task                   AssignedTask;
+  MultiThreaderIDType    ThreadID;
+#if defined(OpenIGTLink_USE_PTHREADS)
+  pthread_t              Thread;
+#elif defined(OpenIGTLink_USE_WIN32_THREADS)
+  HANDLE                 Thread;
+
+  static DWORD WINAPI Entry(LPVOID ptr)
+  {
+    ThreadPool::WorkerLoop(ptr);
+    return 0;
+  }
+#endif
+};
+
+ThreadPool* ThreadPool::GetGlobalThreadPool()
+{
+  // Both are leaked on purpose: no static destructor joins the workers at exit.
+  static SimpleMutexLock* globalPoolLock = new SimpleMutexLock;
+  static ThreadPool* globalPool = NULL;
+
+  globalPoolLock->Lock();
+  if (globalPool == NULL)
+    {
+    ThreadPool::Pointer pool = ThreadPool::New();
+    pool->ReserveWorkers(MultiThreader::GetGlobalDefaultNumberOfThreads() - 1);
+    pool->Register();
+    globalPool = pool;
+    }
+  globalPoolLock->Unlock();
+  return globalPool;
+}
+
+ThreadPool::ThreadPool()
+{
+  this->m_NumberOfPendingTasks = 0;
+  this->m_NumberOfIdleWorkers = 0;
+  this->m_NextQueue = 0;
+  this->m_Stop = false;
+  // The list is never reallocated, so that the workers can be looked up without holding the lock.
+  this->m_Workers.reserve(IGTL_MAX_THREADS);
+}
+
+ThreadPool::~ThreadPool()
+{
+  // The workers run the pending tasks before they exit.
+  this->m_Lock.Lock();
+  this->m_Stop = true;
+  for (unsigned int i = 0; i < this->m_Workers.size(); i++)
+    {
+    this->m_Workers[i]->Condition->Signal();
+    }
+  this->m_Lock.Unlock();
+
+  // The workers are deleted once they have all exited, as a running worker looks for tasks in
+  // the queues of the others.
+  for (unsigned int i = 0; i < this->m_Workers.size(); i++)
+    {
+    JoinWorker(this->m_Workers[i]);
+    }
+  for (unsigned int i = 0; i < this->m_Workers.size(); i++)
+    {
+    delete this->m_Workers[i];
+    }
+  this->m_Workers.clear();
+}
+
+int ThreadPool::ReserveWorkers(int numberOfWorkers)
+{
+  if (numberOfWorkers > IGTL_MAX_THREADS)
+    {
+    numberOfWorkers = IGTL_MAX_THREADS;
+    }
+
+  this->m_Lock.Lock();
+  while ((int)this->m_Workers.size() < numberOfWorkers && !this->m_Stop)
+    {
+    if (this->StartWorker(NULL, false) == NULL)
+      {
+      // No thread support, or the system is out of threads. The tasks run in the waiting threads.
+      break;
+      }
+    }
+  int n = this->m_Workers.size();
+  this->m_Lock.Unlock();
+  return n;
+}
+
+ThreadPool::Worker* ThreadPool::StartWorker(const Task* task, bool temporary)
+{
+  if (!temporary && (int)this->m_Workers.size() >= IGTL_MAX_THREADS)
+    {
+    return NULL;
+    }
+
+  Worker* worker = new Worker;
+  worker->Pool = this;
+  worker->Index = temporary ? -1 : (int)this->m_Workers.size();
+  worker->Started = false;
+  worker->Temporary = temporary;
+  worker->Idle = false;
+  worker->Condition = ConditionVariable::New();
+  worker->HasAssignedTask = (task != NULL);
+  if (task != NULL)
+    {
+    worker->AssignedTask = *task;
+    }
+  if (!temporary)
+    {
+    // The worker is added before it starts, as it looks for tasks in the queues of the other workers.
+    this->m_Workers.push_back(worker);
+    }
+
+  bool created = false;
+#if defined(OpenIGTLink_USE_PTHREADS)
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  created = (pthread_create(&worker->Thread, &attr,
+                            reinterpret_cast<igtlExternCPoolThreadFunctionType>(&ThreadPool::WorkerLoop),
+                            (void*)worker) == 0);
+  pthread_attr_destroy(&attr);
+#elif defined(OpenIGTLink_USE_WIN32_THREADS)
+  DWORD threadId;
+  worker->Thread = CreateThread(NULL, 0, &Worker::Entry, (void*)worker, 0, &threadId);
+  created = (worker->Thread != NULL);
+#endif
+  if (!created)
+    {
+    if (!temporary)
+      {
+      this->m_Workers.pop_back();
+      }
+    delete worker;
+    return NULL;
+    }
+  return worker;
+}
+
+void ThreadPool::JoinWorker(Worker* worker)
+{
+#if defined(OpenIGTLink_USE_PTHREADS)
+  pthread_join(worker->Thread, NULL);
+#elif defined(OpenIGTLink_USE_WIN32_THREADS)
+  WaitForSingleObject(worker->Thread, INFINITE);
+  CloseHandle(worker->Thread);
+#else
+  (void)worker;
+#endif
+}
+
+int ThreadPool::GetNumberOfWorkers()
+{
+  this->m_Lock.Lock();
+  int n = this->m_Workers.size();
+  this->m_Lock.Unlock();
+  return n;
+}
+
+int ThreadPool::GetCurrentWorkerIndex()
+{
+  MultiThreaderIDType id = MultiThreader::GetCurrentThreadID();
+  int index = -1;
+  this->m_Lock.Lock();
+  for (unsigned int i = 0; i < this->m_Workers.size(); i++)
+    {
+    if (this->m_Workers[i]->Started && MultiThreader::ThreadsEqual(this->m_Workers[i]->ThreadID, id))
+      {
+      index = i;
+      break;
+      }
+    }
+  this->m_Lock.Unlock();
+  return index;
+}
+
+void ThreadPool::PushTask(const Task& task)
+{
+  int workerIndex = this->GetCurrentWorkerIndex();
+
+  this->m_Lock.Lock();
+  int numberOfWorkers = this->m_Workers.size();
+  if (workerIndex < 0 && numberOfWorkers > 0)
+    {
+    workerIndex = this->m_NextQueue % numberOfWorkers;
+    this->m_NextQueue = (this->m_NextQueue + 1) % numberOfWorkers;
+    }
+  Worker* worker = numberOfWorkers > 0 ? this->m_Workers[workerIndex] : NULL;
+  this->m_Lock.Unlock();
+
+  if (worker == NULL)
+    {
+    // Without worker, the task runs in the calling thread.
+    Task t = task;
+    this->RunTask(t);
+    return;
+    }
+
+  worker->TasksLock.Lock();
+  worker->Tasks.push_back(task);
+  worker->TasksLock.Unlock();
+
+  this->m_Lock.Lock();
+  this->m_NumberOfPendingTasks++;
+  for (unsigned int i = 0; i < this->m_Workers.size() && this->m_NumberOfIdleWorkers > 0; i++)
+    {
+    Worker* idle = this->m_Workers[i];
+    if (idle->Idle)
+      {
+      idle->Idle = false;
+      this->m_NumberOfIdleWorkers--;
+      idle->Condition->Signal();
+      break;
+      }
+    }
+  this->m_Lock.Unlock();
+}
+
+bool ThreadPool::PopTask(int workerIndex, Task& task)
+{
+  this->m_Lock.Lock();
+  int numberOfWorkers = this->m_Workers.size();
+  this->m_Lock.Unlock();
+  Worker* const* workers = numberOfWorkers > 0 ? &this->m_Workers[0] : NULL;
+  bool found = false;
+
+  // The most recent task of the own queue first, as its data are likely in the cache.
+  if (workerIndex >= 0 && workerIndex < numberOfWorkers)
+    {
+    Worker* worker = workers[workerIndex];
+    worker->TasksLock.Lock();
+    if (!worker->Tasks.empty())
+      {
+      task = worker->Tasks.back();
+      worker->Tasks.pop_back();
+      found = true;
+      }
+    worker->TasksLock.Unlock();
+    }
+
+  // Then the oldest task of the other queues.
+  int start = workerIndex >= 0 ? workerIndex + 1 : 0;
+  for (int i = 0; i < numberOfWorkers && !found; i++)
+    {
+    Worker* victim = workers[(start + i) % numberOfWorkers];
+    victim->TasksLock.Lock();
+    if (!victim->Tasks.empty())
+      {
+      task = victim->Tasks.front();
+      victim->Tasks.pop_front();
+      found = true;
+      }
+    victim->TasksLock.Unlock();
+    }
+
+  if (found)
+    {
+    this->m_Lock.Lock();
+    this->m_NumberOfPendingTasks--;
+    this->m_Lock.Unlock();
+    }
+  return found;
+}
+
+void ThreadPool::RunTask(Task& task)
+{
+  void* result = task.Function(task.Data);
+  task.Future->TaskDone(result);
+  task.Future->UnRegister();
+}
+
+bool ThreadPool::RunPendingTask()
+{
+  Task task;
+  if (!this->PopTask(this->GetCurrentWorkerIndex(), task))
+    {
+    return false;
+    }
+  this->RunTask(task);
+  return true;
+}
+
+void* ThreadPool::WorkerLoop(void* ptr)
+{
+  Worker* worker = static_cast<Worker*>(ptr);
+  ThreadPool* pool = worker->Pool;
+
+  pool->m_Lock.Lock();
+  worker->ThreadID = MultiThreader::GetCurrentThreadID();
+  worker->Started = true;
+  pool->m_Lock.Unlock();
+
+  while (1)
+    {
+    Task task;
+    pool->m_Lock.Lock();
+    bool assigned = worker->HasAssignedTask;
+    if (assigned)
+      {
+      task = worker->AssignedTask;
+      worker->HasAssignedTask = false;
+      }
+    pool->m_Lock.Unlock();
+    if (assigned)
+      {
+      pool->RunTask(task);
+      if (worker->Temporary)
+        {
+        break;
+        }
+      continue;
+      }
+
+    if (pool->PopTask(worker->Index, task))
+      {
+      pool->RunTask(task);
+      continue;
+      }
+    pool->m_Lock.Lock();
+    if (pool->m_NumberOfPendingTasks <= 0 && !worker->HasAssignedTask)
+      {
+      if (pool->m_Stop)
+        {
+        pool->m_Lock.Unlock();
+        break;
+        }
+      // Woken by the thread that gives it a task or queues one, which clears the flag.
+      worker->Idle = true;
+      pool->m_NumberOfIdleWorkers++;
+      while (worker->Idle && !pool->m_Stop)
+        {
+        worker->Condition->Wait(&pool->m_Lock);
+        }
+      if (worker->Idle)
+        {
+        worker->Idle = false;
+        pool->m_NumberOfIdleWorkers--;
+        }
+      }
+    pool->m_Lock.Unlock();
+    }
+  return NULL;
+}
+
+ThreadPoolFuture::Pointer ThreadPool::Submit(PoolTaskFunctionType function, void* data)
+{
+  ThreadPoolFuture::Pointer future = ThreadPoolFuture::New();
+  this->Submit(function, data, future);
+  return future;
+}
+
+void ThreadPool::Submit(PoolTaskFunctionType function, void* data, ThreadPoolFuture* future)
+{
+  if (function == NULL || future == NULL)
+    {
+    return;
+    }
+  Task task;
+  task.Function = function;
+  task.Data = data;
+  task.Future = future;
+  // The task keeps the future alive until it is done.
+  future->Register();
+  future->AddTask(this);
+  this->PushTask(task);
+}
+
+namespace
+{
+  // Ranges of a ParallelFor() handed out to the threads.
+  class ParallelForJob
+  {
+  public:
+    ParallelForFunctionType Function;
+    void*                   Data;
+    int                     Next;
+    int                     End;
+    int                     GrainSize;
+    SimpleMutexLock         Lock;
+  };
+
+  void* ParallelForTask(void* ptr)
+  {
+    ParallelForJob* job = static_cast<ParallelForJob*>(ptr);
+    while (1)
+      {
+      job->Lock.Lock();
+      int begin = job->Next;
+      int end = (job->End - begin > job->GrainSize) ? begin + job->GrainSize : job->End;
+      job->Next = end;
+      job->Lock.Unlock();
+      if (begin >= end)
+        {
+        break;
+        }
+      job->Function(begin, end, job->Data);
+      }
+    return NULL;
+  }
+}
+
+void ThreadPool::ParallelFor(int begin, int end, int grainSize, ParallelForFunctionType function, void* data)
+{
+  if (function == NULL || begin >= end)
+    {
+    return;
+    }
+  int numberOfThreads = this->GetNumberOfWorkers() + 1;
+  if (grainSize <= 0)
+    {
+    grainSize = (end - begin + numberOfThreads - 1) / numberOfThreads;
+    }
+
+  ParallelForJob job;
+  job.Function = function;
+  job.Data = data;
+  job.Next = begin;
+  job.End = end;
+  job.GrainSize = grainSize;
+
+  // One task per thread at most; each task takes ranges until none is left.
+  int numberOfRanges = (end - begin + grainSize - 1) / grainSize;
+  int numberOfTasks = numberOfRanges < numberOfThreads ? numberOfRanges : numberOfThreads;
+  ThreadPoolFuture::Pointer future = ThreadPoolFuture::New();
+  for (int i = 1; i < numberOfTasks; i++)
+    {
+    this->Submit(&ParallelForTask, &job, future);
+    }
+  ParallelForTask(&job);
+  future->Wait();
+}
+
+void ThreadPool::RunConcurrently(int numberOfTasks, PoolTaskFunctionType function, void* const* data)
+{
+  if (function == NULL || numberOfTasks <= 0)
+    {
+    return;
+    }
+
+  ThreadPoolFuture::Pointer future = ThreadPoolFuture::New();
+  std::vector<Worker*> temporaryWorkers;
+  std::vector<Task> deferredTasks;
+
+  // Each task is given to a worker that is not running anything else, rather than queued, so that
+  // it does not wait for a busy worker.
+  this->m_Lock.Lock();
+  unsigned int next = 0;
+  for (int i = 1; i < numberOfTasks; i++)
+    {
+    Task task;
+    task.Function = function;
+    task.Data = data[i];
+    task.Future = future;
+    future->Register();
+    future->AddTask(this);
+
+    Worker* worker = NULL;
+    for (; next < this->m_Workers.size() && worker == NULL; next++)
+      {
+      if (this->m_Workers[next]->Idle)
+        {
+        worker = this->m_Workers[next];
+        }
+      }
+    if (worker != NULL)
+      {
+      worker->Idle = false;
+      this->m_NumberOfIdleWorkers--;
+      worker->AssignedTask = task;
+      worker->HasAssignedTask = true;
+      worker->Condition->Signal();
+      continue;
+      }
+    if (!this->m_Stop && this->StartWorker(&task, false) != NULL)
+      {
+      continue;
+      }
+    worker = this->StartWorker(&task, true);
+    if (worker != NULL)
+      {
+      temporaryWorkers.push_back(worker);
+      }
+    else
+      {
+      // No thread support: the tasks run one after the other.
+      deferredTasks.push_back(task);
+      }
+    }
+  this->m_Lock.Unlock();
+
+  function(data[0]);
+  for (unsigned int i = 0; i < deferredTasks.size(); i++)
+    {
+    this->RunTask(deferredTasks[i]);
+    }
+  future->Wait();
+  for (unsigned int i = 0; i < temporaryWorkers.size(); i++)
+    {
+    JoinWorker(temporaryWorkers[i]);
+    delete temporaryWorkers[i];
+    }
+}
+
+int ThreadPool::SetWorkerAffinity(int workerIndex, int cpu)
+{
+  this->m_Lock.Lock();
+  Worker* worker = (workerIndex >= 0 && workerIndex < (int)this->m_Workers.size()) ? this->m_Workers[workerIndex] : NULL;
+  this->m_Lock.Unlock();
+  if (worker == NULL || cpu < 0)
+    {
+    return 0;
+    }
+#if defined(OpenIGTLink_USE_PTHREADS) && defined(__linux__) && defined(CPU_SET)
+  if (cpu >= CPU_SETSIZE)
+    {
+    return 0;
+    }
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  return pthread_setaffinity_np(worker->Thread, sizeof(cpu_set_t), &cpuSet) == 0 ? 1 : 0;
+#elif defined(OpenIGTLink_USE_WIN32_THREADS)
+  if (cpu >= (int)(sizeof(DWORD_PTR) * 8))
+    {
+    return 0;
+    }
+  return SetThreadAffinityMask(worker->Thread, ((DWORD_PTR)1) << cpu) != 0 ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+void ThreadPool::PrintSelf(std::ostream& os) const
+{
+  this->Superclass::PrintSelf(os);
+
+  const char* indent = "    ";
+  os << indent << "Number Of Workers: " << this->m_Workers.size() << "\n";
+  os << indent << "Number Of Pending Tasks: " << this->m_NumberOfPendingTasks << "\n";
+}
+
+} // namespace igtl
@@ -0,0 +1,166 @@
+/*=========================================================================
+
+  Program:   The OpenIGTLink Library
+  Language:  C++
+  Web page:  http://openigtlink.org/
+
+  Copyright (c) Insight Software Consortium. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#ifndef __igtlThreadPool_h
+#define __igtlThreadPool_h
+
+#include <vector>
+
+#include "igtlObject.h"
+#include "igtlMacro.h"
+#include "igtlMutexLock.h"
+#include "igtlConditionVariable.h"
+
+namespace igtl
+{
+
+class ThreadPool;
+
+/// Function run by a task of a ThreadPool. The returned pointer is available from ThreadPoolFuture::GetResult().
+typedef void* (*PoolTaskFunctionType)(void*);
+
+/// Function run by ThreadPool::ParallelFor() for the indices begin <= i < end.
+typedef void (*ParallelForFunctionType)(int begin, int end, void* data);
+
+/// ThreadPoolFuture tracks the completion of one or more tasks submitted to a ThreadPool.
+class IGTLCommon_EXPORT ThreadPoolFuture : public Object
+{
+public:
+  igtlTypeMacro(igtl::ThreadPoolFuture, Object);
+  igtlNewMacro(igtl::ThreadPoolFuture);
+
+  /// Waits until all the tasks of the future are done, and returns the result of the last task done.
+  /// While waiting, the calling thread runs the pending tasks of the pool, so that a task can wait
+  /// for the tasks it has submitted without holding up a worker.
+  void* Wait();
+
+  /// Returns true if all the tasks of the future are done.
+  bool IsDone();
+
+  /// Gets the value returned by the last task done, NULL until then.
+  void* GetResult();
+
+protected:
+  ThreadPoolFuture();
+  ~ThreadPoolFuture();
+
+  friend class ThreadPool;
+
+  void AddTask(ThreadPool* pool);
+  void TaskDone(void* result);
+
+private:
+  ThreadPool*                m_Pool;
+  int                        m_NumberOfPendingTasks;
+  void*                      m_Result;
+  SimpleMutexLock            m_Lock;
+  ConditionVariable::Pointer m_Condition;
+};
+
+
+/// ThreadPool keeps a set of worker threads running, so that repeated parallel regions do not pay
+/// the cost of creating and joining threads.
+///
+/// Each worker has its own task queue. The tasks submitted by a worker are queued to the worker
+/// itself and run last in, first out, while the tasks submitted by the other threads are spread
+/// over the workers. An idle worker steals the oldest task of the other workers.
+///
+/// MultiThreader::SingleMethodExecute() and MultipleMethodExecute() run on the pool returned by
+/// GetGlobalThreadPool(), with RunConcurrently().
+class IGTLCommon_EXPORT ThreadPool : public Object
+{
+public:
+  igtlTypeMacro(igtl::ThreadPool, Object);
+  igtlNewMacro(igtl::ThreadPool);
+
+  /// Gets the pool shared by the MultiThreaders. It is created on the first call with
+  /// MultiThreader::GetGlobalDefaultNumberOfThreads() - 1 workers, the calling thread taking
+  /// part in the parallel regions. The global pool is never deleted: its workers are not joined
+  /// at exit (or when the library is unloaded, which could deadlock under the loader lock on
+  /// Windows), but end with the process, even if a task is still running. It must not be
+  /// UnRegister()'ed by the callers.
+  static ThreadPool* GetGlobalThreadPool();
+
+  /// Starts workers until the pool has at least numberOfWorkers workers, up to IGTL_MAX_THREADS.
+  /// The workers run until the pool is deleted. Returns the number of workers.
+  int ReserveWorkers(int numberOfWorkers);
+
+  int GetNumberOfWorkers();
+
+  /// Queues a task and returns its future.
+  ThreadPoolFuture::Pointer Submit(PoolTaskFunctionType function, void* data);
+
+  /// Queues a task and adds it to the future, which is done when all its tasks are done.
+  void Submit(PoolTaskFunctionType function, void* data, ThreadPoolFuture* future);
+
+  /// Calls function(i0, i1, data) over consecutive ranges of at most grainSize indices covering
+  /// [begin, end), on the workers and the calling thread, and returns when all the ranges are done.
+  /// The ranges are handed out one at a time, so that ranges of uneven cost are balanced.
+  /// A grainSize of 0 or less splits the indices evenly over the threads.
+  /// The ranges must not wait for each other: all of them may run in the calling thread, e.g. when
+  /// the workers are busy.
+  void ParallelFor(int begin, int end, int grainSize, ParallelForFunctionType function, void* data);
+
+  /// Calls function(data[i]) for 0 <= i < numberOfTasks at the same time, so that the tasks may wait
+  /// for each other (e.g. at a barrier): the task 0 runs in the calling thread and each other task
+  /// on an idle worker of its own. Workers are started when too few are idle, and temporary threads
+  /// beyond IGTL_MAX_THREADS workers. Returns when all the tasks are done.
+  void RunConcurrently(int numberOfTasks, PoolTaskFunctionType function, void* const* data);
+
+  /// Runs one pending task in the calling thread. Returns false if no task was pending.
+  bool RunPendingTask();
+
+  /// Binds a worker to a CPU. Returns 1 on success, 0 if the platform does not support it or if it failed.
+  int SetWorkerAffinity(int workerIndex, int cpu);
+
+  /// Gets the index of the worker calling the method, -1 if it is not called from a worker of this pool.
+  int GetCurrentWorkerIndex();
+
+protected:
+  ThreadPool();
+  ~ThreadPool();
+
+  void PrintSelf(std::ostream& os) const;
+
+  class Task;
+  class Worker;
+
+  /// Starts a worker running 'task' first (if not NULL), with m_Lock held. A temporary worker is
+  /// not added to the pool and exits after the task. Returns NULL if the thread cannot be created.
+  Worker* StartWorker(const Task* task, bool temporary);
+  static void JoinWorker(Worker* worker);
+
+  void PushTask(const Task& task);
+  bool PopTask(int workerIndex, Task& task);
+  void RunTask(Task& task);
+
+  static void* WorkerLoop(void* ptr);
+
+private:
+  std::vector<Worker*>       m_Workers;
+  int                        m_NumberOfPendingTasks;
+  int                        m_NumberOfIdleWorkers;
+  int                        m_NextQueue;
+  bool                       m_Stop;
+
+  /// Protects the counters above, the list of workers and their states
+  SimpleMutexLock            m_Lock;
+
+  ThreadPool(const ThreadPool&);  // Not implemented.
+  void operator=(const ThreadPool&);  // Not implemented.
+};
+
+} // namespace igtl
+
+#endif // __igtlThreadPool_h
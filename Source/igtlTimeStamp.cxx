@@ -42,6 +42,7 @@
   #include <windows.h>
 #else
   #include <sys/time.h>
+  #include <time.h>
 #endif  // defined(WIN32) || defined(_WIN32)
 
 #include <string.h>
@@ -115,6 +116,10 @@ TimeStamp::TimeStamp(): Object()
   this->m_WinClockOrigin = clock();
   this->m_Frequency = 1000000;
 
+#elif defined(CLOCK_REALTIME)
+
+  this->m_Frequency = 1000000000;
+
 #else
 
   this->m_Frequency = 1000000;
@@ -148,6 +153,15 @@ void TimeStamp::GetTime()
   this->m_Second     = this->m_WinTimeOrigin + ( c1 - this->m_WinClockOrigin ) / CLOCKS_PER_SEC;
   this->m_Nanosecond = (c1 - this->m_WinClockOrigin ) % CLOCKS_PER_SEC * ( 1e9 / CLOCKS_PER_SEC );
 
+#elif defined(CLOCK_REALTIME)
+
+  struct timespec tspec;
+
+  ::clock_gettime( CLOCK_REALTIME, &tspec );
+
+  this->m_Second     = tspec.tv_sec;
+  this->m_Nanosecond = tspec.tv_nsec;
+
 #else
 
   struct timeval tval;
@@ -161,6 +175,66 @@ void TimeStamp::GetTime()
   
 }
 
+
+igtlUint64 TimeStamp::GetMonotonicTimeInNanoseconds()
+{
+#if defined(WIN32) || defined(_WIN32)
+
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER tick;
+  ::QueryPerformanceFrequency( &frequency );
+  ::QueryPerformanceCounter( &tick );
+
+  // Split the conversion to avoid the overflow of tick * 1e9
+  igtlUint64 second = tick.QuadPart / frequency.QuadPart;
+  igtlUint64 remainder = tick.QuadPart % frequency.QuadPart;
+  return second * 1000000000ULL + remainder * 1000000000ULL / frequency.QuadPart;
+
+#elif defined(CLOCK_MONOTONIC_RAW) || defined(CLOCK_MONOTONIC)
+
+  struct timespec tspec;
+#if defined(CLOCK_MONOTONIC_RAW)
+  // Not slewed by NTP, so that the drift against a peer is estimated against the oscillator
+  ::clock_gettime( CLOCK_MONOTONIC_RAW, &tspec );
+#else
+  ::clock_gettime( CLOCK_MONOTONIC, &tspec );
+#endif
+  return static_cast<igtlUint64>(tspec.tv_sec) * 1000000000ULL + tspec.tv_nsec;
+
+#else
+
+  struct timeval tval;
+  ::gettimeofday( &tval, 0 );
+  return static_cast<igtlUint64>(tval.tv_sec) * 1000000000ULL + tval.tv_usec * 1000ULL;
+
+#endif  // defined(WIN32) || defined(_WIN32)
+}
+
+igtlUint64 TimeStamp::GetSystemTimeInNanoseconds()
+{
+#if defined(WIN32) || defined(_WIN32)
+
+  // 100 ns intervals since January 1, 1601
+  FILETIME fileTime;
+  ::GetSystemTimeAsFileTime( &fileTime );
+  igtlUint64 ticks = (static_cast<igtlUint64>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+  return (ticks - 116444736000000000ULL) * 100ULL;
+
+#elif defined(CLOCK_REALTIME)
+
+  struct timespec tspec;
+  ::clock_gettime( CLOCK_REALTIME, &tspec );
+  return static_cast<igtlUint64>(tspec.tv_sec) * 1000000000ULL + tspec.tv_nsec;
+
+#else
+
+  struct timeval tval;
+  ::gettimeofday( &tval, 0 );
+  return static_cast<igtlUint64>(tval.tv_sec) * 1000000000ULL + tval.tv_usec * 1000ULL;
+
+#endif  // defined(WIN32) || defined(_WIN32)
+}
+
 void TimeStamp::SetTime(double tm)
 {
   double second = floor(tm);
@@ -191,10 +265,10 @@ void TimeStamp::SetTime(igtlUint64 tm)
 //-----------------------------------------------------------------------------
 void TimeStamp::SetTimeInNanoseconds(igtlUint64 tm)
 {
-  igtlUint64 sec = tm / 1e9; // integer rounding
-  igtlUint64 nano = sec * 1e9; // round it back up to get whole number of seconds expressed in nanoseconds.
+  // Integer arithmetic, as a double does not hold the nanoseconds since 1970
+  igtlUint64 sec = tm / 1000000000ULL;
   this->m_Second = static_cast<igtlInt32>(sec);
-  this->m_Nanosecond = static_cast<igtlInt32>(tm - nano);
+  this->m_Nanosecond = static_cast<igtlInt32>(tm - sec * 1000000000ULL);
 }
 
 
@@ -230,7 +304,7 @@ igtlUint64 TimeStamp::GetTimeStampUint64()
 //-----------------------------------------------------------------------------
 igtlUint64 TimeStamp::GetTimeStampInNanoseconds() const
 {
-  igtlUint64 tmp = this->m_Second * 1e9;
+  igtlUint64 tmp = static_cast<igtlUint64>(static_cast<igtlUint32>(this->m_Second)) * 1000000000ULL;
   tmp += this->m_Nanosecond;
   return tmp;
 }
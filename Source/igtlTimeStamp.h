@@ -43,8 +43,18 @@ public:
   igtlGetConstMacro(Nanosecond, igtlUint32);
 
   /// Gets the current time from the system's clock and save it as a time stamp.
+  /// The resolution is 1 ns where clock_gettime() is available (see GetFrequency()).
   void   GetTime();
 
+  /// Gets the time of a monotonic clock in nanoseconds from an unspecified origin.
+  /// Unlike GetTime(), it does not jump when the system's clock is set, and is meant for
+  /// measuring intervals. CLOCK_MONOTONIC_RAW is used where available.
+  static igtlUint64 GetMonotonicTimeInNanoseconds();
+
+  /// Gets the time of the system's clock in nanoseconds since the Unix epoch, as GetTime()
+  /// followed by GetTimeStampInNanoseconds(), without creating a time stamp.
+  static igtlUint64 GetSystemTimeInNanoseconds();
+
   /// Sets the time by double floating-point value.
   void   SetTime(double tm);
 
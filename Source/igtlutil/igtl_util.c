@@ -165,6 +165,84 @@ igtl_uint64 igtl_export crc64(unsigned char *data,  igtl_uint64 len, igtl_uint64
 }
 
 
+/* Multiplies the 64x64 matrix over GF(2) 'mat' (column i is the image of bit i)
+ * by the vector 'vec'. */
+static igtl_uint64 crc64_matrix_times(const igtl_uint64 *mat, igtl_uint64 vec)
+{
+  igtl_uint64 sum = 0;
+  while (vec)
+    {
+    if (vec & 1)
+      {
+      sum ^= *mat;
+      }
+    vec >>= 1;
+    mat++;
+    }
+  return sum;
+}
+
+
+static void crc64_matrix_square(igtl_uint64 *square, const igtl_uint64 *mat)
+{
+  int n;
+  for (n = 0; n < 64; n++)
+    {
+    square[n] = crc64_matrix_times(mat, mat[n]);
+    }
+}
+
+
+igtl_uint64 igtl_export crc64_combine(igtl_uint64 crc1, igtl_uint64 crc2, igtl_uint64 len2)
+{
+  igtl_uint64 even[64]; /* operator for 2^n zero bits, n even */
+  igtl_uint64 odd[64];  /* operator for 2^n zero bits, n odd */
+  igtl_uint64 row;
+  int n;
+
+  if (len2 == 0)
+    {
+    return crc1;
+    }
+
+  /* Operator for one zero bit: the CRC is shifted to the left, and reduced by the
+   * polynomial if the bit shifted out is set. */
+  odd[63] = 0x42F0E1EBA9EA3693ULL;
+  row = 2;
+  for (n = 0; n < 63; n++)
+    {
+    odd[n] = row;
+    row <<= 1;
+    }
+
+  crc64_matrix_square(even, odd); /* 2 zero bits */
+  crc64_matrix_square(odd, even); /* 4 zero bits */
+
+  /* Applies len2 zero bytes to crc1, squaring the operator for each bit of len2 */
+  do
+    {
+    crc64_matrix_square(even, odd);
+    if (len2 & 1)
+      {
+      crc1 = crc64_matrix_times(even, crc1);
+      }
+    len2 >>= 1;
+    if (len2 == 0)
+      {
+      break;
+      }
+    crc64_matrix_square(odd, even);
+    if (len2 & 1)
+      {
+      crc1 = crc64_matrix_times(odd, crc1);
+      }
+    len2 >>= 1;
+    } while (len2 != 0);
+
+  return crc1 ^ crc2;
+}
+
+
 igtl_uint32 igtl_export igtl_nanosec_to_frac(igtl_uint32 nanosec)
 {
 
@@ -49,6 +49,11 @@ extern "C" {
 int igtl_export igtl_is_little_endian();
 igtl_uint64 igtl_export crc64(unsigned char *data, igtl_uint64 len, igtl_uint64 crc);
 
+/** Computes the CRC64 of the concatenation of two blocks from their CRC64 (crc1 and crc2,
+ *  computed from the initial crc 0) and the size of the second block, e.g. to compute
+ *  the CRC64 of a body from the CRC64 of its chunks computed in parallel. */
+igtl_uint64 igtl_export crc64_combine(igtl_uint64 crc1, igtl_uint64 crc2, igtl_uint64 len2);
+
 /** Converts nanosecond to fraction / fraction to nanosec. */
 igtl_uint32 igtl_export igtl_nanosec_to_frac(igtl_uint32 nanosec);
 igtl_uint32 igtl_export igtl_frac_to_nanosec(igtl_uint32 frac);
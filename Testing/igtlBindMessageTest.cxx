@@ -17,6 +17,9 @@
 #include "igtlTransformMessage.h"
 #include "igtlImageMessage.h"
 #include "igtlSensorMessage.h"
+#include "igtlStatusMessage.h"
+#include "igtlServerSocket.h"
+#include "igtlClientSocket.h"
 #include "igtlMessageDebugFunction.h"
 #include "igtlUnit.h"
 #include "igtl_unit.h"
@@ -225,6 +228,150 @@ TEST(BindMessageTest, Unpack)
   EXPECT_FLOAT_EQ(sensorDataReceiveMsg->GetValue(5),1.2345678);
 }
 
+// Concatenates the fragments serialized by BindMessage::PackFragments()
+std::vector<unsigned char> ConcatenatePackFragments(igtl::BindMessage::Pointer& bindMsg)
+{
+  std::vector<unsigned char> message;
+  for (int i = 0; i < bindMsg->GetNumberOfPackFragments(); i ++)
+    {
+    unsigned char* fragment = (unsigned char*)bindMsg->GetPackFragmentPointer(i);
+    message.insert(message.end(), fragment, fragment + bindMsg->GetPackFragmentSize(i));
+    }
+  return message;
+}
+
+TEST(BindMessageTest, PackFragmentsFormatVersion1)
+{
+  BuildUpElements();
+  std::vector<unsigned char> packed((unsigned char*)bindSendMsg->GetPackPointer(),
+                                    (unsigned char*)bindSendMsg->GetPackPointer() + bindSendMsg->GetPackSize());
+
+  // Header and BIND header, transform, image, sensor
+  EXPECT_EQ(bindSendMsg->PackFragments(), 1);
+  EXPECT_EQ(bindSendMsg->GetNumberOfPackFragments(), 4);
+  EXPECT_EQ(bindSendMsg->GetPackFragmentPointer(2), imageSendMsg2->GetPackBodyPointer());
+  EXPECT_EQ(bindSendMsg->GetPackFragmentPointer(4), (void*)NULL);
+  EXPECT_TRUE(ConcatenatePackFragments(bindSendMsg) == packed);
+
+  // Pack() serializes the whole message again.
+  bindSendMsg->Pack();
+  ASSERT_EQ(bindSendMsg->GetPackSize(), (int)packed.size());
+  EXPECT_EQ(memcmp(bindSendMsg->GetPackPointer(), &packed[0], packed.size()), 0);
+}
+
+#if OpenIGTLink_PROTOCOL_VERSION >= 3
+TEST(BindMessageTest, PackFragmentsFormatVersion2)
+{
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("ChildStatus");
+  statusMsg->SetStatusString("Even");
+  statusMsg->Pack();
+  ASSERT_EQ(statusMsg->GetPackBodySize() % 2, 1);
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("ChildTrans");
+  transformMsg->SetMatrix(inMatrix);
+  transformMsg->Pack();
+
+  igtl::BindMessage::Pointer bindMsg = igtl::BindMessage::New();
+  bindMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  bindMsg->SetDeviceName("DeviceName");
+  bindMsg->SetMetaDataElement("Frame", (igtl_uint32)3);
+  bindMsg->AppendChildMessage(statusMsg);
+  bindMsg->AppendChildMessage(transformMsg);
+  bindMsg->Pack();
+  std::vector<unsigned char> packed((unsigned char*)bindMsg->GetPackPointer(),
+                                    (unsigned char*)bindMsg->GetPackPointer() + bindMsg->GetPackSize());
+
+  // Header, extended header and BIND header, status, padding, transform, meta data
+  EXPECT_EQ(bindMsg->PackFragments(), 1);
+  EXPECT_EQ(bindMsg->GetNumberOfPackFragments(), 5);
+  EXPECT_EQ(bindMsg->GetPackFragmentSize(2), 1);
+  std::vector<unsigned char> fragments = ConcatenatePackFragments(bindMsg);
+  EXPECT_TRUE(fragments == packed);
+
+  // Send the fragments and unpack the received message.
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  std::vector<const void*> data;
+  std::vector<int> length;
+  for (int i = 0; i < bindMsg->GetNumberOfPackFragments(); i ++)
+    {
+    data.push_back(bindMsg->GetPackFragmentPointer(i));
+    length.push_back(bindMsg->GetPackFragmentSize(i));
+    }
+  EXPECT_EQ(clientSocket->Send(&data[0], &length[0], (int)data.size()), 1);
+
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  ASSERT_EQ(socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  igtl::BindMessage::Pointer receiveMsg = igtl::BindMessage::New();
+  receiveMsg->SetMessageHeader(headerMsg);
+  receiveMsg->AllocatePack();
+  ASSERT_EQ(socket->Receive(receiveMsg->GetPackBodyPointer(), receiveMsg->GetPackBodySize()), receiveMsg->GetPackBodySize());
+  EXPECT_TRUE(receiveMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  socket->CloseSocket();
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+
+  igtl_uint64 frame = 0;
+  EXPECT_TRUE(receiveMsg->GetMetaDataElement("Frame", frame));
+  EXPECT_EQ(frame, 3u);
+  ASSERT_EQ(receiveMsg->GetNumberOfChildMessages(), 2);
+  EXPECT_STREQ(receiveMsg->GetChildMessageType(1), "TRANSFORM");
+  EXPECT_STREQ(receiveMsg->GetChildMessageName(1), "ChildTrans");
+
+  // The child bodies are read in place.
+  const unsigned char* body = (const unsigned char*)receiveMsg->GetChildMessageBodyPointer(1);
+  EXPECT_GE(body, (const unsigned char*)receiveMsg->GetPackBodyPointer());
+  EXPECT_LT(body, (const unsigned char*)receiveMsg->GetPackBodyPointer() + receiveMsg->GetPackBodySize());
+  ASSERT_EQ(receiveMsg->GetChildMessageBodySize(1), (igtlUint64)transformMsg->GetPackBodySize());
+  EXPECT_EQ(memcmp(body, transformMsg->GetPackBodyPointer(), transformMsg->GetPackBodySize()), 0);
+  EXPECT_TRUE(receiveMsg->GetChildMessageBodyPointer(2) == NULL);
+}
+
+TEST(BindMessageTest, PackFragmentsIntegrityModes)
+{
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("ChildStatus");
+  statusMsg->SetStatusString("Even");
+  statusMsg->Pack();
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("ChildTrans");
+  transformMsg->SetMatrix(inMatrix);
+  transformMsg->Pack();
+
+  igtl::BindMessage::Pointer bindMsg = igtl::BindMessage::New();
+  bindMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  bindMsg->SetDeviceName("DeviceName");
+  bindMsg->AppendChildMessage(statusMsg);
+  bindMsg->AppendChildMessage(transformMsg);
+
+  // The fragments are the message packed by Pack() in every mode; the chunks span the fragments.
+  int modes[3] = {igtl::MessageBase::INTEGRITY_CRC64, igtl::MessageBase::INTEGRITY_CHUNKED,
+                  igtl::MessageBase::INTEGRITY_NONE};
+  for (int i = 0; i < 3; i ++)
+    {
+    bindMsg->SetIntegrityMode(modes[i]);
+    bindMsg->SetIntegrityChunkSize(20);
+    bindMsg->Pack();
+    std::vector<unsigned char> packed((unsigned char*)bindMsg->GetPackPointer(),
+                                      (unsigned char*)bindMsg->GetPackPointer() + bindMsg->GetPackSize());
+    EXPECT_EQ(bindMsg->PackFragments(), 1);
+    EXPECT_TRUE(ConcatenatePackFragments(bindMsg) == packed) << "mode " << modes[i];
+    std::string table;
+    EXPECT_EQ(bindMsg->GetMetaDataElement(IGTL_INTEGRITY_CHUNKS, table),
+              modes[i] == igtl::MessageBase::INTEGRITY_CHUNKED);
+    }
+}
+#endif
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,239 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlBindStreamer.h"
+#include "igtlBindMessage.h"
+#include "igtlClientSocket.h"
+#include "igtlServerSocket.h"
+#include "igtlStatusMessage.h"
+#include "igtlTransformMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+class BindStreamerConnection
+{
+public:
+  BindStreamerConnection()
+  {
+    serverSocket = igtl::ServerSocket::New();
+    clientSocket = igtl::ClientSocket::New();
+  }
+  ~BindStreamerConnection()
+  {
+    if (socket.IsNotNull())
+      {
+      socket->CloseSocket();
+      }
+    clientSocket->CloseSocket();
+    serverSocket->CloseSocket();
+  }
+  bool Connect()
+  {
+    if (serverSocket->CreateServer(0) != 0 ||
+        clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()) != 0)
+      {
+      return false;
+      }
+    socket = serverSocket->WaitForConnection(1000);
+    return socket.IsNotNull();
+  }
+  /// Receives the next message on the client side. Returns the header, and the body in message if it is not NULL.
+  igtl::MessageHeader::Pointer Receive(igtl::MessageBase* message)
+  {
+    igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+    header->InitPack();
+    if (clientSocket->Receive(header->GetPackPointer(), header->GetPackSize()) != header->GetPackSize())
+      {
+      return NULL;
+      }
+    header->Unpack();
+    igtl::MessageBase::Pointer body = message;
+    if (body.IsNull())
+      {
+      body = igtl::MessageBase::New();
+      }
+    body->SetMessageHeader(header);
+    body->AllocatePack();
+    if (body->GetPackBodySize() > 0 &&
+        clientSocket->Receive(body->GetPackBodyPointer(), body->GetPackBodySize()) != body->GetPackBodySize())
+      {
+      return NULL;
+      }
+    return header;
+  }
+
+  igtl::ServerSocket::Pointer serverSocket;
+  igtl::ClientSocket::Pointer clientSocket;
+  igtl::ClientSocket::Pointer socket;
+};
+
+void CreateSources(igtl::StatusMessage::Pointer& statusMsg, igtl::TransformMessage::Pointer& transformMsg)
+{
+  statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("Status");
+  statusMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+  statusMsg->SetStatusString("Ready");
+  statusMsg->Pack();
+
+  transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tool");
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+  matrix[0][3] = 10.0;
+  transformMsg->SetMatrix(matrix);
+  transformMsg->Pack();
+}
+
+TEST(BindStreamerTest, ResolutionToNanoseconds)
+{
+  EXPECT_EQ(igtl::BindStreamer::ResolutionToNanoseconds(0), 0);
+  EXPECT_EQ(igtl::BindStreamer::ResolutionToNanoseconds(2ULL << 32), 2000000000ULL);
+  // 0x80000000 is half a second.
+  EXPECT_EQ(igtl::BindStreamer::ResolutionToNanoseconds((1ULL << 32) | 0x80000000), 1500000000ULL);
+}
+
+TEST(BindStreamerTest, Sources)
+{
+  igtl::StatusMessage::Pointer statusMsg;
+  igtl::TransformMessage::Pointer transformMsg;
+  CreateSources(statusMsg, transformMsg);
+
+  igtl::BindStreamer::Pointer streamer = igtl::BindStreamer::New();
+  EXPECT_EQ(streamer->UpdateSource(NULL), 0);
+  EXPECT_EQ(streamer->UpdateSource(igtl::TransformMessage::New()), 0);
+  EXPECT_EQ(streamer->UpdateSource(statusMsg), 1);
+  EXPECT_EQ(streamer->UpdateSource(transformMsg), 1);
+  EXPECT_EQ(streamer->UpdateSource(transformMsg), 1);
+  EXPECT_EQ(streamer->GetNumberOfSources(), 2);
+  EXPECT_EQ(streamer->RemoveSource("STATUS", "Tool"), 0);
+  EXPECT_EQ(streamer->RemoveSource("STATUS", "Status"), 1);
+  EXPECT_EQ(streamer->GetNumberOfSources(), 1);
+
+  // Not started without a socket
+  igtl::StartBindMessage::Pointer request = igtl::StartBindMessage::New();
+  EXPECT_EQ(streamer->Start(request), 0);
+  EXPECT_FALSE(streamer->IsStreaming());
+  EXPECT_EQ(streamer->SendBind(), -1);
+}
+
+TEST(BindStreamerTest, SendBind)
+{
+  BindStreamerConnection connection;
+  ASSERT_TRUE(connection.Connect());
+
+  igtl::StatusMessage::Pointer statusMsg;
+  igtl::TransformMessage::Pointer transformMsg;
+  CreateSources(statusMsg, transformMsg);
+
+  igtl::BindStreamer::Pointer streamer = igtl::BindStreamer::New();
+  streamer->SetSocket(connection.socket);
+  EXPECT_EQ(streamer->SendBind(), 0);
+  streamer->UpdateSource(statusMsg);
+  streamer->UpdateSource(transformMsg);
+  EXPECT_EQ(streamer->SendBind(), 2);
+  EXPECT_EQ(streamer->GetNumberOfBindsSent(), 1);
+
+  igtl::BindMessage::Pointer bindMsg = igtl::BindMessage::New();
+  igtl::MessageHeader::Pointer header = connection.Receive(bindMsg);
+  ASSERT_TRUE(header.IsNotNull());
+  EXPECT_STREQ(header->GetDeviceType(), "BIND");
+  ASSERT_TRUE(bindMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  ASSERT_EQ(bindMsg->GetNumberOfChildMessages(), 2);
+  EXPECT_STREQ(bindMsg->GetChildMessageType(0), "STATUS");
+  EXPECT_STREQ(bindMsg->GetChildMessageName(1), "Tool");
+
+  igtl::TransformMessage::Pointer receivedTransform = igtl::TransformMessage::New();
+  ASSERT_EQ(bindMsg->GetChildMessage(1, receivedTransform), 1);
+  igtl::Matrix4x4 matrix;
+  receivedTransform->GetMatrix(matrix);
+  EXPECT_FLOAT_EQ(matrix[0][3], 10.0);
+}
+
+TEST(BindStreamerTest, StartAndStop)
+{
+  BindStreamerConnection connection;
+  ASSERT_TRUE(connection.Connect());
+
+  igtl::StatusMessage::Pointer statusMsg;
+  igtl::TransformMessage::Pointer transformMsg;
+  CreateSources(statusMsg, transformMsg);
+
+  igtl::BindStreamer::Pointer streamer = igtl::BindStreamer::New();
+  streamer->SetSocket(connection.socket);
+  streamer->UpdateSource(statusMsg);
+  streamer->UpdateSource(transformMsg);
+
+  // Only the transform is requested, every 10 ms.
+  igtl::StartBindMessage::Pointer request = igtl::StartBindMessage::New();
+  request->SetDeviceName("Streamer");
+  request->AppendChildMessage("TRANSFORM", "Tool");
+  request->SetResolution((igtlUint64)(0.01 * 4294967296.0));
+  ASSERT_EQ(streamer->Start(request), 1);
+  EXPECT_TRUE(streamer->IsStreaming());
+  EXPECT_NEAR((double)streamer->GetPeriod(), 10000000.0, 10.0);
+
+  igtl::RTSBindMessage::Pointer response = igtl::RTSBindMessage::New();
+  igtl::MessageHeader::Pointer header = connection.Receive(response);
+  ASSERT_TRUE(header.IsNotNull());
+  EXPECT_STREQ(header->GetDeviceType(), "RTS_BIND");
+  EXPECT_STREQ(header->GetDeviceName(), "Streamer");
+  response->Unpack();
+  EXPECT_EQ(response->GetStatus(), igtl::RTSBindMessage::STATUS_SUCCESS);
+
+  for (int i = 0; i < 3; i++)
+    {
+    igtl::BindMessage::Pointer bindMsg = igtl::BindMessage::New();
+    header = connection.Receive(bindMsg);
+    ASSERT_TRUE(header.IsNotNull());
+    EXPECT_STREQ(header->GetDeviceType(), "BIND");
+    ASSERT_TRUE(bindMsg->Unpack() & igtl::MessageHeader::UNPACK_BODY);
+    ASSERT_EQ(bindMsg->GetNumberOfChildMessages(), 1);
+    EXPECT_STREQ(bindMsg->GetChildMessageName(0), "Tool");
+    }
+
+  EXPECT_EQ(streamer->Stop(), 1);
+  EXPECT_FALSE(streamer->IsStreaming());
+  igtl_uint64 numberOfBinds = streamer->GetNumberOfBindsSent();
+  EXPECT_GE(numberOfBinds, 3);
+
+  // The BIND messages sent before the streaming thread stopped are followed by RTS_BIND.
+  for (igtl_uint64 i = 3; i < numberOfBinds; i++)
+    {
+    header = connection.Receive(NULL);
+    ASSERT_TRUE(header.IsNotNull());
+    EXPECT_STREQ(header->GetDeviceType(), "BIND");
+    }
+  header = connection.Receive(response);
+  ASSERT_TRUE(header.IsNotNull());
+  EXPECT_STREQ(header->GetDeviceType(), "RTS_BIND");
+  EXPECT_EQ(streamer->GetNumberOfBindsSent(), numberOfBinds);
+
+  // Stopping again is reported as an error.
+  EXPECT_EQ(streamer->Stop(), 0);
+  header = connection.Receive(response);
+  ASSERT_TRUE(header.IsNotNull());
+  response->Unpack();
+  EXPECT_EQ(response->GetStatus(), igtl::RTSBindMessage::STATUS_ERROR);
+
+  streamer->ResetStatistics();
+  EXPECT_EQ(streamer->GetNumberOfBindsSent(), 0);
+  EXPECT_EQ(streamer->GetNumberOfMissedDeadlines(), 0);
+  EXPECT_EQ(streamer->GetMaximumLateness(), 0);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
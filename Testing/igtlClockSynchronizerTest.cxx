@@ -0,0 +1,126 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlClockSynchronizer.h"
+#include "igtlClockSyncMessage.h"
+#include "igtlMessageFactory.h"
+#include "igtlTimeStamp.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <cmath>
+#include <cstdlib>
+
+#define MS 1000000ULL
+
+TEST(ClockSynchronizerTest, NanosecondClocks)
+{
+  igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+  ts->GetTime();
+  igtl_uint64 ns = ts->GetTimeStampInNanoseconds();
+  igtl::TimeStamp::Pointer copy = igtl::TimeStamp::New();
+  copy->SetTimeInNanoseconds(ns);
+  EXPECT_EQ(copy->GetTimeStampInNanoseconds(), ns);
+
+  igtl_uint64 m1 = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+  igtl_uint64 m2 = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+  EXPECT_LE(m1, m2);
+}
+
+TEST(ClockSynchronizerTest, OffsetAndDrift)
+{
+  // The remote clock is 5 s ahead and gains 20 us per second. The one way delays vary between
+  // 100 and 1100 us, the responder takes 50 us to answer.
+  const double remoteOffset = 5000.0 * MS;
+  const double remoteDrift = 20e-6;
+  igtl_uint64 start = 1500000000ULL * 1000 * MS;
+  srand(1);
+
+  igtl::ClockSynchronizer::Pointer sync = igtl::ClockSynchronizer::New();
+  EXPECT_EQ(sync->RemoteToLocal(start), start);
+  for (int i = 0; i < 64; i++)
+    {
+    igtl_uint64 t1 = start + i * 1000 * MS;
+    igtl_uint64 arrival = t1 + 100000 + rand() % 1000000;
+    igtl_uint64 departure = arrival + 50000;
+    igtl_uint64 t4 = departure + 100000 + rand() % 1000000;
+    igtl_uint64 t2 = arrival + (igtl_uint64)(remoteOffset + remoteDrift * (double)(arrival - start));
+    igtl_uint64 t3 = departure + (igtl_uint64)(remoteOffset + remoteDrift * (double)(departure - start));
+    EXPECT_EQ(sync->AddSample(t1, t2, t3, t4), 1);
+    }
+  EXPECT_EQ(sync->GetNumberOfSamples(), 64);
+  EXPECT_EQ(sync->AddSample(start + 10 * MS, start, start, start), 0);
+
+  igtl_uint64 local = start + 30000 * MS;
+  double expected = remoteOffset + remoteDrift * 30000.0 * MS;
+  EXPECT_NEAR(sync->GetOffset(local), expected, 500000.0);
+  EXPECT_NEAR(sync->GetDrift(), remoteDrift, 10e-6);
+  EXPECT_GE(sync->GetMinimumRoundTripDelay(), 200000u);
+  igtl_uint64 remote = sync->LocalToRemote(local);
+  EXPECT_LT(std::fabs((double)(igtl_int64)(sync->RemoteToLocal(remote) - local)), 2.0);
+
+  sync->SetMaximumNumberOfSamples(1);
+  EXPECT_EQ(sync->GetNumberOfSamples(), 1);
+  EXPECT_EQ(sync->GetDrift(), 0.0);
+  sync->Clear();
+  EXPECT_EQ(sync->GetNumberOfSamples(), 0);
+}
+
+TEST(ClockSynchronizerTest, MessagesFormatVersion2)
+{
+  igtl::GetClockSyncMessage::Pointer request = igtl::GetClockSyncMessage::New();
+  request->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  request->SetDeviceName("Tracker");
+  request->SetOriginateTime(1234567890123456789ULL);
+  request->Pack();
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), request->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  igtl::MessageFactory::Pointer factory = igtl::MessageFactory::New();
+  igtl::MessageBase::Pointer received = factory->CreateReceiveMessage(header);
+  ASSERT_TRUE(received.IsNotNull());
+  memcpy(received->GetPackBodyPointer(), request->GetPackBodyPointer(), request->GetPackBodySize());
+  EXPECT_TRUE(received->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  igtl::GetClockSyncMessage::Pointer receivedRequest = dynamic_cast<igtl::GetClockSyncMessage*>(received.GetPointer());
+  ASSERT_TRUE(receivedRequest.IsNotNull());
+  EXPECT_EQ(receivedRequest->GetOriginateTime(), 1234567890123456789ULL);
+
+  igtl::RTSClockSyncMessage::Pointer response = igtl::RTSClockSyncMessage::New();
+  response->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  igtl_uint64 before = igtl::ClockSynchronizer::GetCurrentTimeInNanoseconds();
+  igtl::ClockSynchronizer::FillResponse(receivedRequest, before, response);
+  EXPECT_STREQ(response->GetDeviceName(), "Tracker");
+  EXPECT_GE(response->GetTransmitTime(), before);
+  response->Pack();
+
+  header->InitPack();
+  memcpy(header->GetPackPointer(), response->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  EXPECT_STREQ(header->GetDeviceType(), "RTS_CLKSYNC");
+  igtl::RTSClockSyncMessage::Pointer receivedResponse = igtl::RTSClockSyncMessage::New();
+  receivedResponse->SetMessageHeader(header);
+  receivedResponse->AllocatePack();
+  memcpy(receivedResponse->GetPackBodyPointer(), response->GetPackBodyPointer(), response->GetPackBodySize());
+  EXPECT_TRUE(receivedResponse->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_EQ(receivedResponse->GetOriginateTime(), 1234567890123456789ULL);
+  EXPECT_EQ(receivedResponse->GetReceiveTime(), before);
+  EXPECT_EQ(receivedResponse->GetTransmitTime(), response->GetTransmitTime());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,278 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageFileSource.h"
+#include "igtlServerSocket.h"
+#include "igtlClientSocket.h"
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtl_util.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <stdio.h>
+#include <vector>
+
+#define DIM_I 40
+#define DIM_J 30
+#define DIM_K 20
+
+void CreateScalars(std::vector<igtl_int16>& scalars)
+{
+  scalars.resize(DIM_I * DIM_J * DIM_K);
+  for (int n = 0; n < DIM_I * DIM_J * DIM_K; n ++)
+    {
+    scalars[n] = (igtl_int16)(n * 7 - 5000);
+    }
+}
+
+void WriteFile(const char* filename, const std::string& header, const void* data, size_t size)
+{
+  FILE* fp = fopen(filename, "wb");
+  ASSERT_TRUE(fp != NULL);
+  fwrite(header.c_str(), 1, header.size(), fp);
+  fwrite(data, 1, size, fp);
+  fclose(fp);
+}
+
+class ImageFileSourceTest : public testing::Test
+{
+protected:
+  void SetUp()
+  {
+    serverSocket = igtl::ServerSocket::New();
+    clientSocket = igtl::ClientSocket::New();
+    ASSERT_EQ(serverSocket->CreateServer(0), 0);
+    ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+    socket = serverSocket->WaitForConnection(1000);
+    ASSERT_TRUE(socket.IsNotNull());
+    CreateScalars(scalars);
+  }
+
+  void TearDown()
+  {
+    clientSocket->CloseSocket();
+    if (socket.IsNotNull())
+      {
+      socket->CloseSocket();
+      }
+    serverSocket->CloseSocket();
+  }
+
+  // Receives and unpacks an IMAGE message, checking its CRC.
+  igtl::ImageMessage::Pointer Receive()
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitPack();
+    EXPECT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+    headerMsg->Unpack();
+    igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+    imageMsg->SetMessageHeader(headerMsg);
+    imageMsg->AllocatePack();
+    EXPECT_EQ(clientSocket->Receive(imageMsg->GetPackBodyPointer(), imageMsg->GetPackBodySize()), imageMsg->GetPackBodySize());
+    EXPECT_TRUE(imageMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+    return imageMsg;
+  }
+
+  // Checks the scalars of a sub-volume of the volume
+  void CheckScalars(igtl::ImageMessage* imageMsg)
+  {
+    int subDim[3];
+    int subOff[3];
+    imageMsg->GetSubVolume(subDim, subOff);
+    igtl_int16* received = (igtl_int16*)imageMsg->GetScalarPointer();
+    int mismatches = 0;
+    for (int k = 0; k < subDim[2]; k ++)
+      {
+      for (int j = 0; j < subDim[1]; j ++)
+        {
+        for (int i = 0; i < subDim[0]; i ++)
+          {
+          int n = ((subOff[2] + k) * DIM_J + subOff[1] + j) * DIM_I + subOff[0] + i;
+          mismatches += *(received ++) != scalars[n];
+          }
+        }
+      }
+    EXPECT_EQ(mismatches, 0);
+  }
+
+  igtl::ServerSocket::Pointer serverSocket;
+  igtl::ClientSocket::Pointer clientSocket;
+  igtl::ClientSocket::Pointer socket;
+  std::vector<igtl_int16> scalars;
+};
+
+TEST_F(ImageFileSourceTest, RawFile)
+{
+  // Scalars after a header of 100 bytes, in the host byte order
+  WriteFile("igtlImageFileSourceTest.raw", std::string(100, 'h'), &scalars[0], scalars.size() * 2);
+  int endian = igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG;
+  int dim[3] = {DIM_I, DIM_J, DIM_K};
+
+  igtl::ImageFileSource::Pointer source = igtl::ImageFileSource::New();
+  EXPECT_EQ(source->Send(socket), 0);
+  ASSERT_EQ(source->OpenRawFile("igtlImageFileSourceTest.raw", dim, igtl::ImageMessage::TYPE_INT16, 1, endian, 100), 1);
+  ASSERT_TRUE(source->IsOpen());
+  EXPECT_EQ(memcmp(source->GetScalarPointer(), &scalars[0], scalars.size() * 2), 0);
+  igtl::ImageMessage* imageMsg = source->GetImageMessage();
+  imageMsg->SetDeviceName("CT");
+  imageMsg->SetTimeStamp(10, 0);
+  EXPECT_EQ(source->GetPackSize(), (igtlUint64)(IGTL_HEADER_SIZE + IGTL_IMAGE_HEADER_SIZE + scalars.size() * 2));
+
+  // Whole volume
+  ASSERT_EQ(source->Send(socket), 1);
+  igtl::ImageMessage::Pointer received = Receive();
+  EXPECT_STREQ(received->GetDeviceName(), "CT");
+  int receivedDim[3];
+  received->GetDimensions(receivedDim);
+  EXPECT_EQ(receivedDim[2], DIM_K);
+  EXPECT_EQ(received->GetScalarType(), igtl::ImageMessage::TYPE_INT16);
+  EXPECT_EQ(received->GetEndian(), endian);
+  CheckScalars(received);
+
+  // Sub-volumes, with a new time stamp
+  imageMsg->SetTimeStamp(11, 0);
+  imageMsg->SetSubVolume(10, 5, 3, 7, 8, 9);
+  ASSERT_EQ(source->Send(socket), 1);
+  received = Receive();
+  unsigned int sec;
+  unsigned int frac;
+  received->GetTimeStamp(&sec, &frac);
+  EXPECT_EQ(sec, 11u);
+  CheckScalars(received);
+
+  imageMsg->SetSubVolume(DIM_I, DIM_J, 4, 0, 0, 16);
+  ASSERT_EQ(source->Send(socket), 1);
+  CheckScalars(Receive());
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+  // Meta data after the scalars, and the CRC computed again when they change
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetMetaDataElement("Patient", IANA_TYPE_US_ASCII, "Phantom");
+  ASSERT_EQ(source->Send(socket), 1);
+  received = Receive();
+  std::string patient;
+  EXPECT_TRUE(received->GetMetaDataElement("Patient", patient));
+  EXPECT_EQ(patient, "Phantom");
+  CheckScalars(received);
+
+  imageMsg->SetMetaDataElement("Patient", IANA_TYPE_US_ASCII, "Phantom2");
+  ASSERT_EQ(source->Send(socket), 1);
+  received = Receive();
+  EXPECT_TRUE(received->GetMetaDataElement("Patient", patient));
+  EXPECT_EQ(patient, "Phantom2");
+#endif
+
+  // Volume larger than the file
+  EXPECT_EQ(imageMsg->SetSubVolume(10, 5, 3, 35, 0, 0), 0);
+  imageMsg->SetDimensions(DIM_I, DIM_J, DIM_K + 1);
+  EXPECT_EQ(source->Send(socket), 0);
+  EXPECT_EQ(source->OpenRawFile("igtlImageFileSourceTest.raw", dim, igtl::ImageMessage::TYPE_INT16, 1, endian, 101), 0);
+  EXPECT_FALSE(source->IsOpen());
+  EXPECT_EQ(source->OpenRawFile("igtlImageFileSourceTest.raw", dim, igtl::ImageMessage::TYPE_INT32, 1, endian), 0);
+  EXPECT_EQ(source->OpenRawFile("igtlImageFileSourceTest.missing", dim, igtl::ImageMessage::TYPE_INT16, 1, endian), 0);
+  remove("igtlImageFileSourceTest.raw");
+}
+
+TEST_F(ImageFileSourceTest, NrrdFile)
+{
+  // Attached data in a LPS space
+  std::string header =
+    "NRRD0004\n"
+    "# Complete NRRD file format specification at:\n"
+    "type: short\n"
+    "dimension: 3\n"
+    "space: left-posterior-superior\n"
+    "sizes: 40 30 20\n"
+    "space directions: (0.5,0,0) (0,0.5,0) (0,0,2)\n"
+    "kinds: domain domain domain\n";
+  header += igtl_is_little_endian() ? "endian: little\n" : "endian: big\n";
+  header +=
+    "encoding: raw\n"
+    "space origin: (10,20,30)\n"
+    "\n";
+  WriteFile("igtlImageFileSourceTest.nrrd", header, &scalars[0], scalars.size() * 2);
+
+  igtl::ImageFileSource::Pointer source = igtl::ImageFileSource::New();
+  ASSERT_EQ(source->OpenNrrdFile("igtlImageFileSourceTest.nrrd"), 1);
+  source->GetImageMessage()->SetDeviceName("CT");
+  ASSERT_EQ(source->Send(socket), 1);
+  igtl::ImageMessage::Pointer received = Receive();
+  int dim[3];
+  float spacing[3];
+  float origin[3];
+  float norm[3][3];
+  received->GetDimensions(dim);
+  received->GetSpacing(spacing);
+  received->GetOrigin(origin);
+  received->GetNormals(norm);
+  EXPECT_EQ(dim[0], DIM_I);
+  EXPECT_EQ(dim[1], DIM_J);
+  EXPECT_EQ(dim[2], DIM_K);
+  EXPECT_FLOAT_EQ(spacing[0], 0.5f);
+  EXPECT_FLOAT_EQ(spacing[2], 2.0f);
+  EXPECT_FLOAT_EQ(origin[0], -10.0f);
+  EXPECT_FLOAT_EQ(origin[1], -20.0f);
+  EXPECT_FLOAT_EQ(origin[2], 30.0f);
+  EXPECT_FLOAT_EQ(norm[0][0], -1.0f);
+  EXPECT_FLOAT_EQ(norm[1][1], -1.0f);
+  EXPECT_FLOAT_EQ(norm[2][2], 1.0f);
+  CheckScalars(received);
+
+  // Detached data at the end of a file, with vector voxels
+  std::vector<igtl_float32> vectors(3 * 4 * 5 * 6);
+  for (size_t n = 0; n < vectors.size(); n ++)
+    {
+    vectors[n] = (igtl_float32)n * 0.5f;
+    }
+  WriteFile("igtlImageFileSourceTest.data", std::string(16, 'x'), &vectors[0], vectors.size() * 4);
+  header =
+    "NRRD0004\n"
+    "type: float\n"
+    "dimension: 4\n"
+    "sizes: 3 4 5 6\n"
+    "kinds: vector domain domain domain\n"
+    "spacings: nan 1.5 2.5 3.5\n";
+  header += igtl_is_little_endian() ? "endian: little\n" : "endian: big\n";
+  header +=
+    "encoding: raw\n"
+    "byte skip: -1\n"
+    "data file: igtlImageFileSourceTest.data\n";
+  WriteFile("igtlImageFileSourceTest.nhdr", header, NULL, 0);
+  ASSERT_EQ(source->OpenNrrdFile("igtlImageFileSourceTest.nhdr"), 1);
+  ASSERT_EQ(source->Send(socket), 1);
+  received = Receive();
+  received->GetDimensions(dim);
+  received->GetSpacing(spacing);
+  EXPECT_EQ(received->GetNumComponents(), 3);
+  EXPECT_EQ(received->GetScalarType(), igtl::ImageMessage::TYPE_FLOAT32);
+  EXPECT_EQ(dim[0], 4);
+  EXPECT_EQ(dim[2], 6);
+  EXPECT_FLOAT_EQ(spacing[1], 2.5f);
+  EXPECT_EQ(memcmp(received->GetScalarPointer(), &vectors[0], vectors.size() * 4), 0);
+
+  // Unsupported encoding
+  header = "NRRD0004\ntype: short\ndimension: 3\nsizes: 40 30 20\nendian: little\nencoding: gzip\n\n";
+  WriteFile("igtlImageFileSourceTest.nrrd", header, &scalars[0], 100);
+  EXPECT_EQ(source->OpenNrrdFile("igtlImageFileSourceTest.nrrd"), 0);
+  EXPECT_EQ(source->OpenNrrdFile("igtlImageFileSourceTest.missing"), 0);
+
+  remove("igtlImageFileSourceTest.nrrd");
+  remove("igtlImageFileSourceTest.nhdr");
+  remove("igtlImageFileSourceTest.data");
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
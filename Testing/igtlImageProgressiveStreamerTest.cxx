@@ -0,0 +1,226 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageProgressiveStreamer.h"
+#include "igtlImageRegionCache.h"
+#include "igtl_header.h"
+#include "igtl_util.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define DIM_I 30
+#define DIM_J 20
+#define DIM_K 10
+
+igtl::ImageMessage::Pointer CreateVolume(int headerVersion)
+{
+  igtl::ImageMessage::Pointer volume = igtl::ImageMessage::New();
+  volume->SetHeaderVersion(headerVersion);
+  volume->SetDeviceName("CT");
+  volume->SetDimensions(DIM_I, DIM_J, DIM_K);
+  volume->SetSpacing(0.5f, 0.5f, 2.0f);
+  volume->SetOrigin(10.0f, 20.0f, 30.0f);
+  volume->SetScalarType(igtl::ImageMessage::TYPE_INT16);
+  volume->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG);
+  volume->AllocateScalars();
+  igtl_int16* scalars = (igtl_int16*)volume->GetScalarPointer();
+  for (int k = 0; k < DIM_K; k ++)
+    {
+    for (int j = 0; j < DIM_J; j ++)
+      {
+      for (int i = 0; i < DIM_I; i ++)
+        {
+        *(scalars ++) = (igtl_int16)(i + 100 * j - 1000 * k);
+        }
+      }
+    }
+  return volume;
+}
+
+// Simulates the transfer of a packed message: copies it to a new message and unpacks it.
+igtl::ImageMessage::Pointer Transfer(igtl::ImageMessage* msg)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  memcpy(headerMsg->GetPackPointer(), msg->GetPackPointer(), IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  igtl::ImageMessage::Pointer received = igtl::ImageMessage::New();
+  received->SetMessageHeader(headerMsg);
+  received->AllocatePack();
+  memcpy(received->GetPackBodyPointer(), (char*)msg->GetPackPointer() + IGTL_HEADER_SIZE,
+         received->GetPackBodySize());
+  EXPECT_TRUE(received->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  return received;
+}
+
+TEST(ImageProgressiveStreamerTest, Downsample)
+{
+  igtl::ImageMessage::Pointer volume = CreateVolume(IGTL_HEADER_VERSION_1);
+  igtl::ImageMessage::Pointer preview = igtl::ImageProgressiveStreamer::Downsample(volume, 4);
+  ASSERT_TRUE(preview.IsNotNull());
+
+  int dim[3];
+  float spacing[3];
+  float origin[3];
+  preview->GetDimensions(dim);
+  preview->GetSpacing(spacing);
+  preview->GetOrigin(origin);
+  EXPECT_EQ(dim[0], 8);
+  EXPECT_EQ(dim[1], 5);
+  EXPECT_EQ(dim[2], 3);
+  EXPECT_FLOAT_EQ(spacing[0], 2.0f);
+  EXPECT_FLOAT_EQ(spacing[2], 8.0f);
+  // 32 x 20 x 12 voxels cover the volume: the center moves by 1 voxel along i and k.
+  EXPECT_FLOAT_EQ(origin[0], 10.5f);
+  EXPECT_FLOAT_EQ(origin[1], 20.0f);
+  EXPECT_FLOAT_EQ(origin[2], 32.0f);
+  EXPECT_STREQ(preview->GetDeviceName(), "CT");
+
+  // Averages of the blocks, including the partial blocks at the end of i and k,
+  // rounded to the nearest integer.
+  igtl_int16* scalars = (igtl_int16*)preview->GetScalarPointer();
+  EXPECT_EQ(scalars[0], -1349);               // 1.5 + 150 - 1500
+  EXPECT_EQ(scalars[7], -1322);               // 28.5 + 150 - 1500
+  EXPECT_EQ(scalars[(2 * 5 + 4) * 8], -6749); // 1.5 + 1750 - 8500
+
+  // Scalars in the other byte order give the same preview, in that byte order.
+  igtl::ImageMessage::Pointer swapped = CreateVolume(IGTL_HEADER_VERSION_1);
+  swapped->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_BIG : igtl::ImageMessage::ENDIAN_LITTLE);
+  unsigned char* bytes = (unsigned char*)swapped->GetScalarPointer();
+  for (int n = 0; n < swapped->GetImageSize(); n += 2)
+    {
+    unsigned char c = bytes[n];
+    bytes[n] = bytes[n + 1];
+    bytes[n + 1] = c;
+    }
+  igtl::ImageMessage::Pointer swappedPreview = igtl::ImageProgressiveStreamer::Downsample(swapped, 4);
+  ASSERT_TRUE(swappedPreview.IsNotNull());
+  bytes = (unsigned char*)swappedPreview->GetScalarPointer();
+  unsigned char* expected = (unsigned char*)preview->GetScalarPointer();
+  for (int n = 0; n < preview->GetImageSize(); n += 2)
+    {
+    EXPECT_EQ(bytes[n], expected[n + 1]);
+    EXPECT_EQ(bytes[n + 1], expected[n]);
+    }
+
+  // Float scalars are not rounded.
+  igtl::ImageMessage::Pointer floatVolume = igtl::ImageMessage::New();
+  floatVolume->SetDimensions(2, 1, 1);
+  floatVolume->SetScalarType(igtl::ImageMessage::TYPE_FLOAT32);
+  floatVolume->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG);
+  floatVolume->AllocateScalars();
+  ((igtl_float32*)floatVolume->GetScalarPointer())[0] = 1.0f;
+  ((igtl_float32*)floatVolume->GetScalarPointer())[1] = 2.0f;
+  igtl::ImageMessage::Pointer floatPreview = igtl::ImageProgressiveStreamer::Downsample(floatVolume, 2);
+  ASSERT_TRUE(floatPreview.IsNotNull());
+  EXPECT_FLOAT_EQ(((igtl_float32*)floatPreview->GetScalarPointer())[0], 1.5f);
+}
+
+TEST(ImageProgressiveStreamerTest, ProgressiveTransfer)
+{
+  igtl::ImageMessage::Pointer volume = CreateVolume(IGTL_HEADER_VERSION_2);
+  igtl::ImageProgressiveStreamer::Pointer streamer = igtl::ImageProgressiveStreamer::New();
+  igtl::ImageRegionCache::Pointer cache = igtl::ImageRegionCache::New();
+
+  // 3 slices per refinement: a preview and 4 refinements
+  streamer->SetRefinementSize(3 * DIM_I * DIM_J * 2 + 1);
+  ASSERT_EQ(streamer->Start(volume), 5);
+  EXPECT_TRUE(streamer->GetPart(5) == NULL);
+
+  for (int i = 0; i < streamer->GetNumberOfParts(); i ++)
+    {
+    igtl::ImageMessage::Pointer received = Transfer(streamer->GetPart(i));
+    igtl_uint64 index = 0;
+    igtl_uint64 count = 0;
+    igtl_uint64 factor = 0;
+    std::string dimensions;
+    EXPECT_TRUE(received->GetMetaDataElement(IGTL_PROGRESSIVE_INDEX, index));
+    EXPECT_TRUE(received->GetMetaDataElement(IGTL_PROGRESSIVE_COUNT, count));
+    EXPECT_TRUE(received->GetMetaDataElement(IGTL_PROGRESSIVE_FACTOR, factor));
+    EXPECT_TRUE(received->GetMetaDataElement(IGTL_PROGRESSIVE_DIMENSIONS, dimensions));
+    EXPECT_EQ(index, (igtl_uint64)i);
+    EXPECT_EQ(count, (igtl_uint64)5);
+    EXPECT_EQ(factor, (igtl_uint64)(i == 0 ? 4 : 1));
+    EXPECT_EQ(dimensions, "30 20 10");
+    ASSERT_EQ(cache->Patch(received), 1);
+
+    igtl::ImageMessage* cached = cache->GetVolume("CT");
+    ASSERT_TRUE(cached != NULL);
+    int dim[3];
+    float spacing[3];
+    float origin[3];
+    cached->GetDimensions(dim);
+    cached->GetSpacing(spacing);
+    cached->GetOrigin(origin);
+    EXPECT_EQ(dim[0], DIM_I);
+    EXPECT_EQ(dim[2], DIM_K);
+    EXPECT_FLOAT_EQ(spacing[0], 0.5f);
+    EXPECT_FLOAT_EQ(spacing[2], 2.0f);
+    EXPECT_FLOAT_EQ(origin[0], 10.0f);
+    EXPECT_FLOAT_EQ(origin[2], 30.0f);
+
+    igtl_int16* scalars = (igtl_int16*)cached->GetScalarPointer();
+    if (i == 0)
+      {
+      // Voxels of the expanded preview
+      EXPECT_EQ(scalars[3], -1349);
+      EXPECT_EQ(scalars[4], -1345);
+      EXPECT_EQ(scalars[(9 * DIM_J + 19) * DIM_I + 29], -6722);
+      }
+    else
+      {
+      // The refinement overwrites the preview.
+      int k = 3 * (i - 1);
+      EXPECT_EQ(scalars[(k * DIM_J + 1) * DIM_I + 3], (igtl_int16)(3 + 100 - 1000 * k));
+      }
+    }
+  EXPECT_EQ(memcmp(cache->GetVolume("CT")->GetScalarPointer(), volume->GetScalarPointer(), volume->GetImageSize()), 0);
+
+  // Without a preview, the volume is sent in one refinement.
+  streamer->SetPreviewFactor(1);
+  streamer->SetRefinementSize(volume->GetImageSize());
+  ASSERT_EQ(streamer->Start(volume), 1);
+  int subDim[3];
+  int subOff[3];
+  streamer->GetPart(0)->GetSubVolume(subDim, subOff);
+  EXPECT_EQ(subDim[2], DIM_K);
+
+  volume->SetSubVolume(4, 4, 4, 0, 0, 0);
+  EXPECT_EQ(streamer->Start(volume), -1);
+}
+
+TEST(ImageProgressiveStreamerTest, HeaderVersion1)
+{
+  // Stock messages without meta data: the preview is a volume with a larger spacing.
+  igtl::ImageMessage::Pointer volume = CreateVolume(IGTL_HEADER_VERSION_1);
+  igtl::ImageProgressiveStreamer::Pointer streamer = igtl::ImageProgressiveStreamer::New();
+  streamer->SetPreviewFactor(2);
+  ASSERT_EQ(streamer->Start(volume), 2);
+  igtl::ImageMessage::Pointer received = Transfer(streamer->GetPart(0));
+  EXPECT_EQ(received->GetHeaderVersion(), IGTL_HEADER_VERSION_1);
+  int dim[3];
+  received->GetDimensions(dim);
+  EXPECT_EQ(dim[0], DIM_I / 2);
+
+  received = Transfer(streamer->GetPart(1));
+  int subDim[3];
+  int subOff[3];
+  received->GetSubVolume(subDim, subOff);
+  EXPECT_EQ(subDim[2], DIM_K);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
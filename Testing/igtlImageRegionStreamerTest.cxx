@@ -0,0 +1,189 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageRegionStreamer.h"
+#include "igtlImageRegionCache.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define DIM_I 64
+#define DIM_J 64
+#define DIM_K 32
+
+igtl::ImageMessage::Pointer CreateFrame()
+{
+  igtl::ImageMessage::Pointer frame = igtl::ImageMessage::New();
+  frame->SetDeviceName("Ultrasound");
+  frame->SetDimensions(DIM_I, DIM_J, DIM_K);
+  frame->SetSpacing(0.5f, 0.5f, 1.0f);
+  frame->SetScalarType(igtl::ImageMessage::TYPE_UINT16);
+  frame->AllocateScalars();
+  igtl_uint16* scalars = (igtl_uint16*)frame->GetScalarPointer();
+  for (int i = 0; i < DIM_I * DIM_J * DIM_K; i ++)
+    {
+    scalars[i] = (igtl_uint16)i;
+    }
+  return frame;
+}
+
+void SetVoxel(igtl::ImageMessage* frame, int i, int j, int k, igtl_uint16 value)
+{
+  ((igtl_uint16*)frame->GetScalarPointer())[(k * DIM_J + j) * DIM_I + i] = value;
+}
+
+// Simulates the transfer of a packed region: copies it to a new message and unpacks it.
+igtl::ImageMessage::Pointer Transfer(igtl::ImageMessage* region)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  memcpy(headerMsg->GetPackPointer(), region->GetPackPointer(), IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  igtl::ImageMessage::Pointer received = igtl::ImageMessage::New();
+  received->SetMessageHeader(headerMsg);
+  received->AllocatePack();
+  memcpy(received->GetPackBodyPointer(), (char*)region->GetPackPointer() + IGTL_HEADER_SIZE,
+         received->GetPackBodySize());
+  EXPECT_TRUE(received->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  return received;
+}
+
+// Sends the regions of a frame to the cache, and checks that the cached volume equals the frame.
+void CheckUpdate(igtl::ImageRegionStreamer* streamer, igtl::ImageRegionCache* cache,
+                 igtl::ImageMessage* frame, int expectedRegions)
+{
+  ASSERT_EQ(streamer->Update(frame), expectedRegions);
+  for (int i = 0; i < streamer->GetNumberOfRegions(); i ++)
+    {
+    igtl::ImageMessage::Pointer received = Transfer(streamer->GetRegion(i));
+    ASSERT_EQ(cache->Patch(received), 1);
+    }
+  igtl::ImageMessage* volume = cache->GetVolume("Ultrasound");
+  ASSERT_TRUE(volume != NULL);
+  ASSERT_EQ(volume->GetImageSize(), frame->GetImageSize());
+  EXPECT_EQ(memcmp(volume->GetScalarPointer(), frame->GetScalarPointer(), frame->GetImageSize()), 0);
+}
+
+TEST(ImageRegionStreamerTest, ChangedRegions)
+{
+  igtl::ImageRegionStreamer::Pointer streamer = igtl::ImageRegionStreamer::New();
+  igtl::ImageRegionCache::Pointer cache = igtl::ImageRegionCache::New();
+  igtl::ImageMessage::Pointer frame = CreateFrame();
+
+  // The first frame is sent entirely.
+  CheckUpdate(streamer, cache, frame, 1);
+  int dim[3];
+  int off[3];
+  streamer->GetRegion(0)->GetSubVolume(dim, off);
+  EXPECT_EQ(dim[0], DIM_I);
+  EXPECT_EQ(dim[2], DIM_K);
+  EXPECT_EQ(cache->GetNumberOfVolumes(), 1);
+  float spacing[3];
+  cache->GetVolume("Ultrasound")->GetSpacing(spacing);
+  EXPECT_FLOAT_EQ(spacing[0], 0.5f);
+
+  // Nothing changed
+  EXPECT_EQ(streamer->Update(frame), 0);
+  EXPECT_EQ(streamer->GetNumberOfChangedBlocks(), 0);
+
+  // A box over 3 x 2 blocks is sent as one region, a single voxel as another one.
+  for (int j = 5; j < 20; j ++)
+    {
+    for (int i = 10; i < 40; i ++)
+      {
+      SetVoxel(frame, i, j, 3, 0);
+      }
+    }
+  SetVoxel(frame, 63, 63, 31, 0);
+  CheckUpdate(streamer, cache, frame, 2);
+  EXPECT_EQ(streamer->GetNumberOfChangedBlocks(), 7);
+  streamer->GetRegion(0)->GetSubVolume(dim, off);
+  EXPECT_EQ(off[0], 0);
+  EXPECT_EQ(off[1], 0);
+  EXPECT_EQ(off[2], 0);
+  EXPECT_EQ(dim[0], 48);
+  EXPECT_EQ(dim[1], 32);
+  EXPECT_EQ(dim[2], 16);
+  streamer->GetRegion(1)->GetSubVolume(dim, off);
+  EXPECT_EQ(off[0], 48);
+  EXPECT_EQ(off[1], 48);
+  EXPECT_EQ(off[2], 16);
+  EXPECT_EQ(dim[0], 16);
+  EXPECT_GT(streamer->GetRegion(0)->GetPackSize(), streamer->GetRegion(1)->GetPackSize());
+
+  // Blocks in an L shape: the runs with different extents are not merged.
+  SetVoxel(frame, 0, 0, 0, 1);
+  SetVoxel(frame, 16, 0, 0, 1);
+  SetVoxel(frame, 0, 16, 0, 1);
+  CheckUpdate(streamer, cache, frame, 2);
+
+  // Most of the volume changed: sent entirely.
+  for (int k = 0; k < 20; k ++)
+    {
+    for (int j = 0; j < DIM_J; j ++)
+      {
+      SetVoxel(frame, 0, j, k, 2);
+      SetVoxel(frame, 16, j, k, 2);
+      SetVoxel(frame, 32, j, k, 2);
+      SetVoxel(frame, 48, j, k, 2);
+      }
+    }
+  CheckUpdate(streamer, cache, frame, 1);
+  streamer->GetRegion(0)->GetSubVolume(dim, off);
+  EXPECT_EQ(dim[1], DIM_J);
+
+  // New dimensions: sent entirely, and the cached volume is created again.
+  igtl::ImageMessage::Pointer smallFrame = igtl::ImageMessage::New();
+  smallFrame->SetDeviceName("Ultrasound");
+  smallFrame->SetDimensions(8, 8, 8);
+  smallFrame->SetScalarType(igtl::ImageMessage::TYPE_UINT16);
+  smallFrame->AllocateScalars();
+  memset(smallFrame->GetScalarPointer(), 1, smallFrame->GetImageSize());
+  CheckUpdate(streamer, cache, smallFrame, 1);
+
+  // A frame must cover the whole volume.
+  smallFrame->SetSubVolume(4, 4, 4, 0, 0, 0);
+  EXPECT_EQ(streamer->Update(smallFrame), -1);
+
+  EXPECT_EQ(cache->RemoveVolume("Ultrasound"), 1);
+  EXPECT_TRUE(cache->GetVolume("Ultrasound") == NULL);
+}
+
+TEST(ImageRegionCacheTest, PatchBeforeFullVolume)
+{
+  igtl::ImageRegionCache::Pointer cache = igtl::ImageRegionCache::New();
+  igtl::ImageMessage::Pointer region = igtl::ImageMessage::New();
+  region->SetDeviceName("MRI");
+  region->SetDimensions(4, 4, 4);
+  region->SetSubVolume(2, 2, 1, 2, 2, 3);
+  region->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  region->AllocateScalars();
+  memset(region->GetScalarPointer(), 9, region->GetSubVolumeImageSize());
+  region->Pack();
+  ASSERT_EQ(cache->Patch(Transfer(region)), 1);
+
+  // Zeros outside of the region
+  igtl::ImageMessage* volume = cache->GetVolume("MRI");
+  ASSERT_TRUE(volume != NULL);
+  unsigned char* scalars = (unsigned char*)volume->GetScalarPointer();
+  EXPECT_EQ(scalars[0], 0);
+  EXPECT_EQ(scalars[(3 * 4 + 2) * 4 + 2], 9);
+  EXPECT_EQ(scalars[(3 * 4 + 3) * 4 + 3], 9);
+  EXPECT_EQ(scalars[(2 * 4 + 3) * 4 + 3], 0);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,279 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlIntraEncoder.h"
+#include "igtlIntraDecoder.h"
+#include "igtlVideoMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <stdlib.h>
+#include <vector>
+
+using namespace igtl;
+
+// Fills the planes with a gradient, a flat rectangle and some noise.
+void CreatePicture(SourcePicture* pic, std::vector<igtl_uint8>& buffer, int width, int height, int format)
+{
+  int chromaWidth = (format == FormatI420) ? width / 2 : width;
+  int chromaHeight = (format == FormatI420) ? height / 2 : height;
+  buffer.resize(width * height + 2 * chromaWidth * chromaHeight);
+  pic->colorFormat = format;
+  pic->picWidth = width;
+  pic->picHeight = height;
+  pic->data[0] = &buffer[0];
+  pic->data[1] = pic->data[0] + width * height;
+  pic->data[2] = pic->data[1] + chromaWidth * chromaHeight;
+  pic->stride[0] = width;
+  pic->stride[1] = pic->stride[2] = chromaWidth;
+  srand(1);
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int w = plane == 0 ? width : chromaWidth;
+    int h = plane == 0 ? height : chromaHeight;
+    for (int y = 0; y < h; y++)
+      {
+      for (int x = 0; x < w; x++)
+        {
+        int value = (x * 3 + y * 2 + plane * 50) & 0xFF;
+        if (x > w / 4 && x < w / 2 && y > h / 4 && y < h / 2)
+          {
+          value = 200;
+          }
+        else if (y > h * 3 / 4)
+          {
+          value = rand() & 0xFF;
+          }
+        pic->data[plane][y * pic->stride[plane] + x] = (igtl_uint8)value;
+        }
+      }
+    }
+}
+
+// Packs the message on the sender side and unpacks a copy of it as the receiver would.
+VideoMessage::Pointer TransferMessage(VideoMessage::Pointer& sent)
+{
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->AllocatePack();
+  memcpy(header->GetPackPointer(), sent->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  VideoMessage::Pointer received = VideoMessage::New();
+  received->SetMessageHeader(header);
+  received->AllocatePack();
+  memcpy(received->GetPackBodyPointer(), sent->GetPackBodyPointer(), sent->GetPackBodySize());
+  received->Unpack();
+  return received;
+}
+
+int GetMaximumDifference(SourcePicture* a, SourcePicture* b, int format)
+{
+  int maxDiff = 0;
+  for (int plane = 0; plane < 3; plane++)
+    {
+    int w, h;
+    IntraCodec::GetPlaneSize(plane, format, a->picWidth, a->picHeight, w, h);
+    for (int y = 0; y < h; y++)
+      {
+      for (int x = 0; x < w; x++)
+        {
+        int diff = abs(a->data[plane][y * a->stride[plane] + x] - b->data[plane][y * b->stride[plane] + x]);
+        maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+      }
+    }
+  return maxDiff;
+}
+
+int RoundTrip(int width, int height, int format, int maximumError, int tileSize, int numberOfThreads, int& compressedSize)
+{
+  SourcePicture source, decoded;
+  std::vector<igtl_uint8> sourceBuffer;
+  CreatePicture(&source, sourceBuffer, width, height, format);
+  std::vector<igtl_uint8> decodedBuffer(sourceBuffer.size(), 0);
+  decoded.data[0] = &decodedBuffer[0];
+
+  IntraEncoder::Pointer encoder = IntraEncoder::New();
+  EXPECT_EQ(encoder->SetTileSize(tileSize, tileSize), 0);
+  EXPECT_EQ(encoder->SetMaximumError(maximumError), 0);
+  encoder->SetNumberOfThreads(numberOfThreads);
+  VideoMessage::Pointer sent = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, sent), ResultSuccess);
+  compressedSize = sent->GetBitStreamSize();
+
+  VideoMessage::Pointer received = TransferMessage(sent);
+  EXPECT_EQ(received->GetCodecType(), std::string(IGTL_VIDEO_CODEC_NAME_INTRA));
+  IntraDecoder::Pointer decoder = IntraDecoder::New();
+  decoder->SetNumberOfThreads(numberOfThreads);
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(received, &decoded), 1);
+  EXPECT_EQ(decoded.colorFormat, format);
+  return GetMaximumDifference(&source, &decoded, format);
+}
+
+TEST(IntraCodecTest, LosslessI420)
+{
+  int compressedSize = 0;
+  EXPECT_EQ(RoundTrip(256, 256, FormatI420, 0, 64, 1, compressedSize), 0);
+  EXPECT_LT(compressedSize, 256 * 256 * 3 / 2);
+  // Tiles not aligned with the picture size
+  EXPECT_EQ(RoundTrip(100, 70, FormatI420, 0, 32, 3, compressedSize), 0);
+}
+
+TEST(IntraCodecTest, LosslessI444)
+{
+  int compressedSize = 0;
+  EXPECT_EQ(RoundTrip(128, 96, FormatI444, 0, 48, 4, compressedSize), 0);
+  EXPECT_EQ(RoundTrip(37, 21, FormatI444, 0, 16, 2, compressedSize), 0);
+}
+
+TEST(IntraCodecTest, NearLossless)
+{
+  int losslessSize = 0;
+  int compressedSize = 0;
+  RoundTrip(256, 256, FormatI420, 0, 64, 2, losslessSize);
+  for (int maximumError = 1; maximumError <= 4; maximumError++)
+    {
+    EXPECT_LE(RoundTrip(256, 256, FormatI420, maximumError, 64, 2, compressedSize), maximumError);
+    EXPECT_LT(compressedSize, losslessSize);
+    }
+  IntraEncoder::Pointer encoder = IntraEncoder::New();
+  EXPECT_EQ(encoder->SetMaximumError(IGTL_INTRA_CODEC_MAXIMUM_ERROR + 1), -1);
+  EXPECT_EQ(encoder->SetTileSize(15, 16), -1);
+  EXPECT_EQ(encoder->SetTileSize(8, 8), -1);
+}
+
+TEST(IntraCodecTest, ThreadsProduceSameStream)
+{
+  SourcePicture source;
+  std::vector<igtl_uint8> sourceBuffer;
+  CreatePicture(&source, sourceBuffer, 200, 120, FormatI420);
+  std::vector<igtl_uint8> streams[2];
+  for (int i = 0; i < 2; i++)
+    {
+    IntraEncoder::Pointer encoder = IntraEncoder::New();
+    encoder->SetTileSize(32, 32);
+    encoder->SetNumberOfThreads(i == 0 ? 1 : 8);
+    VideoMessage::Pointer message = VideoMessage::New();
+    EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, message), ResultSuccess);
+    streams[i].assign(message->GetPackFragmentPointer(2), message->GetPackFragmentPointer(2) + message->GetBitStreamSize());
+    }
+  EXPECT_TRUE(streams[0] == streams[1]);
+}
+
+TEST(IntraCodecTest, CorruptedStream)
+{
+  SourcePicture source, decoded;
+  std::vector<igtl_uint8> sourceBuffer;
+  CreatePicture(&source, sourceBuffer, 64, 64, FormatI420);
+  std::vector<igtl_uint8> decodedBuffer(sourceBuffer.size(), 0);
+  decoded.data[0] = &decodedBuffer[0];
+
+  IntraEncoder::Pointer encoder = IntraEncoder::New();
+  encoder->SetTileSize(32, 32);
+  VideoMessage::Pointer message = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, message), ResultSuccess);
+  IntraDecoder::Pointer decoder = IntraDecoder::New();
+  igtl_uint8* stream = message->GetPackFragmentPointer(2);
+
+  // Tile size beyond the end of the stream
+  stream[IGTL_INTRA_CODEC_HEADER_SIZE] = 0xFF;
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(message, &decoded), -1);
+  stream[IGTL_INTRA_CODEC_HEADER_SIZE] = 0;
+
+  // Unknown version
+  stream[0] = IGTL_INTRA_CODEC_VERSION + 1;
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(message, &decoded), -1);
+  stream[0] = IGTL_INTRA_CODEC_VERSION;
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(message, &decoded), 1);
+
+  // Truncated tile
+  int numberOfTiles = IntraCodec::GetNumberOfTiles(64, 64, 32, 32);
+  igtl_uint8* lastSize = stream + IGTL_INTRA_CODEC_HEADER_SIZE + (numberOfTiles - 1) * IGTL_INTRA_CODEC_TILE_SIZE_BYTES;
+  lastSize[3] = lastSize[3] / 4;
+  lastSize[2] = 0;
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(message, &decoded), -1);
+}
+
+TEST(IntraCodecTest, PartialUpdate)
+{
+  SourcePicture source, decoded;
+  std::vector<igtl_uint8> sourceBuffer;
+  CreatePicture(&source, sourceBuffer, 160, 96, FormatI420);
+  std::vector<igtl_uint8> decodedBuffer(sourceBuffer.size(), 0);
+  decoded.data[0] = &decodedBuffer[0];
+
+  IntraEncoder::Pointer encoder = IntraEncoder::New();
+  encoder->SetTileSize(32, 32);
+  encoder->SetPartialUpdate(true);
+  EXPECT_EQ(encoder->SetKeyFrameDistance(0), -1);
+  EXPECT_EQ(encoder->SetKeyFrameDistance(4), 0);
+  encoder->SetNumberOfThreads(3);
+  IntraDecoder::Pointer decoder = IntraDecoder::New();
+  decoder->SetNumberOfThreads(2);
+  int numberOfTiles = IntraCodec::GetNumberOfTiles(160, 96, 32, 32);
+
+  // The first frame is a full frame.
+  VideoMessage::Pointer keyFrame = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, keyFrame), ResultSuccess);
+  EXPECT_EQ(encoder->GetVideoFrameType(), FrameTypeKey);
+  EXPECT_EQ(encoder->GetNumberOfEncodedTiles(), numberOfTiles);
+
+  // Change two pixels of tiles (1, 0) and (2, 2).
+  source.data[0][5 * 160 + 40] ^= 0xFF;
+  source.data[0][70 * 160 + 70] ^= 0xFF;
+  VideoMessage::Pointer update = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, update, true), ResultSuccess);
+  EXPECT_EQ(encoder->GetVideoFrameType(), FrameTypeInterPrediction);
+  EXPECT_EQ(encoder->GetNumberOfEncodedTiles(), 2);
+  EXPECT_LT(update->GetBitStreamSize(), keyFrame->GetBitStreamSize() / 4);
+
+  // Unchanged frame
+  VideoMessage::Pointer skipped = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, skipped), ResultSuccess);
+  EXPECT_EQ(encoder->GetVideoFrameType(), FrameTypeSkip);
+  EXPECT_EQ(encoder->GetNumberOfEncodedTiles(), 0);
+
+  // A partial update cannot be decoded without the previous frame.
+  VideoMessage::Pointer receivedUpdate = TransferMessage(update);
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(receivedUpdate, &decoded), -1);
+
+  VideoMessage::Pointer receivedKeyFrame = TransferMessage(keyFrame);
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(receivedKeyFrame, &decoded), 1);
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(receivedUpdate, &decoded), 1);
+  EXPECT_TRUE(decoder->GetIsGrayImage());
+  EXPECT_EQ(GetMaximumDifference(&source, &decoded, FormatI420), 0);
+  int x, y, w, h;
+  EXPECT_EQ(decoder->GetUpdatedRegion(x, y, w, h), 2);
+  EXPECT_EQ(x, 32);
+  EXPECT_EQ(y, 0);
+  EXPECT_EQ(w, 64);
+  EXPECT_EQ(h, 96);
+  VideoMessage::Pointer receivedSkipped = TransferMessage(skipped);
+  EXPECT_EQ(decoder->DecodeVideoMSGIntoSingleFrame(receivedSkipped, &decoded), 1);
+  EXPECT_EQ(decoder->GetUpdatedRegion(x, y, w, h), 0);
+  EXPECT_EQ(GetMaximumDifference(&source, &decoded, FormatI420), 0);
+
+  // Every 4th frame is a full frame.
+  VideoMessage::Pointer message = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, message), ResultSuccess);
+  EXPECT_EQ(encoder->GetVideoFrameType(), FrameTypeSkip);
+  message = VideoMessage::New();
+  EXPECT_EQ(encoder->EncodeSingleFrameIntoVideoMSG(&source, message), ResultSuccess);
+  EXPECT_EQ(encoder->GetVideoFrameType(), FrameTypeKey);
+  EXPECT_EQ(encoder->GetNumberOfEncodedTiles(), numberOfTiles);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,204 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlLatencyRecorder.h"
+#include "igtlMessageRTPWrapper.h"
+#include "igtlImageMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <sstream>
+
+int   imageSize[3] = {100, 100, 1}; // 10000 bytes, fragmented into several packets
+int   payloadLength = 1300;
+
+#if OpenIGTLink_PROTOCOL_VERSION >= 3
+#include "igtlMessageFormat2TestMacro.h"
+
+#define MS 1000000ULL
+
+void CreateImageMessage(igtl::ImageMessage::Pointer& imageMsg, igtl_uint32 messageID)
+{
+  imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetDeviceName("Imager");
+  imageMsg->SetDimensions(imageSize);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->SetMessageID(messageID);
+}
+
+TEST(LatencyRecorderTest, StampsAndPercentiles)
+{
+  igtl::LatencyRecorder::Pointer recorder = igtl::LatencyRecorder::New();
+  igtl_uint64 start = 1000 * MS;
+  for (igtl_uint32 i = 1; i <= 100; i++)
+  {
+    EXPECT_EQ(recorder->SetStamp(i, igtl::LatencyRecorder::STAGE_CAPTURE, start + i * MS), 1);
+    EXPECT_EQ(recorder->SetStamp(i, igtl::LatencyRecorder::STAGE_DECODED, start + 2 * i * MS), 1);
+  }
+  EXPECT_EQ(recorder->GetNumberOfFrames(), 100);
+  EXPECT_EQ(recorder->SetStamp(1, igtl::LatencyRecorder::NUMBER_OF_STAGES, start), 0);
+  EXPECT_EQ(recorder->SetStamp(1, igtl::LatencyRecorder::STAGE_WRAP, 0), 0);
+
+  // Frames are identified by the lower 16 bits of the message ID.
+  EXPECT_EQ(recorder->GetStamp(0x10005, igtl::LatencyRecorder::STAGE_CAPTURE), start + 5 * MS);
+  EXPECT_EQ(recorder->GetStamp(5, igtl::LatencyRecorder::STAGE_WRAP), 0);
+  EXPECT_EQ(recorder->StampIfUnset(5, igtl::LatencyRecorder::STAGE_CAPTURE, start), 0);
+  EXPECT_EQ(recorder->GetStamp(5, igtl::LatencyRecorder::STAGE_CAPTURE), start + 5 * MS);
+
+  double latency = 0.0;
+  EXPECT_EQ(recorder->GetLatencyPercentile(igtl::LatencyRecorder::STAGE_CAPTURE, igtl::LatencyRecorder::STAGE_DECODED, 0.0, latency), 100);
+  EXPECT_DOUBLE_EQ(latency, 1.0);
+  recorder->GetLatencyPercentile(igtl::LatencyRecorder::STAGE_CAPTURE, igtl::LatencyRecorder::STAGE_DECODED, 50.0, latency);
+  EXPECT_DOUBLE_EQ(latency, 50.0);
+  recorder->GetLatencyPercentile(igtl::LatencyRecorder::STAGE_CAPTURE, igtl::LatencyRecorder::STAGE_DECODED, 99.0, latency);
+  EXPECT_DOUBLE_EQ(latency, 99.0);
+  recorder->GetLatencyPercentile(igtl::LatencyRecorder::STAGE_CAPTURE, igtl::LatencyRecorder::STAGE_DECODED, 100.0, latency);
+  EXPECT_DOUBLE_EQ(latency, 100.0);
+  EXPECT_EQ(recorder->GetLatencyPercentile(igtl::LatencyRecorder::STAGE_CAPTURE, igtl::LatencyRecorder::STAGE_WRAP, 50.0, latency), 0);
+
+  recorder->SetMaximumNumberOfFrames(10);
+  EXPECT_EQ(recorder->GetNumberOfFrames(), 10);
+  EXPECT_EQ(recorder->GetStamp(90, igtl::LatencyRecorder::STAGE_CAPTURE), 0);
+  EXPECT_EQ(recorder->GetStamp(91, igtl::LatencyRecorder::STAGE_CAPTURE), start + 91 * MS);
+  recorder->Clear();
+  EXPECT_EQ(recorder->GetNumberOfFrames(), 0);
+}
+
+TEST(LatencyRecorderTest, CSV)
+{
+  igtl::LatencyRecorder::Pointer sender = igtl::LatencyRecorder::New();
+  igtl::LatencyRecorder::Pointer receiver = igtl::LatencyRecorder::New();
+  for (igtl_uint32 i = 0; i < 3; i++)
+  {
+    sender->SetStamp(i, igtl::LatencyRecorder::STAGE_CAPTURE, 1000 * MS);
+    sender->SetStamp(i, igtl::LatencyRecorder::STAGE_LAST_PACKET_SENT, 1010 * MS);
+    receiver->SetStamp(i, igtl::LatencyRecorder::STAGE_REASSEMBLED, 1030 * MS);
+    receiver->SetStamp(i, igtl::LatencyRecorder::STAGE_DECODED, 1060 * MS);
+  }
+  receiver->Merge(sender);
+  EXPECT_EQ(receiver->GetStamp(2, igtl::LatencyRecorder::STAGE_CAPTURE), 1000 * MS);
+
+  std::stringstream frames;
+  receiver->WriteFramesCSV(frames);
+  std::string line;
+  std::getline(frames, line);
+  EXPECT_EQ(line, "FrameID,Capture,EncodeStart,EncodeEnd,Wrap,FirstPacketSent,LastPacketSent,"
+                  "FirstPacketReceived,LastPacketReceived,Reassembled,Decoded");
+  std::getline(frames, line);
+  EXPECT_EQ(line, "0,1000000000,,,,,1010000000,,,1030000000,1060000000");
+
+  std::stringstream summary;
+  receiver->WriteSummaryCSV(summary);
+  std::getline(summary, line);
+  EXPECT_EQ(line, "From,To,Frames,Min,P50,P90,P95,P99,Max");
+  std::getline(summary, line);
+  EXPECT_EQ(line, "Capture,LastPacketSent,3,10,10,10,10,10,10");
+  std::getline(summary, line);
+  EXPECT_EQ(line, "LastPacketSent,Reassembled,3,20,20,20,20,20,20");
+  std::getline(summary, line);
+  EXPECT_EQ(line, "Reassembled,Decoded,3,30,30,30,30,30,30");
+  std::getline(summary, line);
+  EXPECT_EQ(line, "Capture,Decoded,3,60,60,60,60,60,60");
+}
+
+TEST(LatencyRecorderTest, MetaDataFormatVersion2)
+{
+  igtl::LatencyRecorder::Pointer sender = igtl::LatencyRecorder::New();
+  igtl::ImageMessage::Pointer imageMsg;
+  CreateImageMessage(imageMsg, 7);
+  sender->SetStamp(7, igtl::LatencyRecorder::STAGE_CAPTURE, 1000 * MS);
+  EXPECT_EQ(sender->WriteStampsToMetaData(imageMsg), 3);
+  imageMsg->AllocateScalars();
+  imageMsg->Pack();
+  int packSize = imageMsg->GetPackSize();
+
+  // Stamping the encoding stages afterwards packs the message again, without changing its size.
+  sender->SetStamp(7, igtl::LatencyRecorder::STAGE_ENCODE_START, 1001 * MS);
+  sender->SetStamp(7, igtl::LatencyRecorder::STAGE_ENCODE_END, 1005 * MS);
+  EXPECT_EQ(sender->WriteStampsToMetaData(imageMsg), 3);
+  EXPECT_EQ(imageMsg->GetPackSize(), packSize);
+
+  // A message allocated without the stamps is left unchanged.
+  igtl::ImageMessage::Pointer otherMsg;
+  CreateImageMessage(otherMsg, 7);
+  otherMsg->AllocateScalars();
+  otherMsg->Pack();
+  EXPECT_EQ(sender->WriteStampsToMetaData(otherMsg), 0);
+  EXPECT_EQ(otherMsg->GetMetaData().size(), 0u);
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), imageMsg->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  igtl::ImageMessage::Pointer receivedMsg = igtl::ImageMessage::New();
+  receivedMsg->SetMessageHeader(header);
+  receivedMsg->AllocatePack();
+  memcpy(receivedMsg->GetPackBodyPointer(), imageMsg->GetPackBodyPointer(), imageMsg->GetPackBodySize());
+  int c = receivedMsg->Unpack(1);
+  EXPECT_TRUE(c & igtl::MessageHeader::UNPACK_BODY);
+
+  igtl::LatencyRecorder::Pointer receiver = igtl::LatencyRecorder::New();
+  EXPECT_EQ(receiver->ReadStampsFromMetaData(receivedMsg), 3);
+  EXPECT_EQ(receiver->GetStamp(7, igtl::LatencyRecorder::STAGE_CAPTURE), 1000 * MS);
+  EXPECT_EQ(receiver->GetStamp(7, igtl::LatencyRecorder::STAGE_ENCODE_START), 1001 * MS);
+  EXPECT_EQ(receiver->GetStamp(7, igtl::LatencyRecorder::STAGE_ENCODE_END), 1005 * MS);
+}
+
+TEST(LatencyRecorderTest, RTPWrapperStagesFormatVersion2)
+{
+  igtl::ImageMessage::Pointer imageMsg;
+  CreateImageMessage(imageMsg, 0x12345);
+  imageMsg->AllocateScalars();
+  memset(imageMsg->GetScalarPointer(), 1, imageMsg->GetImageSize());
+  imageMsg->Pack();
+
+  igtl::LatencyRecorder::Pointer recorder = igtl::LatencyRecorder::New();
+  igtl::MessageRTPWrapper::Pointer sender = igtl::MessageRTPWrapper::New();
+  sender->SetRTPPayloadLength(payloadLength);
+  sender->SetLatencyRecorder(recorder);
+  sender->WrapMessageAndPushToBuffer((igtl_uint8*)imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+  igtl::PacketBuffer packets = sender->GetOutGoingPackets();
+  ASSERT_GT(packets.pPacketLengthInByte.size(), 2);
+
+  igtl::MessageRTPWrapper::Pointer receiver = igtl::MessageRTPWrapper::New();
+  receiver->SetRTPPayloadLength(payloadLength);
+  receiver->SetLatencyRecorder(recorder);
+  igtlUint8* packetPointer = packets.pBsBuf.data();
+  for (unsigned int i = 0; i < packets.pPacketLengthInByte.size(); i++)
+  {
+    receiver->PushDataIntoPacketBuffer(packetPointer, packets.pPacketLengthInByte[i]);
+    packetPointer += packets.pPacketLengthInByte[i];
+  }
+  while (receiver->UnWrapPacketWithTypeAndName("IMAGE", "Imager"));
+  ASSERT_EQ(receiver->unWrappedMessages.size(), 1);
+
+  igtl_uint64 wrap = recorder->GetStamp(0x2345, igtl::LatencyRecorder::STAGE_WRAP);
+  igtl_uint64 firstReceived = recorder->GetStamp(0x2345, igtl::LatencyRecorder::STAGE_FIRST_PACKET_RECEIVED);
+  igtl_uint64 lastReceived = recorder->GetStamp(0x2345, igtl::LatencyRecorder::STAGE_LAST_PACKET_RECEIVED);
+  igtl_uint64 reassembled = recorder->GetStamp(0x2345, igtl::LatencyRecorder::STAGE_REASSEMBLED);
+  EXPECT_EQ(recorder->GetNumberOfFrames(), 1);
+  EXPECT_NE(wrap, 0);
+  EXPECT_LE(wrap, firstReceived);
+  EXPECT_LE(firstReceived, lastReceived);
+  EXPECT_LE(lastReceived, reassembled);
+  receiver->SetLatencyRecorder(NULL);
+  sender->SetLatencyRecorder(NULL);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
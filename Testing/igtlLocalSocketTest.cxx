@@ -0,0 +1,174 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlLocalSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+std::string GetSocketPath()
+{
+  std::stringstream ss;
+  ss << "/tmp/igtl-test-" << getpid() << ".sock";
+  return ss.str();
+}
+
+// Larger than the socket buffers, so that sending it blocks until it is read unless its
+// body is passed as a file descriptor.
+igtl::ImageMessage::Pointer CreateImage(int length)
+{
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {length, length, 4};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  unsigned char* scalars = static_cast<unsigned char*>(imageMsg->GetScalarPointer());
+  for (int i = 0; i < imageMsg->GetImageSize(); i++)
+    {
+    scalars[i] = (unsigned char)(i % 251);
+    }
+  imageMsg->Pack();
+  return imageMsg;
+}
+
+bool ReceiveMessage(igtl::Socket* socket, igtl::MessageBase* message)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+    {
+    return false;
+    }
+  headerMsg->Unpack();
+  message->SetMessageHeader(headerMsg);
+  message->AllocatePack();
+  if (socket->Receive(message->GetPackBodyPointer(), message->GetPackBodySize()) != message->GetPackBodySize())
+    {
+    return false;
+    }
+  return (message->Unpack(1) & igtl::MessageBase::UNPACK_BODY) != 0;
+}
+
+TEST(LocalSocketTest, Connect)
+{
+  std::string path = GetSocketPath();
+  igtl::LocalSocket::Pointer serverSocket = igtl::LocalSocket::New();
+  igtl::LocalSocket::Pointer clientSocket = igtl::LocalSocket::New();
+  EXPECT_EQ(clientSocket->ConnectToServer(path.c_str()), -1);
+  ASSERT_EQ(serverSocket->CreateServer(path.c_str()), 0);
+  EXPECT_TRUE(serverSocket->WaitForConnection(10).IsNull());
+
+  ASSERT_EQ(clientSocket->ConnectToServer(path.c_str()), 0);
+  igtl::LocalSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  // The path is used by the server.
+  igtl::LocalSocket::Pointer otherSocket = igtl::LocalSocket::New();
+  EXPECT_EQ(otherSocket->CreateServer(path.c_str()), -1);
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  EXPECT_EQ(socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 1);
+  igtl::TransformMessage::Pointer received = igtl::TransformMessage::New();
+  ASSERT_TRUE(ReceiveMessage(clientSocket, received));
+  EXPECT_STREQ(received->GetDeviceName(), "Tracker");
+
+  // Timeout, then end of the connection
+  char data[4];
+  clientSocket->SetReceiveTimeout(10);
+  EXPECT_EQ(clientSocket->Receive(data, 4), -1);
+  EXPECT_EQ(clientSocket->Skip(4), -1);
+  socket->CloseSocket();
+  EXPECT_EQ(clientSocket->Receive(data, 4), 0);
+  clientSocket->CloseSocket();
+
+  // The path is removed with the server socket.
+  serverSocket->CloseSocket();
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+
+TEST(LocalSocketTest, DescriptorPassing)
+{
+  std::string path = GetSocketPath();
+  igtl::LocalSocket::Pointer serverSocket = igtl::LocalSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(path.c_str()), 0);
+  serverSocket->SetDescriptorPassing(true);
+  serverSocket->SetDescriptorPassingSize(65536);
+  igtl::LocalSocket::Pointer clientSocket = igtl::LocalSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer(path.c_str()), 0);
+  igtl::LocalSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+  EXPECT_TRUE(socket->GetDescriptorPassing());
+
+  // Messages sent before they are read: the large images do not fill the socket buffers.
+  igtl::ImageMessage::Pointer largeImageMsg = CreateImage(1024);
+  igtl::ImageMessage::Pointer smallImageMsg = CreateImage(16);
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  socket->SetSendTimeout(5000);
+  clientSocket->SetReceiveTimeout(5000);
+  ASSERT_EQ(socket->Send(largeImageMsg->GetPackPointer(), largeImageMsg->GetPackSize()), 1);
+  ASSERT_EQ(socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 1);
+  ASSERT_EQ(socket->Send(smallImageMsg->GetPackPointer(), smallImageMsg->GetPackSize()), 1);
+
+  // Split into fragments, the first of them ending inside the header
+  const void* fragments[3] = {largeImageMsg->GetPackPointer(), (char*)largeImageMsg->GetPackPointer() + 20,
+                              (char*)largeImageMsg->GetPackPointer() + 100000};
+  int sizes[3] = {20, 100000 - 20, (int)largeImageMsg->GetPackSize() - 100000};
+  ASSERT_EQ(socket->Send(fragments, sizes, 3), 1);
+  ASSERT_EQ(socket->Send(largeImageMsg->GetPackPointer(), largeImageMsg->GetPackSize()), 1);
+
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  ASSERT_TRUE(ReceiveMessage(clientSocket, imageMsg));
+  EXPECT_STREQ(imageMsg->GetDeviceName(), "Camera");
+  EXPECT_EQ(imageMsg->GetImageSize(), largeImageMsg->GetImageSize());
+  EXPECT_EQ(memcmp(imageMsg->GetScalarPointer(), largeImageMsg->GetScalarPointer(), largeImageMsg->GetImageSize()), 0);
+  igtl::TransformMessage::Pointer receivedTransformMsg = igtl::TransformMessage::New();
+  ASSERT_TRUE(ReceiveMessage(clientSocket, receivedTransformMsg));
+  EXPECT_STREQ(receivedTransformMsg->GetDeviceName(), "Tracker");
+  ASSERT_TRUE(ReceiveMessage(clientSocket, imageMsg));
+  EXPECT_EQ(imageMsg->GetImageSize(), smallImageMsg->GetImageSize());
+  ASSERT_TRUE(ReceiveMessage(clientSocket, imageMsg));
+  EXPECT_EQ(memcmp(imageMsg->GetScalarPointer(), largeImageMsg->GetScalarPointer(), largeImageMsg->GetImageSize()), 0);
+
+  // A body passed as a file descriptor is skipped as any other.
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  EXPECT_STREQ(headerMsg->GetDeviceType(), "IMAGE");
+  EXPECT_EQ(clientSocket->Skip(headerMsg->GetBodySizeToRead()), headerMsg->GetBodySizeToRead());
+
+  ASSERT_EQ(socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 1);
+  ASSERT_TRUE(ReceiveMessage(clientSocket, receivedTransformMsg));
+
+  socket->CloseSocket();
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
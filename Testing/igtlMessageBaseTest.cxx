@@ -13,6 +13,8 @@
 
 #include "igtlMessageBase.h"
 #include "igtlMessageHeader.h"
+#include "igtlMultiThreader.h"
+#include "igtlStatusMessage.h"
 #include "igtlTestConfig.h"
 #include "string.h"
 
@@ -67,6 +69,197 @@ TEST(MessageBaseTest, UNPACKTEST)
   EXPECT_EQ(status, static_cast<int>(messageBaseTest->UNPACK_HEADER));
 }
 
+#if OpenIGTLink_PROTOCOL_VERSION >= 3
+TEST(MessageBaseTest, MetaDataStoreFormatVersion2)
+{
+  igtl::StatusMessage::Pointer sendMsg = igtl::StatusMessage::New();
+  sendMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  sendMsg->SetDeviceName("Device");
+  EXPECT_TRUE(sendMsg->SetMetaDataElement("Width", (igtl_uint32)640));
+  EXPECT_TRUE(sendMsg->SetMetaDataElement("Offset", (igtl_int64)-9223372036854775807LL - 1));
+  EXPECT_TRUE(sendMsg->SetMetaDataElement("Gain", 1.5));
+  EXPECT_TRUE(sendMsg->SetMetaDataElement("Level", (igtl_uint8)7));
+  EXPECT_TRUE(sendMsg->SetMetaDataElement("Patient", IANA_TYPE_UTF_8, "Doe"));
+
+  std::string text;
+  EXPECT_TRUE(sendMsg->GetMetaDataElement("Offset", text));
+  EXPECT_EQ(text, "-9223372036854775808");
+  EXPECT_TRUE(sendMsg->GetMetaDataElement("Level", text));
+  EXPECT_EQ(text, "7");
+  igtl_uint64 width = 0;
+  EXPECT_TRUE(sendMsg->GetMetaDataElement("Width", width));
+  EXPECT_EQ(width, 640u);
+  igtl_int64 offset = 0;
+  EXPECT_FALSE(sendMsg->GetMetaDataElement("Offset", width));
+  EXPECT_TRUE(sendMsg->GetMetaDataElement("Offset", offset));
+  EXPECT_EQ(offset, -9223372036854775807LL - 1);
+  EXPECT_FALSE(sendMsg->GetMetaDataElement("Patient", offset));
+
+  sendMsg->Pack();
+  int packSize = sendMsg->GetPackSize();
+  std::vector<unsigned char> packed((unsigned char*)sendMsg->GetPackPointer(),
+                                    (unsigned char*)sendMsg->GetPackPointer() + packSize);
+
+  // Setting the same values does not change the message, the cached meta data are packed again.
+  sendMsg->SetMetaDataElement("Width", (igtl_uint32)640);
+  sendMsg->SetMetaDataElement("Patient", IANA_TYPE_UTF_8, "Doe");
+  sendMsg->SetStatusString("OK");
+  sendMsg->Pack();
+  sendMsg->SetMetaDataElement("Width", (igtl_uint32)640);
+  sendMsg->Pack();
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), sendMsg->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  igtl::StatusMessage::Pointer receiveMsg = igtl::StatusMessage::New();
+  receiveMsg->SetMessageHeader(header);
+  receiveMsg->AllocatePack();
+  memcpy(receiveMsg->GetPackBodyPointer(), sendMsg->GetPackBodyPointer(), sendMsg->GetPackBodySize());
+  EXPECT_TRUE(receiveMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_EQ(receiveMsg->GetMetaData().size(), 5u);
+  igtl::MessageBase::MetaDataMap::const_iterator it = receiveMsg->GetMetaData().begin();
+  EXPECT_EQ(it->first, "Gain");
+  EXPECT_EQ(it->second.second, "1.5");
+  double gain = 0.0;
+  EXPECT_TRUE(receiveMsg->GetMetaDataElement("Gain", gain));
+  EXPECT_DOUBLE_EQ(gain, 1.5);
+  EXPECT_TRUE(receiveMsg->GetMetaDataElement("Width", width));
+  EXPECT_EQ(width, 640u);
+  IANA_ENCODING_TYPE encoding;
+  EXPECT_TRUE(receiveMsg->GetMetaDataElement("Patient", encoding, text));
+  EXPECT_EQ(encoding, IANA_TYPE_UTF_8);
+  EXPECT_EQ(text, "Doe");
+
+  // Changing an element repacks the meta data.
+  EXPECT_TRUE(sendMsg->RemoveMetaDataElement("Gain"));
+  EXPECT_FALSE(sendMsg->RemoveMetaDataElement("Gain"));
+  sendMsg->SetStatusString("");
+  sendMsg->Pack();
+  EXPECT_LT(sendMsg->GetPackSize(), packSize);
+  EXPECT_EQ(sendMsg->GetMetaData().size(), 4u);
+}
+
+TEST(MessageBaseTest, UnpackHeaderAndMetaDataFormatVersion2)
+{
+  igtl::StatusMessage::Pointer sendMsg = igtl::StatusMessage::New();
+  sendMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  sendMsg->SetDeviceName("Device");
+  sendMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+  sendMsg->SetStatusString("Ready");
+  sendMsg->SetMetaDataElement("Route", IANA_TYPE_US_ASCII, "Tracker");
+  sendMsg->SetMetaDataElement("Sequence", (igtl_uint32)12);
+  sendMsg->Pack();
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), sendMsg->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  igtl::StatusMessage::Pointer receiveMsg = igtl::StatusMessage::New();
+  receiveMsg->SetMessageHeader(header);
+  receiveMsg->AllocatePack();
+  memcpy(receiveMsg->GetPackBodyPointer(), sendMsg->GetPackBodyPointer(), sendMsg->GetPackBodySize());
+
+  // The meta data are available without the content.
+  int r = receiveMsg->UnpackHeaderAndMetaData(1);
+  EXPECT_EQ(r, (int)igtl::MessageBase::UNPACK_META_DATA);
+  EXPECT_STREQ(receiveMsg->GetDeviceName(), "Device");
+  EXPECT_STREQ(receiveMsg->GetStatusString(), "");
+  std::string route;
+  EXPECT_TRUE(receiveMsg->GetMetaDataElement("Route", route));
+  EXPECT_EQ(route, "Tracker");
+  EXPECT_EQ(receiveMsg->UnpackHeaderAndMetaData(1), (int)igtl::MessageBase::UNPACK_UNDEF);
+
+  // The content is unpacked on demand.
+  r = receiveMsg->Unpack();
+  EXPECT_EQ(r, (int)igtl::MessageBase::UNPACK_BODY);
+  EXPECT_STREQ(receiveMsg->GetStatusString(), "Ready");
+  EXPECT_EQ(receiveMsg->GetCode(), (int)igtl::StatusMessage::STATUS_OK);
+  EXPECT_EQ(receiveMsg->GetMetaData().size(), 2u);
+
+  // The meta data parsed after a full unpack, or copied before being parsed.
+  igtl::StatusMessage::Pointer fullMsg = igtl::StatusMessage::New();
+  fullMsg->SetMessageHeader(header);
+  fullMsg->AllocatePack();
+  memcpy(fullMsg->GetPackBodyPointer(), sendMsg->GetPackBodyPointer(), sendMsg->GetPackBodySize());
+  EXPECT_EQ(fullMsg->Unpack(1), (int)igtl::MessageBase::UNPACK_BODY);
+  igtl::MessageBase::Pointer clone = fullMsg->Clone();
+  igtl_uint64 sequence = 0;
+  EXPECT_TRUE(clone->GetMetaDataElement("Sequence", sequence));
+  EXPECT_EQ(sequence, 12u);
+  EXPECT_TRUE(fullMsg->GetMetaDataElement("Sequence", sequence));
+  fullMsg->SetStatusString("Done");
+  fullMsg->Pack();
+  EXPECT_EQ(fullMsg->GetMetaData().size(), 2u);
+
+  // A corrupted body is not unpacked.
+  igtl::StatusMessage::Pointer corruptedMsg = igtl::StatusMessage::New();
+  corruptedMsg->SetMessageHeader(header);
+  corruptedMsg->AllocatePack();
+  memcpy(corruptedMsg->GetPackBodyPointer(), sendMsg->GetPackBodyPointer(), sendMsg->GetPackBodySize());
+  ((unsigned char*)corruptedMsg->GetPackBodyPointer())[sendMsg->GetPackBodySize() - 1] ^= 0xFF;
+  EXPECT_EQ(corruptedMsg->UnpackHeaderAndMetaData(1), (int)igtl::MessageBase::UNPACK_UNDEF);
+  EXPECT_EQ(corruptedMsg->GetMetaData().size(), 0u);
+}
+
+// Received message whose meta data are read by several threads
+struct MetaDataReaders
+{
+  const igtl::MessageBase* message;
+  bool                     valid[4];
+};
+
+void* ReadMetaData(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  MetaDataReaders* readers = static_cast<MetaDataReaders*>(info->UserData);
+  igtl_uint64 sequence = 0;
+  std::string route;
+  bool valid = true;
+  for (int i = 0; i < 100; i ++)
+    {
+    valid = valid && readers->message->GetMetaDataElement("Sequence", sequence) && sequence == 12 &&
+            readers->message->GetMetaDataElement("Route", route) && route == "Tracker";
+    }
+  readers->valid[info->ThreadID] = valid;
+  return NULL;
+}
+
+TEST(MessageBaseTest, ConcurrentMetaDataReadersFormatVersion2)
+{
+  igtl::StatusMessage::Pointer sendMsg = igtl::StatusMessage::New();
+  sendMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  sendMsg->SetDeviceName("Device");
+  sendMsg->SetMetaDataElement("Route", IANA_TYPE_US_ASCII, "Tracker");
+  sendMsg->SetMetaDataElement("Sequence", (igtl_uint32)12);
+  sendMsg->Pack();
+
+  igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+  header->InitPack();
+  memcpy(header->GetPackPointer(), sendMsg->GetPackPointer(), IGTL_HEADER_SIZE);
+  header->Unpack();
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SetNumberOfThreads(4);
+  for (int n = 0; n < 20; n ++)
+    {
+    // The meta data are parsed by the first reader, while the others wait.
+    igtl::StatusMessage::Pointer receiveMsg = igtl::StatusMessage::New();
+    receiveMsg->SetMessageHeader(header);
+    receiveMsg->AllocatePack();
+    memcpy(receiveMsg->GetPackBodyPointer(), sendMsg->GetPackBodyPointer(), sendMsg->GetPackBodySize());
+    ASSERT_EQ(receiveMsg->Unpack(1), (int)igtl::MessageBase::UNPACK_BODY);
+    MetaDataReaders readers;
+    readers.message = receiveMsg.GetPointer();
+    threader->SetSingleMethod((igtl::ThreadFunctionType)&ReadMetaData, &readers);
+    threader->SingleMethodExecute();
+    for (int i = 0; i < 4; i ++)
+      {
+      EXPECT_TRUE(readers.valid[i]);
+      }
+    EXPECT_EQ(receiveMsg->GetMetaData().size(), 2u);
+    }
+}
+#endif
 
 int main(int argc, char **argv)
 {
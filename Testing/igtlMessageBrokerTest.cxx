@@ -0,0 +1,174 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageBroker.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlOSUtil.h"
+#include "igtlTransformMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <vector>
+
+// Waits until the broker has the number of clients, up to 5 s.
+bool WaitForClients(igtl::MessageBroker* broker, int n)
+{
+  for (int i = 0; i < 500; i++)
+    {
+    if (broker->GetNumberOfClients() == n)
+      {
+      return true;
+      }
+    igtl::Sleep(10);
+    }
+  return false;
+}
+
+igtl::ClientSocket::Pointer Connect(igtl::MessageBroker* broker)
+{
+  igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+  if (socket->ConnectToServer("127.0.0.1", broker->GetPort()) != 0)
+    {
+    return NULL;
+    }
+  socket->SetReceiveTimeout(5000);
+  return socket;
+}
+
+// Receives a whole message (header in network byte order).
+bool ReceivePacked(igtl::ClientSocket* socket, std::vector<igtl_uint8>& buffer)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+    {
+    return false;
+    }
+  buffer.assign((igtl_uint8*)headerMsg->GetPackPointer(), (igtl_uint8*)headerMsg->GetPackPointer() + IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  int bodySize = headerMsg->GetBodySizeToRead();
+  buffer.resize(IGTL_HEADER_SIZE + bodySize);
+  return bodySize == 0 || socket->Receive(&buffer[IGTL_HEADER_SIZE], bodySize) == bodySize;
+}
+
+igtl::TransformMessage::Pointer CreateTransform(const char* name, float x)
+{
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName(name);
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+  matrix[0][3] = x;
+  transformMsg->SetMatrix(matrix);
+  transformMsg->Pack();
+  return transformMsg;
+}
+
+TEST(MessageBrokerTest, FanOutAndCache)
+{
+  igtl::MessageBroker::Pointer broker = igtl::MessageBroker::New();
+  ASSERT_EQ(broker->Start(0), 1);
+  EXPECT_TRUE(broker->IsRunning());
+
+  igtl::ClientSocket::Pointer producer = Connect(broker);
+  igtl::ClientSocket::Pointer consumer1 = Connect(broker);
+  igtl::ClientSocket::Pointer consumer2 = Connect(broker);
+  ASSERT_TRUE(producer.IsNotNull() && consumer1.IsNotNull() && consumer2.IsNotNull());
+  ASSERT_TRUE(WaitForClients(broker, 3));
+
+  // Relayed as sent to the consumers
+  igtl::TransformMessage::Pointer transformMsg = CreateTransform("Tracker", 1.0f);
+  ASSERT_EQ(producer->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 1);
+  std::vector<igtl_uint8> buffer;
+  ASSERT_TRUE(ReceivePacked(consumer1, buffer));
+  ASSERT_EQ(buffer.size(), (size_t)transformMsg->GetPackSize());
+  EXPECT_EQ(memcmp(&buffer[0], transformMsg->GetPackPointer(), buffer.size()), 0);
+  ASSERT_TRUE(ReceivePacked(consumer2, buffer));
+  EXPECT_EQ(memcmp(&buffer[0], transformMsg->GetPackPointer(), buffer.size()), 0);
+  EXPECT_EQ(broker->GetNumberOfCachedMessages(), 1);
+
+  // Answered from the cache
+  igtl::GetTransformMessage::Pointer getTransformMsg = igtl::GetTransformMessage::New();
+  getTransformMsg->SetDeviceName("Tracker");
+  getTransformMsg->Pack();
+  ASSERT_EQ(consumer2->Send(getTransformMsg->GetPackPointer(), getTransformMsg->GetPackSize()), 1);
+  ASSERT_TRUE(ReceivePacked(consumer2, buffer));
+  ASSERT_EQ(buffer.size(), (size_t)transformMsg->GetPackSize());
+  EXPECT_EQ(memcmp(&buffer[0], transformMsg->GetPackPointer(), buffer.size()), 0);
+
+  // Published by the application
+  igtl::TransformMessage::Pointer publishedMsg = CreateTransform("Tracker", 2.0f);
+  EXPECT_EQ(broker->Publish(publishedMsg), 1);
+  ASSERT_TRUE(ReceivePacked(producer, buffer));
+  EXPECT_EQ(memcmp(&buffer[0], publishedMsg->GetPackPointer(), buffer.size()), 0);
+  ASSERT_TRUE(ReceivePacked(consumer1, buffer));
+  EXPECT_EQ(memcmp(&buffer[0], publishedMsg->GetPackPointer(), buffer.size()), 0);
+  ASSERT_TRUE(ReceivePacked(consumer2, buffer));
+
+  igtl::TransformMessage::Pointer cachedMsg = igtl::TransformMessage::New();
+  EXPECT_EQ(broker->GetCachedMessage("TRANSFORM", "Unknown", cachedMsg), 0);
+  ASSERT_EQ(broker->GetCachedMessage("TRANSFORM", "Tracker", cachedMsg), 1);
+  ASSERT_TRUE(cachedMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  igtl::Matrix4x4 matrix;
+  cachedMsg->GetMatrix(matrix);
+  EXPECT_FLOAT_EQ(matrix[0][3], 2.0f);
+  EXPECT_EQ(broker->GetNumberOfCachedMessages(), 1);
+  EXPECT_EQ(broker->GetNumberOfMessagesReceived(), 3u);
+  EXPECT_EQ(broker->GetNumberOfMessagesDropped(), 0u);
+
+  // A disconnected client is removed.
+  producer->CloseSocket();
+  EXPECT_TRUE(WaitForClients(broker, 2));
+
+  EXPECT_EQ(broker->Stop(), 1);
+  EXPECT_FALSE(broker->IsRunning());
+  EXPECT_EQ(broker->GetNumberOfClients(), 0);
+  EXPECT_EQ(broker->GetNumberOfCachedMessages(), 1);
+  consumer1->CloseSocket();
+  consumer2->CloseSocket();
+}
+
+TEST(MessageBrokerTest, DropOldest)
+{
+  igtl::MessageBroker::Pointer broker = igtl::MessageBroker::New();
+  broker->SetMaximumQueueLength(1);
+  ASSERT_EQ(broker->Start(0), 1);
+  igtl::ClientSocket::Pointer consumer = Connect(broker);
+  ASSERT_TRUE(consumer.IsNotNull());
+  ASSERT_TRUE(WaitForClients(broker, 1));
+
+  // The consumer does not read while large images are published, until the socket buffers are full.
+  int size[3] = {1024, 1024, 1};
+  for (int i = 0; i < 32; i++)
+    {
+    igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+    imageMsg->SetDeviceName("Camera");
+    imageMsg->SetDimensions(size);
+    imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+    imageMsg->AllocateScalars();
+    memset(imageMsg->GetScalarPointer(), i, imageMsg->GetImageSize());
+    imageMsg->Pack();
+    EXPECT_EQ(broker->Publish(imageMsg), 1);
+    }
+  EXPECT_GT(broker->GetNumberOfMessagesDropped(), 0u);
+  EXPECT_EQ(broker->GetNumberOfCachedMessages(), 1);
+
+  EXPECT_EQ(broker->Stop(), 1);
+  consumer->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlImageMessage.h"
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtl_util.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define DIM_I 64
+#define DIM_J 64
+#define DIM_K 16
+#define CHUNK_SIZE 16384
+
+igtl::ImageMessage::Pointer CreateImage(int headerVersion)
+{
+  igtl::ImageMessage::Pointer img = igtl::ImageMessage::New();
+  img->SetHeaderVersion(headerVersion);
+  img->SetDeviceName("Image");
+  img->SetDimensions(DIM_I, DIM_J, DIM_K);
+  img->SetScalarType(igtl::ImageMessage::TYPE_INT16);
+  img->AllocateScalars();
+  igtl_int16* scalars = (igtl_int16*)img->GetScalarPointer();
+  for (int i = 0; i < DIM_I * DIM_J * DIM_K; i ++)
+    {
+    scalars[i] = (igtl_int16)(i % 1000);
+    }
+  if (headerVersion == IGTL_HEADER_VERSION_2)
+    {
+    img->SetMetaDataElement("Modality", IANA_TYPE_US_ASCII, "CT");
+    }
+  return img;
+}
+
+// Simulates the reception of a packed message: the header, then the body.
+igtl::ImageMessage::Pointer Receive(igtl::MessageBase* msg)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  memcpy(headerMsg->GetPackPointer(), msg->GetPackPointer(), IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  igtl::ImageMessage::Pointer received = igtl::ImageMessage::New();
+  received->SetMessageHeader(headerMsg);
+  received->AllocatePack();
+  memcpy(received->GetPackBodyPointer(), (char*)msg->GetPackPointer() + IGTL_HEADER_SIZE,
+         received->GetPackBodySize());
+  return received;
+}
+
+igtl_uint64 GetPackedCRC(igtl::MessageBase* msg)
+{
+  igtl_header header;
+  memcpy(&header, msg->GetPackPointer(), IGTL_HEADER_SIZE);
+  igtl_header_convert_byte_order(&header);
+  return header.crc;
+}
+
+TEST(MessageIntegrityTest, Chunked)
+{
+  for (int version = IGTL_HEADER_VERSION_1; version <= IGTL_HEADER_VERSION_2; version ++)
+    {
+    igtl::ImageMessage::Pointer img = CreateImage(version);
+    img->SetIntegrityMode(igtl::MessageBase::INTEGRITY_CHUNKED);
+    img->SetIntegrityChunkSize(CHUNK_SIZE);
+    EXPECT_EQ(img->Pack(), 1);
+
+    // The CRC in the header is the CRC of the body, checked by any receiver.
+    EXPECT_EQ(GetPackedCRC(img),
+              crc64((unsigned char*)img->GetPackBodyPointer(), img->GetPackBodySize(), 0LL));
+    igtl::ImageMessage::Pointer received = Receive(img);
+    EXPECT_TRUE(received->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+    EXPECT_EQ(memcmp(received->GetScalarPointer(), img->GetScalarPointer(), img->GetImageSize()), 0);
+    }
+}
+
+TEST(MessageIntegrityTest, CorruptedChunks)
+{
+  igtl::ImageMessage::Pointer img = CreateImage(IGTL_HEADER_VERSION_2);
+  img->SetIntegrityMode(igtl::MessageBase::INTEGRITY_CHUNKED);
+  img->SetIntegrityChunkSize(CHUNK_SIZE);
+  img->Pack();
+
+  std::vector<int> corrupted;
+  int nChunks = (IGTL_EXTENDED_HEADER_SIZE + IGTL_IMAGE_HEADER_SIZE + img->GetImageSize() - 1) / CHUNK_SIZE + 1;
+  igtl::ImageMessage::Pointer received = Receive(img);
+  EXPECT_EQ(received->CheckIntegrityChunks(corrupted), nChunks);
+  EXPECT_TRUE(corrupted.empty());
+
+  // Corrupts the chunk 3
+  received = Receive(img);
+  ((unsigned char*)received->GetPackBodyPointer())[3 * CHUNK_SIZE + 100] ^= 0x10;
+  EXPECT_FALSE(received->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  EXPECT_EQ(received->CheckIntegrityChunks(corrupted), nChunks);
+  ASSERT_EQ(corrupted.size(), 1u);
+  EXPECT_EQ(corrupted[0], 3);
+
+  // The chunk table is removed with another mode.
+  std::string table;
+  EXPECT_TRUE(img->GetMetaDataElement(IGTL_INTEGRITY_CHUNKS, table));
+  img->SetIntegrityMode(igtl::MessageBase::INTEGRITY_CRC64);
+  img->Pack();
+  EXPECT_FALSE(img->GetMetaDataElement(IGTL_INTEGRITY_CHUNKS, table));
+  EXPECT_EQ(Receive(img)->CheckIntegrityChunks(corrupted), -1);
+}
+
+TEST(MessageIntegrityTest, None)
+{
+  // Messages with header version 2 are marked, and accepted when the CRC is checked only if
+  // the receiver accepts them.
+  igtl::ImageMessage::Pointer img = CreateImage(IGTL_HEADER_VERSION_2);
+  img->SetIntegrityMode(igtl::MessageBase::INTEGRITY_NONE);
+  img->Pack();
+  EXPECT_EQ(GetPackedCRC(img), 0u);
+  igtl::ImageMessage::Pointer received = Receive(img);
+  EXPECT_FALSE(received->GetAcceptIntegrityNone());
+  EXPECT_FALSE(received->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  received = Receive(img);
+  received->SetAcceptIntegrityNone(true);
+  EXPECT_TRUE(received->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  EXPECT_EQ(memcmp(received->GetScalarPointer(), img->GetScalarPointer(), img->GetImageSize()), 0);
+
+  // Messages with header version 1 are only accepted without CRC check.
+  img = CreateImage(IGTL_HEADER_VERSION_1);
+  img->SetIntegrityMode(igtl::MessageBase::INTEGRITY_NONE);
+  img->Pack();
+  EXPECT_EQ(GetPackedCRC(img), 0u);
+  EXPECT_FALSE(Receive(img)->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  EXPECT_TRUE(Receive(img)->Unpack(0) & igtl::MessageBase::UNPACK_BODY);
+}
+
+TEST(MessageIntegrityTest, HeaderOnlyRepack)
+{
+  igtl::ImageMessage::Pointer img = CreateImage(IGTL_HEADER_VERSION_2);
+  img->SetTimeStamp(1, 0);
+  img->Pack();
+  igtl_uint64 crc = GetPackedCRC(img);
+
+  // Packing a message whose body has not changed packs its header with the new time stamp.
+  img->SetTimeStamp(2, 0);
+  img->Pack();
+  EXPECT_EQ(GetPackedCRC(img), crc);
+  igtl::ImageMessage::Pointer received = Receive(img);
+  EXPECT_TRUE(received->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  unsigned int sec, frac;
+  received->GetTimeStamp(&sec, &frac);
+  EXPECT_EQ(sec, 2u);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,194 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageLogReader.h"
+#include "igtlMessageLogReplayer.h"
+#include "igtlMessageLogWriter.h"
+#include "igtlClientSocket.h"
+#include "igtlServerSocket.h"
+#include "igtlStatusMessage.h"
+#include "igtlTimeStamp.h"
+#include "igtlTransformMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <cstdio>
+#include <vector>
+
+#define MS 1000000ULL
+
+const char* logFileName = "igtlMessageLogTest.igtllog";
+const char* truncatedLogFileName = "igtlMessageLogTestTruncated.igtllog";
+igtl_uint64 startTime = 1000000 * MS;
+
+// Records 10 messages, alternately from two trackers, one per period, then a status message.
+void WriteLog(const char* filename, igtl_uint64 period)
+{
+  igtl::MessageLogWriter::Pointer writer = igtl::MessageLogWriter::New();
+  ASSERT_EQ(writer->Open(filename), 1);
+  for (int i = 0; i < 10; i++)
+    {
+    igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+    transformMsg->SetDeviceName(i % 2 == 0 ? "Tracker0" : "Tracker1");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    matrix[0][3] = (float)i;
+    transformMsg->SetMatrix(matrix);
+    transformMsg->Pack();
+    EXPECT_EQ(writer->Write(transformMsg, startTime + i * period), 1);
+    }
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("StatusDeviceNameOf20");
+  statusMsg->SetStatusString("Done");
+  statusMsg->Pack();
+  // Earlier than the previous message, recorded as the previous one
+  EXPECT_EQ(writer->Write(statusMsg, startTime), 1);
+  EXPECT_EQ(writer->GetNumberOfMessages(), 11);
+  EXPECT_EQ(writer->Close(), 1);
+}
+
+TEST(MessageLogTest, WriteAndRead)
+{
+  WriteLog(logFileName, 10 * MS);
+
+  igtl::MessageLogReader::Pointer reader = igtl::MessageLogReader::New();
+  ASSERT_EQ(reader->Open(logFileName), 1);
+  EXPECT_TRUE(reader->IsIndexed());
+  ASSERT_EQ(reader->GetNumberOfMessages(), 11);
+  EXPECT_EQ(reader->GetArrivalTime(3), startTime + 30 * MS);
+  EXPECT_EQ(reader->GetArrivalTime(10), startTime + 90 * MS);
+  EXPECT_EQ(reader->GetMessageType(1), "TRANSFORM");
+  EXPECT_EQ(reader->GetDeviceName(1), "Tracker1");
+  EXPECT_EQ(reader->GetMessageType(10), "STATUS");
+  EXPECT_EQ(reader->GetDeviceName(10), "StatusDeviceNameOf20");
+  EXPECT_EQ(reader->GetMessageSize(0), IGTL_HEADER_SIZE + 48);
+  EXPECT_TRUE(reader->GetMessagePointer(11) == NULL);
+
+  EXPECT_EQ(reader->FindMessage(0), 0);
+  EXPECT_EQ(reader->FindMessage(startTime + 30 * MS), 3);
+  EXPECT_EQ(reader->FindMessage(startTime + 31 * MS), 4);
+  EXPECT_EQ(reader->FindMessage(startTime + 90 * MS), 9);
+  EXPECT_EQ(reader->FindMessage(startTime + 91 * MS), 11);
+  EXPECT_EQ(reader->FindMessage(startTime + 31 * MS, "TRANSFORM", "Tracker0"), 4);
+  EXPECT_EQ(reader->FindMessage(startTime + 31 * MS, "TRANSFORM", "Tracker1"), 5);
+  EXPECT_EQ(reader->FindMessage(startTime + 81 * MS, "TRANSFORM", "Tracker0"), 11);
+  EXPECT_EQ(reader->FindMessage(0, "STATUS", "StatusDeviceNameOf20"), 10);
+  EXPECT_EQ(reader->FindMessage(0, "STATUS", "Tracker0"), 11);
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  ASSERT_EQ(reader->ReadMessage(7, transformMsg), 1);
+  EXPECT_STREQ(transformMsg->GetDeviceName(), "Tracker1");
+  ASSERT_TRUE(transformMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  igtl::Matrix4x4 matrix;
+  transformMsg->GetMatrix(matrix);
+  EXPECT_FLOAT_EQ(matrix[0][3], 7.0f);
+  EXPECT_EQ(memcmp(transformMsg->GetPackBodyPointer(), (const char*)reader->GetMessagePointer(7) + IGTL_HEADER_SIZE,
+                   transformMsg->GetPackBodySize()), 0);
+  reader->Close();
+  EXPECT_FALSE(reader->IsOpen());
+  EXPECT_EQ(reader->Open("igtlMessageLogTestMissing.igtllog"), 0);
+  remove(logFileName);
+}
+
+TEST(MessageLogTest, RebuildIndex)
+{
+  WriteLog(logFileName, 10 * MS);
+
+  // Cut the log in the middle of the last record, as if the recording was interrupted.
+  std::vector<char> data;
+  FILE* file = fopen(logFileName, "rb");
+  ASSERT_TRUE(file != NULL);
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+    data.insert(data.end(), buffer, buffer + n);
+    }
+  fclose(file);
+  size_t indexSize = 11 * IGTL_MESSAGE_LOG_INDEX_ENTRY_SIZE + IGTL_MESSAGE_LOG_TRAILER_SIZE;
+  ASSERT_GT(data.size(), indexSize + 10);
+  file = fopen(truncatedLogFileName, "wb");
+  ASSERT_TRUE(file != NULL);
+  fwrite(&data[0], 1, data.size() - indexSize - 10, file);
+  fclose(file);
+
+  igtl::MessageLogReader::Pointer reader = igtl::MessageLogReader::New();
+  ASSERT_EQ(reader->Open(truncatedLogFileName), 1);
+  EXPECT_FALSE(reader->IsIndexed());
+  ASSERT_EQ(reader->GetNumberOfMessages(), 10);
+  EXPECT_EQ(reader->GetDeviceName(9), "Tracker1");
+  EXPECT_EQ(reader->FindMessage(startTime + 45 * MS), 5);
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  ASSERT_EQ(reader->ReadMessage(9, transformMsg), 1);
+  EXPECT_TRUE(transformMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  reader->Close();
+  remove(truncatedLogFileName);
+  remove(logFileName);
+}
+
+TEST(MessageLogTest, Replay)
+{
+  WriteLog(logFileName, 5 * MS);
+  igtl::MessageLogReader::Pointer reader = igtl::MessageLogReader::New();
+  ASSERT_EQ(reader->Open(logFileName), 1);
+
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::MessageLogReplayer::Pointer replayer = igtl::MessageLogReplayer::New();
+  EXPECT_EQ(replayer->Replay(), -1);
+  replayer->SetReader(reader);
+  replayer->SetSocket(socket);
+
+  // The messages from 20 ms to 40 ms are sent with their original intervals.
+  igtl_uint64 start = igtl::TimeStamp::GetMonotonicTimeInNanoseconds();
+  EXPECT_EQ(replayer->Replay(startTime + 20 * MS, startTime + 41 * MS), 5);
+  igtl_uint64 elapsed = igtl::TimeStamp::GetMonotonicTimeInNanoseconds() - start;
+  EXPECT_GE(elapsed, 20 * MS);
+
+  for (int i = 4; i <= 8; i++)
+    {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitPack();
+    ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+    headerMsg->Unpack();
+    igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+    transformMsg->SetMessageHeader(headerMsg);
+    transformMsg->AllocatePack();
+    ASSERT_EQ(clientSocket->Receive(transformMsg->GetPackBodyPointer(), transformMsg->GetPackBodySize()), transformMsg->GetPackBodySize());
+    ASSERT_TRUE(transformMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+    igtl::Matrix4x4 matrix;
+    transformMsg->GetMatrix(matrix);
+    EXPECT_FLOAT_EQ(matrix[0][3], (float)i);
+    }
+
+  // As fast as possible
+  replayer->SetSpeed(0.0);
+  EXPECT_EQ(replayer->Replay(), 11);
+
+  socket->CloseSocket();
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+  reader->Close();
+  remove(logFileName);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
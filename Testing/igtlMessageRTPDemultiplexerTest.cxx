@@ -0,0 +1,123 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageRTPDemultiplexer.h"
+#include "igtlImageMessage.h"
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define NUMBER_OF_SENDERS 8
+int   imageSize[3] = {100, 100, 1}; // 10000 bytes, fragmented into several packets
+int   payloadLength = 1300;
+
+#if OpenIGTLink_PROTOCOL_VERSION >= 3
+#include "igtlMessageFormat2TestMacro.h"
+
+// Every sender sends an image with the same device name and message ID, filled with its own SSRC.
+void WrapImageOfSender(igtl_uint32 ssrc, igtl::ImageMessage::Pointer& imageMsg, igtl::PacketBuffer& packets)
+{
+  imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetDeviceName("Imager");
+  imageMsg->SetDimensions(imageSize);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->SetMessageID(1);
+  imageMsg->AllocateScalars();
+  memset(imageMsg->GetScalarPointer(), (int)ssrc, imageMsg->GetImageSize());
+  imageMsg->Pack();
+  igtl::MessageRTPWrapper::Pointer wrapper = igtl::MessageRTPWrapper::New();
+  wrapper->SetRTPPayloadLength(payloadLength);
+  wrapper->SetSSRC(ssrc);
+  wrapper->WrapMessageAndPushToBuffer((igtl_uint8*)imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+  packets = wrapper->GetOutGoingPackets();
+}
+
+TEST(MessageRTPDemultiplexerTest, InterleavedSendersFormatVersion2)
+{
+  igtl::ImageMessage::Pointer imageMsgs[NUMBER_OF_SENDERS];
+  igtl::PacketBuffer packets[NUMBER_OF_SENDERS];
+  for (int i = 0; i < NUMBER_OF_SENDERS; i++)
+  {
+    WrapImageOfSender(i+1, imageMsgs[i], packets[i]);
+    ASSERT_GT(packets[i].pPacketLengthInByte.size(), 2);
+  }
+
+  igtl::MessageRTPDemultiplexer::Pointer demultiplexer = igtl::MessageRTPDemultiplexer::New();
+  demultiplexer->SetRTPPayloadLength(payloadLength);
+  demultiplexer->SetNumberOfThreads(4);
+  // Interleave the packets of all the senders, as they would arrive on a shared port.
+  int numberOfPackets = 0;
+  igtlUint8* packetPointers[NUMBER_OF_SENDERS];
+  for (int i = 0; i < NUMBER_OF_SENDERS; i++)
+  {
+    packetPointers[i] = packets[i].pBsBuf.data();
+  }
+  for (unsigned int j = 0; j < packets[0].pPacketLengthInByte.size(); j++)
+  {
+    for (int i = 0; i < NUMBER_OF_SENDERS; i++)
+    {
+      EXPECT_EQ(demultiplexer->PushDataIntoPacketBuffer(packetPointers[i], packets[i].pPacketLengthInByte[j]), 1);
+      packetPointers[i] += packets[i].pPacketLengthInByte[j];
+      numberOfPackets++;
+    }
+  }
+  EXPECT_EQ(demultiplexer->GetNumberOfContexts(), NUMBER_OF_SENDERS);
+  EXPECT_EQ(demultiplexer->UnWrapPacketsWithTypeAndName("IMAGE", "Imager"), numberOfPackets);
+  EXPECT_EQ(demultiplexer->UnWrapPacketsWithTypeAndName("IMAGE", "Imager"), 0);
+
+  std::vector<igtl_uint32> ssrcs;
+  demultiplexer->GetSSRCs(ssrcs);
+  ASSERT_EQ(ssrcs.size(), NUMBER_OF_SENDERS);
+  for (int i = 0; i < NUMBER_OF_SENDERS; i++)
+  {
+    EXPECT_EQ(ssrcs[i], i+1);
+    igtl::MessageRTPWrapper::Pointer context = demultiplexer->GetContext(i+1);
+    ASSERT_TRUE(context.IsNotNull());
+    ASSERT_EQ(context->unWrappedMessages.size(), 1);
+    igtl::UnWrappedMessage* message = context->unWrappedMessages.begin()->second;
+    ASSERT_EQ(message->messageDataLength, imageMsgs[i]->GetPackSize());
+    int r = memcmp(message->messagePackPointer + IGTL_HEADER_SIZE + IGTL_EXTENDED_HEADER_SIZE,
+                   (const char*)imageMsgs[i]->GetPackPointer() + IGTL_HEADER_SIZE + IGTL_EXTENDED_HEADER_SIZE,
+                   imageMsgs[i]->GetPackSize() - IGTL_HEADER_SIZE - IGTL_EXTENDED_HEADER_SIZE);
+    EXPECT_EQ(r, 0);
+  }
+}
+
+TEST(MessageRTPDemultiplexerTest, ContextsFormatVersion2)
+{
+  igtl::ImageMessage::Pointer imageMsg;
+  igtl::PacketBuffer packets;
+  WrapImageOfSender(42, imageMsg, packets);
+  igtl::MessageRTPDemultiplexer::Pointer demultiplexer = igtl::MessageRTPDemultiplexer::New();
+  demultiplexer->SetNumberOfThreads(0);
+  EXPECT_EQ(demultiplexer->GetNumberOfThreads(), 1);
+  EXPECT_EQ(demultiplexer->UnWrapPacketsWithTypeAndName("IMAGE", "Imager"), 0);
+  EXPECT_TRUE(demultiplexer->GetContext(42).IsNull());
+  // A packet shorter than the RTP header is rejected.
+  EXPECT_EQ(demultiplexer->PushDataIntoPacketBuffer(packets.pBsBuf.data(), RTP_HEADER_LENGTH-1), 0);
+  EXPECT_EQ(demultiplexer->GetNumberOfContexts(), 0);
+  EXPECT_EQ(demultiplexer->PushDataIntoPacketBuffer(packets.pBsBuf.data(), packets.pPacketLengthInByte[0]), 1);
+  EXPECT_TRUE(demultiplexer->GetContext(42).IsNotNull());
+  EXPECT_EQ(demultiplexer->RemoveContext(42), 1);
+  EXPECT_EQ(demultiplexer->RemoveContext(42), 0);
+  EXPECT_EQ(demultiplexer->GetNumberOfContexts(), 0);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
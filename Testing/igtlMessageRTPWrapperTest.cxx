@@ -13,6 +13,10 @@
 
 #include "igtlMessageRTPWrapper.h"
 #include "igtlImageMessage.h"
+#include "igtlTrackingDataMessage.h"
+#include "igtlUDPServerSocket.h"
+#include "igtlUDPClientSocket.h"
+#include "igtlOSUtil.h"
 #include "igtlutil/igtl_test_data_rtpwrapper.h"
 #include "igtlMessageDebugFunction.h"
 #include "igtl_types.h"
@@ -21,6 +25,7 @@
 #include "igtl_util.h"
 #include "igtlTestConfig.h"
 #include "string.h"
+#include <set>
 
 igtl::ImageMessage::Pointer imageSendMsg = igtl::ImageMessage::New();
 igtl::ImageMessage::Pointer imageReceiveMsg = igtl::ImageMessage::New();
@@ -219,6 +224,219 @@ TEST(MessageRTPWrapperTest, UnwrapMessageFormatVersion2)
   r = memcmp((const char*)imageReceiveMsg->GetPackBodyPointer() + IGTL_IMAGE_HEADER_SIZE + IGTL_EXTENDED_HEADER_SIZE, (const void*)(test_image), (size_t)(TEST_IMAGE_MESSAGE_SIZE));
   EXPECT_EQ(r, 0);
 }
+
+// Loss injection harness running on loopback. The data channel goes from the sender to the receiver,
+// the feedback channel carries the NACK packets back to the sender. Packets listed in droppedPackets
+// are never written to the data channel.
+class LossyLoopbackChannel
+{
+public:
+  LossyLoopbackChannel(int dataPort, int feedbackPort)
+  {
+    dataSender = igtl::UDPServerSocket::New();
+    dataSender->CreateUDPServer();
+    dataSender->AddClient("127.0.0.1", dataPort, 1);
+    dataReceiver = igtl::UDPClientSocket::New();
+    dataReceiver->JoinNetwork("127.0.0.1", dataPort);
+    dataReceiver->SetReceiveTimeout(1000);
+    feedbackSender = igtl::UDPServerSocket::New();
+    feedbackSender->CreateUDPServer();
+    feedbackSender->AddClient("127.0.0.1", feedbackPort, 1);
+    feedbackReceiver = igtl::UDPClientSocket::New();
+    feedbackReceiver->JoinNetwork("127.0.0.1", feedbackPort);
+    feedbackReceiver->SetReceiveTimeout(50);
+  };
+  ~LossyLoopbackChannel()
+  {
+    dataSender->CloseSocket();
+    dataReceiver->CloseSocket();
+    feedbackSender->CloseSocket();
+    feedbackReceiver->CloseSocket();
+  };
+  int SendPackets(igtl::PacketBuffer& packets, const std::set<int>& droppedPackets)
+  {
+    int numberOfSentPackets = 0;
+    igtlUint8* UDPPacket = packets.pBsBuf.data();
+    for (unsigned int i = 0; i < packets.pPacketLengthInByte.size(); i++)
+    {
+      if (droppedPackets.find(i) == droppedPackets.end())
+      {
+        dataSender->WriteSocket(UDPPacket, packets.pPacketLengthInByte[i]);
+        numberOfSentPackets++;
+      }
+      UDPPacket += packets.pPacketLengthInByte[i];
+    }
+    return numberOfSentPackets;
+  };
+  // Reads numberOfPackets packets from the data channel and unwraps them, returns the number of packets read.
+  int ReceivePackets(igtl::MessageRTPWrapper::Pointer& receiver, int numberOfPackets, const char* deviceType, const char* deviceName)
+  {
+    unsigned char buffer[RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH];
+    int i = 0;
+    for (; i < numberOfPackets; i++)
+    {
+      int length = dataReceiver->ReadSocket(buffer, RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH);
+      if (length <= 0)
+      {
+        break;
+      }
+      receiver->PushDataIntoPacketBuffer(buffer, length);
+      while (receiver->UnWrapPacketWithTypeAndName(deviceType, deviceName));
+    }
+    return i;
+  };
+  // Delivers the pending NACK packets to the sender, returns the number of resent packets.
+  int ForwardNACKs(igtl::MessageRTPWrapper::Pointer& sender)
+  {
+    unsigned char buffer[RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH];
+    int numberOfResentPackets = 0;
+    int length = 0;
+    while ((length = feedbackReceiver->ReadSocket(buffer, RTP_PAYLOAD_LENGTH+RTP_HEADER_LENGTH)) > 0)
+    {
+      int r = sender->ProcessNACKPacket(dataSender, buffer, length);
+      if (r > 0)
+      {
+        numberOfResentPackets += r;
+      }
+    }
+    return numberOfResentPackets;
+  };
+  igtl::UDPServerSocket::Pointer dataSender;
+  igtl::UDPClientSocket::Pointer dataReceiver;
+  igtl::UDPServerSocket::Pointer feedbackSender;
+  igtl::UDPClientSocket::Pointer feedbackReceiver;
+};
+
+TEST(MessageRTPWrapperTest, NACKRetransmissionFormatVersion2)
+{
+  BuildUp();
+  igtl::MessageRTPWrapper::Pointer sender = igtl::MessageRTPWrapper::New();
+  sender->SetRTPPayloadLength(UDPPacketLength);
+  sender->SetSeqNum(0);
+  sender->SetSSRC(0x12345678);
+  sender->SetRetransmitCacheSize(64);
+  sender->WrapMessageAndPushToBuffer((igtl_uint8*)imageSendMsg->GetPackPointer(), imageSendMsg->GetPackSize());
+  igtl::PacketBuffer packets = sender->GetOutGoingPackets();
+  int numberOfPackets = packets.pPacketLengthInByte.size();
+  ASSERT_GE(numberOfPackets, 3);
+
+  igtl::MessageRTPWrapper::Pointer receiver = igtl::MessageRTPWrapper::New();
+  receiver->SetRTPPayloadLength(UDPPacketLength);
+  receiver->SetNACKEnabled(true);
+  receiver->SetMessageDeadline(2000000000); // generous, the timing is not tested here
+
+  LossyLoopbackChannel channel(18950, 18951);
+  std::set<int> droppedPackets;
+  droppedPackets.insert(1);
+  EXPECT_EQ(channel.SendPackets(packets, droppedPackets), numberOfPackets-1);
+  EXPECT_EQ(channel.ReceivePackets(receiver, numberOfPackets-1, "IMAGE", "DeviceName"), numberOfPackets-1);
+  EXPECT_EQ(receiver->unWrappedMessages.size(), 0);
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 1);
+
+  EXPECT_EQ(receiver->SendNACK(channel.feedbackSender), 1);
+  // The missing packet was requested just now, no new NACK before the retry interval.
+  EXPECT_EQ(receiver->SendNACK(channel.feedbackSender), 0);
+  EXPECT_EQ(channel.ForwardNACKs(sender), 1);
+  EXPECT_EQ(sender->GetNumberOfRetransmittedPackets(), 1);
+  EXPECT_EQ(channel.ReceivePackets(receiver, 1, "IMAGE", "DeviceName"), 1);
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 0);
+  ASSERT_EQ(receiver->unWrappedMessages.size(), 1);
+
+  igtl::UnWrappedMessage* message = receiver->unWrappedMessages.begin()->second;
+  ASSERT_EQ(message->messageDataLength, imageSendMsg->GetPackSize());
+  int r = memcmp(message->messagePackPointer + IGTL_HEADER_SIZE + IGTL_EXTENDED_HEADER_SIZE,
+                 (const char*)imageSendMsg->GetPackPointer() + IGTL_HEADER_SIZE + IGTL_EXTENDED_HEADER_SIZE,
+                 imageSendMsg->GetPackSize() - IGTL_HEADER_SIZE - IGTL_EXTENDED_HEADER_SIZE);
+  EXPECT_EQ(r, 0);
+
+  // A duplicated packet is dropped and doesn't start a new message.
+  receiver->PushDataIntoPacketBuffer(packets.pBsBuf.data(), packets.pPacketLengthInByte[0]);
+  EXPECT_EQ(receiver->UnWrapPacketWithTypeAndName("IMAGE", "DeviceName"), 1);
+  EXPECT_EQ(receiver->unWrappedMessages.size(), 1);
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 0);
+}
+
+TEST(MessageRTPWrapperTest, NACKMessageDeadlineFormatVersion2)
+{
+  BuildUp();
+  igtl::PacketBuffer packets = messageWrapperSenderSide->GetOutGoingPackets();
+  int numberOfPackets = packets.pPacketLengthInByte.size();
+  ASSERT_GE(numberOfPackets, 3);
+  igtl::MessageRTPWrapper::Pointer receiver = igtl::MessageRTPWrapper::New();
+  receiver->SetRTPPayloadLength(UDPPacketLength);
+  receiver->SetNACKEnabled(true);
+  receiver->SetMessageDeadline(1000000); // 1 ms
+  std::vector<igtlUint8*> packetPointers;
+  igtlUint8* UDPPacket = packets.pBsBuf.data();
+  for (int i = 0; i < numberOfPackets; i++)
+  {
+    packetPointers.push_back(UDPPacket);
+    UDPPacket += packets.pPacketLengthInByte[i];
+  }
+  for (int i = 0; i < numberOfPackets; i++)
+  {
+    if (i != 1)
+    {
+      receiver->PushDataIntoPacketBuffer(packetPointers[i], packets.pPacketLengthInByte[i]);
+      receiver->UnWrapPacketWithTypeAndName("IMAGE", "DeviceName");
+    }
+  }
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 1);
+  igtl::Sleep(10);
+  // The stale packet is not requested anymore and the incomplete message is given up.
+  igtl::UDPServerSocket::Pointer feedbackSocket = igtl::UDPServerSocket::New();
+  EXPECT_EQ(receiver->SendNACK(feedbackSocket), 0);
+  receiver->PushDataIntoPacketBuffer(packetPointers[1], packets.pPacketLengthInByte[1]);
+  receiver->UnWrapPacketWithTypeAndName("IMAGE", "DeviceName");
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 0);
+  EXPECT_EQ(receiver->GetNumberOfAbandonedPackets(), 1);
+  EXPECT_EQ(receiver->unWrappedMessages.size(), 0);
+}
+
+TEST(MessageRTPWrapperTest, NACKTrackingDataLossFormatVersion2)
+{
+  const int numberOfMessages = 20;
+  igtl::MessageRTPWrapper::Pointer sender = igtl::MessageRTPWrapper::New();
+  sender->SetSSRC(1);
+  sender->SetRetransmitCacheSize(numberOfMessages);
+  igtl::TrackingDataMessage::Pointer trackingMsg = igtl::TrackingDataMessage::New();
+  trackingMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  trackingMsg->SetDeviceName("Tracker");
+  igtl::TrackingDataElement::Pointer trackElement = igtl::TrackingDataElement::New();
+  trackElement->SetName("Channel 0");
+  trackElement->SetType(igtl::TrackingDataElement::TYPE_TRACKER);
+  trackElement->SetMatrix(inMatrix);
+  trackingMsg->AddTrackingDataElement(trackElement);
+  for (int i = 0; i < numberOfMessages; i++)
+  {
+    trackingMsg->SetMessageID(i+1);
+    trackingMsg->Pack();
+    sender->WrapMessageAndPushToBuffer((igtl_uint8*)trackingMsg->GetPackPointer(), trackingMsg->GetPackSize());
+  }
+  igtl::PacketBuffer packets = sender->GetOutGoingPackets();
+  ASSERT_EQ(packets.pPacketLengthInByte.size(), numberOfMessages);
+
+  LossyLoopbackChannel channel(18952, 18953);
+  igtl::MessageRTPWrapper::Pointer receiver = igtl::MessageRTPWrapper::New();
+  receiver->SetNACKEnabled(true);
+  receiver->SetMessageDeadline(2000000000);
+  // NACKs are sent by the receiver as soon as a gap is detected.
+  receiver->SetFeedbackSocket(channel.feedbackSender);
+  std::set<int> droppedPackets;
+  for (int i = 1; i < numberOfMessages; i += 4)
+  {
+    droppedPackets.insert(i);
+  }
+  int numberOfSentPackets = channel.SendPackets(packets, droppedPackets);
+  EXPECT_EQ(channel.ReceivePackets(receiver, numberOfSentPackets, "TDATA", "Tracker"), numberOfSentPackets);
+  EXPECT_EQ(receiver->unWrappedMessages.size(), numberOfSentPackets);
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), droppedPackets.size());
+
+  EXPECT_EQ(channel.ForwardNACKs(sender), droppedPackets.size());
+  EXPECT_EQ(channel.ReceivePackets(receiver, droppedPackets.size(), "TDATA", "Tracker"), droppedPackets.size());
+  EXPECT_EQ(receiver->GetNumberOfMissingPackets(), 0);
+  EXPECT_EQ(receiver->unWrappedMessages.size(), numberOfMessages);
+}
 #endif
 
 int main(int argc, char **argv)
@@ -0,0 +1,159 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageReader.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlMultiThreader.h"
+#include "igtlServerSocket.h"
+#include "igtlStatusMessage.h"
+#include "igtlTransformMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define NUMBER_OF_TRANSFORMS 1000
+
+void* SendMessages(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  igtl::Socket* socket = static_cast<igtl::Socket*>(info->UserData);
+
+  // The transforms are sent at once, as a burst from a tracker.
+  std::vector<char> burst;
+  for (int i = 0; i < NUMBER_OF_TRANSFORMS; i++)
+    {
+    igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+    transformMsg->SetDeviceName(i % 2 == 0 ? "Tool0" : "Tool1");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    matrix[0][3] = (float)i;
+    transformMsg->SetMatrix(matrix);
+    transformMsg->Pack();
+    const char* packed = (const char*)transformMsg->GetPackPointer();
+    burst.insert(burst.end(), packed, packed + transformMsg->GetPackSize());
+    }
+  socket->Send(&burst[0], burst.size());
+
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {512, 512, 4};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  for (int i = 0; i < imageMsg->GetImageSize(); i++)
+    {
+    ((unsigned char*)imageMsg->GetScalarPointer())[i] = (unsigned char)(i * 3);
+    }
+  imageMsg->Pack();
+  socket->Send(imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("Server");
+  statusMsg->SetStatusString("Done");
+  statusMsg->Pack();
+  socket->Send(statusMsg->GetPackPointer(), statusMsg->GetPackSize());
+  socket->Send(imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+  socket->Send(statusMsg->GetPackPointer(), statusMsg->GetPackSize());
+  return NULL;
+}
+
+TEST(MessageReaderTest, ReadBufferedMessages)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  clientSocket->SetReceiveTimeout(5000);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  int threadID = threader->SpawnThread((igtl::ThreadFunctionType)&SendMessages, socket.GetPointer());
+  ASSERT_GE(threadID, 0);
+
+  igtl::MessageReader::Pointer reader = igtl::MessageReader::New();
+  reader->SetSocket(clientSocket);
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+
+  // Small messages: many per recv()
+  for (int i = 0; i < NUMBER_OF_TRANSFORMS; i++)
+    {
+    ASSERT_EQ(reader->ReadHeader(headerMsg), 1);
+    ASSERT_STREQ(headerMsg->GetDeviceType(), "TRANSFORM");
+    ASSERT_TRUE(reader->GetHeaderPointer() != NULL);
+    igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+    transformMsg->SetMessageHeader(headerMsg);
+    transformMsg->AllocatePack();
+    if (i % 10 == 0)
+      {
+      // View of the body, without copying it
+      const void* body = reader->GetBodyPointer();
+      ASSERT_TRUE(body != NULL);
+      memcpy(transformMsg->GetPackBodyPointer(), body, transformMsg->GetPackBodySize());
+      }
+    else
+      {
+      ASSERT_EQ(reader->ReadBody(transformMsg), 1);
+      }
+    EXPECT_EQ(reader->GetBodySizeToRead(), 0);
+    ASSERT_TRUE(transformMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+    igtl::Matrix4x4 matrix;
+    transformMsg->GetMatrix(matrix);
+    ASSERT_FLOAT_EQ(matrix[0][3], (float)i);
+    }
+  EXPECT_LT(reader->GetNumberOfReceiveCalls(), (igtl_uint64)NUMBER_OF_TRANSFORMS / 10);
+
+  // Large body, read directly into the message
+  ASSERT_EQ(reader->ReadHeader(headerMsg), 1);
+  ASSERT_STREQ(headerMsg->GetDeviceType(), "IMAGE");
+  EXPECT_TRUE(reader->GetBodyPointer() == NULL);
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetMessageHeader(headerMsg);
+  imageMsg->AllocatePack();
+  ASSERT_EQ(reader->ReadBody(imageMsg), 1);
+  ASSERT_TRUE(imageMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  bool equal = true;
+  for (int i = 0; i < imageMsg->GetImageSize() && equal; i++)
+    {
+    equal = ((unsigned char*)imageMsg->GetScalarPointer())[i] == (unsigned char)(i * 3);
+    }
+  EXPECT_TRUE(equal);
+
+  ASSERT_EQ(reader->ReadHeader(headerMsg), 1);
+  ASSERT_STREQ(headerMsg->GetDeviceType(), "STATUS");
+
+  // The bodies left unread are skipped.
+  ASSERT_EQ(reader->ReadHeader(headerMsg), 1);
+  ASSERT_STREQ(headerMsg->GetDeviceType(), "IMAGE");
+  ASSERT_EQ(reader->ReadHeader(headerMsg), 1);
+  ASSERT_STREQ(headerMsg->GetDeviceType(), "STATUS");
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetMessageHeader(headerMsg);
+  statusMsg->AllocatePack();
+  ASSERT_EQ(reader->ReadBody(statusMsg), 1);
+  ASSERT_TRUE(statusMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_STREQ(statusMsg->GetStatusString(), "Done");
+
+  threader->TerminateThread(threadID);
+  socket->CloseSocket();
+  EXPECT_EQ(reader->ReadHeader(headerMsg), 0);
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlMessageSender.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlOSUtil.h"
+#include "igtlServerSocket.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <algorithm>
+#include <vector>
+
+#define NUMBER_OF_CLIENTS 2
+
+TEST(MessageSenderTest, MultiplexedSend)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+
+  igtl::ClientSocket::Pointer clientSockets[NUMBER_OF_CLIENTS];
+  igtl::MessageSender::Pointer senders[NUMBER_OF_CLIENTS];
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    clientSockets[i] = igtl::ClientSocket::New();
+    ASSERT_EQ(clientSockets[i]->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+    clientSockets[i]->SetReceiveTimeout(10);
+    igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+    ASSERT_TRUE(socket.IsNotNull());
+    socket->SetSendBlocking(0);
+    senders[i] = igtl::MessageSender::New();
+    senders[i]->SetSocket(socket);
+    }
+
+  // Larger than the socket buffers
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {1024, 1024, 16};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  for (int i = 0; i < imageMsg->GetImageSize(); i++)
+    {
+    ((unsigned char*)imageMsg->GetScalarPointer())[i] = (unsigned char)(i * 7);
+    }
+  imageMsg->Pack();
+  int messageSize = imageMsg->GetPackSize();
+
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    ASSERT_EQ(senders[i]->Start(imageMsg), 0);
+    EXPECT_TRUE(senders[i]->IsPending());
+    EXPECT_GT(senders[i]->GetBytesSent(), 0);
+    EXPECT_EQ(senders[i]->GetBytesSent() + senders[i]->GetBytesRemaining(), messageSize);
+    EXPECT_EQ(senders[i]->Start(imageMsg), -1);
+    }
+
+  // The clients read in the same thread as the senders write.
+  std::vector<char> received[NUMBER_OF_CLIENTS];
+  int receivedSize[NUMBER_OF_CLIENTS];
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    received[i].resize(messageSize);
+    receivedSize[i] = 0;
+    }
+  bool done = false;
+  for (int loop = 0; loop < 100000 && !done; loop++)
+    {
+    done = true;
+    for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+      {
+      ASSERT_GE(senders[i]->Resume(), 0);
+      if (receivedSize[i] < messageSize)
+        {
+        int r = clientSockets[i]->Receive(&received[i][receivedSize[i]],
+                                          std::min(65536, messageSize - receivedSize[i]), 0);
+        ASSERT_NE(r, 0);
+        if (r > 0)
+          {
+          receivedSize[i] += r;
+          }
+        }
+      done = done && !senders[i]->IsPending() && receivedSize[i] == messageSize;
+      }
+    }
+  ASSERT_TRUE(done);
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    EXPECT_EQ(memcmp(&received[i][0], imageMsg->GetPackPointer(), messageSize), 0);
+    // Nothing pending
+    EXPECT_EQ(senders[i]->Resume(), 1);
+    }
+
+  // A small message is sent at once.
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  EXPECT_EQ(senders[0]->Start(transformMsg), 1);
+  EXPECT_FALSE(senders[0]->IsPending());
+
+  // Disconnected
+  clientSockets[1]->CloseSocket();
+  int r = 1;
+  for (int i = 0; i < 100 && r >= 0; i++)
+    {
+    r = senders[1]->Start(transformMsg);
+    igtl::Sleep(10);
+    }
+  EXPECT_EQ(r, -1);
+  EXPECT_FALSE(senders[1]->IsPending());
+
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    senders[i]->GetSocket()->CloseSocket();
+    clientSockets[i]->CloseSocket();
+    }
+  serverSocket->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,176 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlOutboundMessageQueue.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlOSUtil.h"
+#include "igtlServerSocket.h"
+#include "igtlStatusMessage.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define MB (1024 * 1024)
+
+// Larger than the socket buffers, so that sending it blocks until the client reads it.
+igtl::ImageMessage::Pointer CreateImage(int value)
+{
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {1024, 1024, 16};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  memset(imageMsg->GetScalarPointer(), value, imageMsg->GetImageSize());
+  imageMsg->Pack();
+  return imageMsg;
+}
+
+igtl::TransformMessage::Pointer CreateTransform(float x)
+{
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+  matrix[0][3] = x;
+  transformMsg->SetMatrix(matrix);
+  transformMsg->Pack();
+  return transformMsg;
+}
+
+igtl::StatusMessage::Pointer CreateStatus()
+{
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("Server");
+  statusMsg->SetStatusString("OK");
+  statusMsg->Pack();
+  return statusMsg;
+}
+
+// Receives a message and unpacks its header. Returns the message type.
+std::string ReceiveMessage(igtl::ClientSocket* socket, igtl::MessageBase* message)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+    {
+    return "";
+    }
+  headerMsg->Unpack();
+  message->SetMessageHeader(headerMsg);
+  message->AllocatePack();
+  if (socket->Receive(message->GetPackBodyPointer(), message->GetPackBodySize()) != message->GetPackBodySize())
+    {
+    return "";
+    }
+  return headerMsg->GetMessageType();
+}
+
+TEST(OutboundMessageQueueTest, ConflationAndWatermarks)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  clientSocket->SetReceiveTimeout(5000);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::OutboundMessageQueue::Pointer queue = igtl::OutboundMessageQueue::New();
+  EXPECT_EQ(queue->Push(CreateStatus()), 0);
+  queue->SetSocket(socket);
+  queue->SetWatermarks(24 * MB, 8 * MB);
+  ASSERT_EQ(queue->Start(), 1);
+
+  // The client does not read: the first image blocks the sending thread.
+  ASSERT_EQ(queue->Push(CreateImage(0)), 1);
+  for (int i = 0; i < 500 && queue->GetNumberOfQueuedMessages() > 0; i++)
+    {
+    igtl::Sleep(10);
+    }
+  ASSERT_EQ(queue->GetNumberOfQueuedMessages(), 0);
+
+  // The transforms replace each other, and the images too.
+  ASSERT_EQ(queue->Push(CreateImage(1)), 1);
+  for (int i = 0; i < 10; i++)
+    {
+    EXPECT_EQ(queue->Push(CreateTransform((float)i)), 1);
+    }
+  ASSERT_EQ(queue->Push(CreateImage(2)), 1);
+  EXPECT_EQ(queue->GetNumberOfQueuedMessages(), 2);
+  EXPECT_EQ(queue->GetNumberOfMessagesConflated(), 10u);
+  EXPECT_FALSE(queue->IsCongested());
+
+  // Congested once the high watermark is reached: only the replacements are queued.
+  queue->AddConflatedType("STATUS");
+  ASSERT_EQ(queue->Push(CreateStatus()), 1);
+  queue->RemoveConflatedType("STATUS");
+  igtl::StatusMessage::Pointer largeStatusMsg = igtl::StatusMessage::New();
+  largeStatusMsg->SetDeviceName("Server");
+  largeStatusMsg->SetStatusString(std::string(10 * MB, 'x').c_str());
+  largeStatusMsg->Pack();
+  ASSERT_EQ(queue->Push(largeStatusMsg), 1);
+  EXPECT_TRUE(queue->IsCongested());
+  EXPECT_EQ(queue->Push(CreateStatus()), 0);
+  EXPECT_EQ(queue->Push(CreateTransform(10.0f)), 1);
+  EXPECT_EQ(queue->GetNumberOfQueuedMessages(), 4);
+  EXPECT_EQ(queue->GetNumberOfMessagesDropped(), 1u);
+
+  // Received in the order of the first messages of each device, with the latest values.
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  ASSERT_EQ(ReceiveMessage(clientSocket, imageMsg), "IMAGE");
+  ASSERT_TRUE(imageMsg->Unpack() & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_EQ(((unsigned char*)imageMsg->GetScalarPointer())[0], 0);
+  ASSERT_EQ(ReceiveMessage(clientSocket, imageMsg), "IMAGE");
+  ASSERT_TRUE(imageMsg->Unpack() & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_EQ(((unsigned char*)imageMsg->GetScalarPointer())[0], 2);
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  ASSERT_EQ(ReceiveMessage(clientSocket, transformMsg), "TRANSFORM");
+  ASSERT_TRUE(transformMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  igtl::Matrix4x4 matrix;
+  transformMsg->GetMatrix(matrix);
+  EXPECT_FLOAT_EQ(matrix[0][3], 10.0f);
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  ASSERT_EQ(ReceiveMessage(clientSocket, statusMsg), "STATUS");
+  ASSERT_TRUE(statusMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY);
+  EXPECT_STREQ(statusMsg->GetStatusString(), "OK");
+  ASSERT_EQ(ReceiveMessage(clientSocket, statusMsg), "STATUS");
+
+  for (int i = 0; i < 500 && queue->GetNumberOfMessagesSent() < 5; i++)
+    {
+    igtl::Sleep(10);
+    }
+  EXPECT_EQ(queue->GetNumberOfMessagesSent(), 5u);
+  EXPECT_FALSE(queue->IsCongested());
+  EXPECT_EQ(queue->GetQueuedSize(), 0u);
+
+  // Stopped by itself when the client disconnects
+  clientSocket->CloseSocket();
+  for (int i = 0; i < 500 && queue->IsRunning(); i++)
+    {
+    queue->Push(CreateTransform(0.0f));
+    igtl::Sleep(10);
+    }
+  EXPECT_FALSE(queue->IsRunning());
+  EXPECT_EQ(queue->Push(CreateTransform(0.0f)), 0);
+  queue->Stop();
+  socket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,158 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlPackedMessage.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlServerSocket.h"
+#include "igtlThreadPool.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#define NUMBER_OF_CLIENTS 4
+
+// Larger than the socket buffers, so that sending it blocks until the client reads it.
+igtl::ImageMessage::Pointer CreateImage(int value)
+{
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {1024, 1024, 4};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  memset(imageMsg->GetScalarPointer(), value, imageMsg->GetImageSize());
+  imageMsg->Pack();
+  return imageMsg;
+}
+
+// Receives a message with its CRC checked. Returns false if it cannot be received or unpacked.
+bool ReceiveMessage(igtl::ClientSocket* socket, igtl::MessageBase* message)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+    {
+    return false;
+    }
+  headerMsg->Unpack();
+  message->SetMessageHeader(headerMsg);
+  message->AllocatePack();
+  if (socket->Receive(message->GetPackBodyPointer(), message->GetPackBodySize()) != message->GetPackBodySize())
+    {
+    return false;
+    }
+  return (message->Unpack(1) & igtl::MessageBase::UNPACK_BODY) != 0;
+}
+
+struct BroadcastData
+{
+  igtl::PackedMessage*                packed;
+  std::vector<igtl::Socket::Pointer>  sockets;
+  std::vector<int>                    results;
+  int                                 sent;
+};
+
+void* Broadcast(void* ptr)
+{
+  BroadcastData* data = static_cast<BroadcastData*>(ptr);
+  data->sent = data->packed->Send(data->sockets, &data->results);
+  return NULL;
+}
+
+TEST(PackedMessageTest, Create)
+{
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  EXPECT_TRUE(igtl::PackedMessage::Create(NULL).IsNull());
+  EXPECT_TRUE(igtl::PackedMessage::Create(transformMsg).IsNull());
+
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  igtl::PackedMessage::Pointer packed = igtl::PackedMessage::Create(transformMsg);
+  ASSERT_TRUE(packed.IsNotNull());
+  EXPECT_EQ(packed->GetMessageType(), "TRANSFORM");
+  EXPECT_EQ(packed->GetDeviceName(), "Tracker");
+  ASSERT_EQ(packed->GetPackSize(), (igtl_uint64)transformMsg->GetPackSize());
+  EXPECT_EQ(memcmp(packed->GetPackPointer(), transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 0);
+
+  // A buffer must hold the whole body.
+  EXPECT_TRUE(igtl::PackedMessage::Create(transformMsg->GetPackPointer(), transformMsg->GetPackSize() - 1).IsNull());
+}
+
+TEST(PackedMessageTest, SendToSockets)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  std::vector<igtl::ClientSocket::Pointer> clientSockets;
+  BroadcastData data;
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+    ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+    clientSocket->SetReceiveTimeout(5000);
+    clientSockets.push_back(clientSocket);
+    igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+    ASSERT_TRUE(socket.IsNotNull());
+    data.sockets.push_back(igtl::Socket::Pointer(socket.GetPointer()));
+    }
+
+  // The packed message is not changed when its message is packed again.
+  igtl::ImageMessage::Pointer imageMsg = CreateImage(1);
+  igtl::PackedMessage::Pointer packed = igtl::PackedMessage::Create(imageMsg);
+  ASSERT_TRUE(packed.IsNotNull());
+  memset(imageMsg->GetScalarPointer(), 2, imageMsg->GetImageSize());
+  imageMsg->SetDeviceName("Other");
+  imageMsg->Pack();
+
+  // Sent to the sockets in parallel while the clients read one after the other.
+  data.packed = packed;
+  data.sent = -1;
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  pool->ReserveWorkers(1);
+  igtl::ThreadPoolFuture::Pointer future = pool->Submit(Broadcast, &data);
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    igtl::ImageMessage::Pointer received = igtl::ImageMessage::New();
+    ASSERT_TRUE(ReceiveMessage(clientSockets[i], received));
+    EXPECT_STREQ(received->GetDeviceName(), "Camera");
+    EXPECT_EQ(((unsigned char*)received->GetScalarPointer())[received->GetImageSize() - 1], 1);
+    }
+  future->Wait();
+  EXPECT_EQ(data.sent, NUMBER_OF_CLIENTS);
+  ASSERT_EQ(data.results.size(), (size_t)NUMBER_OF_CLIENTS);
+  EXPECT_EQ(data.results[0], 1);
+
+  // A socket that fails does not prevent sending to the others.
+  clientSockets[1]->CloseSocket();
+  data.sockets[1]->CloseSocket();
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  EXPECT_EQ(igtl::PackedMessage::Create(transformMsg)->Send(data.sockets, &data.results), NUMBER_OF_CLIENTS - 1);
+  EXPECT_EQ(data.results[1], 0);
+  igtl::TransformMessage::Pointer received = igtl::TransformMessage::New();
+  EXPECT_TRUE(ReceiveMessage(clientSockets[2], received));
+
+  for (int i = 0; i < NUMBER_OF_CLIENTS; i++)
+    {
+    clientSockets[i]->CloseSocket();
+    data.sockets[i]->CloseSocket();
+    }
+  serverSocket->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
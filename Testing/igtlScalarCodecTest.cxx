@@ -0,0 +1,253 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlScalarCodec.h"
+#include "igtlImageMessage.h"
+#include "igtlNDArrayMessage.h"
+#include "igtlStringMessage.h"
+#include "igtl_header.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+#include <stdlib.h>
+
+// Smooth 16-bit scalars with a little noise, like a CT slice
+void CreateScalars(std::vector<igtl_uint16>& scalars, int count)
+{
+  srand(1);
+  scalars.resize(count);
+  for (int i = 0; i < count; i ++)
+    {
+    scalars[i] = (igtl_uint16)(1000 + (i % 256) * 4 + (i / 4096) + (rand() % 4));
+    }
+}
+
+// Simulates the reception of a packed message: the header, then the body.
+igtl::MessageBase::Pointer Receive(igtl::MessageBase* msg)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  memcpy(headerMsg->GetPackPointer(), msg->GetPackPointer(), IGTL_HEADER_SIZE);
+  headerMsg->Unpack();
+  igtl::MessageBase::Pointer received = igtl::MessageBase::New();
+  received->SetMessageHeader(headerMsg);
+  received->AllocatePack();
+  memcpy(received->GetPackBodyPointer(), (char*)msg->GetPackPointer() + IGTL_HEADER_SIZE,
+         received->GetPackBodySize());
+  return received;
+}
+
+TEST(ScalarCodecTest, CompressDecompress)
+{
+  igtl::ScalarCodec::Pointer codec = igtl::ScalarCodec::New();
+  std::vector<igtl_uint16> scalars;
+  CreateScalars(scalars, 300000);
+  int size = (int)(scalars.size() * sizeof(igtl_uint16));
+
+  for (int threads = 0; threads <= 4; threads += 2)
+    {
+    codec->SetNumberOfThreads(threads);
+    std::vector<unsigned char> encoded;
+    int encodedSize = codec->Compress(&scalars[0], size, 2, 65536, encoded);
+    ASSERT_GT(encodedSize, 0);
+    EXPECT_EQ(encodedSize, (int)encoded.size());
+    EXPECT_LT(encodedSize, size / 2);
+    ASSERT_EQ(igtl::ScalarCodec::GetDecompressedSize(&encoded[0], encodedSize), size);
+
+    std::vector<igtl_uint16> decoded(scalars.size());
+    ASSERT_EQ(codec->Decompress(&encoded[0], encodedSize, &decoded[0], size), size);
+    EXPECT_TRUE(decoded == scalars);
+    }
+
+  // Incompressible data is stored, and sizes that are not a multiple of the chunk size
+  // or of the scalar size are kept.
+  std::vector<unsigned char> noise(100003);
+  for (size_t i = 0; i < noise.size(); i ++)
+    {
+    noise[i] = (unsigned char)(rand() >> 4);
+    }
+  std::vector<unsigned char> encoded(3, 0);
+  int encodedSize = codec->Compress(&noise[0], (int)noise.size(), 8, 10000, encoded);
+  ASSERT_GT(encodedSize, 0);
+  EXPECT_EQ(encoded.size(), (size_t)encodedSize + 3);
+  EXPECT_LT(encodedSize, (int)noise.size() + 100);
+  std::vector<unsigned char> decoded(noise.size());
+  ASSERT_EQ(codec->Decompress(&encoded[3], encodedSize, &decoded[0], (int)decoded.size()), (int)noise.size());
+  EXPECT_TRUE(decoded == noise);
+
+  // Long runs and long literals
+  std::vector<unsigned char> runs(70000, 7);
+  memcpy(&runs[1000], &noise[0], 5000);
+  encoded.clear();
+  encodedSize = codec->Compress(&runs[0], (int)runs.size(), 1, 1 << 20, encoded);
+  EXPECT_LT(encodedSize, 6000);
+  decoded.assign(runs.size(), 0);
+  ASSERT_EQ(codec->Decompress(&encoded[0], encodedSize, &decoded[0], (int)decoded.size()), (int)runs.size());
+  EXPECT_TRUE(decoded == runs);
+
+  // Empty
+  encoded.clear();
+  encodedSize = codec->Compress(NULL, 0, 2, 100, encoded);
+  ASSERT_GT(encodedSize, 0);
+  EXPECT_EQ(codec->GetDecompressedSize(&encoded[0], encodedSize), 0);
+}
+
+TEST(ScalarCodecTest, CorruptedStream)
+{
+  igtl::ScalarCodec::Pointer codec = igtl::ScalarCodec::New();
+  std::vector<igtl_uint16> scalars;
+  CreateScalars(scalars, 50000);
+  int size = (int)(scalars.size() * sizeof(igtl_uint16));
+  std::vector<unsigned char> encoded;
+  int encodedSize = codec->Compress(&scalars[0], size, 2, 8192, encoded);
+  std::vector<igtl_uint16> decoded(scalars.size());
+
+  // Wrong output size, truncated stream, bad magic
+  EXPECT_EQ(codec->Decompress(&encoded[0], encodedSize, &decoded[0], size - 2), 0);
+  EXPECT_EQ(codec->Decompress(&encoded[0], encodedSize - 1, &decoded[0], size), 0);
+  std::vector<unsigned char> corrupted(encoded);
+  corrupted[0] = 'X';
+  EXPECT_EQ(igtl::ScalarCodec::GetDecompressedSize(&corrupted[0], encodedSize), -1);
+
+  // Corrupted bytes never write out of the output.
+  srand(2);
+  for (int trial = 0; trial < 200; trial ++)
+    {
+    corrupted = encoded;
+    for (int n = 0; n < 4; n ++)
+      {
+      corrupted[20 + rand() % (encodedSize - 20)] ^= (unsigned char)(1 + rand() % 255);
+      }
+    codec->Decompress(&corrupted[0], encodedSize, &decoded[0], size);
+    }
+}
+
+TEST(ScalarCodecTest, ImageMessage)
+{
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  imageMsg->SetDeviceName("CT");
+  imageMsg->SetTimeStamp(12, 34);
+  imageMsg->SetDimensions(128, 96, 20);
+  imageMsg->SetSubVolume(128, 96, 10, 0, 0, 5);
+  imageMsg->SetSpacing(0.5f, 0.5f, 2.0f);
+  imageMsg->SetOrigin(1.0f, 2.0f, 3.0f);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT16);
+  imageMsg->SetMetaDataElement("Patient", IANA_TYPE_US_ASCII, "Phantom");
+  imageMsg->AllocateScalars();
+  std::vector<igtl_uint16> scalars;
+  CreateScalars(scalars, 128 * 96 * 10);
+  memcpy(imageMsg->GetScalarPointer(), &scalars[0], imageMsg->GetSubVolumeImageSize());
+
+  igtl::ScalarCodec::Pointer codec = igtl::ScalarCodec::New();
+  igtl::MessageBase::Pointer encoded = codec->Encode(imageMsg);
+  ASSERT_TRUE(encoded.IsNotNull());
+  EXPECT_EQ(encoded->GetMessageType(), "IMAGE");
+  EXPECT_LT(encoded->GetPackSize(), imageMsg->GetPackSize() / 2);
+
+  igtl::MessageBase::Pointer received = Receive(encoded);
+  EXPECT_TRUE(igtl::ScalarCodec::IsEncoded(received) == false); // meta data not unpacked yet
+  igtl::ImageMessage::Pointer decoded = igtl::ImageMessage::New();
+  ASSERT_EQ(codec->Decode(received, decoded), 1);
+  EXPECT_TRUE(igtl::ScalarCodec::IsEncoded(received));
+  EXPECT_FALSE(igtl::ScalarCodec::IsEncoded(decoded));
+
+  EXPECT_STREQ(decoded->GetDeviceName(), "CT");
+  unsigned int sec;
+  unsigned int frac;
+  decoded->GetTimeStamp(&sec, &frac);
+  EXPECT_EQ(sec, 12u);
+  int dim[3];
+  int subDim[3];
+  int subOff[3];
+  float origin[3];
+  decoded->GetDimensions(dim);
+  decoded->GetSubVolume(subDim, subOff);
+  decoded->GetOrigin(origin);
+  EXPECT_EQ(dim[2], 20);
+  EXPECT_EQ(subDim[2], 10);
+  EXPECT_EQ(subOff[2], 5);
+  EXPECT_FLOAT_EQ(origin[1], 2.0f);
+  std::string patient;
+  EXPECT_TRUE(decoded->GetMetaDataElement("Patient", patient));
+  EXPECT_EQ(patient, "Phantom");
+  ASSERT_EQ(decoded->GetSubVolumeImageSize(), imageMsg->GetSubVolumeImageSize());
+  EXPECT_EQ(memcmp(decoded->GetScalarPointer(), &scalars[0], decoded->GetSubVolumeImageSize()), 0);
+
+  // CRC check
+  received = Receive(encoded);
+  ((unsigned char*)received->GetPackBodyPointer())[200] ^= 1;
+  decoded = igtl::ImageMessage::New();
+  EXPECT_EQ(codec->Decode(received, decoded), 0);
+
+  // Header version 1 and other types are not encoded.
+  imageMsg->SetHeaderVersion(IGTL_HEADER_VERSION_1);
+  EXPECT_TRUE(codec->Encode(imageMsg).IsNull());
+  igtl::StringMessage::Pointer stringMsg = igtl::StringMessage::New();
+  stringMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  stringMsg->SetString("text");
+  EXPECT_TRUE(codec->Encode(stringMsg).IsNull());
+}
+
+TEST(ScalarCodecTest, NDArrayMessage)
+{
+  std::vector<igtlUint16> size(3);
+  size[0] = 40;
+  size[1] = 30;
+  size[2] = 20;
+  igtl::Array<igtl_float32> array;
+  array.SetSize(size);
+  igtl_float32* values = (igtl_float32*)array.GetRawArray();
+  for (int i = 0; i < 40 * 30 * 20; i ++)
+    {
+    values[i] = (igtl_float32)(i / 100);
+    }
+  igtl::NDArrayMessage::Pointer arrayMsg = igtl::NDArrayMessage::New();
+  arrayMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  arrayMsg->SetDeviceName("Dose");
+  arrayMsg->SetArray(igtl::NDArrayMessage::TYPE_FLOAT32, &array);
+
+  igtl::ScalarCodec::Pointer codec = igtl::ScalarCodec::New();
+  codec->SetChunkSize(10000);
+  codec->SetNumberOfThreads(3);
+  igtl::MessageBase::Pointer encoded = codec->Encode(arrayMsg);
+  ASSERT_TRUE(encoded.IsNotNull());
+  EXPECT_LT(encoded->GetPackSize(), arrayMsg->GetPackSize() / 4);
+
+  igtl::MessageBase::Pointer received = Receive(encoded);
+  igtl::NDArrayMessage::Pointer decoded = igtl::NDArrayMessage::New();
+  ASSERT_EQ(codec->Decode(received, decoded), 1);
+  ASSERT_EQ(decoded->GetType(), igtl::NDArrayMessage::TYPE_FLOAT32);
+  igtl::ArrayBase* decodedArray = decoded->GetArray();
+  ASSERT_TRUE(decodedArray != NULL);
+  ASSERT_EQ(decodedArray->GetRawArraySize(), array.GetRawArraySize());
+  EXPECT_EQ(memcmp(decodedArray->GetRawArray(), array.GetRawArray(), array.GetRawArraySize()), 0);
+}
+
+TEST(ScalarCodecTest, Negotiation)
+{
+  igtl::GetImageMessage::Pointer request = igtl::GetImageMessage::New();
+  EXPECT_FALSE(igtl::ScalarCodec::IsEncodingAccepted(request));
+  igtl::ScalarCodec::SetAcceptEncoding(request);
+  EXPECT_TRUE(igtl::ScalarCodec::IsEncodingAccepted(request));
+
+  request->SetMetaDataElement(IGTL_ACCEPT_CONTENT_ENCODING, IANA_TYPE_US_ASCII, "zstd, shuffle-lz");
+  EXPECT_TRUE(igtl::ScalarCodec::IsEncodingAccepted(request));
+  request->SetMetaDataElement(IGTL_ACCEPT_CONTENT_ENCODING, IANA_TYPE_US_ASCII, "zstd");
+  EXPECT_FALSE(igtl::ScalarCodec::IsEncodingAccepted(request));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
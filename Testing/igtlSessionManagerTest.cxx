@@ -0,0 +1,269 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlSessionManager.h"
+#include "igtlClientSocket.h"
+#include "igtlImageMessage.h"
+#include "igtlMessageHandlerMacro.h"
+#include "igtlMultiThreader.h"
+#include "igtlServerSocket.h"
+#include "igtlStatusMessage.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+typedef struct {
+  int numberOfTransforms;
+  int numberOfStatus;
+} ReceivedCount;
+
+igtlMessageHandlerClassMacro(igtl::TransformMessage, TransformHandler, ReceivedCount);
+igtlMessageHandlerClassMacro(igtl::StatusMessage, StatusHandler, ReceivedCount);
+
+int TransformHandler::Process(igtl::TransformMessage*, ReceivedCount* count)
+{
+  count->numberOfTransforms++;
+  return 1;
+}
+
+int StatusHandler::Process(igtl::StatusMessage*, ReceivedCount* count)
+{
+  count->numberOfStatus++;
+  return 1;
+}
+
+// Sends a large image, a status and a transform.
+void* SendMessages(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  igtl::Socket* socket = static_cast<igtl::Socket*>(info->UserData);
+
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {1024, 1024, 8};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  memset(imageMsg->GetScalarPointer(), 0, imageMsg->GetImageSize());
+  imageMsg->Pack();
+  socket->Send(imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+
+  igtl::StatusMessage::Pointer statusMsg = igtl::StatusMessage::New();
+  statusMsg->SetDeviceName("Server");
+  statusMsg->SetStatusString("OK");
+  statusMsg->Pack();
+  socket->Send(statusMsg->GetPackPointer(), statusMsg->GetPackSize());
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize());
+  return NULL;
+}
+
+TEST(SessionManagerTest, SkipLargeBody)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  int threadID = threader->SpawnThread((igtl::ThreadFunctionType)&SendMessages, socket.GetPointer());
+  ASSERT_GE(threadID, 0);
+
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  EXPECT_STREQ(headerMsg->GetDeviceType(), "IMAGE");
+  // The body is larger than the socket buffers: it is skipped as it arrives, even without skipFully.
+  EXPECT_EQ(clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0), headerMsg->GetBodySizeToRead());
+
+  // The following messages are read as sent.
+  headerMsg->InitPack();
+  ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  EXPECT_STREQ(headerMsg->GetDeviceType(), "STATUS");
+  EXPECT_STREQ(headerMsg->GetDeviceName(), "Server");
+  EXPECT_EQ(clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0), headerMsg->GetBodySizeToRead());
+  headerMsg->InitPack();
+  ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  EXPECT_STREQ(headerMsg->GetDeviceType(), "TRANSFORM");
+  EXPECT_EQ(clientSocket->Skip(headerMsg->GetBodySizeToRead()), headerMsg->GetBodySizeToRead());
+
+  // Nothing to skip, then fewer bytes than requested: the timeout ends the call.
+  clientSocket->SetReceiveTimeout(10);
+  EXPECT_EQ(clientSocket->Skip(100, 0), -1);
+  EXPECT_EQ(clientSocket->Skip(100), -1);
+  char data[50] = {0};
+  ASSERT_EQ(socket->Send(data, 50), 1);
+  EXPECT_EQ(clientSocket->Skip(100), 50);
+  ASSERT_EQ(socket->Send(data, 50), 1);
+  EXPECT_EQ(clientSocket->Skip(100, 0), 50);
+
+  threader->TerminateThread(threadID);
+  socket->CloseSocket();
+  EXPECT_EQ(clientSocket->Skip(100), 0);
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+TEST(SessionManagerTest, Subscription)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+
+  ReceivedCount count;
+  count.numberOfTransforms = 0;
+  count.numberOfStatus = 0;
+  TransformHandler::Pointer transformHandler = TransformHandler::New();
+  transformHandler->SetData(&count);
+  StatusHandler::Pointer statusHandler = StatusHandler::New();
+  statusHandler->SetData(&count);
+
+  igtl::SessionManager::Pointer sessionManager = igtl::SessionManager::New();
+  sessionManager->SetMode(igtl::SessionManager::MODE_CLIENT);
+  sessionManager->SetHostname("127.0.0.1");
+  sessionManager->SetPort(serverSocket->GetServerPort());
+  sessionManager->AddMessageHandler(transformHandler);
+  sessionManager->AddMessageHandler(statusHandler);
+  EXPECT_EQ(sessionManager->AddSubscription("TRANSFORM"), 1);
+  EXPECT_EQ(sessionManager->AddSubscription("TRANSFORM"), 0);
+  EXPECT_EQ(sessionManager->AddSubscription("IMGMETA"), 1);
+  EXPECT_EQ(sessionManager->RemoveSubscription("IMGMETA"), 1);
+  EXPECT_EQ(sessionManager->RemoveSubscription("IMGMETA"), 0);
+  ASSERT_EQ(sessionManager->Connect(), 1);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  int threadID = threader->SpawnThread((igtl::ThreadFunctionType)&SendMessages, socket.GetPointer());
+  ASSERT_GE(threadID, 0);
+
+  // The image and the status are discarded, though a handler is registered for the status.
+  for (int i = 0; i < 100000 && count.numberOfTransforms == 0; i++)
+    {
+    ASSERT_NE(sessionManager->ProcessMessage(), 0);
+    }
+  EXPECT_EQ(count.numberOfTransforms, 1);
+  EXPECT_EQ(count.numberOfStatus, 0);
+
+  threader->TerminateThread(threadID);
+  sessionManager->Disconnect();
+  socket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+TEST(SessionManagerTest, PushMessageIntegrityMode)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer("127.0.0.1", serverSocket->GetServerPort()), 0);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::SessionManager::Pointer sessionManager = igtl::SessionManager::New();
+  sessionManager->SetIntegrityMode(igtl::MessageBase::INTEGRITY_NONE);
+  ASSERT_EQ(sessionManager->Connect(socket), 1);
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  transformMsg->SetDeviceName("Tracker");
+  igtl::Matrix4x4 matrix;
+  igtl::IdentityMatrix(matrix);
+  matrix[0][3] = 12.5;
+  transformMsg->SetMatrix(matrix);
+  transformMsg->Pack();
+  std::vector<char> packed((char*)transformMsg->GetPackPointer(),
+                           (char*)transformMsg->GetPackPointer() + transformMsg->GetPackSize());
+
+  // The message is sent with the mode of the session, and left as packed by the caller.
+  ASSERT_EQ(sessionManager->PushMessage(transformMsg), 1);
+  EXPECT_EQ(transformMsg->GetIntegrityMode(), igtl::MessageBase::INTEGRITY_CRC64);
+  ASSERT_EQ(transformMsg->GetPackSize(), (int)packed.size());
+  EXPECT_EQ(memcmp(transformMsg->GetPackPointer(), &packed[0], packed.size()), 0);
+
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  ASSERT_EQ(clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()), headerMsg->GetPackSize());
+  headerMsg->Unpack();
+  headerMsg->SetAcceptIntegrityNone(true);
+  igtl::TransformMessage::Pointer receivedMsg = igtl::TransformMessage::New();
+  receivedMsg->SetMessageHeader(headerMsg);
+  receivedMsg->AllocatePack();
+  ASSERT_EQ(clientSocket->Receive(receivedMsg->GetPackBodyPointer(), receivedMsg->GetPackBodySize()),
+            receivedMsg->GetPackBodySize());
+  EXPECT_TRUE(receivedMsg->Unpack(1) & igtl::MessageBase::UNPACK_BODY);
+  std::string integrity;
+  EXPECT_TRUE(receivedMsg->GetMetaDataElement(IGTL_INTEGRITY, integrity));
+  EXPECT_EQ(integrity, IGTL_INTEGRITY_NONE);
+  EXPECT_STREQ(receivedMsg->GetDeviceName(), "Tracker");
+  igtl::Matrix4x4 receivedMatrix;
+  receivedMsg->GetMatrix(receivedMatrix);
+  EXPECT_FLOAT_EQ(receivedMatrix[0][3], 12.5);
+
+  sessionManager->Disconnect();
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+TEST(SessionManagerTest, AcceptIntegrityNone)
+{
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(0), 0);
+
+  ReceivedCount count;
+  count.numberOfTransforms = 0;
+  count.numberOfStatus = 0;
+  TransformHandler::Pointer transformHandler = TransformHandler::New();
+  transformHandler->SetData(&count);
+
+  // The messages without CRC are passed to the handlers, which check the CRC, once accepted.
+  igtl::SessionManager::Pointer sessionManager = igtl::SessionManager::New();
+  EXPECT_FALSE(sessionManager->GetAcceptIntegrityNone());
+  sessionManager->SetAcceptIntegrityNone(true);
+  sessionManager->SetMode(igtl::SessionManager::MODE_CLIENT);
+  sessionManager->SetHostname("127.0.0.1");
+  sessionManager->SetPort(serverSocket->GetServerPort());
+  sessionManager->AddMessageHandler(transformHandler);
+  ASSERT_EQ(sessionManager->Connect(), 1);
+  igtl::ClientSocket::Pointer socket = serverSocket->WaitForConnection(1000);
+  ASSERT_TRUE(socket.IsNotNull());
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->SetIntegrityMode(igtl::MessageBase::INTEGRITY_NONE);
+  transformMsg->Pack();
+  ASSERT_EQ(socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize()), 1);
+  for (int i = 0; i < 100000 && count.numberOfTransforms == 0; i++)
+    {
+    ASSERT_NE(sessionManager->ProcessMessage(), 0);
+    }
+  EXPECT_EQ(count.numberOfTransforms, 1);
+
+  sessionManager->Disconnect();
+  socket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,230 @@
+/*=========================================================================
+
+ Program:   OpenIGTLink Library
+ Language:  C++
+
+ Copyright (c) Insight Software Consortium. All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+
+ =========================================================================*/
+
+#include "igtlSharedMemorySocket.h"
+#include "igtlImageMessage.h"
+#include "igtlMessageHandlerMacro.h"
+#include "igtlMultiThreader.h"
+#include "igtlSessionManager.h"
+#include "igtlTransformMessage.h"
+#include "igtlTestConfig.h"
+#include "string.h"
+
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+// Smaller than the image, so that the sender waits for the receiver.
+#define BUFFER_SIZE 65536
+
+igtlMessageHandlerClassMacro(igtl::TransformMessage, TransformHandler, int);
+
+int TransformHandler::Process(igtl::TransformMessage*, int* count)
+{
+  (*count)++;
+  return 1;
+}
+
+std::string GetSegmentName()
+{
+  std::stringstream ss;
+  ss << "/igtl-test-" << getpid();
+  return ss.str();
+}
+
+// Sends an image and a transform, then closes the socket.
+void* SendMessages(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  igtl::Socket* socket = static_cast<igtl::Socket*>(info->UserData);
+
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  imageMsg->SetDeviceName("Camera");
+  int size[3] = {512, 512, 4};
+  imageMsg->SetDimensions(size);
+  imageMsg->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+  imageMsg->AllocateScalars();
+  unsigned char* scalars = static_cast<unsigned char*>(imageMsg->GetScalarPointer());
+  for (int i = 0; i < imageMsg->GetImageSize(); i++)
+    {
+    scalars[i] = (unsigned char)(i % 251);
+    }
+  imageMsg->Pack();
+  socket->Send(imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  transformMsg->SetDeviceName("Tracker");
+  transformMsg->Pack();
+  socket->Send(transformMsg->GetPackPointer(), transformMsg->GetPackSize());
+  socket->CloseSocket();
+  return NULL;
+}
+
+bool ReceiveMessage(igtl::Socket* socket, igtl::MessageBase* message)
+{
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  headerMsg->InitPack();
+  if (socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize()) != headerMsg->GetPackSize())
+    {
+    return false;
+    }
+  headerMsg->Unpack();
+  message->SetMessageHeader(headerMsg);
+  message->AllocatePack();
+  if (socket->Receive(message->GetPackBodyPointer(), message->GetPackBodySize()) != message->GetPackBodySize())
+    {
+    return false;
+    }
+  return (message->Unpack(1) & igtl::MessageBase::UNPACK_BODY) != 0;
+}
+
+TEST(SharedMemorySocketTest, Connect)
+{
+  std::string name = GetSegmentName();
+  igtl::SharedMemorySocket::Pointer serverSocket = igtl::SharedMemorySocket::New();
+  igtl::SharedMemorySocket::Pointer clientSocket = igtl::SharedMemorySocket::New();
+  EXPECT_EQ(clientSocket->ConnectToServer(name.c_str()), -1);
+  ASSERT_EQ(serverSocket->CreateServer(name.c_str(), BUFFER_SIZE), 0);
+  EXPECT_FALSE(serverSocket->GetConnected());
+  EXPECT_EQ(serverSocket->WaitForConnection(10), -1);
+
+  // The name is used until a client connects.
+  igtl::SharedMemorySocket::Pointer otherSocket = igtl::SharedMemorySocket::New();
+  EXPECT_EQ(otherSocket->CreateServer(name.c_str(), BUFFER_SIZE), -1);
+
+  ASSERT_EQ(clientSocket->ConnectToServer(name.c_str()), 0);
+  ASSERT_EQ(serverSocket->WaitForConnection(1000), 0);
+  EXPECT_TRUE(serverSocket->GetConnected());
+  EXPECT_TRUE(clientSocket->GetConnected());
+  EXPECT_EQ(otherSocket->ConnectToServer(name.c_str()), -1);
+  EXPECT_EQ(otherSocket->CreateServer(name.c_str(), BUFFER_SIZE), 0);
+  otherSocket->CloseSocket();
+
+  // Timeout, then end of the connection after the data sent
+  char data[4] = {1, 2, 3, 4};
+  char received[8];
+  clientSocket->SetReceiveBlocking(0);
+  EXPECT_EQ(clientSocket->Receive(received, 4), -1);
+  EXPECT_EQ(clientSocket->Skip(4), -1);
+  EXPECT_EQ(serverSocket->Send(data, 4), 1);
+  serverSocket->CloseSocket();
+  EXPECT_FALSE(serverSocket->GetConnected());
+  EXPECT_EQ(clientSocket->Receive(received, 8, 0), 4);
+  EXPECT_EQ(memcmp(data, received, 4), 0);
+  EXPECT_EQ(clientSocket->Receive(received, 4), 0);
+  EXPECT_EQ(clientSocket->Send(data, 4), 0);
+  EXPECT_EQ(clientSocket->SendNonBlocking(data, 4), -1);
+  clientSocket->CloseSocket();
+}
+
+TEST(SharedMemorySocketTest, SendMessages)
+{
+  std::string name = GetSegmentName();
+  igtl::SharedMemorySocket::Pointer serverSocket = igtl::SharedMemorySocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(name.c_str(), BUFFER_SIZE), 0);
+  igtl::SharedMemorySocket::Pointer clientSocket = igtl::SharedMemorySocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer(name.c_str()), 0);
+  ASSERT_EQ(serverSocket->WaitForConnection(1000), 0);
+
+  // The buffer is filled without waiting, then the sender stops.
+  std::vector<char> data(2 * BUFFER_SIZE, 1);
+  EXPECT_EQ(clientSocket->SendNonBlocking(&data[0], (int)data.size()), BUFFER_SIZE);
+  EXPECT_EQ(clientSocket->SendNonBlocking(&data[0], (int)data.size()), 0);
+  EXPECT_EQ(serverSocket->Skip(BUFFER_SIZE), BUFFER_SIZE);
+
+  // The image is larger than the buffer and is read while it is sent.
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  int threadID = threader->SpawnThread((igtl::ThreadFunctionType)&SendMessages, serverSocket.GetPointer());
+  ASSERT_GE(threadID, 0);
+  igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+  ASSERT_TRUE(ReceiveMessage(clientSocket, imageMsg));
+  EXPECT_STREQ(imageMsg->GetDeviceName(), "Camera");
+  unsigned char* scalars = static_cast<unsigned char*>(imageMsg->GetScalarPointer());
+  EXPECT_EQ(scalars[imageMsg->GetImageSize() - 1], (unsigned char)((imageMsg->GetImageSize() - 1) % 251));
+  igtl::TransformMessage::Pointer transformMsg = igtl::TransformMessage::New();
+  ASSERT_TRUE(ReceiveMessage(clientSocket, transformMsg));
+  EXPECT_STREQ(transformMsg->GetDeviceName(), "Tracker");
+  threader->TerminateThread(threadID);
+  EXPECT_EQ(clientSocket->Skip(100), 0);
+  clientSocket->CloseSocket();
+}
+
+TEST(SharedMemorySocketTest, PositionWrap)
+{
+  // The size is rounded up to 131072 bytes, so that the offsets in the buffer stay
+  // continuous when the positions wrap at 4 GiB.
+  std::string name = GetSegmentName();
+  igtl::SharedMemorySocket::Pointer serverSocket = igtl::SharedMemorySocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(name.c_str(), 100000), 0);
+  igtl::SharedMemorySocket::Pointer clientSocket = igtl::SharedMemorySocket::New();
+  ASSERT_EQ(clientSocket->ConnectToServer(name.c_str()), 0);
+  ASSERT_EQ(serverSocket->WaitForConnection(1000), 0);
+
+  std::vector<char> data(2 * 131072);
+  EXPECT_EQ(clientSocket->SendNonBlocking(&data[0], (int)data.size()), 131072);
+  EXPECT_EQ(serverSocket->Skip(131072), 131072);
+
+  // Blocks of a size not dividing the buffer, each with its own content, past 2^32 bytes
+  const int blockSize = 99991;
+  std::vector<char> received(blockSize);
+  igtl_uint64 total = 131072;
+  for (int i = 0; total < 0x100000000ULL + 4 * blockSize; i++)
+    {
+    memset(&data[0], (char)i, blockSize);
+    data[blockSize - 1] = (char)(i >> 8);
+    ASSERT_EQ(clientSocket->SendNonBlocking(&data[0], blockSize), blockSize);
+    ASSERT_EQ(serverSocket->Receive(&received[0], blockSize), blockSize);
+    ASSERT_EQ(memcmp(&data[0], &received[0], blockSize), 0) << "block " << i;
+    total += blockSize;
+    }
+  clientSocket->CloseSocket();
+  serverSocket->CloseSocket();
+}
+
+TEST(SharedMemorySocketTest, SessionManager)
+{
+  std::string name = GetSegmentName();
+  igtl::SharedMemorySocket::Pointer serverSocket = igtl::SharedMemorySocket::New();
+  ASSERT_EQ(serverSocket->CreateServer(name.c_str(), BUFFER_SIZE), 0);
+  igtl::SharedMemorySocket::Pointer clientSocket = igtl::SharedMemorySocket::New();
+
+  int count = 0;
+  TransformHandler::Pointer transformHandler = TransformHandler::New();
+  transformHandler->SetData(&count);
+  igtl::SessionManager::Pointer sessionManager = igtl::SessionManager::New();
+  sessionManager->AddMessageHandler(transformHandler);
+  EXPECT_EQ(sessionManager->Connect(clientSocket), 0);
+  ASSERT_EQ(clientSocket->ConnectToServer(name.c_str()), 0);
+  ASSERT_EQ(sessionManager->Connect(clientSocket), 1);
+  ASSERT_EQ(serverSocket->WaitForConnection(1000), 0);
+
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  int threadID = threader->SpawnThread((igtl::ThreadFunctionType)&SendMessages, serverSocket.GetPointer());
+  ASSERT_GE(threadID, 0);
+  for (int i = 0; i < 100000 && count == 0; i++)
+    {
+    ASSERT_NE(sessionManager->ProcessMessage(), 0);
+    }
+  EXPECT_EQ(count, 1);
+
+  threader->TerminateThread(threadID);
+  sessionManager->Disconnect();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
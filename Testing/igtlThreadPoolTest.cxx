@@ -0,0 +1,208 @@
+/*=========================================================================
+ 
+ Program:   OpenIGTLink Library
+ Language:  C++
+ 
+ Copyright (c) Insight Software Consortium. All rights reserved.
+ 
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notices for more information.
+ 
+ =========================================================================*/
+
+#include "igtlThreadPool.h"
+#include "igtlConditionVariable.h"
+#include "igtlMultiThreader.h"
+#include "igtlTestConfig.h"
+#include <vector>
+#include <string.h>
+
+typedef struct {
+  igtl::ThreadPool* pool;
+  int value;
+  int result;
+} TaskData;
+
+void* SquareTask(void* ptr)
+{
+  TaskData* td = static_cast<TaskData*>(ptr);
+  td->result = td->value * td->value;
+  return &td->result;
+}
+
+// Submits the squares of 1 to value and waits for them from a task of the pool.
+void* NestedTask(void* ptr)
+{
+  TaskData* td = static_cast<TaskData*>(ptr);
+  std::vector<TaskData> children(td->value);
+  igtl::ThreadPoolFuture::Pointer future = igtl::ThreadPoolFuture::New();
+  for (int i = 0; i < td->value; i++)
+    {
+    children[i].value = i + 1;
+    td->pool->Submit(&SquareTask, &children[i], future);
+    }
+  future->Wait();
+  td->result = 0;
+  for (int i = 0; i < td->value; i++)
+    {
+    td->result += children[i].result;
+    }
+  return NULL;
+}
+
+void CountRange(int begin, int end, void* data)
+{
+  std::vector<int>* counts = static_cast<std::vector<int>*>(data);
+  for (int i = begin; i < end; i++)
+    {
+    (*counts)[i]++;
+    }
+}
+
+// Threads of a parallel region waiting for each other
+typedef struct {
+  igtl::SimpleMutexLock lock;
+  igtl::ConditionVariable::Pointer condition;
+  int numberOfThreads;
+  int arrived;
+} Barrier;
+
+void* WaitAtBarrier(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  Barrier* barrier = static_cast<Barrier*>(info->UserData);
+  barrier->lock.Lock();
+  barrier->arrived++;
+  if (barrier->arrived == barrier->numberOfThreads)
+    {
+    barrier->condition->Broadcast();
+    }
+  while (barrier->arrived < barrier->numberOfThreads)
+    {
+    barrier->condition->Wait(&barrier->lock);
+    }
+  barrier->lock.Unlock();
+  return NULL;
+}
+
+// Runs a parallel region of 4 threads waiting for each other.
+void* RunRegion(void* ptr)
+{
+  igtl::MultiThreader::ThreadInfo* info = static_cast<igtl::MultiThreader::ThreadInfo*>(ptr);
+  int* done = static_cast<int*>(info->UserData);
+  Barrier barrier;
+  barrier.condition = igtl::ConditionVariable::New();
+  barrier.numberOfThreads = 4;
+  barrier.arrived = 0;
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SetNumberOfThreads(4);
+  threader->SetSingleMethod(&WaitAtBarrier, &barrier);
+  threader->SingleMethodExecute();
+  done[info->ThreadID] = barrier.arrived;
+  return NULL;
+}
+
+TEST(ThreadPoolTest, SubmitAndWait)
+{
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  EXPECT_EQ(pool->ReserveWorkers(2), 2);
+  EXPECT_EQ(pool->ReserveWorkers(1), 2);
+  EXPECT_EQ(pool->GetNumberOfWorkers(), 2);
+  EXPECT_EQ(pool->GetCurrentWorkerIndex(), -1);
+
+  TaskData td;
+  td.value = 7;
+  igtl::ThreadPoolFuture::Pointer future = pool->Submit(&SquareTask, &td);
+  EXPECT_EQ(future->Wait(), &td.result);
+  EXPECT_TRUE(future->IsDone());
+  EXPECT_EQ(td.result, 49);
+
+  std::vector<TaskData> tasks(100);
+  igtl::ThreadPoolFuture::Pointer all = igtl::ThreadPoolFuture::New();
+  for (int i = 0; i < 100; i++)
+    {
+    tasks[i].value = i;
+    pool->Submit(&SquareTask, &tasks[i], all);
+    }
+  all->Wait();
+  for (int i = 0; i < 100; i++)
+    {
+    EXPECT_EQ(tasks[i].result, i * i);
+    }
+}
+
+TEST(ThreadPoolTest, NestedTasks)
+{
+  // More nested tasks than workers: the waiting tasks run the tasks they have submitted.
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  pool->ReserveWorkers(2);
+  std::vector<TaskData> tasks(8);
+  igtl::ThreadPoolFuture::Pointer future = igtl::ThreadPoolFuture::New();
+  for (int i = 0; i < 8; i++)
+    {
+    tasks[i].pool = pool;
+    tasks[i].value = 10;
+    pool->Submit(&NestedTask, &tasks[i], future);
+    }
+  future->Wait();
+  for (int i = 0; i < 8; i++)
+    {
+    EXPECT_EQ(tasks[i].result, 385);
+    }
+}
+
+TEST(ThreadPoolTest, ParallelFor)
+{
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  pool->ReserveWorkers(3);
+  std::vector<int> counts(1000, 0);
+  pool->ParallelFor(0, 1000, 7, &CountRange, &counts);
+  pool->ParallelFor(100, 900, 0, &CountRange, &counts);
+  for (int i = 0; i < 1000; i++)
+    {
+    EXPECT_EQ(counts[i], (i >= 100 && i < 900) ? 2 : 1);
+    }
+
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SetNumberOfThreads(4);
+  threader->ParallelFor(0, 1000, 0, &CountRange, &counts);
+  EXPECT_EQ(counts[0], 2);
+  EXPECT_EQ(counts[999], 2);
+  EXPECT_GE(igtl::MultiThreader::GetThreadPool()->GetNumberOfWorkers(), 3);
+}
+
+TEST(ThreadPoolTest, ConcurrentRegions)
+{
+  // The threads of each region get their own workers, whatever the other regions running.
+  int done[16];
+  igtl::MultiThreader::Pointer threader = igtl::MultiThreader::New();
+  threader->SetNumberOfThreads(16);
+  threader->SetSingleMethod(&RunRegion, done);
+  for (int i = 0; i < 5; i++)
+    {
+    memset(done, 0, sizeof(done));
+    threader->SingleMethodExecute();
+    for (int j = 0; j < 16; j++)
+      {
+      EXPECT_EQ(done[j], 4);
+      }
+    }
+}
+
+TEST(ThreadPoolTest, WorkerAffinity)
+{
+  igtl::ThreadPool::Pointer pool = igtl::ThreadPool::New();
+  pool->ReserveWorkers(1);
+  EXPECT_EQ(pool->SetWorkerAffinity(1, 0), 0);
+  EXPECT_EQ(pool->SetWorkerAffinity(0, -1), 0);
+#if defined(__linux__)
+  EXPECT_EQ(pool->SetWorkerAffinity(0, 0), 1);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -19,8 +19,32 @@
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
 
+#define TEST_DATA_SIZE 1000
+
 int main( int argc, char * argv [] )
 {
+  unsigned char data[TEST_DATA_SIZE];
+  igtl_uint64 crc;
+  igtl_uint64 crc1;
+  igtl_uint64 crc2;
+  int i;
+
+  for (i = 0; i < TEST_DATA_SIZE; i ++)
+    {
+    data[i] = (unsigned char)((i * 7919) >> 3);
+    }
+
+  /* The CRC64 of two blocks combined must be the CRC64 of the whole data */
+  crc = crc64(data, TEST_DATA_SIZE, 0LL);
+  for (i = 0; i <= TEST_DATA_SIZE; i += 37)
+    {
+    crc1 = crc64(data, i, 0LL);
+    crc2 = crc64(&data[i], TEST_DATA_SIZE - i, 0LL);
+    if (crc64_combine(crc1, crc2, TEST_DATA_SIZE - i) != crc)
+      {
+      return EXIT_FAILURE;
+      }
+    }
 
   return EXIT_SUCCESS;
 }